@@ -2503,6 +2503,21 @@ void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 	stagesurf->device->context->Unmap(stagesurf->texture, 0);
 }
 
+bool gs_stagesurface_ready(gs_stagesurf_t *stagesurf)
+{
+	D3D11_MAPPED_SUBRESOURCE map;
+	HRESULT hr = stagesurf->device->context->Map(
+		stagesurf->texture, 0, D3D11_MAP_READ,
+		D3D11_MAP_FLAG_DO_NOT_WAIT, &map);
+	if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+		return false;
+
+	/* let gs_stagesurface_map report any other error */
+	if (SUCCEEDED(hr))
+		stagesurf->device->context->Unmap(stagesurf->texture, 0);
+	return true;
+}
+
 void gs_zstencil_destroy(gs_zstencil_t *zstencil)
 {
 	delete zstencil;
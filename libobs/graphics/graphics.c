@@ -2542,6 +2542,29 @@ void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 	graphics->exports.gs_stagesurface_unmap(stagesurf);
 }
 
+bool gs_stagesurface_ready(gs_stagesurf_t *stagesurf)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_stagesurface_ready", stagesurf))
+		return false;
+
+	if (graphics->exports.gs_stagesurface_ready)
+		return graphics->exports.gs_stagesurface_ready(stagesurf);
+	else
+		return true;
+}
+
+bool gs_stagesurface_ready_supported(void)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_stagesurface_ready_supported"))
+		return false;
+
+	return graphics->exports.gs_stagesurface_ready != NULL;
+}
+
 void gs_zstencil_destroy(gs_zstencil_t *zstencil)
 {
 	if (!gs_valid("gs_zstencil_destroy"))
@@ -789,6 +789,8 @@ gs_stagesurface_get_color_format(const gs_stagesurf_t *stagesurf);
 EXPORT bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 				uint32_t *linesize);
 EXPORT void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf);
+EXPORT bool gs_stagesurface_ready(gs_stagesurf_t *stagesurf);
+EXPORT bool gs_stagesurface_ready_supported(void);
 
 EXPORT void gs_zstencil_destroy(gs_zstencil_t *zstencil);
 
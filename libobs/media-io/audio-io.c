@@ -26,6 +26,7 @@
 #include "../util/util_uint64.h"
 
 #include "audio-io.h"
+#include "audio-math.h"
 #include "audio-resampler.h"
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
@@ -37,21 +38,29 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 		int invalid = 0; \
 	} while (0)
 
-struct audio_input {
+/* Inputs of a mix that want the same conversion share a resample group, so
+ * each conversion is only computed once per tick no matter how many inputs
+ * want it. */
+struct audio_resample_group {
 	struct audio_convert_info conversion;
 	audio_resampler_t *resampler;
+	long refs;
+
+	/* output of the current tick */
+	struct audio_data data;
+	bool valid;
+};
+
+struct audio_input {
+	struct audio_resample_group *group;
 
 	audio_output_callback_t callback;
 	void *param;
 };
 
-static inline void audio_input_free(struct audio_input *input)
-{
-	audio_resampler_destroy(input->resampler);
-}
-
 struct audio_mix {
 	DARRAY(struct audio_input) inputs;
+	DARRAY(struct audio_resample_group *) groups;
 	float buffer[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
 };
 
@@ -64,6 +73,15 @@ struct audio_output {
 	pthread_t thread;
 	os_event_t *stop_event;
 
+	/* offline mode: the audio thread only processes audio up to the time
+	 * given to audio_output_advance */
+	os_sem_t *advance_sem;
+	os_sem_t *advance_done;
+	uint64_t advance_time;
+
+	/* extra input callbacks requested with audio_output_add_tick */
+	volatile long extra_ticks;
+
 	bool initialized;
 
 	audio_input_callback_t input_cb;
@@ -74,12 +92,12 @@ struct audio_output {
 
 /* ------------------------------------------------------------------------- */
 
-static bool resample_audio_output(struct audio_input *input,
+static bool resample_audio_output(struct audio_resample_group *group,
 				  struct audio_data *data)
 {
 	bool success = true;
 
-	if (input->resampler) {
+	if (group->resampler) {
 		uint8_t *output[MAX_AV_PLANES];
 		uint32_t frames;
 		uint64_t offset;
@@ -87,7 +105,7 @@ static bool resample_audio_output(struct audio_input *input,
 		memset(output, 0, sizeof(output));
 
 		success = audio_resampler_resample(
-			input->resampler, output, &frames, &offset,
+			group->resampler, output, &frames, &offset,
 			(const uint8_t *const *)data->data, data->frames);
 
 		for (size_t i = 0; i < MAX_AV_PLANES; i++)
@@ -107,16 +125,29 @@ static inline void do_audio_output(struct audio_output *audio, size_t mix_idx,
 
 	pthread_mutex_lock(&audio->input_mutex);
 
+	for (size_t i = 0; i < mix->groups.num; i++) {
+		struct audio_resample_group *group = mix->groups.array[i];
+
+		memset(&group->data, 0, sizeof(group->data));
+		for (size_t i = 0; i < audio->planes; i++)
+			group->data.data[i] = (uint8_t *)mix->buffer[i];
+		group->data.frames = frames;
+		group->data.timestamp = timestamp;
+
+		group->valid = resample_audio_output(group, &group->data);
+	}
+
 	for (size_t i = mix->inputs.num; i > 0; i--) {
 		struct audio_input *input = mix->inputs.array + (i - 1);
 
-		for (size_t i = 0; i < audio->planes; i++)
-			data.data[i] = (uint8_t *)mix->buffer[i];
-		data.frames = frames;
-		data.timestamp = timestamp;
+		if (!input->group->valid)
+			continue;
 
-		if (resample_audio_output(input, &data))
-			input->callback(input->param, mix_idx, &data);
+		/* each input gets its own copy of the struct, but the planes
+		 * are shared with every input in the group, so callbacks must
+		 * treat the audio itself as read-only */
+		data = input->group->data;
+		input->callback(input->param, mix_idx, &data);
 	}
 
 	pthread_mutex_unlock(&audio->input_mutex);
@@ -133,24 +164,16 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 		if (!mix->inputs.num)
 			continue;
 
-		for (size_t plane = 0; plane < audio->planes; plane++) {
-			float *mix_data = mix->buffer[plane];
-			float *mix_end = &mix_data[float_size];
-
-			while (mix_data < mix_end) {
-				float val = *mix_data;
-				val = (val > 1.0f) ? 1.0f : val;
-				val = (val < -1.0f) ? -1.0f : val;
-				*(mix_data++) = val;
-			}
-		}
+		for (size_t plane = 0; plane < audio->planes; plane++)
+			audio_clamp_floats(mix->buffer[plane], float_size);
 	}
 }
 
 static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 			     uint64_t prev_time)
 {
-	size_t bytes = AUDIO_OUTPUT_FRAMES * audio->block_size;
+	uint32_t frames = audio->info.frames_per_tick;
+	size_t bytes = frames * audio->block_size;
 	struct audio_output_data data[MAX_AUDIO_MIXES];
 	uint32_t active_mixes = 0;
 	uint64_t new_ts = 0;
@@ -192,19 +215,20 @@ static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 
 	/* output */
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
-		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
+		do_audio_output(audio, i, new_ts, frames);
 }
 
 static void *audio_thread(void *param)
 {
 	struct audio_output *audio = param;
 	size_t rate = audio->info.samples_per_sec;
+	uint32_t frames = audio->info.frames_per_tick;
 	uint64_t samples = 0;
 	uint64_t start_time = os_gettime_ns();
 	uint64_t prev_time = start_time;
 	uint64_t audio_time = prev_time;
-	uint32_t audio_wait_time = (uint32_t)(
-		audio_frames_to_ns(rate, AUDIO_OUTPUT_FRAMES) / 1000000);
+	uint32_t audio_wait_time =
+		(uint32_t)(audio_frames_to_ns(rate, frames) / 1000000);
 
 	os_set_thread_name("audio-io: audio thread");
 
@@ -215,13 +239,18 @@ static void *audio_thread(void *param)
 	while (os_event_try(audio->stop_event) == EAGAIN) {
 		uint64_t cur_time;
 
-		os_sleep_ms(audio_wait_time);
+		if (audio->info.offline) {
+			os_sem_wait(audio->advance_sem);
+			cur_time = audio->advance_time;
+		} else {
+			os_sleep_ms(audio_wait_time);
+			cur_time = os_gettime_ns();
+		}
 
 		profile_start(audio_thread_name);
 
-		cur_time = os_gettime_ns();
 		while (audio_time <= cur_time) {
-			samples += AUDIO_OUTPUT_FRAMES;
+			samples += frames;
 			audio_time =
 				start_time + audio_frames_to_ns(rate, samples);
 
@@ -229,11 +258,23 @@ static void *audio_thread(void *param)
 			prev_time = audio_time;
 		}
 
+		while (os_atomic_load_long(&audio->extra_ticks) > 0) {
+			os_atomic_dec_long(&audio->extra_ticks);
+			input_and_output(audio, prev_time, prev_time);
+		}
+
 		profile_end(audio_thread_name);
 
+		if (audio->info.offline)
+			os_sem_post(audio->advance_done);
+
 		profile_reenable_thread();
 	}
 
+	/* don't leave a caller of audio_output_advance waiting */
+	if (audio->info.offline)
+		os_sem_post(audio->advance_done);
+
 	return NULL;
 }
 
@@ -254,33 +295,68 @@ static size_t audio_get_input_idx(const audio_t *audio, size_t mix_idx,
 	return DARRAY_INVALID;
 }
 
-static inline bool audio_input_init(struct audio_input *input,
-				    struct audio_output *audio)
+static inline bool same_conversion(const struct audio_convert_info *a,
+				   const struct audio_convert_info *b)
+{
+	return a->format == b->format &&
+	       a->samples_per_sec == b->samples_per_sec &&
+	       a->speakers == b->speakers;
+}
+
+static struct audio_resample_group *
+get_resample_group(struct audio_output *audio, struct audio_mix *mix,
+		   const struct audio_convert_info *conversion)
 {
-	if (input->conversion.format != audio->info.format ||
-	    input->conversion.samples_per_sec != audio->info.samples_per_sec ||
-	    input->conversion.speakers != audio->info.speakers) {
+	struct audio_resample_group *group;
+
+	for (size_t i = 0; i < mix->groups.num; i++) {
+		group = mix->groups.array[i];
+
+		if (same_conversion(&group->conversion, conversion)) {
+			group->refs++;
+			return group;
+		}
+	}
+
+	group = bzalloc(sizeof(*group));
+	group->conversion = *conversion;
+	group->refs = 1;
+
+	if (conversion->format != audio->info.format ||
+	    conversion->samples_per_sec != audio->info.samples_per_sec ||
+	    conversion->speakers != audio->info.speakers) {
 		struct resample_info from = {
 			.format = audio->info.format,
 			.samples_per_sec = audio->info.samples_per_sec,
 			.speakers = audio->info.speakers};
 
 		struct resample_info to = {
-			.format = input->conversion.format,
-			.samples_per_sec = input->conversion.samples_per_sec,
-			.speakers = input->conversion.speakers};
+			.format = conversion->format,
+			.samples_per_sec = conversion->samples_per_sec,
+			.speakers = conversion->speakers};
 
-		input->resampler = audio_resampler_create(&to, &from);
-		if (!input->resampler) {
-			blog(LOG_ERROR, "audio_input_init: Failed to "
+		group->resampler = audio_resampler_create(&to, &from);
+		if (!group->resampler) {
+			blog(LOG_ERROR, "audio_output_connect: Failed to "
 					"create resampler");
-			return false;
+			bfree(group);
+			return NULL;
 		}
-	} else {
-		input->resampler = NULL;
 	}
 
-	return true;
+	da_push_back(mix->groups, &group);
+	return group;
+}
+
+static void release_resample_group(struct audio_mix *mix,
+				   struct audio_resample_group *group)
+{
+	if (--group->refs > 0)
+		return;
+
+	da_erase_item(mix->groups, &group);
+	audio_resampler_destroy(group->resampler);
+	bfree(group);
 }
 
 bool audio_output_connect(audio_t *audio, size_t mi,
@@ -296,28 +372,28 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 
 	if (audio_get_input_idx(audio, mi, callback, param) == DARRAY_INVALID) {
 		struct audio_mix *mix = &audio->mixes[mi];
+		struct audio_convert_info conv;
 		struct audio_input input;
 		input.callback = callback;
 		input.param = param;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			conv = *conversion;
 		} else {
-			input.conversion.format = audio->info.format;
-			input.conversion.speakers = audio->info.speakers;
-			input.conversion.samples_per_sec =
-				audio->info.samples_per_sec;
+			conv.format = audio->info.format;
+			conv.speakers = audio->info.speakers;
+			conv.samples_per_sec = audio->info.samples_per_sec;
 		}
 
-		if (input.conversion.format == AUDIO_FORMAT_UNKNOWN)
-			input.conversion.format = audio->info.format;
-		if (input.conversion.speakers == SPEAKERS_UNKNOWN)
-			input.conversion.speakers = audio->info.speakers;
-		if (input.conversion.samples_per_sec == 0)
-			input.conversion.samples_per_sec =
-				audio->info.samples_per_sec;
+		if (conv.format == AUDIO_FORMAT_UNKNOWN)
+			conv.format = audio->info.format;
+		if (conv.speakers == SPEAKERS_UNKNOWN)
+			conv.speakers = audio->info.speakers;
+		if (conv.samples_per_sec == 0)
+			conv.samples_per_sec = audio->info.samples_per_sec;
 
-		success = audio_input_init(&input, audio);
+		input.group = get_resample_group(audio, mix, &conv);
+		success = input.group != NULL;
 		if (success)
 			da_push_back(mix->inputs, &input);
 	}
@@ -338,7 +414,7 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 	size_t idx = audio_get_input_idx(audio, mix_idx, callback, param);
 	if (idx != DARRAY_INVALID) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
-		audio_input_free(mix->inputs.array + idx);
+		release_resample_group(mix, mix->inputs.array[idx].group);
 		da_erase(mix->inputs, idx);
 	}
 
@@ -348,7 +424,10 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 static inline bool valid_audio_params(const struct audio_output_info *info)
 {
 	return info->format && info->name && info->samples_per_sec > 0 &&
-	       info->speakers > 0;
+	       info->speakers > 0 &&
+	       (!info->frames_per_tick ||
+		(info->frames_per_tick >= AUDIO_OUTPUT_MIN_FRAMES &&
+		 info->frames_per_tick <= AUDIO_OUTPUT_FRAMES));
 }
 
 int audio_output_open(audio_t **audio, struct audio_output_info *info)
@@ -364,6 +443,8 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 		goto fail0;
 
 	memcpy(&out->info, info, sizeof(struct audio_output_info));
+	if (!out->info.frames_per_tick)
+		out->info.frames_per_tick = AUDIO_OUTPUT_FRAMES;
 	out->channels = get_audio_channels(info->speakers);
 	out->planes = planar ? out->channels : 1;
 	out->input_cb = info->input_callback;
@@ -375,13 +456,21 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 		goto fail0;
 	if (os_event_init(&out->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail1;
-	if (pthread_create(&out->thread, NULL, audio_thread, out) != 0)
+	if (os_sem_init(&out->advance_sem, 0) != 0)
 		goto fail2;
+	if (os_sem_init(&out->advance_done, 0) != 0)
+		goto fail3;
+	if (pthread_create(&out->thread, NULL, audio_thread, out) != 0)
+		goto fail4;
 
 	out->initialized = true;
 	*audio = out;
 	return AUDIO_OUTPUT_SUCCESS;
 
+fail4:
+	os_sem_destroy(out->advance_done);
+fail3:
+	os_sem_destroy(out->advance_sem);
 fail2:
 	os_event_destroy(out->stop_event);
 fail1:
@@ -400,8 +489,11 @@ void audio_output_close(audio_t *audio)
 
 	if (audio->initialized) {
 		os_event_signal(audio->stop_event);
+		os_sem_post(audio->advance_sem);
 		pthread_join(audio->thread, &thread_ret);
 		os_event_destroy(audio->stop_event);
+		os_sem_destroy(audio->advance_sem);
+		os_sem_destroy(audio->advance_done);
 		pthread_mutex_destroy(&audio->input_mutex);
 	}
 
@@ -409,9 +501,10 @@ void audio_output_close(audio_t *audio)
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		for (size_t i = 0; i < mix->inputs.num; i++)
-			audio_input_free(mix->inputs.array + i);
+			release_resample_group(mix, mix->inputs.array[i].group);
 
 		da_free(mix->inputs);
+		da_free(mix->groups);
 	}
 	bfree(audio);
 }
@@ -421,6 +514,24 @@ const struct audio_output_info *audio_output_get_info(const audio_t *audio)
 	return audio ? &audio->info : NULL;
 }
 
+void audio_output_advance(audio_t *audio, uint64_t time)
+{
+	if (!audio || !audio->initialized || !audio->info.offline)
+		return;
+	if (os_event_try(audio->stop_event) != EAGAIN)
+		return;
+
+	audio->advance_time = time;
+	os_sem_post(audio->advance_sem);
+	os_sem_wait(audio->advance_done);
+}
+
+void audio_output_add_tick(audio_t *audio)
+{
+	if (audio)
+		os_atomic_inc_long(&audio->extra_ticks);
+}
+
 bool audio_output_active(const audio_t *audio)
 {
 	if (!audio)
@@ -455,3 +566,8 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 {
 	return audio ? audio->info.samples_per_sec : 0;
 }
+
+uint32_t audio_output_get_frames_per_tick(const audio_t *audio)
+{
+	return audio ? audio->info.frames_per_tick : 0;
+}
@@ -28,6 +28,7 @@ extern "C" {
 #define MAX_AUDIO_MIXES 6
 #define MAX_AUDIO_CHANNELS 8
 #define AUDIO_OUTPUT_FRAMES 1024
+#define AUDIO_OUTPUT_MIN_FRAMES 64
 
 #define TOTAL_AUDIO_SIZE                                              \
 	(MAX_AUDIO_MIXES * MAX_AUDIO_CHANNELS * AUDIO_OUTPUT_FRAMES * \
@@ -99,6 +100,14 @@ struct audio_output_info {
 
 	audio_input_callback_t input_callback;
 	void *input_param;
+
+	/* don't follow the system clock; only process audio up to the time
+	 * given to audio_output_advance */
+	bool offline;
+
+	/* frames mixed and output per tick, from AUDIO_OUTPUT_MIN_FRAMES to
+	 * AUDIO_OUTPUT_FRAMES (0 for AUDIO_OUTPUT_FRAMES) */
+	uint32_t frames_per_tick;
 };
 
 struct audio_convert_info {
@@ -222,10 +231,20 @@ EXPORT void audio_output_disconnect(audio_t *video, size_t mix_idx,
 
 EXPORT bool audio_output_active(const audio_t *audio);
 
+/* calls the input callback one more time right after the current tick, with
+ * the same start and end time, so that the input can output a block it had
+ * buffered and lower its latency by one tick */
+EXPORT void audio_output_add_tick(audio_t *audio);
+
+/* offline mode only: processes every audio block up to the given time and
+ * returns once they have all been output */
+EXPORT void audio_output_advance(audio_t *audio, uint64_t time);
+
 EXPORT size_t audio_output_get_block_size(const audio_t *audio);
 EXPORT size_t audio_output_get_planes(const audio_t *audio);
 EXPORT size_t audio_output_get_channels(const audio_t *audio);
 EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
+EXPORT uint32_t audio_output_get_frames_per_tick(const audio_t *audio);
 EXPORT const struct audio_output_info *
 audio_output_get_info(const audio_t *audio);
 
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "../util/c99defs.h"
+#include "../util/sse-intrin.h"
 #include <math.h>
 
 #ifdef _MSC_VER
@@ -41,3 +42,127 @@ static inline float db_to_mul(const float db)
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
+
+/* adds count floats from src to dst */
+static inline void audio_mix_floats(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_add_ps(_mm_loadu_ps(dst + i),
+				      _mm_loadu_ps(src + i));
+		__m128 b = _mm_add_ps(_mm_loadu_ps(dst + i + 4),
+				      _mm_loadu_ps(src + i + 4));
+		_mm_storeu_ps(dst + i, a);
+		_mm_storeu_ps(dst + i + 4, b);
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+/* adds count floats from src multiplied by mul to dst */
+static inline void audio_mix_floats_mul(float *dst, const float *src,
+					const float *mul, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(src + i),
+				      _mm_loadu_ps(mul + i));
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), v));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i] * mul[i];
+}
+
+/* multiplies count floats by mul */
+static inline void audio_scale_floats(float *data, float mul, size_t count)
+{
+	const __m128 mul_val = _mm_set1_ps(mul);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(data + i), mul_val);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(data + i + 4), mul_val);
+		_mm_storeu_ps(data + i, a);
+		_mm_storeu_ps(data + i + 4, b);
+	}
+
+	for (; i < count; i++)
+		data[i] *= mul;
+}
+
+/* multiplies count floats by the matching floats of mul */
+static inline void audio_mul_floats(float *data, const float *mul,
+				    size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(data + i),
+				      _mm_loadu_ps(mul + i));
+		_mm_storeu_ps(data + i, v);
+	}
+
+	for (; i < count; i++)
+		data[i] *= mul[i];
+}
+
+/* raises count floats of dst to the absolute value of src where larger */
+static inline void audio_max_abs_floats(float *dst, const float *src,
+					size_t count)
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 v = _mm_andnot_ps(sign, _mm_loadu_ps(src + i));
+		_mm_storeu_ps(dst + i, _mm_max_ps(_mm_loadu_ps(dst + i), v));
+	}
+
+	for (; i < count; i++)
+		dst[i] = fmaxf(dst[i], fabsf(src[i]));
+}
+
+/* clamps count floats to the range [-1.0, 1.0] */
+static inline void audio_clamp_floats(float *data, size_t count)
+{
+	const __m128 min_val = _mm_set1_ps(-1.0f);
+	const __m128 max_val = _mm_set1_ps(1.0f);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 v = _mm_loadu_ps(data + i);
+		v = _mm_min_ps(_mm_max_ps(v, min_val), max_val);
+		_mm_storeu_ps(data + i, v);
+	}
+
+	for (; i < count; i++) {
+		float val = data[i];
+		val = (val > 1.0f) ? 1.0f : val;
+		val = (val < -1.0f) ? -1.0f : val;
+		data[i] = val;
+	}
+}
+
+/* returns whether all count floats are zero */
+static inline bool audio_floats_silent(const float *data, size_t count)
+{
+	__m128 bits = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+		bits = _mm_or_ps(bits, _mm_loadu_ps(data + i));
+
+	if (_mm_movemask_ps(_mm_cmpneq_ps(bits, _mm_setzero_ps())) != 0)
+		return false;
+
+	for (; i < count; i++) {
+		if (data[i] != 0.0f)
+			return false;
+	}
+
+	return true;
+}
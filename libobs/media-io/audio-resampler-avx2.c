@@ -0,0 +1,81 @@
+/******************************************************************************
+    Copyright (C) 2023 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/* AVX2 version of the polyphase filter kernel in audio-resampler-polyphase.c,
+ * kept separate for the same reason as format-conversion-avx2.c and only
+ * called after checking that the CPU supports AVX2. */
+
+#include "../util/c99defs.h"
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+     defined(_M_IX86)) &&                                             \
+	!defined(__e2k__) && !(defined(_M_ARM64) || defined(_M_ARM64EC))
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define AVX2_FUNC
+#else
+#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+
+/* taps are a multiple of 8 and every phase of the filter bank starts on a
+ * 32-byte boundary, so only the history loads are unaligned */
+AVX2_FUNC void polyphase_kernel_avx2(float *out, uint32_t out_frames,
+				     const float *hist, const float *coeffs,
+				     uint32_t taps, uint32_t phase,
+				     uint32_t phases, uint32_t step_int,
+				     uint32_t step_frac)
+{
+	for (uint32_t i = 0; i < out_frames; i++) {
+		const float *c = coeffs + (size_t)phase * taps;
+		__m256 sum0 = _mm256_setzero_ps();
+		__m256 sum1 = _mm256_setzero_ps();
+		uint32_t j = 0;
+
+		for (; j + 16 <= taps; j += 16) {
+			sum0 = _mm256_add_ps(
+				sum0, _mm256_mul_ps(_mm256_loadu_ps(hist + j),
+						    _mm256_load_ps(c + j)));
+			sum1 = _mm256_add_ps(
+				sum1,
+				_mm256_mul_ps(_mm256_loadu_ps(hist + j + 8),
+					      _mm256_load_ps(c + j + 8)));
+		}
+		if (j < taps)
+			sum0 = _mm256_add_ps(
+				sum0, _mm256_mul_ps(_mm256_loadu_ps(hist + j),
+						    _mm256_load_ps(c + j)));
+
+		sum0 = _mm256_add_ps(sum0, sum1);
+
+		__m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum0),
+					_mm256_extractf128_ps(sum0, 1));
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+		out[i] = _mm_cvtss_f32(sum);
+
+		hist += step_int;
+		phase += step_frac;
+		if (phase >= phases) {
+			phase -= phases;
+			hist++;
+		}
+	}
+}
+
+#endif
@@ -17,12 +17,17 @@
 
 #include "../util/bmem.h"
 #include "audio-resampler.h"
+#include "audio-resampler-polyphase.h"
 #include "audio-io.h"
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 
 struct audio_resampler {
+	/* set when the native backend is in use, in which case none of the
+	 * swresample state below is */
+	struct polyphase_resampler *native;
+
 	struct SwrContext *context;
 	bool opened;
 
@@ -91,8 +96,9 @@ static inline uint64_t convert_speaker_layout(enum speaker_layout layout)
 	return 0;
 }
 
-audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
-					  const struct resample_info *src)
+static audio_resampler_t *
+audio_resampler_create_ffmpeg(const struct resample_info *dst,
+			      const struct resample_info *src)
 {
 	struct audio_resampler *rs = bzalloc(sizeof(struct audio_resampler));
 	int errcode;
@@ -148,9 +154,55 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 	return rs;
 }
 
+static audio_resampler_t *
+audio_resampler_create_native(const struct resample_info *dst,
+			      const struct resample_info *src,
+			      enum audio_resampler_quality quality)
+{
+	struct polyphase_resampler *native =
+		polyphase_resampler_create(dst, src, quality);
+	if (!native)
+		return NULL;
+
+	struct audio_resampler *rs = bzalloc(sizeof(struct audio_resampler));
+	rs->native = native;
+	return rs;
+}
+
+audio_resampler_t *audio_resampler_create2(const struct resample_info *dst,
+					   const struct resample_info *src,
+					   enum audio_resampler_type type,
+					   enum audio_resampler_quality quality)
+{
+	switch (type) {
+	case AUDIO_RESAMPLER_POLYPHASE:
+		return audio_resampler_create_native(dst, src, quality);
+	case AUDIO_RESAMPLER_FFMPEG:
+		return audio_resampler_create_ffmpeg(dst, src);
+	case AUDIO_RESAMPLER_DEFAULT:
+		break;
+	}
+
+	/* the native backend only covers float planar output with the same
+	 * speaker layout (or a mono upmix), anything else goes through
+	 * swresample */
+	if (polyphase_resampler_supported(dst, src))
+		return audio_resampler_create_native(dst, src, quality);
+
+	return audio_resampler_create_ffmpeg(dst, src);
+}
+
+audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
+					  const struct resample_info *src)
+{
+	return audio_resampler_create2(dst, src, AUDIO_RESAMPLER_DEFAULT,
+				       AUDIO_RESAMPLER_QUALITY_MEDIUM);
+}
+
 void audio_resampler_destroy(audio_resampler_t *rs)
 {
 	if (rs) {
+		polyphase_resampler_destroy(rs->native);
 		if (rs->context)
 			swr_free(&rs->context);
 		if (rs->output_buffer[0])
@@ -167,6 +219,11 @@ bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
 	if (!rs)
 		return false;
 
+	if (rs->native)
+		return polyphase_resampler_resample(rs->native, output,
+						    out_frames, ts_offset,
+						    input, in_frames);
+
 	struct SwrContext *context = rs->context;
 	int ret;
 
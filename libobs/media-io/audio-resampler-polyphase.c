@@ -0,0 +1,484 @@
+/******************************************************************************
+    Copyright (C) 2023 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "../util/bmem.h"
+#include "../util/base.h"
+#include "../util/sse-intrin.h"
+#include "audio-resampler-polyphase.h"
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+     defined(_M_IX86)) &&                                             \
+	!defined(__e2k__) && !(defined(_M_ARM64) || defined(_M_ARM64EC))
+#define HAVE_AVX2_KERNELS
+
+/* format-conversion-avx2.c */
+extern bool format_conversion_cpu_has_avx2(void);
+
+/* audio-resampler-avx2.c */
+extern void polyphase_kernel_avx2(float *out, uint32_t out_frames,
+				  const float *hist, const float *coeffs,
+				  uint32_t taps, uint32_t phase,
+				  uint32_t phases, uint32_t step_int,
+				  uint32_t step_frac);
+#endif
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+/* the filter bank holds phases * taps coefficients, so keep both bounded */
+#define MAX_PHASES 1024
+#define MAX_TAPS 512
+
+struct polyphase_preset {
+	uint32_t taps;
+	double beta;
+	double rolloff;
+};
+
+static const struct polyphase_preset presets[] = {
+	[AUDIO_RESAMPLER_QUALITY_FAST] = {16, 6.0, 0.90},
+	[AUDIO_RESAMPLER_QUALITY_MEDIUM] = {32, 8.0, 0.94},
+	[AUDIO_RESAMPLER_QUALITY_HIGH] = {64, 10.0, 0.97},
+};
+
+/* mono upmix matrix, the same one the ffmpeg backend uses (LFE silent) */
+static const bool upmix_matrix[MAX_AUDIO_CHANNELS][MAX_AUDIO_CHANNELS] = {
+	{1},
+	{1, 1},
+	{1, 1, 0},
+	{1, 1, 1, 1},
+	{1, 1, 1, 0, 1},
+	{1, 1, 1, 1, 1, 1},
+	{1, 1, 1, 0, 1, 1, 1},
+	{1, 1, 1, 0, 1, 1, 1, 1},
+};
+
+struct polyphase_resampler {
+	uint32_t in_rate;
+	enum audio_format in_format;
+	uint32_t in_channels;
+	uint32_t out_channels;
+
+	/* output channels fed by the mono input when upmixing */
+	bool upmix;
+	bool upmix_map[MAX_AUDIO_CHANNELS];
+
+	uint32_t phases;
+	uint32_t step_int;
+	uint32_t step_frac;
+	uint32_t taps;
+	float *coeffs;
+	polyphase_kernel_t kernel;
+
+	/* unconsumed input per channel, starting taps / 2 - 1 samples before
+	 * the sample the next output is centered on */
+	float *hist[MAX_AUDIO_CHANNELS];
+	uint32_t hist_frames;
+	uint32_t hist_size;
+	uint32_t phase;
+
+	float *out_buf;
+	uint32_t out_size;
+};
+
+/* ------------------------------------------------------------------------- */
+/* Filter design */
+
+static uint32_t gcd_uint32(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static double bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	double half_x = x * 0.5;
+
+	for (int k = 1; k < 50; k++) {
+		term *= (half_x / k) * (half_x / k);
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+
+	return sum;
+}
+
+static inline uint32_t get_taps(uint32_t base_taps, uint32_t phases,
+				uint32_t step)
+{
+	/* widen the filter by the decimation factor when downsampling so the
+	 * lowered cutoff keeps the same transition band */
+	uint64_t taps = base_taps;
+	if (step > phases)
+		taps = ((uint64_t)base_taps * step + phases - 1) / phases;
+
+	return (uint32_t)((taps + 7) & ~7ULL);
+}
+
+static void design_filter(struct polyphase_resampler *rs,
+			  const struct polyphase_preset *preset, uint32_t step)
+{
+	const uint32_t taps = rs->taps;
+	const double half = (double)(taps / 2);
+	const double scale = step > rs->phases ? (double)rs->phases / step
+					       : 1.0;
+	const double cutoff = scale * preset->rolloff;
+	const double i0_beta = bessel_i0(preset->beta);
+
+	for (uint32_t p = 0; p < rs->phases; p++) {
+		float *c = rs->coeffs + (size_t)p * taps;
+		double sum = 0.0;
+
+		for (uint32_t j = 0; j < taps; j++) {
+			double x = (double)j - (half - 1.0) -
+				   (double)p / (double)rs->phases;
+			double t = x / half;
+			double w = bessel_i0(preset->beta *
+					     sqrt(fmax(0.0, 1.0 - t * t))) /
+				   i0_beta;
+			double s = x == 0.0 ? 1.0
+					    : sin(M_PI * cutoff * x) /
+						      (M_PI * cutoff * x);
+			double v = cutoff * s * w;
+
+			c[j] = (float)v;
+			sum += v;
+		}
+
+		/* unity DC gain for every phase */
+		for (uint32_t j = 0; j < taps; j++)
+			c[j] = (float)(c[j] / sum);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* Kernels */
+
+/* SIMDe maps these to the native vector instructions on non-x86 hosts */
+static void polyphase_kernel_sse(float *out, uint32_t out_frames,
+				 const float *hist, const float *coeffs,
+				 uint32_t taps, uint32_t phase, uint32_t phases,
+				 uint32_t step_int, uint32_t step_frac)
+{
+	for (uint32_t i = 0; i < out_frames; i++) {
+		const float *c = coeffs + (size_t)phase * taps;
+		__m128 sum0 = _mm_setzero_ps();
+		__m128 sum1 = _mm_setzero_ps();
+
+		for (uint32_t j = 0; j < taps; j += 8) {
+			sum0 = _mm_add_ps(sum0,
+					  _mm_mul_ps(_mm_loadu_ps(hist + j),
+						     _mm_load_ps(c + j)));
+			sum1 = _mm_add_ps(sum1,
+					  _mm_mul_ps(_mm_loadu_ps(hist + j + 4),
+						     _mm_load_ps(c + j + 4)));
+		}
+
+		sum0 = _mm_add_ps(sum0, sum1);
+		sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+		sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+		out[i] = _mm_cvtss_f32(sum0);
+
+		hist += step_int;
+		phase += step_frac;
+		if (phase >= phases) {
+			phase -= phases;
+			hist++;
+		}
+	}
+}
+
+static polyphase_kernel_t get_kernel(void)
+{
+#ifdef HAVE_AVX2_KERNELS
+	if (format_conversion_cpu_has_avx2())
+		return polyphase_kernel_avx2;
+#endif
+	return polyphase_kernel_sse;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Input conversion */
+
+static inline float sample_to_float(enum audio_format format,
+				    const uint8_t *data, size_t idx)
+{
+	switch (format) {
+	case AUDIO_FORMAT_U8BIT:
+	case AUDIO_FORMAT_U8BIT_PLANAR:
+		return ((float)data[idx] - 128.0f) / 128.0f;
+	case AUDIO_FORMAT_16BIT:
+	case AUDIO_FORMAT_16BIT_PLANAR:
+		return (float)((const int16_t *)data)[idx] / 32768.0f;
+	case AUDIO_FORMAT_32BIT:
+	case AUDIO_FORMAT_32BIT_PLANAR:
+		return (float)((double)((const int32_t *)data)[idx] /
+			       2147483648.0);
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		return ((const float *)data)[idx];
+	case AUDIO_FORMAT_UNKNOWN:
+		break;
+	}
+
+	return 0.0f;
+}
+
+static void convert_input(const struct polyphase_resampler *rs, float *dst[],
+			  uint32_t offset, const uint8_t *const input[],
+			  uint32_t frames)
+{
+	const uint32_t channels = rs->in_channels;
+
+	if (rs->in_format == AUDIO_FORMAT_FLOAT_PLANAR) {
+		for (uint32_t c = 0; c < channels; c++)
+			memcpy(dst[c] + offset, input[c],
+			       frames * sizeof(float));
+
+	} else if (is_audio_planar(rs->in_format)) {
+		for (uint32_t c = 0; c < channels; c++) {
+			float *out = dst[c] + offset;
+			for (uint32_t i = 0; i < frames; i++)
+				out[i] = sample_to_float(rs->in_format,
+							 input[c], i);
+		}
+
+	} else {
+		for (uint32_t c = 0; c < channels; c++) {
+			float *out = dst[c] + offset;
+			for (uint32_t i = 0; i < frames; i++)
+				out[i] = sample_to_float(
+					rs->in_format, input[0],
+					(size_t)i * channels + c);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+bool polyphase_resampler_supported(const struct resample_info *dst,
+				   const struct resample_info *src)
+{
+	if (dst->format != AUDIO_FORMAT_FLOAT_PLANAR ||
+	    src->format == AUDIO_FORMAT_UNKNOWN)
+		return false;
+	if (!dst->samples_per_sec || !src->samples_per_sec)
+		return false;
+	if (dst->speakers == SPEAKERS_UNKNOWN ||
+	    src->speakers == SPEAKERS_UNKNOWN)
+		return false;
+	if (src->speakers != dst->speakers && src->speakers != SPEAKERS_MONO)
+		return false;
+
+	uint32_t g = gcd_uint32(dst->samples_per_sec, src->samples_per_sec);
+	uint32_t phases = dst->samples_per_sec / g;
+	uint32_t step = src->samples_per_sec / g;
+
+	return phases <= MAX_PHASES &&
+	       get_taps(presets[AUDIO_RESAMPLER_QUALITY_HIGH].taps, phases,
+			step) <= MAX_TAPS;
+}
+
+struct polyphase_resampler *
+polyphase_resampler_create(const struct resample_info *dst,
+			   const struct resample_info *src,
+			   enum audio_resampler_quality quality)
+{
+	struct polyphase_resampler *rs;
+	uint32_t g, step;
+
+	if (!polyphase_resampler_supported(dst, src))
+		return NULL;
+	if (quality > AUDIO_RESAMPLER_QUALITY_HIGH)
+		quality = AUDIO_RESAMPLER_QUALITY_HIGH;
+
+	rs = bzalloc(sizeof(struct polyphase_resampler));
+	rs->in_rate = src->samples_per_sec;
+	rs->in_format = src->format;
+	rs->in_channels = get_audio_channels(src->speakers);
+	rs->out_channels = get_audio_channels(dst->speakers);
+	rs->upmix = rs->in_channels != rs->out_channels;
+
+	if (rs->upmix) {
+		for (uint32_t c = 0; c < rs->out_channels; c++)
+			rs->upmix_map[c] =
+				upmix_matrix[rs->out_channels - 1][c];
+	}
+
+	g = gcd_uint32(dst->samples_per_sec, src->samples_per_sec);
+	rs->phases = dst->samples_per_sec / g;
+	step = src->samples_per_sec / g;
+	rs->step_int = step / rs->phases;
+	rs->step_frac = step % rs->phases;
+	rs->kernel = get_kernel();
+
+	/* equal rates only need the format conversion */
+	if (rs->phases == 1 && step == 1)
+		return rs;
+
+	rs->taps = get_taps(presets[quality].taps, rs->phases, step);
+	rs->coeffs = bmalloc((size_t)rs->phases * rs->taps * sizeof(float));
+	design_filter(rs, &presets[quality], step);
+
+	/* prime the history so the first output lands on the first input */
+	rs->hist_frames = rs->taps / 2 - 1;
+	rs->hist_size = rs->taps;
+	for (uint32_t c = 0; c < rs->in_channels; c++)
+		rs->hist[c] = bzalloc(rs->hist_size * sizeof(float));
+
+	return rs;
+}
+
+void polyphase_resampler_destroy(struct polyphase_resampler *rs)
+{
+	if (rs) {
+		for (uint32_t c = 0; c < rs->in_channels; c++)
+			bfree(rs->hist[c]);
+		bfree(rs->coeffs);
+		bfree(rs->out_buf);
+		bfree(rs);
+	}
+}
+
+/* only reallocates when a bigger block comes in than ever before */
+static inline void ensure_output(struct polyphase_resampler *rs,
+				 uint32_t frames)
+{
+	if (frames > rs->out_size) {
+		/* keep every channel 32-byte aligned */
+		rs->out_size = (frames + 7) & ~7U;
+		bfree(rs->out_buf);
+		rs->out_buf = bmalloc((size_t)rs->out_size *
+				      rs->out_channels * sizeof(float));
+	}
+}
+
+static inline void ensure_history(struct polyphase_resampler *rs,
+				  uint32_t frames)
+{
+	if (frames > rs->hist_size) {
+		rs->hist_size = frames;
+		for (uint32_t c = 0; c < rs->in_channels; c++)
+			rs->hist[c] = brealloc(rs->hist[c],
+					       frames * sizeof(float));
+	}
+}
+
+static void finish_output(struct polyphase_resampler *rs, uint8_t *output[],
+			  uint32_t frames)
+{
+	float *out[MAX_AUDIO_CHANNELS];
+
+	for (uint32_t c = 0; c < rs->out_channels; c++) {
+		out[c] = rs->out_buf + (size_t)c * rs->out_size;
+		output[c] = (uint8_t *)out[c];
+	}
+
+	if (!rs->upmix)
+		return;
+
+	for (uint32_t c = 1; c < rs->out_channels; c++) {
+		if (rs->upmix_map[c])
+			memcpy(out[c], out[0], frames * sizeof(float));
+		else
+			memset(out[c], 0, frames * sizeof(float));
+	}
+}
+
+bool polyphase_resampler_resample(struct polyphase_resampler *rs,
+				  uint8_t *output[], uint32_t *out_frames,
+				  uint64_t *ts_offset,
+				  const uint8_t *const input[],
+				  uint32_t in_frames)
+{
+	float *out[MAX_AUDIO_CHANNELS];
+	const uint32_t taps = rs->taps;
+
+	if (!taps) {
+		ensure_output(rs, in_frames);
+		for (uint32_t c = 0; c < rs->in_channels; c++)
+			out[c] = rs->out_buf + (size_t)c * rs->out_size;
+
+		convert_input(rs, out, 0, input, in_frames);
+		finish_output(rs, output, in_frames);
+
+		*ts_offset = 0;
+		*out_frames = in_frames;
+		return true;
+	}
+
+	/* input time of the next output sample relative to the end of the
+	 * buffered input, measured before the new input is added */
+	double delay = (double)rs->hist_frames - (double)(taps / 2 - 1) -
+		       (double)rs->phase / (double)rs->phases;
+	*ts_offset = delay > 0.0 ? (uint64_t)(delay * 1000000000.0 /
+					      (double)rs->in_rate)
+				 : 0;
+
+	uint32_t avail = rs->hist_frames + in_frames;
+	ensure_history(rs, avail);
+	convert_input(rs, rs->hist, rs->hist_frames, input, in_frames);
+
+	/* walk the phase once to find how many outputs the input covers and
+	 * where the next call resumes */
+	uint32_t pos = 0;
+	uint32_t phase = rs->phase;
+	uint32_t frames = 0;
+
+	while (pos + taps <= avail) {
+		frames++;
+		pos += rs->step_int;
+		phase += rs->step_frac;
+		if (phase >= rs->phases) {
+			phase -= rs->phases;
+			pos++;
+		}
+	}
+
+	ensure_output(rs, frames);
+
+	for (uint32_t c = 0; c < rs->in_channels; c++) {
+		out[c] = rs->out_buf + (size_t)c * rs->out_size;
+		rs->kernel(out[c], frames, rs->hist[c], rs->coeffs, taps,
+			   rs->phase, rs->phases, rs->step_int, rs->step_frac);
+	}
+
+	/* taps always exceed the step, so pos never runs past the input */
+	if (pos) {
+		for (uint32_t c = 0; c < rs->in_channels; c++)
+			memmove(rs->hist[c], rs->hist[c] + pos,
+				(avail - pos) * sizeof(float));
+	}
+
+	rs->hist_frames = avail - pos;
+	rs->phase = phase;
+
+	finish_output(rs, output, frames);
+	*out_frames = frames;
+	return true;
+}
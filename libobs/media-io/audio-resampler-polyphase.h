@@ -0,0 +1,56 @@
+/******************************************************************************
+    Copyright (C) 2023 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+/* Built-in fixed-ratio polyphase resampler used as the native backend of
+ * audio-resampler.h.  Not exported; use audio_resampler_create2 instead. */
+
+#include "audio-resampler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct polyphase_resampler;
+
+/* per-channel filter kernel, produces out_frames samples starting at the
+ * given phase, stepping step_int input samples plus step_frac/phases of a
+ * sample for each output sample */
+typedef void (*polyphase_kernel_t)(float *out, uint32_t out_frames,
+				   const float *hist, const float *coeffs,
+				   uint32_t taps, uint32_t phase,
+				   uint32_t phases, uint32_t step_int,
+				   uint32_t step_frac);
+
+extern bool polyphase_resampler_supported(const struct resample_info *dst,
+					  const struct resample_info *src);
+extern struct polyphase_resampler *
+polyphase_resampler_create(const struct resample_info *dst,
+			   const struct resample_info *src,
+			   enum audio_resampler_quality quality);
+extern void polyphase_resampler_destroy(struct polyphase_resampler *rs);
+extern bool polyphase_resampler_resample(struct polyphase_resampler *rs,
+					 uint8_t *output[],
+					 uint32_t *out_frames,
+					 uint64_t *ts_offset,
+					 const uint8_t *const input[],
+					 uint32_t in_frames);
+
+#ifdef __cplusplus
+}
+#endif
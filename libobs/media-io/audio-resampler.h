@@ -33,9 +33,26 @@ struct resample_info {
 	enum speaker_layout speakers;
 };
 
+enum audio_resampler_type {
+	AUDIO_RESAMPLER_DEFAULT,
+	AUDIO_RESAMPLER_FFMPEG,
+	AUDIO_RESAMPLER_POLYPHASE,
+};
+
+enum audio_resampler_quality {
+	AUDIO_RESAMPLER_QUALITY_FAST,
+	AUDIO_RESAMPLER_QUALITY_MEDIUM,
+	AUDIO_RESAMPLER_QUALITY_HIGH,
+};
+
 EXPORT audio_resampler_t *
 audio_resampler_create(const struct resample_info *dst,
 		       const struct resample_info *src);
+EXPORT audio_resampler_t *
+audio_resampler_create2(const struct resample_info *dst,
+			const struct resample_info *src,
+			enum audio_resampler_type type,
+			enum audio_resampler_quality quality);
 EXPORT void audio_resampler_destroy(audio_resampler_t *resampler);
 
 EXPORT bool audio_resampler_resample(audio_resampler_t *resampler,
@@ -0,0 +1,273 @@
+/******************************************************************************
+    Copyright (C) 2023 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/* AVX2 versions of the packed 444 YUV packers in format-conversion.c.  These
+ * are kept in their own file so that the native AVX2 intrinsics don't clash
+ * with the SIMDe aliases pulled in by sse-intrin.h, and are only called after
+ * checking that the CPU supports AVX2. */
+
+#include "../util/c99defs.h"
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+     defined(_M_IX86)) &&                                             \
+	!defined(__e2k__) && !(defined(_M_ARM64) || defined(_M_ARM64EC))
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_FUNC
+#else
+#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+
+#define Z -1
+
+/* shuffle that gathers bytes of each 128-bit lane into the low eight bytes of
+ * the lane, so that ORing the lanes together (see gather_lanes) gives the low
+ * lane's picks followed by the high lane's picks */
+#define lane_shuffle(lo_0, lo_1, lo_2, lo_3, hi_0, hi_1, hi_2, hi_3)         \
+	_mm256_setr_epi8(lo_0, lo_1, lo_2, lo_3, hi_0, hi_1, hi_2, hi_3, Z, Z, \
+			 Z, Z, Z, Z, Z, Z, lo_0, lo_1, lo_2, lo_3, hi_0, hi_1, \
+			 hi_2, hi_3, Z, Z, Z, Z, Z, Z, Z, Z)
+
+#define LUM_LO lane_shuffle(1, 5, 9, 13, Z, Z, Z, Z)
+#define LUM_HI lane_shuffle(Z, Z, Z, Z, 1, 5, 9, 13)
+
+static AVX2_FUNC FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+static AVX2_FUNC FORCE_INLINE __m128i gather_lanes(__m256i val,
+						   __m256i lo_shuffle,
+						   __m256i hi_shuffle)
+{
+	__m256i lo = _mm256_shuffle_epi8(val, lo_shuffle);
+	__m256i hi = _mm256_shuffle_epi8(val, hi_shuffle);
+	return _mm_or_si128(_mm256_castsi256_si128(lo),
+			    _mm256_extracti128_si256(hi, 1));
+}
+
+/* averages the 2x2 blocks of chroma of two lines, leaving each pair of
+ * pixels as a 32-bit value holding the 16-bit U and V averages.  This matches
+ * the truncating average of the SSE2 version. */
+static AVX2_FUNC FORCE_INLINE __m256i avg_chroma(__m256i line1, __m256i line2)
+{
+	const __m256i uv_mask = _mm256_set1_epi16(0x00FF);
+	__m256i sum = _mm256_add_epi16(_mm256_and_si256(line1, uv_mask),
+				       _mm256_and_si256(line2, uv_mask));
+	sum = _mm256_hadd_epi32(sum, sum);
+	return _mm256_srli_epi16(sum, 2);
+}
+
+static AVX2_FUNC FORCE_INLINE __m256i load_8px(const uint8_t *line)
+{
+	return _mm256_loadu_si256((const __m256i *)line);
+}
+
+/* loads the last block of four pixels of a line into the low lane only; the
+ * contents of the high lane are ignored by the partial stores */
+static AVX2_FUNC FORCE_INLINE __m256i load_4px(const uint8_t *line)
+{
+	return _mm256_castsi128_si256(
+		_mm_loadu_si128((const __m128i *)line));
+}
+
+static AVX2_FUNC FORCE_INLINE void store_64(uint8_t *dst, __m128i val)
+{
+	_mm_storel_epi64((__m128i *)dst, val);
+}
+
+static AVX2_FUNC FORCE_INLINE void store_32(uint8_t *dst, __m128i val)
+{
+	*(uint32_t *)dst = (uint32_t)_mm_cvtsi128_si32(val);
+}
+
+static AVX2_FUNC FORCE_INLINE void store_16(uint8_t *dst, __m128i val)
+{
+	*(uint16_t *)dst = (uint16_t)_mm_cvtsi128_si32(val);
+}
+
+AVX2_FUNC void compress_uyvx_to_i420_avx2(const uint8_t *input,
+					  uint32_t in_linesize,
+					  uint32_t start_y, uint32_t end_y,
+					  uint8_t *output[],
+					  const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	const __m256i lum_lo = LUM_LO;
+	const __m256i lum_hi = LUM_HI;
+	const __m256i u_lo = lane_shuffle(0, 4, Z, Z, Z, Z, Z, Z);
+	const __m256i u_hi = lane_shuffle(Z, Z, 0, 4, Z, Z, Z, Z);
+	const __m256i v_lo = lane_shuffle(2, 6, Z, Z, Z, Z, Z, Z);
+	const __m256i v_hi = lane_shuffle(Z, Z, 2, 6, Z, Z, Z, Z);
+
+	for (uint32_t y = start_y; y < end_y; y += 2) {
+		const uint8_t *line1 = input + y * in_linesize;
+		const uint8_t *line2 = line1 + in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *u = output[1] + (y >> 1) * out_linesize[1];
+		uint8_t *v = output[2] + (y >> 1) * out_linesize[2];
+		uint32_t x = 0;
+
+		for (; x + 8 <= width; x += 8) {
+			__m256i l1 = load_8px(line1 + x * 4);
+			__m256i l2 = load_8px(line2 + x * 4);
+			__m256i chroma = avg_chroma(l1, l2);
+
+			store_64(lum0 + x, gather_lanes(l1, lum_lo, lum_hi));
+			store_64(lum1 + x, gather_lanes(l2, lum_lo, lum_hi));
+			store_32(u + (x >> 1),
+				 gather_lanes(chroma, u_lo, u_hi));
+			store_32(v + (x >> 1),
+				 gather_lanes(chroma, v_lo, v_hi));
+		}
+
+		if (x < width) {
+			__m256i l1 = load_4px(line1 + x * 4);
+			__m256i l2 = load_4px(line2 + x * 4);
+			__m256i chroma = avg_chroma(l1, l2);
+
+			store_32(lum0 + x, gather_lanes(l1, lum_lo, lum_hi));
+			store_32(lum1 + x, gather_lanes(l2, lum_lo, lum_hi));
+			store_16(u + (x >> 1),
+				 gather_lanes(chroma, u_lo, u_hi));
+			store_16(v + (x >> 1),
+				 gather_lanes(chroma, v_lo, v_hi));
+		}
+	}
+}
+
+AVX2_FUNC void compress_uyvx_to_nv12_avx2(const uint8_t *input,
+					  uint32_t in_linesize,
+					  uint32_t start_y, uint32_t end_y,
+					  uint8_t *output[],
+					  const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	const __m256i lum_lo = LUM_LO;
+	const __m256i lum_hi = LUM_HI;
+	const __m256i uv_lo = lane_shuffle(0, 2, 4, 6, Z, Z, Z, Z);
+	const __m256i uv_hi = lane_shuffle(Z, Z, Z, Z, 0, 2, 4, 6);
+
+	for (uint32_t y = start_y; y < end_y; y += 2) {
+		const uint8_t *line1 = input + y * in_linesize;
+		const uint8_t *line2 = line1 + in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *uv = output[1] + (y >> 1) * out_linesize[1];
+		uint32_t x = 0;
+
+		for (; x + 8 <= width; x += 8) {
+			__m256i l1 = load_8px(line1 + x * 4);
+			__m256i l2 = load_8px(line2 + x * 4);
+			__m256i chroma = avg_chroma(l1, l2);
+
+			store_64(lum0 + x, gather_lanes(l1, lum_lo, lum_hi));
+			store_64(lum1 + x, gather_lanes(l2, lum_lo, lum_hi));
+			store_64(uv + x, gather_lanes(chroma, uv_lo, uv_hi));
+		}
+
+		if (x < width) {
+			__m256i l1 = load_4px(line1 + x * 4);
+			__m256i l2 = load_4px(line2 + x * 4);
+			__m256i chroma = avg_chroma(l1, l2);
+
+			store_32(lum0 + x, gather_lanes(l1, lum_lo, lum_hi));
+			store_32(lum1 + x, gather_lanes(l2, lum_lo, lum_hi));
+			store_32(uv + x, gather_lanes(chroma, uv_lo, uv_hi));
+		}
+	}
+}
+
+AVX2_FUNC void convert_uyvx_to_i444_avx2(const uint8_t *input,
+					 uint32_t in_linesize, uint32_t start_y,
+					 uint32_t end_y, uint8_t *output[],
+					 const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	const __m256i lum_lo = LUM_LO;
+	const __m256i lum_hi = LUM_HI;
+	const __m256i u_lo = lane_shuffle(0, 4, 8, 12, Z, Z, Z, Z);
+	const __m256i u_hi = lane_shuffle(Z, Z, Z, Z, 0, 4, 8, 12);
+	const __m256i v_lo = lane_shuffle(2, 6, 10, 14, Z, Z, Z, Z);
+	const __m256i v_hi = lane_shuffle(Z, Z, Z, Z, 2, 6, 10, 14);
+
+	for (uint32_t y = start_y; y < end_y; y += 2) {
+		const uint8_t *line1 = input + y * in_linesize;
+		const uint8_t *line2 = line1 + in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *u0 = output[1] + y * out_linesize[0];
+		uint8_t *u1 = u0 + out_linesize[0];
+		uint8_t *v0 = output[2] + y * out_linesize[0];
+		uint8_t *v1 = v0 + out_linesize[0];
+		uint32_t x = 0;
+
+		for (; x + 8 <= width; x += 8) {
+			__m256i l1 = load_8px(line1 + x * 4);
+			__m256i l2 = load_8px(line2 + x * 4);
+
+			store_64(lum0 + x, gather_lanes(l1, lum_lo, lum_hi));
+			store_64(lum1 + x, gather_lanes(l2, lum_lo, lum_hi));
+			store_64(u0 + x, gather_lanes(l1, u_lo, u_hi));
+			store_64(u1 + x, gather_lanes(l2, u_lo, u_hi));
+			store_64(v0 + x, gather_lanes(l1, v_lo, v_hi));
+			store_64(v1 + x, gather_lanes(l2, v_lo, v_hi));
+		}
+
+		if (x < width) {
+			__m256i l1 = load_4px(line1 + x * 4);
+			__m256i l2 = load_4px(line2 + x * 4);
+
+			store_32(lum0 + x, gather_lanes(l1, lum_lo, lum_hi));
+			store_32(lum1 + x, gather_lanes(l2, lum_lo, lum_hi));
+			store_32(u0 + x, gather_lanes(l1, u_lo, u_hi));
+			store_32(u1 + x, gather_lanes(l2, u_lo, u_hi));
+			store_32(v0 + x, gather_lanes(l1, v_lo, v_hi));
+			store_32(v1 + x, gather_lanes(l2, v_lo, v_hi));
+		}
+	}
+}
+
+bool format_conversion_cpu_has_avx2(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	/* the OS must also save the AVX registers (OSXSAVE + XCR0) */
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+		return false;
+	if ((_xgetbv(0) & 0x6) != 0x6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
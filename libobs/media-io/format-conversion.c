@@ -16,9 +16,16 @@
 ******************************************************************************/
 
 #include "format-conversion.h"
+#include "../util/threading.h"
 
 #include "../util/sse-intrin.h"
 
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+     defined(_M_IX86)) &&                                             \
+	!defined(__e2k__) && !(defined(_M_ARM64) || defined(_M_ARM64EC))
+#define HAVE_AVX2_KERNELS
+#endif
+
 /* ...surprisingly, if I don't use a macro to force inlining, it causes the
  * CPU usage to boost by a tremendous amount in debug builds. */
 
@@ -90,9 +97,10 @@ static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
 	return a < b ? a : b;
 }
 
-void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
-			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
-			   const uint32_t out_linesize[])
+static void compress_uyvx_to_i420_sse2(const uint8_t *input,
+					uint32_t in_linesize, uint32_t start_y,
+					uint32_t end_y, uint8_t *output[],
+					const uint32_t out_linesize[])
 {
 	uint8_t *lum_plane = output[0];
 	uint8_t *u_plane = output[1];
@@ -127,9 +135,10 @@ void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
 	}
 }
 
-void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
-			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
-			   const uint32_t out_linesize[])
+static void compress_uyvx_to_nv12_sse2(const uint8_t *input,
+					uint32_t in_linesize, uint32_t start_y,
+					uint32_t end_y, uint8_t *output[],
+					const uint32_t out_linesize[])
 {
 	uint8_t *lum_plane = output[0];
 	uint8_t *chroma_plane = output[1];
@@ -162,9 +171,10 @@ void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
 	}
 }
 
-void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize,
-			  uint32_t start_y, uint32_t end_y, uint8_t *output[],
-			  const uint32_t out_linesize[])
+static void convert_uyvx_to_i444_sse2(const uint8_t *input,
+				       uint32_t in_linesize, uint32_t start_y,
+				       uint32_t end_y, uint8_t *output[],
+				       const uint32_t out_linesize[])
 {
 	uint8_t *lum_plane = output[0];
 	uint8_t *u_plane = output[1];
@@ -200,6 +210,265 @@ void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize,
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+/* Scalar versions of the packers above.  These operate on the same blocks of
+ * four pixels as the SSE2 versions and produce bit-exact output. */
+
+#define UYVX_U(px, i) ((px)[(i)*4])
+#define UYVX_Y(px, i) ((px)[(i)*4 + 1])
+#define UYVX_V(px, i) ((px)[(i)*4 + 2])
+
+static FORCE_INLINE uint8_t avg_2x2(const uint8_t *line1, const uint8_t *line2,
+				    size_t i, size_t comp)
+{
+	const size_t pos = i * 4 + comp;
+	return (uint8_t)((line1[pos] + line1[pos + 4] + line2[pos] +
+			  line2[pos + 4]) >>
+			 2);
+}
+
+static FORCE_INLINE void pack_lum_c(uint8_t *lum0, uint8_t *lum1,
+				    const uint8_t *line1, const uint8_t *line2)
+{
+	for (size_t i = 0; i < 4; i++) {
+		lum0[i] = UYVX_Y(line1, i);
+		lum1[i] = UYVX_Y(line2, i);
+	}
+}
+
+static FORCE_INLINE void i420_block_c(uint8_t *lum0, uint8_t *lum1,
+				      uint8_t *u, uint8_t *v,
+				      const uint8_t *line1,
+				      const uint8_t *line2)
+{
+	pack_lum_c(lum0, lum1, line1, line2);
+	u[0] = avg_2x2(line1, line2, 0, 0);
+	u[1] = avg_2x2(line1, line2, 2, 0);
+	v[0] = avg_2x2(line1, line2, 0, 2);
+	v[1] = avg_2x2(line1, line2, 2, 2);
+}
+
+static FORCE_INLINE void nv12_block_c(uint8_t *lum0, uint8_t *lum1,
+				      uint8_t *uv, const uint8_t *line1,
+				      const uint8_t *line2)
+{
+	pack_lum_c(lum0, lum1, line1, line2);
+	uv[0] = avg_2x2(line1, line2, 0, 0);
+	uv[1] = avg_2x2(line1, line2, 0, 2);
+	uv[2] = avg_2x2(line1, line2, 2, 0);
+	uv[3] = avg_2x2(line1, line2, 2, 2);
+}
+
+static FORCE_INLINE void i444_block_c(uint8_t *lum0, uint8_t *lum1,
+				      uint8_t *u0, uint8_t *u1, uint8_t *v0,
+				      uint8_t *v1, const uint8_t *line1,
+				      const uint8_t *line2)
+{
+	pack_lum_c(lum0, lum1, line1, line2);
+	for (size_t i = 0; i < 4; i++) {
+		u0[i] = UYVX_U(line1, i);
+		u1[i] = UYVX_U(line2, i);
+		v0[i] = UYVX_V(line1, i);
+		v1[i] = UYVX_V(line2, i);
+	}
+}
+
+static void compress_uyvx_to_i420_c(const uint8_t *input, uint32_t in_linesize,
+				    uint32_t start_y, uint32_t end_y,
+				    uint8_t *output[],
+				    const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+
+	for (uint32_t y = start_y; y < end_y; y += 2) {
+		const uint8_t *line1 = input + y * in_linesize;
+		const uint8_t *line2 = line1 + in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *u = output[1] + (y >> 1) * out_linesize[1];
+		uint8_t *v = output[2] + (y >> 1) * out_linesize[2];
+
+		for (uint32_t x = 0; x < width; x += 4)
+			i420_block_c(lum0 + x, lum1 + x, u + (x >> 1),
+				     v + (x >> 1), line1 + x * 4,
+				     line2 + x * 4);
+	}
+}
+
+static void compress_uyvx_to_nv12_c(const uint8_t *input, uint32_t in_linesize,
+				    uint32_t start_y, uint32_t end_y,
+				    uint8_t *output[],
+				    const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+
+	for (uint32_t y = start_y; y < end_y; y += 2) {
+		const uint8_t *line1 = input + y * in_linesize;
+		const uint8_t *line2 = line1 + in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *uv = output[1] + (y >> 1) * out_linesize[1];
+
+		for (uint32_t x = 0; x < width; x += 4)
+			nv12_block_c(lum0 + x, lum1 + x, uv + x, line1 + x * 4,
+				     line2 + x * 4);
+	}
+}
+
+static void convert_uyvx_to_i444_c(const uint8_t *input, uint32_t in_linesize,
+				   uint32_t start_y, uint32_t end_y,
+				   uint8_t *output[],
+				   const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+
+	for (uint32_t y = start_y; y < end_y; y += 2) {
+		const uint8_t *line1 = input + y * in_linesize;
+		const uint8_t *line2 = line1 + in_linesize;
+		uint32_t pos0 = y * out_linesize[0];
+		uint32_t pos1 = pos0 + out_linesize[0];
+
+		for (uint32_t x = 0; x < width; x += 4)
+			i444_block_c(output[0] + pos0 + x,
+				     output[0] + pos1 + x,
+				     output[1] + pos0 + x,
+				     output[1] + pos1 + x,
+				     output[2] + pos0 + x,
+				     output[2] + pos1 + x, line1 + x * 4,
+				     line2 + x * 4);
+	}
+}
+
+#ifdef HAVE_AVX2_KERNELS
+/* format-conversion-avx2.c */
+extern bool format_conversion_cpu_has_avx2(void);
+extern void compress_uyvx_to_i420_avx2(const uint8_t *input,
+				       uint32_t in_linesize, uint32_t start_y,
+				       uint32_t end_y, uint8_t *output[],
+				       const uint32_t out_linesize[]);
+extern void compress_uyvx_to_nv12_avx2(const uint8_t *input,
+				       uint32_t in_linesize, uint32_t start_y,
+				       uint32_t end_y, uint8_t *output[],
+				       const uint32_t out_linesize[]);
+extern void convert_uyvx_to_i444_avx2(const uint8_t *input,
+				      uint32_t in_linesize, uint32_t start_y,
+				      uint32_t end_y, uint8_t *output[],
+				      const uint32_t out_linesize[]);
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Packer selection, done once based on the features of the running CPU */
+
+typedef void (*uyvx_packer_t)(const uint8_t *input, uint32_t in_linesize,
+			      uint32_t start_y, uint32_t end_y,
+			      uint8_t *output[], const uint32_t out_linesize[]);
+
+struct format_conversion_funcs {
+	const char *name;
+	uyvx_packer_t compress_uyvx_to_i420;
+	uyvx_packer_t compress_uyvx_to_nv12;
+	uyvx_packer_t convert_uyvx_to_i444;
+};
+
+static const struct format_conversion_funcs scalar_funcs = {
+	"C",
+	compress_uyvx_to_i420_c,
+	compress_uyvx_to_nv12_c,
+	convert_uyvx_to_i444_c,
+};
+
+/* on non-x86 hosts, SIMDe maps the SSE2 versions to the native vector
+ * instructions (NEON, VSX, etc) */
+static const struct format_conversion_funcs sse2_funcs = {
+#ifdef HAVE_AVX2_KERNELS
+	"SSE2",
+#else
+	"SSE2 (SIMDe)",
+#endif
+	compress_uyvx_to_i420_sse2,
+	compress_uyvx_to_nv12_sse2,
+	convert_uyvx_to_i444_sse2,
+};
+
+#ifdef HAVE_AVX2_KERNELS
+static const struct format_conversion_funcs avx2_funcs = {
+	"AVX2",
+	compress_uyvx_to_i420_avx2,
+	compress_uyvx_to_nv12_avx2,
+	convert_uyvx_to_i444_avx2,
+};
+#endif
+
+static const struct format_conversion_funcs *conversion_funcs = &sse2_funcs;
+static pthread_once_t conversion_funcs_once = PTHREAD_ONCE_INIT;
+
+static void init_conversion_funcs(void)
+{
+#ifdef HAVE_AVX2_KERNELS
+	if (format_conversion_cpu_has_avx2())
+		conversion_funcs = &avx2_funcs;
+#endif
+}
+
+static inline const struct format_conversion_funcs *get_conversion_funcs(void)
+{
+	pthread_once(&conversion_funcs_once, init_conversion_funcs);
+	return conversion_funcs;
+}
+
+const char *format_conversion_get_impl(void)
+{
+	return get_conversion_funcs()->name;
+}
+
+void format_conversion_set_impl(enum format_conversion_impl impl)
+{
+	get_conversion_funcs();
+
+	switch (impl) {
+	case FORMAT_CONVERSION_IMPL_AUTO:
+		conversion_funcs = &sse2_funcs;
+		init_conversion_funcs();
+		break;
+	case FORMAT_CONVERSION_IMPL_C:
+		conversion_funcs = &scalar_funcs;
+		break;
+	case FORMAT_CONVERSION_IMPL_SSE2:
+		conversion_funcs = &sse2_funcs;
+		break;
+	case FORMAT_CONVERSION_IMPL_AVX2:
+#ifdef HAVE_AVX2_KERNELS
+		if (format_conversion_cpu_has_avx2())
+			conversion_funcs = &avx2_funcs;
+#endif
+		break;
+	}
+}
+
+void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
+			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			   const uint32_t out_linesize[])
+{
+	get_conversion_funcs()->compress_uyvx_to_i420(
+		input, in_linesize, start_y, end_y, output, out_linesize);
+}
+
+void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
+			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			   const uint32_t out_linesize[])
+{
+	get_conversion_funcs()->compress_uyvx_to_nv12(
+		input, in_linesize, start_y, end_y, output, out_linesize);
+}
+
+void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize,
+			  uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			  const uint32_t out_linesize[])
+{
+	get_conversion_funcs()->convert_uyvx_to_i444(
+		input, in_linesize, start_y, end_y, output, out_linesize);
+}
+
 void decompress_420(const uint8_t *const input[], const uint32_t in_linesize[],
 		    uint32_t start_y, uint32_t end_y, uint8_t *output,
 		    uint32_t out_linesize)
@@ -23,10 +23,27 @@
 extern "C" {
 #endif
 
+enum format_conversion_impl {
+	FORMAT_CONVERSION_IMPL_AUTO,
+	FORMAT_CONVERSION_IMPL_C,
+	FORMAT_CONVERSION_IMPL_SSE2,
+	FORMAT_CONVERSION_IMPL_AVX2,
+};
+
 /*
  * Functions for converting to and from packed 444 YUV
  */
 
+/** Returns the name of the instruction set the packers below currently use */
+EXPORT const char *format_conversion_get_impl(void);
+
+/**
+ * Forces the packers below to use a specific implementation, mainly for
+ * testing.  Unsupported implementations are ignored.  Not thread safe with
+ * respect to conversions already in progress.
+ */
+EXPORT void format_conversion_set_impl(enum format_conversion_impl impl);
+
 EXPORT void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
 				  uint32_t start_y, uint32_t end_y,
 				  uint8_t *output[],
@@ -22,6 +22,7 @@
 #include "../util/profiler.h"
 #include "../util/threading.h"
 #include "../util/darray.h"
+#include "../util/circlebuf.h"
 #include "../util/util_uint64.h"
 
 #include "format-conversion.h"
@@ -31,40 +32,100 @@
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
-#define MAX_CONVERT_BUFFERS 3
-#define MAX_CACHE_SIZE 16
-
+#define MIN_CACHE_SIZE 2
+#define MAX_CACHE_SIZE 64
+#define DEFAULT_CACHE_SIZE 6
+
+/* The frame cache is a single-producer/single-consumer ring.  The graphics
+ * thread (producer) fills the slot at write_idx and publishes it by
+ * incrementing queued_frames and pending_frames.  The video thread
+ * (consumer) hands the slot at read_idx to every input and then decrements
+ * pending_frames.  A slot is released once the video thread and every input
+ * that queued it are done with it, in order, by decrementing queued_frames.
+ *
+ * The consumer always keeps the newest published slot until a newer one is
+ * published, which is what allows the producer to safely add duplicate
+ * frames to it without a lock when the ring is full. */
 struct cached_frame_info {
 	struct video_data frame;
-	int skipped;
-	int count;
+	uint64_t seq;
+	volatile long skipped;
+	volatile long count;
+	volatile long refs;
 };
 
-struct video_input {
+struct video_input_frame {
+	size_t idx;
+	uint64_t seq;
+	uint64_t timestamp;
+	long count;
+};
+
+/* Inputs that want the same conversion share a scale group, so each frame
+ * is only scaled once per conversion no matter how many inputs want it.
+ * Scaled frames are reference counted by the inputs currently using them,
+ * and are reused for duplicated frames. */
+struct video_scaled_frame {
+	struct video_frame frame;
+	uint64_t seq;
+	long refs;
+	bool valid;
+};
+
+struct video_scale_group {
 	struct video_scale_info conversion;
 	video_scaler_t *scaler;
-	struct video_frame frame[MAX_CONVERT_BUFFERS];
-	int cur_frame;
+	long refs;
+
+	pthread_mutex_t mutex;
+	DARRAY(struct video_scaled_frame *) frames;
+
+	uint64_t scaled_frames;
+	uint64_t shared_frames;
+};
+
+struct video_input {
+	struct video_output *video;
+
+	struct video_scale_info conversion;
+	struct video_scale_group *scale_group;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
-};
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
+	pthread_t thread;
+	bool thread_active;
+	volatile bool stop;
+	os_sem_t *sem;
+
+	pthread_mutex_t queue_mutex;
+	struct circlebuf queue;
+	/* the frame currently being output, which keeps taking duplicates
+	 * while busy.  busy_seq is its cache slot, or 0 once released */
+	bool busy;
+	uint64_t busy_seq;
+	long busy_count;
+	bool release_busy;
+	uint64_t max_span;
+
+	struct video_frame copy;
+	bool copy_valid;
+
+	volatile long queued_frames;
+	volatile long max_queued_frames;
+	volatile long skipped_frames;
+	volatile long total_frames;
+};
 
 struct video_output {
 	struct video_output_info info;
 
 	pthread_t thread;
-	pthread_mutex_t data_mutex;
 	bool stop;
 
 	os_sem_t *update_semaphore;
+	os_event_t *frame_released;
+	os_event_t *input_frame_done;
 	uint64_t frame_time;
 	volatile long skipped_frames;
 	volatile long total_frames;
@@ -72,12 +133,23 @@ struct video_output {
 	bool initialized;
 
 	pthread_mutex_t input_mutex;
-	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_input *) inputs;
+	DARRAY(struct video_input *) stopped_inputs;
+	DARRAY(struct video_scale_group *) scale_groups;
 
-	size_t available_frames;
-	size_t first_added;
-	size_t last_added;
-	struct cached_frame_info cache[MAX_CACHE_SIZE];
+	volatile long queued_frames;
+	volatile long pending_frames;
+	size_t read_idx;
+	size_t write_idx;
+	uint64_t write_seq;
+	struct cached_frame_info *cache;
+
+	pthread_mutex_t release_mutex;
+	size_t release_idx;
+
+	/* 64-bit, so updated and read under release_mutex */
+	uint64_t lock_wait_ns;
+	volatile long lock_waits;
 
 	volatile bool raw_active;
 	volatile long gpu_refs;
@@ -85,89 +157,509 @@ struct video_output {
 
 /* ------------------------------------------------------------------------- */
 
-static inline bool scale_video_output(struct video_input *input,
-				      struct video_data *data)
+static inline void atomic_add_long(volatile long *val, long add)
 {
-	bool success = true;
+	long cur = os_atomic_load_long(val);
+	while (!os_atomic_compare_exchange_long(val, &cur, cur + add))
+		;
+}
 
-	if (input->scaler) {
-		struct video_frame *frame;
+/* only the consumer ever decrements these, so there is no need for a CAS */
+static inline bool atomic_dec_if_positive(volatile long *val)
+{
+	if (os_atomic_load_long(val) <= 0)
+		return false;
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+	os_atomic_dec_long(val);
+	return true;
+}
 
-		frame = &input->frame[input->cur_frame];
+/* releases every frame at the start of the ring that is no longer referenced
+ * by the video thread or any input */
+static void release_frames(struct video_output *video)
+{
+	pthread_mutex_lock(&video->release_mutex);
 
-		success = video_scaler_scale(input->scaler, frame->data,
-					     frame->linesize,
-					     (const uint8_t *const *)data->data,
-					     data->linesize);
+	while (os_atomic_load_long(&video->queued_frames) > 0) {
+		struct cached_frame_info *frame_info =
+			&video->cache[video->release_idx];
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i] = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
+		if (os_atomic_load_long(&frame_info->refs) > 0)
+			break;
+
+		if (++video->release_idx == video->info.cache_size)
+			video->release_idx = 0;
+
+		os_atomic_dec_long(&video->queued_frames);
+		os_event_signal(video->frame_released);
+	}
+
+	pthread_mutex_unlock(&video->release_mutex);
+}
+
+static inline uint64_t get_lock_wait_ns(struct video_output *video)
+{
+	uint64_t wait_ns;
+
+	pthread_mutex_lock(&video->release_mutex);
+	wait_ns = video->lock_wait_ns;
+	pthread_mutex_unlock(&video->release_mutex);
+	return wait_ns;
+}
+
+static inline void add_lock_wait_ns(struct video_output *video,
+				    uint64_t wait_start)
+{
+	uint64_t wait_ns = os_gettime_ns() - wait_start;
+
+	pthread_mutex_lock(&video->release_mutex);
+	video->lock_wait_ns += wait_ns;
+	pthread_mutex_unlock(&video->release_mutex);
+}
+
+static inline void release_frame_ref(struct video_output *video,
+				     struct cached_frame_info *frame_info)
+{
+	if (os_atomic_dec_long(&frame_info->refs) == 0)
+		release_frames(video);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static struct video_scaled_frame *
+video_scale_group_get_frame(struct video_scale_group *group,
+			    const struct cached_frame_info *frame_info)
+{
+	struct video_scaled_frame *scaled = NULL;
+	struct video_scaled_frame *unused = NULL;
+
+	pthread_mutex_lock(&group->mutex);
+
+	for (size_t i = 0; i < group->frames.num; i++) {
+		struct video_scaled_frame *cur = group->frames.array[i];
+
+		if (cur->valid && cur->seq == frame_info->seq) {
+			scaled = cur;
+			break;
+		}
+		if (!cur->refs && (!unused || cur->seq < unused->seq))
+			unused = cur;
+	}
+
+	if (scaled) {
+		group->shared_frames++;
+
+	} else {
+		if (!unused) {
+			unused = bzalloc(sizeof(*unused));
+			video_frame_init(&unused->frame,
+					 group->conversion.format,
+					 group->conversion.width,
+					 group->conversion.height);
+			da_push_back(group->frames, &unused);
+		}
+
+		/* the scaler can't be used from multiple threads at once, so
+		 * scale while locked; any other input of this group would
+		 * have to wait for this frame anyway */
+		unused->seq = frame_info->seq;
+		unused->valid = video_scaler_scale(
+			group->scaler, unused->frame.data,
+			unused->frame.linesize,
+			(const uint8_t *const *)frame_info->frame.data,
+			frame_info->frame.linesize);
+
+		if (unused->valid) {
+			scaled = unused;
+			group->scaled_frames++;
 		} else {
 			blog(LOG_WARNING, "video-io: Could not scale frame!");
 		}
 	}
 
-	return success;
+	if (scaled)
+		scaled->refs++;
+
+	pthread_mutex_unlock(&group->mutex);
+	return scaled;
+}
+
+static inline void
+video_scale_group_release_frame(struct video_scale_group *group,
+				struct video_scaled_frame *scaled)
+{
+	pthread_mutex_lock(&group->mutex);
+	scaled->refs--;
+	pthread_mutex_unlock(&group->mutex);
+}
+
+/* returns false once every duplicate of the frame being output has been
+ * output, after which no more can be added to it */
+static inline bool video_input_next_busy(struct video_input *input, long idx,
+					 bool *release)
+{
+	bool more;
+
+	pthread_mutex_lock(&input->queue_mutex);
+	more = idx < input->busy_count;
+	*release = input->release_busy && input->busy_seq;
+	if (*release)
+		input->busy_seq = 0;
+	if (!more) {
+		input->busy = false;
+		input->busy_seq = 0;
+	}
+	pthread_mutex_unlock(&input->queue_mutex);
+	return more;
+}
+
+static void video_input_copy_frame(struct video_input *input,
+				   const struct cached_frame_info *frame_info,
+				   struct video_data *frame)
+{
+	const struct video_output_info *info = &input->video->info;
+
+	if (!input->copy_valid) {
+		video_frame_init(&input->copy, info->format, info->width,
+				 info->height);
+		input->copy_valid = true;
+	}
+
+	video_frame_copy(&input->copy,
+			 (const struct video_frame *)&frame_info->frame,
+			 info->format, info->height);
+	memcpy(frame->data, input->copy.data, sizeof(frame->data));
+}
+
+/* outputs a frame and all of its duplicates.  the frame's cache slot would
+ * hold back every newer slot for as long as that takes, so once the input is
+ * lagging the slot is released early, and the rest are output from the
+ * scaled frame or from a copy */
+static inline void video_input_output_frame(struct video_input *input,
+					    const struct video_input_frame *in)
+{
+	struct video_output *video = input->video;
+	struct cached_frame_info *frame_info = &video->cache[in->idx];
+	struct video_scaled_frame *scaled = NULL;
+	struct video_data frame;
+	bool released = false;
+
+	if (input->scale_group) {
+		scaled = video_scale_group_get_frame(input->scale_group,
+						     frame_info);
+		if (!scaled)
+			goto release;
+
+		memcpy(frame.data, scaled->frame.data, sizeof(frame.data));
+		memcpy(frame.linesize, scaled->frame.linesize,
+		       sizeof(frame.linesize));
+	} else {
+		memcpy(frame.data, frame_info->frame.data, sizeof(frame.data));
+		memcpy(frame.linesize, frame_info->frame.linesize,
+		       sizeof(frame.linesize));
+	}
+
+	for (long i = 0; !input->stop; i++) {
+		bool release = false;
+
+		if (i > 0 && !video_input_next_busy(input, i, &release))
+			break;
+
+		if (release && !released) {
+			if (!scaled)
+				video_input_copy_frame(input, frame_info,
+						       &frame);
+
+			release_frame_ref(video, frame_info);
+			released = true;
+		}
+
+		frame.timestamp = in->timestamp + video->frame_time * i;
+		input->callback(input->param, &frame);
+
+		os_atomic_inc_long(&input->total_frames);
+	}
+
+	if (scaled)
+		video_scale_group_release_frame(input->scale_group, scaled);
+
+release:
+	if (!released)
+		release_frame_ref(video, frame_info);
+}
+
+static void video_input_clear_queue(struct video_input *input)
+{
+	struct video_output *video = input->video;
+
+	pthread_mutex_lock(&input->queue_mutex);
+
+	while (input->queue.size) {
+		struct video_input_frame in;
+		circlebuf_pop_front(&input->queue, &in, sizeof(in));
+		release_frame_ref(video, &video->cache[in.idx]);
+	}
+
+	os_atomic_set_long(&input->queued_frames, 0);
+	pthread_mutex_unlock(&input->queue_mutex);
+}
+
+static void *video_input_thread(void *param)
+{
+	struct video_input *input = param;
+	struct video_output *video = input->video;
+
+	os_set_thread_name("video-io: video input thread");
+
+	const char *video_input_thread_name =
+		profile_store_name(obs_get_profiler_name_store(),
+				   "video_input_thread(%s)", video->info.name);
+
+	while (os_sem_wait(input->sem) == 0) {
+		struct video_input_frame in;
+
+		if (input->stop)
+			break;
+
+		pthread_mutex_lock(&input->queue_mutex);
+		if (!input->queue.size) {
+			pthread_mutex_unlock(&input->queue_mutex);
+			continue;
+		}
+
+		circlebuf_pop_front(&input->queue, &in, sizeof(in));
+		input->busy = true;
+		input->busy_seq = in.seq;
+		input->busy_count = in.count;
+		pthread_mutex_unlock(&input->queue_mutex);
+
+		profile_start(video_input_thread_name);
+		video_input_output_frame(input, &in);
+		profile_end(video_input_thread_name);
+
+		pthread_mutex_lock(&input->queue_mutex);
+		atomic_add_long(&input->queued_frames, -input->busy_count);
+		input->busy = false;
+		input->busy_seq = 0;
+		input->busy_count = 0;
+		input->release_busy = false;
+		pthread_mutex_unlock(&input->queue_mutex);
+
+		if (video->info.offline)
+			os_event_signal(video->input_frame_done);
+
+		profile_reenable_thread();
+	}
+
+	video_input_clear_queue(input);
+	return NULL;
+}
+
+/* the oldest cache slot still held by an input, or 0 if it holds none.
+ * slots are released in order, so the input effectively holds every slot
+ * from this one up to the newest */
+static inline uint64_t video_input_oldest_seq(struct video_input *input)
+{
+	struct video_input_frame *first;
+
+	if (input->busy_seq)
+		return input->busy_seq;
+	if (!input->queue.size)
+		return 0;
+
+	first = circlebuf_data(&input->queue, 0);
+	return first->seq;
+}
+
+static inline bool video_input_lagging(struct video_input *input,
+				       uint64_t seq)
+{
+	uint64_t oldest = video_input_oldest_seq(input);
+	return oldest && seq - oldest >= input->max_span;
+}
+
+/* gives up the oldest cache slot held by a lagging input.  the frame being
+ * output releases its slot itself once it's been copied.  the oldest queued
+ * frame becomes more duplicates of the frame being output instead, which
+ * keeps frame counts and timestamps the same */
+static bool video_input_release_oldest(struct video_input *input)
+{
+	struct video_output *video = input->video;
+	struct video_input_frame first;
+
+	if (input->busy_seq) {
+		input->release_busy = true;
+		return false;
+	}
+	if (!input->busy || !input->queue.size)
+		return false;
+
+	circlebuf_pop_front(&input->queue, &first, sizeof(first));
+	input->busy_count += first.count;
+	atomic_add_long(&input->skipped_frames, first.count);
+	release_frame_ref(video, &video->cache[first.idx]);
+	return true;
+}
+
+static inline void video_input_add_queued(struct video_input *input)
+{
+	long queued = os_atomic_inc_long(&input->queued_frames);
+	if (queued > os_atomic_load_long(&input->max_queued_frames))
+		os_atomic_set_long(&input->max_queued_frames, queued);
+}
+
+/* queues a frame for an input.  if queuing it would make the input hold more
+ * than its share of the frame cache, the last frame it was given is
+ * duplicated instead so that a slow input can never hold on to enough of the
+ * cache to cause other inputs to skip frames.  that frame may already be
+ * being output if nothing else is queued */
+static bool video_input_queue_frame(struct video_input *input, size_t idx,
+				    uint64_t timestamp)
+{
+	struct video_output *video = input->video;
+	struct video_input_frame *last = NULL;
+	uint64_t seq = video->cache[idx].seq;
+	bool queued = false;
+	bool skipped = false;
+
+	pthread_mutex_lock(&input->queue_mutex);
+
+	if (input->queue.size)
+		last = circlebuf_data(&input->queue,
+				      input->queue.size - sizeof(*last));
+
+	if (last ? last->seq == seq : input->busy_seq == seq) {
+		/* the same frame again, as the producer duplicated it */
+		if (last)
+			last->count++;
+		else
+			input->busy_count++;
+		goto done;
+	}
+
+	while (video_input_lagging(input, seq)) {
+		if (!video_input_release_oldest(input))
+			break;
+		skipped = true;
+	}
+
+	last = input->queue.size ? circlebuf_data(&input->queue,
+						  input->queue.size -
+							  sizeof(*last))
+				 : NULL;
+
+	if (!video_input_lagging(input, seq)) {
+		struct video_input_frame in = {idx, seq, timestamp, 1};
+
+		os_atomic_inc_long(&video->cache[idx].refs);
+		circlebuf_push_back(&input->queue, &in, sizeof(in));
+		queued = true;
+
+	} else {
+		if (last)
+			last->count++;
+		else
+			input->busy_count++;
+
+		os_atomic_inc_long(&input->skipped_frames);
+		skipped = true;
+	}
+
+done:
+	video_input_add_queued(input);
+	pthread_mutex_unlock(&input->queue_mutex);
+
+	if (queued)
+		os_sem_post(input->sem);
+	return !skipped;
+}
+
+static bool video_input_full(struct video_input *input, uint64_t seq)
+{
+	bool full;
+
+	pthread_mutex_lock(&input->queue_mutex);
+	full = video_input_lagging(input, seq);
+	pthread_mutex_unlock(&input->queue_mutex);
+	return full;
 }
 
-static inline bool video_output_cur_frame(struct video_output *video)
+/* in offline mode inputs never have frames duplicated for them, so wait until
+ * every input has room for the next frame instead.  the input mutex can't be
+ * held while waiting, as inputs are allowed to disconnect from their own
+ * callback */
+static void video_output_wait_for_inputs(struct video_output *video,
+					 uint64_t seq)
 {
-	struct cached_frame_info *frame_info;
-	bool complete;
-	bool skipped;
+	while (!video->stop) {
+		bool full = false;
 
-	/* -------------------------------- */
+		pthread_mutex_lock(&video->input_mutex);
+		for (size_t i = 0; !full && i < video->inputs.num; i++)
+			full = video_input_full(video->inputs.array[i], seq);
+		pthread_mutex_unlock(&video->input_mutex);
 
-	pthread_mutex_lock(&video->data_mutex);
+		if (!full)
+			break;
 
-	frame_info = &video->cache[video->first_added];
+		os_event_timedwait(video->input_frame_done, 10);
+	}
+}
 
-	pthread_mutex_unlock(&video->data_mutex);
+static inline void video_output_cur_frame(struct video_output *video,
+					  struct cached_frame_info *frame_info)
+{
+	if (video->info.offline)
+		video_output_wait_for_inputs(video, frame_info->seq);
 
-	/* -------------------------------- */
+	bool skipped = atomic_dec_if_positive(&frame_info->skipped);
 
 	pthread_mutex_lock(&video->input_mutex);
 
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
-		struct video_data frame = frame_info->frame;
-
-		if (scale_video_output(input, &frame))
-			input->callback(input->param, &frame);
+		if (!video_input_queue_frame(video->inputs.array[i],
+					     video->read_idx,
+					     frame_info->frame.timestamp))
+			skipped = true;
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
 
-	/* -------------------------------- */
+	frame_info->frame.timestamp += video->frame_time;
 
-	pthread_mutex_lock(&video->data_mutex);
+	if (skipped)
+		os_atomic_inc_long(&video->skipped_frames);
+}
 
-	frame_info->frame.timestamp += video->frame_time;
-	complete = --frame_info->count == 0;
-	skipped = frame_info->skipped > 0;
+static inline void video_output_process_frames(struct video_output *video)
+{
+	while (!video->stop) {
+		struct cached_frame_info *frame_info;
+
+		/* once a newer frame has been published, the producer will no
+		 * longer add duplicates to this one, so check for that before
+		 * draining the count */
+		long pending = os_atomic_load_long(&video->pending_frames);
+		if (!pending)
+			break;
 
-	if (complete) {
-		if (++video->first_added == video->info.cache_size)
-			video->first_added = 0;
+		frame_info = &video->cache[video->read_idx];
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
-	} else if (skipped) {
-		--frame_info->skipped;
-		os_atomic_inc_long(&video->skipped_frames);
-	}
+		while (!video->stop &&
+		       atomic_dec_if_positive(&frame_info->count)) {
+			video_output_cur_frame(video, frame_info);
+			os_atomic_inc_long(&video->total_frames);
+		}
 
-	pthread_mutex_unlock(&video->data_mutex);
+		if (pending == 1)
+			break;
 
-	/* -------------------------------- */
+		if (++video->read_idx == video->info.cache_size)
+			video->read_idx = 0;
 
-	return complete;
+		os_atomic_dec_long(&video->pending_frames);
+		release_frame_ref(video, frame_info);
+	}
 }
 
 static void *video_thread(void *param)
@@ -185,11 +677,7 @@ static void *video_thread(void *param)
 			break;
 
 		profile_start(video_thread_name);
-		while (!video->stop && !video_output_cur_frame(video)) {
-			os_atomic_inc_long(&video->total_frames);
-		}
-
-		os_atomic_inc_long(&video->total_frames);
+		video_output_process_frames(video);
 		profile_end(video_thread_name);
 
 		profile_reenable_thread();
@@ -200,6 +688,129 @@ static void *video_thread(void *param)
 
 /* ------------------------------------------------------------------------- */
 
+static inline bool scale_info_equal(const struct video_scale_info *a,
+				    const struct video_scale_info *b)
+{
+	return a->format == b->format && a->width == b->width &&
+	       a->height == b->height && a->range == b->range &&
+	       a->colorspace == b->colorspace;
+}
+
+static struct video_scale_group *
+video_scale_group_get(struct video_output *video,
+		      const struct video_scale_info *conversion)
+{
+	struct video_scale_group *group;
+
+	for (size_t i = 0; i < video->scale_groups.num; i++) {
+		group = video->scale_groups.array[i];
+		if (scale_info_equal(&group->conversion, conversion)) {
+			group->refs++;
+			return group;
+		}
+	}
+
+	struct video_scale_info from = {.format = video->info.format,
+					.width = video->info.width,
+					.height = video->info.height,
+					.range = video->info.range,
+					.colorspace = video->info.colorspace};
+
+	group = bzalloc(sizeof(*group));
+	group->conversion = *conversion;
+	group->refs = 1;
+
+	int ret = video_scaler_create_sliced(&group->scaler, conversion, &from,
+					     VIDEO_SCALE_FAST_BILINEAR,
+					     (int)video->info.scaler_threads);
+	if (ret != VIDEO_SCALER_SUCCESS) {
+		if (ret == VIDEO_SCALER_BAD_CONVERSION)
+			blog(LOG_ERROR, "video_input_init: Bad "
+					"scale conversion type");
+		else
+			blog(LOG_ERROR, "video_input_init: Failed to "
+					"create scaler");
+
+		bfree(group);
+		return NULL;
+	}
+
+	pthread_mutex_init(&group->mutex, NULL);
+	da_push_back(video->scale_groups, &group);
+	return group;
+}
+
+static void video_scale_group_release(struct video_output *video,
+				      struct video_scale_group *group)
+{
+	if (!group)
+		return;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	if (--group->refs == 0) {
+		da_erase_item(video->scale_groups, &group);
+
+		blog(LOG_DEBUG,
+		     "video-io: %ux%u %s scaler: %" PRIu64 " frames "
+		     "scaled, %" PRIu64 " frames shared",
+		     group->conversion.width, group->conversion.height,
+		     get_video_format_name(group->conversion.format),
+		     group->scaled_frames, group->shared_frames);
+
+		for (size_t i = 0; i < group->frames.num; i++) {
+			video_frame_free(&group->frames.array[i]->frame);
+			bfree(group->frames.array[i]);
+		}
+		da_free(group->frames);
+
+		video_scaler_destroy(group->scaler);
+		pthread_mutex_destroy(&group->mutex);
+		bfree(group);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+}
+
+static void video_input_free(struct video_input *input)
+{
+	if (input->thread_active)
+		pthread_join(input->thread, NULL);
+
+	video_scale_group_release(input->video, input->scale_group);
+
+	if (input->copy_valid)
+		video_frame_free(&input->copy);
+	circlebuf_free(&input->queue);
+	os_sem_destroy(input->sem);
+	pthread_mutex_destroy(&input->queue_mutex);
+	bfree(input);
+}
+
+static inline void video_input_stop(struct video_input *input)
+{
+	if (input->thread_active) {
+		os_atomic_set_bool(&input->stop, true);
+		os_sem_post(input->sem);
+	}
+}
+
+/* inputs that disconnect from their own callback can't be joined right
+ * away, so they're freed the next time an input connects or disconnects */
+static void free_stopped_inputs(struct video_output *video)
+{
+	for (size_t i = video->stopped_inputs.num; i > 0; i--) {
+		struct video_input *input = video->stopped_inputs.array[i - 1];
+
+		if (!pthread_equal(input->thread, pthread_self())) {
+			video_input_free(input);
+			da_erase(video->stopped_inputs, i - 1);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline bool valid_video_params(const struct video_output_info *info)
 {
 	return info->height != 0 && info->width != 0 && info->fps_den != 0 &&
@@ -208,9 +819,16 @@ static inline bool valid_video_params(const struct video_output_info *info)
 
 static inline void init_cache(struct video_output *video)
 {
-	if (video->info.cache_size > MAX_CACHE_SIZE)
+	if (!video->info.cache_size)
+		video->info.cache_size = DEFAULT_CACHE_SIZE;
+	else if (video->info.cache_size < MIN_CACHE_SIZE)
+		video->info.cache_size = MIN_CACHE_SIZE;
+	else if (video->info.cache_size > MAX_CACHE_SIZE)
 		video->info.cache_size = MAX_CACHE_SIZE;
 
+	video->cache = bzalloc(sizeof(struct cached_frame_info) *
+			       video->info.cache_size);
+
 	for (size_t i = 0; i < video->info.cache_size; i++) {
 		struct video_frame *frame;
 		frame = (struct video_frame *)&video->cache[i];
@@ -218,8 +836,6 @@ static inline void init_cache(struct video_output *video)
 		video_frame_init(frame, video->info.format, video->info.width,
 				 video->info.height);
 	}
-
-	video->available_frames = video->info.cache_size;
 }
 
 int video_output_open(video_t **video, struct video_output_info *info)
@@ -238,27 +854,27 @@ int video_output_open(video_t **video, struct video_output_info *info)
 		util_mul_div64(1000000000ULL, info->fps_den, info->fps_num);
 	out->initialized = false;
 
-	if (pthread_mutex_init_recursive(&out->data_mutex) != 0)
-		goto fail0;
+	init_cache(out);
+	pthread_mutex_init_value(&out->input_mutex);
+	pthread_mutex_init_value(&out->release_mutex);
+
 	if (pthread_mutex_init_recursive(&out->input_mutex) != 0)
-		goto fail1;
+		goto fail0;
+	if (pthread_mutex_init(&out->release_mutex, NULL) != 0)
+		goto fail0;
+	if (os_event_init(&out->frame_released, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail0;
+	if (os_event_init(&out->input_frame_done, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail0;
 	if (os_sem_init(&out->update_semaphore, 0) != 0)
-		goto fail2;
+		goto fail0;
 	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
-		goto fail3;
-
-	init_cache(out);
+		goto fail0;
 
 	out->initialized = true;
 	*video = out;
 	return VIDEO_OUTPUT_SUCCESS;
 
-fail3:
-	os_sem_destroy(out->update_semaphore);
-fail2:
-	pthread_mutex_destroy(&out->input_mutex);
-fail1:
-	pthread_mutex_destroy(&out->data_mutex);
 fail0:
 	video_output_close(out);
 	return VIDEO_OUTPUT_FAIL;
@@ -272,11 +888,27 @@ void video_output_close(video_t *video)
 	video_output_stop(video);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_stop(video->inputs.array[i]);
+	for (size_t i = 0; i < video->inputs.num; i++)
+		video_input_free(video->inputs.array[i]);
 	da_free(video->inputs);
 
-	for (size_t i = 0; i < video->info.cache_size; i++)
-		video_frame_free((struct video_frame *)&video->cache[i]);
+	free_stopped_inputs(video);
+	da_free(video->stopped_inputs);
+	da_free(video->scale_groups);
+
+	os_sem_destroy(video->update_semaphore);
+	os_event_destroy(video->frame_released);
+	os_event_destroy(video->input_frame_done);
+	pthread_mutex_destroy(&video->release_mutex);
+	pthread_mutex_destroy(&video->input_mutex);
+
+	if (video->cache) {
+		for (size_t i = 0; i < video->info.cache_size; i++)
+			video_frame_free(
+				(struct video_frame *)&video->cache[i]);
+		bfree(video->cache);
+	}
 
 	bfree(video);
 }
@@ -287,7 +919,7 @@ static size_t video_get_input_idx(const video_t *video,
 				  void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -301,34 +933,28 @@ static inline bool video_input_init(struct video_input *input,
 	if (input->conversion.width != video->info.width ||
 	    input->conversion.height != video->info.height ||
 	    input->conversion.format != video->info.format) {
-		struct video_scale_info from = {.format = video->info.format,
-						.width = video->info.width,
-						.height = video->info.height,
-						.range = video->info.range,
-						.colorspace =
-							video->info.colorspace};
-
-		int ret = video_scaler_create(&input->scaler,
-					      &input->conversion, &from,
-					      VIDEO_SCALE_FAST_BILINEAR);
-		if (ret != VIDEO_SCALER_SUCCESS) {
-			if (ret == VIDEO_SCALER_BAD_CONVERSION)
-				blog(LOG_ERROR, "video_input_init: Bad "
-						"scale conversion type");
-			else
-				blog(LOG_ERROR, "video_input_init: Failed to "
-						"create scaler");
-
+		input->scale_group =
+			video_scale_group_get(video, &input->conversion);
+		if (!input->scale_group)
 			return false;
-		}
-
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					 input->conversion.format,
-					 input->conversion.width,
-					 input->conversion.height);
 	}
 
+	/* an input may hold on to at most half of the frame cache, counted
+	 * from its oldest slot to the newest, after which it's given
+	 * duplicates of its last frame instead */
+	input->max_span = video->info.cache_size / 2;
+	circlebuf_reserve(&input->queue,
+			  input->max_span * sizeof(struct video_input_frame));
+
+	if (pthread_mutex_init(&input->queue_mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&input->sem, 0) != 0)
+		return false;
+	if (pthread_create(&input->thread, NULL, video_input_thread, input) !=
+	    0)
+		return false;
+
+	input->thread_active = true;
 	return true;
 }
 
@@ -336,6 +962,11 @@ static inline void reset_frames(video_t *video)
 {
 	os_atomic_set_long(&video->skipped_frames, 0);
 	os_atomic_set_long(&video->total_frames, 0);
+	os_atomic_set_long(&video->lock_waits, 0);
+
+	pthread_mutex_lock(&video->release_mutex);
+	video->lock_wait_ns = 0;
+	pthread_mutex_unlock(&video->release_mutex);
 }
 
 bool video_output_connect(
@@ -349,27 +980,30 @@ bool video_output_connect(
 
 	pthread_mutex_lock(&video->input_mutex);
 
+	free_stopped_inputs(video);
+
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(*input));
 
-		input.callback = callback;
-		input.param = param;
+		input->video = video;
+		input->callback = callback;
+		input->param = param;
+		pthread_mutex_init_value(&input->queue_mutex);
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format = video->info.format;
-			input.conversion.width = video->info.width;
-			input.conversion.height = video->info.height;
+			input->conversion.format = video->info.format;
+			input->conversion.width = video->info.width;
+			input->conversion.height = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
+		success = video_input_init(input, video);
 		if (success) {
 			if (video->inputs.num == 0) {
 				if (!os_atomic_load_long(&video->gpu_refs)) {
@@ -378,6 +1012,8 @@ bool video_output_connect(
 				os_atomic_set_bool(&video->raw_active, true);
 			}
 			da_push_back(video->inputs, &input);
+		} else {
+			video_input_free(input);
 		}
 	}
 
@@ -401,6 +1037,28 @@ static void log_skipped(video_t *video)
 		     "%ld/%ld (%0.1f%%)",
 		     video->skipped_frames, video->total_frames,
 		     percentage_skipped);
+
+	long waits = os_atomic_load_long(&video->lock_waits);
+	if (waits)
+		blog(LOG_INFO,
+		     "Video frame cache was full %ld time(s), "
+		     "total wait time: %" PRIu64 " ms",
+		     waits, get_lock_wait_ns(video) / 1000000);
+}
+
+static void log_input_skipped(struct video_input *input)
+{
+	long skipped = os_atomic_load_long(&input->skipped_frames);
+	long total = os_atomic_load_long(&input->total_frames);
+
+	if (skipped)
+		blog(LOG_INFO,
+		     "Video input (%ux%u %s) disconnected, number of "
+		     "duplicated frames due to input lag: %ld/%ld "
+		     "(max queued frames: %ld)",
+		     input->conversion.width, input->conversion.height,
+		     get_video_format_name(input->conversion.format), skipped,
+		     total, os_atomic_load_long(&input->max_queued_frames));
 }
 
 void video_output_disconnect(video_t *video,
@@ -408,6 +1066,8 @@ void video_output_disconnect(video_t *video,
 					      struct video_data *frame),
 			     void *param)
 {
+	struct video_input *input = NULL;
+
 	if (!video || !callback)
 		return;
 
@@ -415,7 +1075,7 @@ void video_output_disconnect(video_t *video,
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array + idx);
+		input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
 
 		if (video->inputs.num == 0) {
@@ -424,9 +1084,53 @@ void video_output_disconnect(video_t *video,
 				log_skipped(video);
 			}
 		}
+
+		log_input_skipped(input);
+		video_input_stop(input);
+
+		/* can't join the input thread from its own callback */
+		if (pthread_equal(input->thread, pthread_self()))
+			da_push_back(video->stopped_inputs, &input);
 	}
 
+	free_stopped_inputs(video);
+
 	pthread_mutex_unlock(&video->input_mutex);
+
+	if (input && !pthread_equal(input->thread, pthread_self()))
+		video_input_free(input);
+}
+
+bool video_output_get_input_stats(video_t *video,
+				  void (*callback)(void *param,
+						   struct video_data *frame),
+				  void *param, struct video_input_stats *stats)
+{
+	bool found = false;
+
+	if (!video || !callback || !stats)
+		return false;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID) {
+		struct video_input *input = video->inputs.array[idx];
+
+		stats->queued_frames = (uint32_t)os_atomic_load_long(
+			&input->queued_frames);
+		stats->max_queued_frames = (uint32_t)os_atomic_load_long(
+			&input->max_queued_frames);
+		stats->skipped_frames = (uint32_t)os_atomic_load_long(
+			&input->skipped_frames);
+		stats->total_frames =
+			(uint32_t)os_atomic_load_long(&input->total_frames);
+		found = true;
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return found;
 }
 
 bool video_output_active(const video_t *video)
@@ -441,41 +1145,72 @@ const struct video_output_info *video_output_get_info(const video_t *video)
 	return video ? &video->info : NULL;
 }
 
+/* waits for the video thread to release a frame if the cache is full, for no
+ * longer than max_wait_ms in total */
+static bool wait_for_free_frame(struct video_output *video, uint64_t start)
+{
+	/* offline rendering never drops frames, it only waits */
+	if (video->info.offline) {
+		os_event_timedwait(video->frame_released, 10);
+		return !video->stop;
+	}
+
+	uint64_t max_wait_ns = (uint64_t)video->info.max_wait_ms * 1000000ULL;
+	uint64_t waited = os_gettime_ns() - start;
+
+	if (waited >= max_wait_ns)
+		return false;
+
+	uint64_t remaining_ms = (max_wait_ns - waited + 999999) / 1000000;
+	os_event_timedwait(video->frame_released, (unsigned long)remaining_ms);
+	return true;
+}
+
 bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 			     int count, uint64_t timestamp)
 {
 	struct cached_frame_info *cfi;
-	bool locked;
+	uint64_t wait_start = 0;
+	size_t last_idx;
 
 	if (!video)
 		return false;
 
-	pthread_mutex_lock(&video->data_mutex);
-
-	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
-		video->cache[video->last_added].skipped += count;
-		locked = false;
-
-	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
+	while (os_atomic_load_long(&video->queued_frames) ==
+	       (long)video->info.cache_size) {
+		if (!wait_start) {
+			wait_start = os_gettime_ns();
+			os_atomic_inc_long(&video->lock_waits);
 		}
 
-		cfi = &video->cache[video->last_added];
-		cfi->frame.timestamp = timestamp;
-		cfi->count = count;
-		cfi->skipped = 0;
-
-		memcpy(frame, &cfi->frame, sizeof(*frame));
-
-		locked = true;
+		if (!wait_for_free_frame(video, wait_start)) {
+			add_lock_wait_ns(video, wait_start);
+
+			/* the video thread never releases the newest frame
+			 * until a newer one is published, so it's safe to
+			 * add to its count here */
+			last_idx = video->write_idx ? video->write_idx
+						    : video->info.cache_size;
+			cfi = &video->cache[last_idx - 1];
+			atomic_add_long(&cfi->skipped, count);
+			atomic_add_long(&cfi->count, count);
+			os_sem_post(video->update_semaphore);
+			return false;
+		}
 	}
 
-	pthread_mutex_unlock(&video->data_mutex);
+	if (wait_start)
+		add_lock_wait_ns(video, wait_start);
 
-	return locked;
+	cfi = &video->cache[video->write_idx];
+	cfi->frame.timestamp = timestamp;
+	cfi->seq = ++video->write_seq;
+	os_atomic_set_long(&cfi->count, count);
+	os_atomic_set_long(&cfi->skipped, 0);
+	os_atomic_set_long(&cfi->refs, 1);
+
+	memcpy(frame, &cfi->frame, sizeof(*frame));
+	return true;
 }
 
 void video_output_unlock_frame(video_t *video)
@@ -483,12 +1218,12 @@ void video_output_unlock_frame(video_t *video)
 	if (!video)
 		return;
 
-	pthread_mutex_lock(&video->data_mutex);
+	if (++video->write_idx == video->info.cache_size)
+		video->write_idx = 0;
 
-	video->available_frames--;
+	os_atomic_inc_long(&video->queued_frames);
+	os_atomic_inc_long(&video->pending_frames);
 	os_sem_post(video->update_semaphore);
-
-	pthread_mutex_unlock(&video->data_mutex);
 }
 
 uint64_t video_output_get_frame_time(const video_t *video)
@@ -508,9 +1243,6 @@ void video_output_stop(video_t *video)
 		video->stop = true;
 		os_sem_post(video->update_semaphore);
 		pthread_join(video->thread, &thread_ret);
-		os_sem_destroy(video->update_semaphore);
-		pthread_mutex_destroy(&video->data_mutex);
-		pthread_mutex_destroy(&video->input_mutex);
 	}
 }
 
@@ -555,6 +1287,16 @@ uint32_t video_output_get_total_frames(const video_t *video)
 	return (uint32_t)os_atomic_load_long(&video->total_frames);
 }
 
+uint32_t video_output_get_lock_waits(const video_t *video)
+{
+	return video ? (uint32_t)os_atomic_load_long(&video->lock_waits) : 0;
+}
+
+uint64_t video_output_get_lock_wait_time(const video_t *video)
+{
+	return video ? get_lock_wait_ns((struct video_output *)video) : 0;
+}
+
 /* Note: These four functions below are a very slight bit of a hack.  If the
  * texture encoder thread is active while the raw encoder thread is active, the
  * total frame count will just be doubled while they're both active.  Which is
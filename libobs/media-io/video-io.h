@@ -101,6 +101,30 @@ struct video_output_info {
 
 	enum video_colorspace colorspace;
 	enum video_range_type range;
+
+	/* maximum time to wait for a free cache frame before duplicating the
+	 * last frame instead (0 to never wait) */
+	uint32_t max_wait_ms;
+
+	/* number of threads each CPU scaler uses for its inputs (0 or 1 to
+	 * scale on the input's own thread only) */
+	uint32_t scaler_threads;
+
+	/* render without a real-time deadline: never skip or duplicate frames,
+	 * and block the producer until the frame cache and every input have
+	 * room for the next frame instead */
+	bool offline;
+};
+
+struct video_input_stats {
+	/* frames currently queued for the input, including the one being
+	 * output */
+	uint32_t queued_frames;
+	uint32_t max_queued_frames;
+
+	/* frames duplicated because the input fell too far behind */
+	uint32_t skipped_frames;
+	uint32_t total_frames;
 };
 
 static inline bool format_is_yuv(enum video_format format)
@@ -241,6 +265,11 @@ EXPORT void video_output_disconnect(video_t *video,
 				    void (*callback)(void *param,
 						     struct video_data *frame),
 				    void *param);
+EXPORT bool
+video_output_get_input_stats(video_t *video,
+			     void (*callback)(void *param,
+					      struct video_data *frame),
+			     void *param, struct video_input_stats *stats);
 
 EXPORT bool video_output_active(const video_t *video);
 
@@ -260,6 +289,8 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
+EXPORT uint32_t video_output_get_lock_waits(const video_t *video);
+EXPORT uint64_t video_output_get_lock_wait_time(const video_t *video);
 
 extern void video_output_inc_texture_encoders(video_t *video);
 extern void video_output_dec_texture_encoders(video_t *video);
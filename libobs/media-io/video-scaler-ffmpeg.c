@@ -16,17 +16,60 @@
 ******************************************************************************/
 
 #include "../util/bmem.h"
+#include "../util/threading.h"
 #include "video-scaler.h"
 
 #include <libavutil/imgutils.h>
 #include <libswscale/swscale.h>
 
+#define MAX_SCALER_THREADS 16
+
+/* In sliced mode, the output is split into horizontal bands that are each
+ * scaled by their own swscale context on their own thread.  Band boundaries
+ * are placed where source and output rows line up exactly, and each band is
+ * padded with extra rows on either side that are scaled but then discarded,
+ * so that the filter taps at the band edges see the same source rows they
+ * would when scaling the whole frame.  Each band's context still computes
+ * its own filter coefficients for its own height, which can round samples
+ * differently by 1. */
+struct video_scaler_band {
+	struct video_scaler *scaler;
+	struct SwsContext *swscale;
+
+	int src_y;
+	int src_h;
+	int dst_y;
+	int dst_h;
+	int pad_h;
+
+	uint8_t *dst_pointers[4];
+	int dst_linesizes[4];
+
+	pthread_t thread;
+	bool thread_active;
+	os_sem_t *start;
+	bool success;
+};
+
 struct video_scaler {
 	struct SwsContext *swscale;
 	int src_height;
 	int dst_heights[4];
 	uint8_t *dst_pointers[4];
 	int dst_linesizes[4];
+
+	int src_shift[4];
+	int dst_shift[4];
+
+	struct video_scaler_band *bands;
+	size_t num_bands;
+	os_sem_t *done;
+	volatile bool stop;
+
+	const uint8_t *const *input;
+	const uint32_t *in_linesize;
+	uint8_t **output;
+	const uint32_t *out_linesize;
 };
 
 static inline enum AVPixelFormat
@@ -112,10 +155,10 @@ static inline int get_ffmpeg_range_type(enum video_range_type type)
 
 #define FIXED_1_0 (1 << 16)
 
-int video_scaler_create(video_scaler_t **scaler_out,
-			const struct video_scale_info *dst,
-			const struct video_scale_info *src,
-			enum video_scale_type type)
+static struct SwsContext *create_swscale(const struct video_scale_info *dst,
+					 const struct video_scale_info *src,
+					 int src_height, int dst_height,
+					 enum video_scale_type type)
 {
 	enum AVPixelFormat format_src = get_ffmpeg_video_format(src->format);
 	enum AVPixelFormat format_dst = get_ffmpeg_video_format(dst->format);
@@ -124,6 +167,253 @@ int video_scaler_create(video_scaler_t **scaler_out,
 	const int *coeff_dst = get_ffmpeg_coeffs(dst->colorspace);
 	int range_src = get_ffmpeg_range_type(src->range);
 	int range_dst = get_ffmpeg_range_type(dst->range);
+	struct SwsContext *swscale;
+	int ret;
+
+	swscale = sws_getCachedContext(NULL, src->width, src_height,
+				       format_src, dst->width, dst_height,
+				       format_dst, scale_type, NULL, NULL,
+				       NULL);
+	if (!swscale) {
+		blog(LOG_ERROR, "video_scaler_create: Could not create "
+				"swscale");
+		return NULL;
+	}
+
+	ret = sws_setColorspaceDetails(swscale, coeff_src, range_src,
+				       coeff_dst, range_dst, 0, FIXED_1_0,
+				       FIXED_1_0);
+	if (ret < 0) {
+		blog(LOG_DEBUG, "video_scaler_create: "
+				"sws_setColorspaceDetails failed, ignoring");
+	}
+
+	return swscale;
+}
+
+static void get_plane_shifts(enum AVPixelFormat format, int shifts[4])
+{
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+
+	/* only the chroma planes are subsampled */
+	for (size_t i = 0; i < 4; i++)
+		shifts[i] = 0;
+	for (size_t i = 1; i < 3; i++)
+		shifts[i] = desc->log2_chroma_h;
+}
+
+static void copy_plane_rows(uint8_t *dst, size_t dst_linesize,
+			    const uint8_t *src, size_t src_linesize,
+			    size_t height)
+{
+	if (src_linesize == dst_linesize) {
+		memcpy(dst, src, src_linesize * height);
+	} else {
+		size_t linesize = src_linesize;
+		if (linesize > dst_linesize)
+			linesize = dst_linesize;
+
+		for (size_t y = 0; y < height; y++) {
+			memcpy(dst, src, linesize);
+			dst += dst_linesize;
+			src += src_linesize;
+		}
+	}
+}
+
+static bool scale_band(struct video_scaler_band *band)
+{
+	struct video_scaler *scaler = band->scaler;
+	const uint8_t *input[4] = {0};
+	int ret;
+
+	for (size_t plane = 0; plane < 4; plane++) {
+		if (!scaler->input[plane])
+			continue;
+
+		size_t y = (size_t)(band->src_y >> scaler->src_shift[plane]);
+		input[plane] = scaler->input[plane] +
+			       y * scaler->in_linesize[plane];
+	}
+
+	ret = sws_scale(band->swscale, input,
+			(const int *)scaler->in_linesize, 0, band->src_h,
+			band->dst_pointers, band->dst_linesizes);
+	if (ret <= 0) {
+		blog(LOG_ERROR, "video_scaler_scale: sws_scale failed: %d",
+		     ret);
+		return false;
+	}
+
+	for (size_t plane = 0; plane < 4; plane++) {
+		if (!band->dst_pointers[plane])
+			continue;
+
+		const int shift = scaler->dst_shift[plane];
+		const size_t scaled_linesize = band->dst_linesizes[plane];
+		const size_t plane_linesize = scaler->out_linesize[plane];
+		const size_t pad = (size_t)(band->pad_h >> shift);
+		const size_t dst_y = (size_t)(band->dst_y >> shift);
+		const size_t dst_h = (size_t)(band->dst_h >> shift);
+
+		copy_plane_rows(scaler->output[plane] + dst_y * plane_linesize,
+				plane_linesize,
+				band->dst_pointers[plane] +
+					pad * scaled_linesize,
+				scaled_linesize, dst_h);
+	}
+
+	return true;
+}
+
+static void *band_thread(void *data)
+{
+	struct video_scaler_band *band = data;
+	struct video_scaler *scaler = band->scaler;
+
+	os_set_thread_name("video-scaler: band thread");
+
+	while (os_sem_wait(band->start) == 0) {
+		if (scaler->stop)
+			break;
+
+		band->success = scale_band(band);
+		os_sem_post(scaler->done);
+	}
+
+	return NULL;
+}
+
+static inline int gcd_int(int a, int b)
+{
+	while (b) {
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static bool init_bands(struct video_scaler *scaler,
+		       const struct video_scale_info *dst,
+		       const struct video_scale_info *src,
+		       enum video_scale_type type, int threads)
+{
+	enum AVPixelFormat format_dst = get_ffmpeg_video_format(dst->format);
+	int src_h = (int)src->height;
+	int dst_h = (int)dst->height;
+
+	/* smallest group of source/output rows that map exactly onto each
+	 * other, kept even for chroma subsampling */
+	int g = gcd_int(src_h, dst_h);
+	int src_unit = src_h / g;
+	int dst_unit = dst_h / g;
+	if ((src_unit & 1) || (dst_unit & 1)) {
+		src_unit *= 2;
+		dst_unit *= 2;
+	}
+
+	int units = dst_h / dst_unit;
+	if (threads > units)
+		threads = units;
+	if (threads < 2)
+		return false;
+
+	/* pad each band with enough output rows that the filter taps at the
+	 * band edges never reach outside of the band's source rows */
+	int min_pad = 4;
+	if (src_h < dst_h)
+		min_pad = (4 * dst_h + src_h - 1) / src_h;
+	int pad_units = (min_pad + dst_unit - 1) / dst_unit;
+
+	scaler->bands = bzalloc(sizeof(struct video_scaler_band) * threads);
+	scaler->num_bands = threads;
+
+	if (os_sem_init(&scaler->done, 0) != 0)
+		return false;
+
+	for (int i = 0; i < threads; i++) {
+		struct video_scaler_band *band = &scaler->bands[i];
+		int first = units * i / threads;
+		int last = units * (i + 1) / threads;
+		int pad_top = first < pad_units ? first : pad_units;
+		int pad_bottom = units - last < pad_units ? units - last
+							  : pad_units;
+		int out_h;
+
+		band->scaler = scaler;
+		band->dst_y = first * dst_unit;
+		band->dst_h = (last - first) * dst_unit;
+		band->pad_h = pad_top * dst_unit;
+		band->src_y = (first - pad_top) * src_unit;
+		band->src_h = (last - first + pad_top + pad_bottom) * src_unit;
+		out_h = (last - first + pad_top + pad_bottom) * dst_unit;
+
+		if (av_image_alloc(band->dst_pointers, band->dst_linesizes,
+				   dst->width, out_h, format_dst, 32) < 0)
+			return false;
+
+		band->swscale =
+			create_swscale(dst, src, band->src_h, out_h, type);
+		if (!band->swscale)
+			return false;
+
+		/* the calling thread scales the first band itself */
+		if (i == 0)
+			continue;
+
+		if (os_sem_init(&band->start, 0) != 0)
+			return false;
+		if (pthread_create(&band->thread, NULL, band_thread, band) != 0)
+			return false;
+		band->thread_active = true;
+	}
+
+	blog(LOG_DEBUG,
+	     "video_scaler_create: %ux%u -> %ux%u using %d sliced threads",
+	     src->width, src->height, dst->width, dst->height, threads);
+	return true;
+}
+
+static void free_bands(struct video_scaler *scaler)
+{
+	scaler->stop = true;
+
+	for (size_t i = 0; i < scaler->num_bands; i++) {
+		struct video_scaler_band *band = &scaler->bands[i];
+
+		if (band->thread_active) {
+			os_sem_post(band->start);
+			pthread_join(band->thread, NULL);
+		}
+
+		os_sem_destroy(band->start);
+		sws_freeContext(band->swscale);
+		if (band->dst_pointers[0])
+			av_freep(band->dst_pointers);
+	}
+
+	bfree(scaler->bands);
+	os_sem_destroy(scaler->done);
+	scaler->bands = NULL;
+	scaler->num_bands = 0;
+}
+
+int video_scaler_create(video_scaler_t **scaler_out,
+			const struct video_scale_info *dst,
+			const struct video_scale_info *src,
+			enum video_scale_type type)
+{
+	return video_scaler_create_sliced(scaler_out, dst, src, type, 1);
+}
+
+int video_scaler_create_sliced(video_scaler_t **scaler_out,
+			       const struct video_scale_info *dst,
+			       const struct video_scale_info *src,
+			       enum video_scale_type type, int threads)
+{
+	enum AVPixelFormat format_src = get_ffmpeg_video_format(src->format);
+	enum AVPixelFormat format_dst = get_ffmpeg_video_format(dst->format);
 	struct video_scaler *scaler;
 	int ret;
 
@@ -133,8 +423,25 @@ int video_scaler_create(video_scaler_t **scaler_out,
 	if (format_src == AV_PIX_FMT_NONE || format_dst == AV_PIX_FMT_NONE)
 		return VIDEO_SCALER_BAD_CONVERSION;
 
+	if (threads > MAX_SCALER_THREADS)
+		threads = MAX_SCALER_THREADS;
+
 	scaler = bzalloc(sizeof(struct video_scaler));
 	scaler->src_height = src->height;
+	get_plane_shifts(format_src, scaler->src_shift);
+	get_plane_shifts(format_dst, scaler->dst_shift);
+
+	if (threads > 1) {
+		if (init_bands(scaler, dst, src, type, threads)) {
+			*scaler_out = scaler;
+			return VIDEO_SCALER_SUCCESS;
+		}
+
+		/* fall back to a single context if the frame can't be split
+		 * into bands */
+		free_bands(scaler);
+		scaler->stop = false;
+	}
 
 	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format_dst);
 	bool has_plane[4] = {0};
@@ -158,23 +465,10 @@ int video_scaler_create(video_scaler_t **scaler_out,
 		goto fail;
 	}
 
-	scaler->swscale = sws_getCachedContext(NULL, src->width, src->height,
-					       format_src, dst->width,
-					       dst->height, format_dst,
-					       scale_type, NULL, NULL, NULL);
-	if (!scaler->swscale) {
-		blog(LOG_ERROR, "video_scaler_create: Could not create "
-				"swscale");
+	scaler->swscale =
+		create_swscale(dst, src, src->height, dst->height, type);
+	if (!scaler->swscale)
 		goto fail;
-	}
-
-	ret = sws_setColorspaceDetails(scaler->swscale, coeff_src, range_src,
-				       coeff_dst, range_dst, 0, FIXED_1_0,
-				       FIXED_1_0);
-	if (ret < 0) {
-		blog(LOG_DEBUG, "video_scaler_create: "
-				"sws_setColorspaceDetails failed, ignoring");
-	}
 
 	*scaler_out = scaler;
 	return VIDEO_SCALER_SUCCESS;
@@ -187,6 +481,7 @@ fail:
 void video_scaler_destroy(video_scaler_t *scaler)
 {
 	if (scaler) {
+		free_bands(scaler);
 		sws_freeContext(scaler->swscale);
 
 		if (scaler->dst_pointers[0])
@@ -196,6 +491,38 @@ void video_scaler_destroy(video_scaler_t *scaler)
 	}
 }
 
+int video_scaler_get_threads(const video_scaler_t *scaler)
+{
+	if (!scaler)
+		return 0;
+	return scaler->num_bands ? (int)scaler->num_bands : 1;
+}
+
+static bool scale_sliced(video_scaler_t *scaler, uint8_t *output[],
+			 const uint32_t out_linesize[],
+			 const uint8_t *const input[],
+			 const uint32_t in_linesize[])
+{
+	bool success;
+
+	scaler->input = input;
+	scaler->in_linesize = in_linesize;
+	scaler->output = output;
+	scaler->out_linesize = out_linesize;
+
+	for (size_t i = 1; i < scaler->num_bands; i++)
+		os_sem_post(scaler->bands[i].start);
+
+	success = scale_band(&scaler->bands[0]);
+
+	for (size_t i = 1; i < scaler->num_bands; i++)
+		os_sem_wait(scaler->done);
+	for (size_t i = 1; i < scaler->num_bands; i++)
+		success = success && scaler->bands[i].success;
+
+	return success;
+}
+
 bool video_scaler_scale(video_scaler_t *scaler, uint8_t *output[],
 			const uint32_t out_linesize[],
 			const uint8_t *const input[],
@@ -204,6 +531,10 @@ bool video_scaler_scale(video_scaler_t *scaler, uint8_t *output[],
 	if (!scaler)
 		return false;
 
+	if (scaler->num_bands)
+		return scale_sliced(scaler, output, out_linesize, input,
+				    in_linesize);
+
 	int ret = sws_scale(scaler->swscale, input, (const int *)in_linesize, 0,
 			    scaler->src_height, scaler->dst_pointers,
 			    scaler->dst_linesizes);
@@ -217,24 +548,10 @@ bool video_scaler_scale(video_scaler_t *scaler, uint8_t *output[],
 		if (!scaler->dst_pointers[plane])
 			continue;
 
-		const size_t scaled_linesize = scaler->dst_linesizes[plane];
-		const size_t plane_linesize = out_linesize[plane];
-		uint8_t *dst = output[plane];
-		const uint8_t *src = scaler->dst_pointers[plane];
-		const size_t height = scaler->dst_heights[plane];
-		if (scaled_linesize == plane_linesize) {
-			memcpy(dst, src, scaled_linesize * height);
-		} else {
-			size_t linesize = scaled_linesize;
-			if (linesize > plane_linesize)
-				linesize = plane_linesize;
-
-			for (size_t y = 0; y < height; y++) {
-				memcpy(dst, src, linesize);
-				dst += plane_linesize;
-				src += scaled_linesize;
-			}
-		}
+		copy_plane_rows(output[plane], out_linesize[plane],
+				scaler->dst_pointers[plane],
+				scaler->dst_linesizes[plane],
+				scaler->dst_heights[plane]);
 	}
 
 	return true;
@@ -35,8 +35,23 @@ EXPORT int video_scaler_create(video_scaler_t **scaler,
 			       const struct video_scale_info *dst,
 			       const struct video_scale_info *src,
 			       enum video_scale_type type);
+
+/**
+ * Creates a scaler that splits each frame into horizontal bands and scales
+ * them in parallel on up to the given number of threads.  Output may differ
+ * from a single-threaded scaler by 1 in some samples, as each band's scaling
+ * filter is rounded slightly differently.  Falls back to a single thread if
+ * the frame is too small to split.
+ */
+EXPORT int video_scaler_create_sliced(video_scaler_t **scaler,
+				      const struct video_scale_info *dst,
+				      const struct video_scale_info *src,
+				      enum video_scale_type type, int threads);
 EXPORT void video_scaler_destroy(video_scaler_t *scaler);
 
+/** Returns the number of threads the scaler uses per frame */
+EXPORT int video_scaler_get_threads(const video_scaler_t *scaler);
+
 EXPORT bool video_scaler_scale(video_scaler_t *scaler, uint8_t *output[],
 			       const uint32_t out_linesize[],
 			       const uint8_t *const input[],
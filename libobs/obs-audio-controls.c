@@ -74,10 +74,13 @@ struct obs_volmeter {
 
 	enum obs_peak_meter_type peak_meter_type;
 	unsigned int update_ms;
-	float prev_samples[MAX_AUDIO_CHANNELS][4];
+	unsigned int decimation;
 
-	float magnitude[MAX_AUDIO_CHANNELS];
+	/* linear levels gathered over the ticks not yet reported */
+	unsigned int ticks;
+	size_t frames;
 	float peak[MAX_AUDIO_CHANNELS];
+	float sum_squares[MAX_AUDIO_CHANNELS];
 };
 
 static float cubic_def_to_db(const float def)
@@ -261,269 +264,192 @@ static void volmeter_source_destroyed(void *vptr, calldata_t *calldata)
 	obs_volmeter_detach_source(volmeter);
 }
 
-static int get_nr_channels_from_audio_data(const struct audio_data *data)
-{
-	int nr_channels = 0;
-	for (int i = 0; i < MAX_AV_PLANES; i++) {
-		if (data->data[i])
-			nr_channels++;
-	}
-	return CLAMP(nr_channels, 0, MAX_AUDIO_CHANNELS);
-}
+/* ------------------------------------------------------------------------- */
+/* Shared meter
+ *
+ * Every source with at least one volmeter attached gets a single audio_meter,
+ * which measures the source audio once per tick and hands the linear levels
+ * to all of its volmeters.  Each volmeter then only applies its own volume,
+ * peak type and decimation, so adding meters for a source (mixer, advanced
+ * audio properties, docks) doesn't add another pass over the audio. */
 
-/* msb(h, g, f, e) lsb(d, c, b, a)   -->  msb(h, h, g, f) lsb(e, d, c, b)
- */
-#define SHIFT_RIGHT_2PS(msb, lsb)                                          \
-	{                                                                  \
-		__m128 tmp =                                               \
-			_mm_shuffle_ps(lsb, msb, _MM_SHUFFLE(0, 0, 3, 3)); \
-		lsb = _mm_shuffle_ps(lsb, tmp, _MM_SHUFFLE(2, 1, 2, 1));   \
-		msb = _mm_shuffle_ps(msb, msb, _MM_SHUFFLE(3, 3, 2, 1));   \
-	}
+struct audio_meter {
+	pthread_mutex_t mutex;
+	DARRAY(struct obs_volmeter *) volmeters;
+
+	/* last four samples of every channel, history[i][channel] */
+	float history[4][MAX_AUDIO_CHANNELS];
+};
+
+struct meter_levels {
+	int nr_channels;
+	size_t frames;
+	float sample_peak[MAX_AUDIO_CHANNELS];
+	float true_peak[MAX_AUDIO_CHANNELS];
+	float sum_squares[MAX_AUDIO_CHANNELS];
+};
+
+/* creates/destroys source->audio_meter, never taken from the audio thread */
+static pthread_mutex_t audio_meters_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* x(d, c, b, a) --> (|d|, |c|, |b|, |a|)
  */
 #define abs_ps(v) _mm_andnot_ps(_mm_set1_ps(-0.f), v)
 
-/* Take cross product of a vector with a matrix resulting in vector.
- */
-#define VECTOR_MATRIX_CROSS_PS(out, v, m0, m1, m2, m3)    \
-	{                                                 \
-		out = _mm_mul_ps(v, m0);                  \
-		__m128 mul1 = _mm_mul_ps(v, m1);          \
-		__m128 mul2 = _mm_mul_ps(v, m2);          \
-		__m128 mul3 = _mm_mul_ps(v, m3);          \
-                                                          \
-		_MM_TRANSPOSE4_PS(out, mul1, mul2, mul3); \
-                                                          \
-		out = _mm_add_ps(out, mul1);              \
-		out = _mm_add_ps(out, mul2);              \
-		out = _mm_add_ps(out, mul3);              \
-	}
+/* Four channels side by side, one per lane. */
+struct meter_lanes {
+	__m128 h0, h1, h2, h3;
+	__m128 sample_peak;
+	__m128 true_peak;
+	__m128 sum_squares;
+};
 
-/* x4(d, c, b, a)  -->  max(a, b, c, d)
- */
-#define hmax_ps(r, x4)                     \
-	do {                               \
-		float x4_mem[4];           \
-		_mm_storeu_ps(x4_mem, x4); \
-		r = x4_mem[0];             \
-		r = fmaxf(r, x4_mem[1]);   \
-		r = fmaxf(r, x4_mem[2]);   \
-		r = fmaxf(r, x4_mem[3]);   \
-	} while (false)
-
-/* Calculate the true peak over a set of samples.
- * The algorithm implements 5x oversampling by using Whittaker–Shannon
- * interpolation over four samples.
- *
- * The four samples have location t=-1.5, -0.5, +0.5, +1.5
- * The oversamples are taken at locations t=-0.3, -0.1, +0.1, +0.3
- *
- * @param previous_samples  Last 4 samples from the previous iteration.
- * @param samples           The samples to find the peak in.
- * @param nr_samples        Number of sets of 4 samples.
- * @returns 5 times oversampled true-peak from the set of samples.
- */
-static float get_true_peak(__m128 previous_samples, const float *samples,
-			   size_t nr_samples)
-{
-	/* These are normalized-sinc parameters for interpolating over sample
-	 * points which are located at x-coords: -1.5, -0.5, +0.5, +1.5.
-	 * And oversample points at x-coords: -0.3, -0.1, 0.1, 0.3. */
-	const __m128 m3 =
-		_mm_set_ps(-0.155915f, 0.935489f, 0.233872f, -0.103943f);
-	const __m128 m1 =
-		_mm_set_ps(-0.216236f, 0.756827f, 0.504551f, -0.189207f);
-	const __m128 p1 =
-		_mm_set_ps(-0.189207f, 0.504551f, 0.756827f, -0.216236f);
-	const __m128 p3 =
-		_mm_set_ps(-0.103943f, 0.233872f, 0.935489f, -0.155915f);
-
-	__m128 work = previous_samples;
-	__m128 peak = previous_samples;
-	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
-		__m128 new_work = _mm_load_ps(&samples[i]);
-		__m128 intrp_samples;
-
-		/* Include the actual sample values in the peak. */
-		__m128 abs_new_work = abs_ps(new_work);
-		peak = _mm_max_ps(peak, abs_new_work);
-
-		/* Shift in the next point. */
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
-
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
-
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
-
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
-	}
+/* Normalized-sinc weights for interpolating over the sample points h0..h3,
+ * which are located at x-coords -1.5, -0.5, +0.5, +1.5, at the oversample
+ * points -0.3, -0.1, +0.1 and +0.3. */
+static const float true_peak_weights[4][4] = {
+	{-0.155915f, 0.935489f, 0.233872f, -0.103943f},
+	{-0.216236f, 0.756827f, 0.504551f, -0.189207f},
+	{-0.189207f, 0.504551f, 0.756827f, -0.216236f},
+	{-0.103943f, 0.233872f, 0.935489f, -0.155915f},
+};
 
-	float r;
-	hmax_ps(r, peak);
-	return r;
+static FORCE_INLINE __m128 interpolate_lanes(const struct meter_lanes *l,
+					     const float w[4])
+{
+	__m128 r = _mm_mul_ps(l->h0, _mm_set1_ps(w[0]));
+	r = _mm_add_ps(r, _mm_mul_ps(l->h1, _mm_set1_ps(w[1])));
+	r = _mm_add_ps(r, _mm_mul_ps(l->h2, _mm_set1_ps(w[2])));
+	r = _mm_add_ps(r, _mm_mul_ps(l->h3, _mm_set1_ps(w[3])));
+	return abs_ps(r);
 }
 
-/* points contain the first four samples to calculate the sinc interpolation
- * over. They will have come from a previous iteration.
- */
-static float get_sample_peak(__m128 previous_samples, const float *samples,
-			     size_t nr_samples)
+static FORCE_INLINE void meter_sample(struct meter_lanes *l, __m128 x,
+				      const bool true_peak)
 {
-	__m128 peak = previous_samples;
-	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
-		__m128 new_work = _mm_load_ps(&samples[i]);
-		peak = _mm_max_ps(peak, abs_ps(new_work));
-	}
+	l->h0 = l->h1;
+	l->h1 = l->h2;
+	l->h2 = l->h3;
+	l->h3 = x;
 
-	float r;
-	hmax_ps(r, peak);
-	return r;
-}
+	l->sample_peak = _mm_max_ps(l->sample_peak, abs_ps(x));
+	l->sum_squares = _mm_add_ps(l->sum_squares, _mm_mul_ps(x, x));
 
-static void volmeter_process_peak_last_samples(obs_volmeter_t *volmeter,
-					       int channel_nr, float *samples,
-					       size_t nr_samples)
-{
-	/* Take the last 4 samples that need to be used for the next peak
-	 * calculation. If there are less than 4 samples in total the new
-	 * samples shift out the old samples. */
+	if (true_peak) {
+		/* 5x oversampling between h1 and h2 using Whittaker-Shannon
+		 * interpolation over the four samples around them */
+		__m128 p0 = interpolate_lanes(l, true_peak_weights[0]);
+		__m128 p1 = interpolate_lanes(l, true_peak_weights[1]);
+		__m128 p2 = interpolate_lanes(l, true_peak_weights[2]);
+		__m128 p3 = interpolate_lanes(l, true_peak_weights[3]);
 
-	switch (nr_samples) {
-	case 0:
-		break;
-	case 1:
-		volmeter->prev_samples[channel_nr][0] =
-			volmeter->prev_samples[channel_nr][1];
-		volmeter->prev_samples[channel_nr][1] =
-			volmeter->prev_samples[channel_nr][2];
-		volmeter->prev_samples[channel_nr][2] =
-			volmeter->prev_samples[channel_nr][3];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
-		break;
-	case 2:
-		volmeter->prev_samples[channel_nr][0] =
-			volmeter->prev_samples[channel_nr][2];
-		volmeter->prev_samples[channel_nr][1] =
-			volmeter->prev_samples[channel_nr][3];
-		volmeter->prev_samples[channel_nr][2] = samples[nr_samples - 2];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
-		break;
-	case 3:
-		volmeter->prev_samples[channel_nr][0] =
-			volmeter->prev_samples[channel_nr][3];
-		volmeter->prev_samples[channel_nr][1] = samples[nr_samples - 3];
-		volmeter->prev_samples[channel_nr][2] = samples[nr_samples - 2];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
-		break;
-	default:
-		volmeter->prev_samples[channel_nr][0] = samples[nr_samples - 4];
-		volmeter->prev_samples[channel_nr][1] = samples[nr_samples - 3];
-		volmeter->prev_samples[channel_nr][2] = samples[nr_samples - 2];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
+		p0 = _mm_max_ps(_mm_max_ps(p0, p1), _mm_max_ps(p2, p3));
+		l->true_peak = _mm_max_ps(l->true_peak, p0);
 	}
 }
 
-static void volmeter_process_peak(obs_volmeter_t *volmeter,
-				  const struct audio_data *data,
-				  int nr_channels)
-{
-	int nr_samples = data->frames;
-	int channel_nr = 0;
-	for (int plane_nr = 0; channel_nr < nr_channels; plane_nr++) {
-		float *samples = (float *)data->data[plane_nr];
-		if (!samples) {
-			continue;
-		}
-		if (((uintptr_t)samples & 0xf) > 0) {
-			printf("Audio plane %i is not aligned %p skipping "
-			       "peak volume measurement.\n",
-			       plane_nr, samples);
-			volmeter->peak[channel_nr] = 1.0;
-			channel_nr++;
-			continue;
-		}
+/* Measure up to four channels at once.  Unused lanes repeat the first
+ * channel and are ignored by the caller. */
+static FORCE_INLINE void meter_channels(float *const history[4],
+					const float *const planes[4],
+					size_t frames, struct meter_lanes *l,
+					const bool true_peak)
+{
+	size_t i = 0;
+
+	l->h0 = _mm_loadu_ps(history[0]);
+	l->h1 = _mm_loadu_ps(history[1]);
+	l->h2 = _mm_loadu_ps(history[2]);
+	l->h3 = _mm_loadu_ps(history[3]);
+	l->sample_peak = _mm_setzero_ps();
+	l->sum_squares = _mm_setzero_ps();
+
+	/* the previous tick's samples are part of the interpolation of the
+	 * first few points, so include them like the old per-channel meter */
+	l->true_peak = _mm_max_ps(_mm_max_ps(abs_ps(l->h0), abs_ps(l->h1)),
+				  _mm_max_ps(abs_ps(l->h2), abs_ps(l->h3)));
+
+	for (; i + 3 < frames; i += 4) {
+		__m128 s0 = _mm_loadu_ps(planes[0] + i);
+		__m128 s1 = _mm_loadu_ps(planes[1] + i);
+		__m128 s2 = _mm_loadu_ps(planes[2] + i);
+		__m128 s3 = _mm_loadu_ps(planes[3] + i);
+
+		/* planar to one sample of every channel per vector */
+		_MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+
+		meter_sample(l, s0, true_peak);
+		meter_sample(l, s1, true_peak);
+		meter_sample(l, s2, true_peak);
+		meter_sample(l, s3, true_peak);
+	}
 
-		/* volmeter->prev_samples may not be aligned to 16 bytes;
-		 * use unaligned load. */
-		__m128 previous_samples =
-			_mm_loadu_ps(volmeter->prev_samples[channel_nr]);
-
-		float peak;
-		switch (volmeter->peak_meter_type) {
-		case TRUE_PEAK_METER:
-			peak = get_true_peak(previous_samples, samples,
-					     nr_samples);
-			break;
-
-		case SAMPLE_PEAK_METER:
-		default:
-			peak = get_sample_peak(previous_samples, samples,
-					       nr_samples);
-			break;
-		}
+	for (; i < frames; i++) {
+		__m128 s = _mm_set_ps(planes[3][i], planes[2][i], planes[1][i],
+				      planes[0][i]);
+		meter_sample(l, s, true_peak);
+	}
 
-		volmeter_process_peak_last_samples(volmeter, channel_nr,
-						   samples, nr_samples);
+	_mm_storeu_ps(history[0], l->h0);
+	_mm_storeu_ps(history[1], l->h1);
+	_mm_storeu_ps(history[2], l->h2);
+	_mm_storeu_ps(history[3], l->h3);
 
-		volmeter->peak[channel_nr] = peak;
+	l->true_peak = _mm_max_ps(l->true_peak, l->sample_peak);
+}
 
-		channel_nr++;
-	}
+static void audio_meter_measure(struct audio_meter *meter,
+				const struct audio_data *data,
+				struct meter_levels *levels, bool true_peak)
+{
+	const float *planes[MAX_AUDIO_CHANNELS];
+	int nr_channels = 0;
 
-	/* Clear the peak of the channels that have not been handled. */
-	for (; channel_nr < MAX_AUDIO_CHANNELS; channel_nr++) {
-		volmeter->peak[channel_nr] = 0.0;
+	for (int i = 0; i < MAX_AV_PLANES; i++) {
+		if (data->data[i] && nr_channels < MAX_AUDIO_CHANNELS)
+			planes[nr_channels++] = (const float *)data->data[i];
 	}
-}
 
-static void volmeter_process_magnitude(obs_volmeter_t *volmeter,
-				       const struct audio_data *data,
-				       int nr_channels)
-{
-	size_t nr_samples = data->frames;
+	memset(levels, 0, sizeof(*levels));
+	levels->nr_channels = nr_channels;
+	levels->frames = data->frames;
 
-	int channel_nr = 0;
-	for (int plane_nr = 0; channel_nr < nr_channels; plane_nr++) {
-		float *samples = (float *)data->data[plane_nr];
-		if (!samples) {
-			continue;
-		}
+	for (int ch = 0; ch < nr_channels; ch += 4) {
+		const float *group[4];
+		float *history[4];
+		struct meter_lanes lanes;
+		float lane_out[4];
 
-		float sum = 0.0;
-		for (size_t i = 0; i < nr_samples; i++) {
-			float sample = samples[i];
-			sum += sample * sample;
+		for (int i = 0; i < 4; i++) {
+			group[i] = ch + i < nr_channels ? planes[ch + i]
+							: planes[ch];
+			history[i] = &meter->history[i][ch];
 		}
-		volmeter->magnitude[channel_nr] = sqrtf(sum / nr_samples);
 
-		channel_nr++;
+		if (true_peak)
+			meter_channels(history, group, data->frames, &lanes,
+				       true);
+		else
+			meter_channels(history, group, data->frames, &lanes,
+				       false);
+
+		int count = nr_channels - ch < 4 ? nr_channels - ch : 4;
+
+		_mm_storeu_ps(lane_out, lanes.sample_peak);
+		memcpy(&levels->sample_peak[ch], lane_out,
+		       count * sizeof(float));
+		_mm_storeu_ps(lane_out, lanes.true_peak);
+		memcpy(&levels->true_peak[ch], lane_out,
+		       count * sizeof(float));
+		_mm_storeu_ps(lane_out, lanes.sum_squares);
+		memcpy(&levels->sum_squares[ch], lane_out,
+		       count * sizeof(float));
 	}
 }
 
-static void volmeter_process_audio_data(obs_volmeter_t *volmeter,
-					const struct audio_data *data)
+static void volmeter_update(struct obs_volmeter *volmeter,
+			    const struct meter_levels *levels, bool muted)
 {
-	int nr_channels = get_nr_channels_from_audio_data(data);
-
-	volmeter_process_peak(volmeter, data, nr_channels);
-	volmeter_process_magnitude(volmeter, data, nr_channels);
-}
-
-static void volmeter_source_data_received(void *vptr, obs_source_t *source,
-					  const struct audio_data *data,
-					  bool muted)
-{
-	struct obs_volmeter *volmeter = (struct obs_volmeter *)vptr;
 	float mul;
 	float magnitude[MAX_AUDIO_CHANNELS];
 	float peak[MAX_AUDIO_CHANNELS];
@@ -531,29 +457,141 @@ static void volmeter_source_data_received(void *vptr, obs_source_t *source,
 
 	pthread_mutex_lock(&volmeter->mutex);
 
-	volmeter_process_audio_data(volmeter, data);
+	const float *tick_peak = volmeter->peak_meter_type == TRUE_PEAK_METER
+					 ? levels->true_peak
+					 : levels->sample_peak;
+
+	for (int channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS;
+	     channel_nr++) {
+		float *peak_acc = &volmeter->peak[channel_nr];
+
+		*peak_acc = fmaxf(*peak_acc, tick_peak[channel_nr]);
+		volmeter->sum_squares[channel_nr] +=
+			levels->sum_squares[channel_nr];
+	}
+	volmeter->frames += levels->frames;
+
+	if (++volmeter->ticks < volmeter->decimation) {
+		pthread_mutex_unlock(&volmeter->mutex);
+		return;
+	}
 
 	// Adjust magnitude/peak based on the volume level set by the user.
 	// And convert to dB.
 	mul = muted ? 0.0f : db_to_mul(volmeter->cur_db);
 	for (int channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS;
 	     channel_nr++) {
-		magnitude[channel_nr] =
-			mul_to_db(volmeter->magnitude[channel_nr] * mul);
+		float rms = volmeter->frames
+				    ? sqrtf(volmeter->sum_squares[channel_nr] /
+					    volmeter->frames)
+				    : 0.0f;
+
+		magnitude[channel_nr] = mul_to_db(rms * mul);
 		peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr] * mul);
 
 		/* The input-peak is NOT adjusted with volume, so that the user
 		 * can check the input-gain. */
 		input_peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr]);
+
+		volmeter->peak[channel_nr] = 0.0f;
+		volmeter->sum_squares[channel_nr] = 0.0f;
 	}
+	volmeter->frames = 0;
+	volmeter->ticks = 0;
 
 	pthread_mutex_unlock(&volmeter->mutex);
 
 	signal_levels_updated(volmeter, magnitude, peak, input_peak);
+}
+
+static void audio_meter_data_received(void *vptr, obs_source_t *source,
+				      const struct audio_data *data,
+				      bool muted)
+{
+	struct audio_meter *meter = vptr;
+	struct meter_levels levels;
+	bool true_peak = false;
+
+	pthread_mutex_lock(&meter->mutex);
+
+	/* the more expensive true peak is only measured if a meter shows it */
+	for (size_t i = 0; i < meter->volmeters.num; i++) {
+		struct obs_volmeter *volmeter = meter->volmeters.array[i];
+
+		pthread_mutex_lock(&volmeter->mutex);
+		if (volmeter->peak_meter_type == TRUE_PEAK_METER)
+			true_peak = true;
+		pthread_mutex_unlock(&volmeter->mutex);
+	}
+
+	audio_meter_measure(meter, data, &levels, true_peak);
+
+	for (size_t i = 0; i < meter->volmeters.num; i++)
+		volmeter_update(meter->volmeters.array[i], &levels, muted);
+
+	pthread_mutex_unlock(&meter->mutex);
 
 	UNUSED_PARAMETER(source);
 }
 
+static void audio_meter_add_volmeter(obs_source_t *source,
+				     struct obs_volmeter *volmeter)
+{
+	struct audio_meter *meter;
+
+	pthread_mutex_lock(&audio_meters_mutex);
+
+	meter = source->audio_meter;
+	if (!meter) {
+		meter = bzalloc(sizeof(struct audio_meter));
+		pthread_mutex_init(&meter->mutex, NULL);
+		source->audio_meter = meter;
+
+		obs_source_add_audio_capture_callback(
+			source, audio_meter_data_received, meter);
+	}
+
+	pthread_mutex_lock(&meter->mutex);
+	da_push_back(meter->volmeters, &volmeter);
+	pthread_mutex_unlock(&meter->mutex);
+
+	pthread_mutex_unlock(&audio_meters_mutex);
+}
+
+static void audio_meter_remove_volmeter(obs_source_t *source,
+					struct obs_volmeter *volmeter)
+{
+	struct audio_meter *meter;
+	bool empty;
+
+	pthread_mutex_lock(&audio_meters_mutex);
+
+	meter = source->audio_meter;
+	if (!meter) {
+		pthread_mutex_unlock(&audio_meters_mutex);
+		return;
+	}
+
+	/* once this returns the audio thread can no longer call into the
+	 * volmeter */
+	pthread_mutex_lock(&meter->mutex);
+	da_erase_item(meter->volmeters, &volmeter);
+	empty = meter->volmeters.num == 0;
+	pthread_mutex_unlock(&meter->mutex);
+
+	if (empty) {
+		obs_source_remove_audio_capture_callback(
+			source, audio_meter_data_received, meter);
+		source->audio_meter = NULL;
+
+		da_free(meter->volmeters);
+		pthread_mutex_destroy(&meter->mutex);
+		bfree(meter);
+	}
+
+	pthread_mutex_unlock(&audio_meters_mutex);
+}
+
 obs_fader_t *obs_fader_create(enum obs_fader_type type)
 {
 	struct obs_fader *fader = bzalloc(sizeof(struct obs_fader));
@@ -782,6 +820,7 @@ obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 		goto fail;
 
 	volmeter->type = type;
+	volmeter->decimation = 1;
 
 	obs_volmeter_set_update_interval(volmeter, 50);
 
@@ -819,17 +858,21 @@ bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
 			       volmeter);
 	signal_handler_connect(sh, "destroy", volmeter_source_destroyed,
 			       volmeter);
-	obs_source_add_audio_capture_callback(
-		source, volmeter_source_data_received, volmeter);
 	vol = obs_source_get_volume(source);
 
 	pthread_mutex_lock(&volmeter->mutex);
 
 	volmeter->source = source;
 	volmeter->cur_db = mul_to_db(vol);
+	volmeter->ticks = 0;
+	volmeter->frames = 0;
+	memset(volmeter->peak, 0, sizeof(volmeter->peak));
+	memset(volmeter->sum_squares, 0, sizeof(volmeter->sum_squares));
 
 	pthread_mutex_unlock(&volmeter->mutex);
 
+	audio_meter_add_volmeter(source, volmeter);
+
 	return true;
 }
 
@@ -854,8 +897,7 @@ void obs_volmeter_detach_source(obs_volmeter_t *volmeter)
 				  volmeter);
 	signal_handler_disconnect(sh, "destroy", volmeter_source_destroyed,
 				  volmeter);
-	obs_source_remove_audio_capture_callback(
-		source, volmeter_source_data_received, volmeter);
+	audio_meter_remove_volmeter(source, volmeter);
 }
 
 void obs_volmeter_set_peak_meter_type(obs_volmeter_t *volmeter,
@@ -889,6 +931,29 @@ unsigned int obs_volmeter_get_update_interval(obs_volmeter_t *volmeter)
 	return interval;
 }
 
+void obs_volmeter_set_decimation(obs_volmeter_t *volmeter,
+				 unsigned int ticks)
+{
+	if (!volmeter || !ticks)
+		return;
+
+	pthread_mutex_lock(&volmeter->mutex);
+	volmeter->decimation = ticks;
+	pthread_mutex_unlock(&volmeter->mutex);
+}
+
+unsigned int obs_volmeter_get_decimation(obs_volmeter_t *volmeter)
+{
+	if (!volmeter)
+		return 0;
+
+	pthread_mutex_lock(&volmeter->mutex);
+	const unsigned int ticks = volmeter->decimation;
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	return ticks;
+}
+
 int obs_volmeter_get_nr_channels(obs_volmeter_t *volmeter)
 {
 	int source_nr_audio_channels;
@@ -259,6 +259,24 @@ EXPORT void obs_volmeter_set_update_interval(obs_volmeter_t *volmeter,
  */
 EXPORT unsigned int obs_volmeter_get_update_interval(obs_volmeter_t *volmeter);
 
+/**
+ * @brief Only report levels once every few audio ticks
+ * @param volmeter pointer to the volume meter object
+ * @param ticks number of audio ticks per levels_updated callback
+ *
+ * Peaks and magnitude are gathered over all ticks in between, so nothing is
+ * missed, only reported less often.  The default is 1, reporting every tick.
+ */
+EXPORT void obs_volmeter_set_decimation(obs_volmeter_t *volmeter,
+					unsigned int ticks);
+
+/**
+ * @brief Get the number of audio ticks per levels_updated callback
+ * @param volmeter pointer to the volume meter object
+ * @return number of ticks
+ */
+EXPORT unsigned int obs_volmeter_get_decimation(obs_volmeter_t *volmeter);
+
 /**
  * @brief Get the number of channels which are configured for this source.
  * @param volmeter pointer to the volume meter object
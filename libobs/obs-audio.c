@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include "obs-internal.h"
 #include "util/util_uint64.h"
+#include "media-io/audio-math.h"
 
 struct ts_info {
 	uint64_t start;
@@ -26,7 +27,6 @@ struct ts_info {
 
 #define DEBUG_AUDIO 0
 #define DEBUG_LAGGED_AUDIO 0
-#define MAX_BUFFERING_TICKS 45
 
 static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
@@ -47,10 +47,11 @@ static inline size_t convert_time_to_frames(size_t sample_rate, uint64_t t)
 }
 
 static inline void mix_audio(struct audio_output_data *mixes,
-			     obs_source_t *source, size_t channels,
-			     size_t sample_rate, struct ts_info *ts)
+			     obs_source_t *source, uint32_t mixers,
+			     size_t channels, size_t sample_rate,
+			     struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t total_floats = obs->audio.frames_per_tick;
 	size_t start_point = 0;
 
 	if (source->audio_ts < ts->start || ts->end <= source->audio_ts)
@@ -59,24 +60,24 @@ static inline void mix_audio(struct audio_output_data *mixes,
 	if (source->audio_ts != ts->start) {
 		start_point = convert_time_to_frames(
 			sample_rate, source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES)
+		if (start_point == total_floats)
 			return;
 
 		total_floats -= start_point;
 	}
 
+	/* only mix into active mixes the source has audio for */
+	mixers &= ~source->audio_silent_mixes;
+
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		for (size_t ch = 0; ch < channels; ch++) {
-			register float *mix = mixes[mix_idx].data[ch];
-			register float *aud =
-				source->audio_output_buf[mix_idx][ch];
-			register float *end;
+		if ((mixers & (1 << mix_idx)) == 0)
+			continue;
 
-			mix += start_point;
-			end = aud + total_floats;
+		for (size_t ch = 0; ch < channels; ch++) {
+			float *mix = mixes[mix_idx].data[ch];
+			float *aud = source->audio_output_buf[mix_idx][ch];
 
-			while (aud < end)
-				*(mix++) += *(aud++);
+			audio_mix_floats(mix + start_point, aud, total_floats);
 		}
 	}
 }
@@ -193,16 +194,12 @@ static bool discard_if_stopped(obs_source_t *source, size_t channels)
 	}
 }
 
-#define MAX_AUDIO_SIZE (AUDIO_OUTPUT_FRAMES * sizeof(float))
-
 static inline void discard_audio(struct obs_core_audio *audio,
 				 obs_source_t *source, size_t channels,
 				 size_t sample_rate, struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t total_floats = audio->frames_per_tick;
 	size_t size;
-	/* debug assert only */
-	UNUSED_PARAMETER(audio);
 
 #if DEBUG_AUDIO == 1
 	bool is_audio_source = source->info.output_flags & OBS_SOURCE_AUDIO;
@@ -226,7 +223,8 @@ static inline void discard_audio(struct obs_core_audio *audio,
 
 	if (source->audio_ts < (ts->start - 1)) {
 		if (source->audio_pending &&
-		    source->audio_input_buf[0].size < MAX_AUDIO_SIZE &&
+		    source->audio_input_buf[0].size <
+			    total_floats * sizeof(float) &&
 		    discard_if_stopped(source, channels))
 			return;
 
@@ -241,7 +239,8 @@ static inline void discard_audio(struct obs_core_audio *audio,
 
 		/* ignore_audio should have already run and marked this source
 		 * pending, unless we *just* added buffering */
-		assert(audio->total_buffering_ticks < MAX_BUFFERING_TICKS ||
+		assert(audio->total_buffering_ticks <
+			       audio->max_buffering_ticks ||
 		       source->audio_pending || !source->audio_ts ||
 		       audio->buffering_wait_ticks);
 #endif
@@ -252,7 +251,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	    source->audio_ts != (ts->start - 1)) {
 		size_t start_point = convert_time_to_frames(
 			sample_rate, source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES) {
+		if (start_point == total_floats) {
 #if DEBUG_AUDIO == 1
 			if (is_audio_source)
 				blog(LOG_DEBUG, "can't discard, start point is "
@@ -292,10 +291,24 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	source->audio_ts = ts->end;
 }
 
+static void signal_audio_buffering(struct obs_core_audio *audio,
+				   size_t sample_rate)
+{
+	struct calldata params;
+	uint8_t stack[128];
+	int ms = (int)((uint64_t)audio->total_buffering_ticks *
+		       audio->frames_per_tick * 1000 / sample_rate);
+
+	calldata_init_fixed(&params, stack, sizeof(stack));
+	calldata_set_int(&params, "ms", ms);
+	signal_handler_signal(obs->signals, "audio_buffering", &params);
+}
+
 static void add_audio_buffering(struct obs_core_audio *audio,
 				size_t sample_rate, struct ts_info *ts,
 				uint64_t min_ts, const char *buffering_name)
 {
+	size_t tick_frames = audio->frames_per_tick;
 	struct ts_info new_ts;
 	uint64_t offset;
 	uint64_t frames;
@@ -303,7 +316,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	size_t ms;
 	int ticks;
 
-	if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS)
+	if (audio->total_buffering_ticks == audio->max_buffering_ticks)
 		return;
 
 	if (!audio->buffering_wait_ticks)
@@ -311,18 +324,19 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 
 	offset = ts->start - min_ts;
 	frames = ns_to_audio_frames(sample_rate, offset);
-	ticks = (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
+	ticks = (int)((frames + tick_frames - 1) / tick_frames);
 
 	audio->total_buffering_ticks += ticks;
 
-	if (audio->total_buffering_ticks >= MAX_BUFFERING_TICKS) {
-		ticks -= audio->total_buffering_ticks - MAX_BUFFERING_TICKS;
-		audio->total_buffering_ticks = MAX_BUFFERING_TICKS;
+	if (audio->total_buffering_ticks >= audio->max_buffering_ticks) {
+		ticks -= audio->total_buffering_ticks -
+			 audio->max_buffering_ticks;
+		audio->total_buffering_ticks = audio->max_buffering_ticks;
 		blog(LOG_WARNING, "Max audio buffering reached!");
 	}
 
-	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
+	ms = ticks * tick_frames * 1000 / sample_rate;
+	total_ms = audio->total_buffering_ticks * tick_frames * 1000 /
 		   sample_rate;
 
 	blog(LOG_INFO,
@@ -330,6 +344,10 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	     "audio buffering is now %d milliseconds"
 	     " (source: %s)\n",
 	     (int)ms, (int)total_ms, buffering_name);
+	signal_audio_buffering(audio, sample_rate);
+
+	/* start looking for a chance to shrink back down from scratch */
+	audio->shrink_window_start = 0;
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG,
 	     "min_ts (%" PRIu64 ") < start timestamp "
@@ -339,19 +357,17 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	     ts->end);
 #endif
 
+	frames = audio->buffering_wait_ticks * tick_frames;
 	new_ts.start =
-		audio->buffered_ts -
-		audio_frames_to_ns(sample_rate, audio->buffering_wait_ticks *
-							AUDIO_OUTPUT_FRAMES);
+		audio->buffered_ts - audio_frames_to_ns(sample_rate, frames);
 
 	while (ticks--) {
 		const uint64_t cur_ticks = ++audio->buffering_wait_ticks;
 
 		new_ts.end = new_ts.start;
-		new_ts.start =
-			audio->buffered_ts -
-			audio_frames_to_ns(sample_rate,
-					   cur_ticks * AUDIO_OUTPUT_FRAMES);
+		new_ts.start = audio->buffered_ts -
+			       audio_frames_to_ns(sample_rate,
+						  cur_ticks * tick_frames);
 
 #if DEBUG_AUDIO == 1
 		blog(LOG_DEBUG, "add buffered ts: %" PRIu64 "-%" PRIu64,
@@ -365,10 +381,70 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	*ts = new_ts;
 }
 
+/* how far past the end of the current tick a source has audio buffered, or
+ * UINT64_MAX for sources that don't hold back the mix */
+static inline uint64_t audio_lead(struct obs_source *source,
+				  size_t sample_rate, const struct ts_info *ts)
+{
+	size_t frames = source->audio_input_buf[0].size / sizeof(float);
+	uint64_t end;
+
+	if (source->info.audio_render || !source->audio_ts)
+		return UINT64_MAX;
+	if (source->audio_pending)
+		return 0;
+
+	end = source->audio_ts + audio_frames_to_ns(sample_rate, frames);
+	return end > ts->end ? end - ts->end : 0;
+}
+
+/* Buffering is lowered one tick at a time, and only once every source has
+ * stayed at least two ticks ahead of the mix for the whole shrink period.
+ * The tick is removed by asking the audio output for one extra tick right
+ * away, so output timestamps stay contiguous and in sync with video. */
+static void shrink_audio_buffering(struct obs_core_audio *audio,
+				   size_t sample_rate,
+				   const struct ts_info *ts, uint64_t lead)
+{
+	uint64_t tick_ns;
+	int total_ms;
+
+	if (!audio->buffering_shrink_ns || !audio->total_buffering_ticks)
+		return;
+
+	if (!audio->shrink_window_start) {
+		audio->shrink_window_start = ts->end;
+		audio->shrink_min_lead = lead;
+		return;
+	}
+
+	if (lead < audio->shrink_min_lead)
+		audio->shrink_min_lead = lead;
+	if (ts->end - audio->shrink_window_start < audio->buffering_shrink_ns)
+		return;
+
+	tick_ns = audio_frames_to_ns(sample_rate, audio->frames_per_tick);
+
+	if (audio->shrink_min_lead >= tick_ns * 2) {
+		audio->total_buffering_ticks--;
+		audio_output_add_tick(audio->audio);
+
+		total_ms = (int)((uint64_t)audio->total_buffering_ticks *
+				 audio->frames_per_tick * 1000 / sample_rate);
+		blog(LOG_INFO,
+		     "removing %d milliseconds of audio buffering, total "
+		     "audio buffering is now %d milliseconds",
+		     (int)(tick_ns / 1000000), total_ms);
+		signal_audio_buffering(audio, sample_rate);
+	}
+
+	audio->shrink_window_start = 0;
+}
+
 static bool audio_buffer_insuffient(struct obs_source *source,
 				    size_t sample_rate, uint64_t min_ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t total_floats = obs->audio.frames_per_tick;
 	size_t size;
 
 	if (source->info.audio_render || source->audio_pending ||
@@ -379,7 +455,7 @@ static bool audio_buffer_insuffient(struct obs_source *source,
 	if (source->audio_ts != min_ts && source->audio_ts != (min_ts - 1)) {
 		size_t start_point = convert_time_to_frames(
 			sample_rate, source->audio_ts - min_ts);
-		if (start_point >= AUDIO_OUTPUT_FRAMES)
+		if (start_point >= total_floats)
 			return false;
 
 		total_floats -= start_point;
@@ -442,6 +518,157 @@ static inline void release_audio_sources(struct obs_core_audio *audio)
 		obs_source_release(audio->render_order.array[i]);
 }
 
+#define MAX_AUDIO_RENDER_THREADS 4
+
+static inline uint64_t get_audio_render_time(obs_source_t *source)
+{
+	return (uint64_t)os_atomic_load_long(&source->audio_render_time);
+}
+
+static inline void set_audio_render_time(obs_source_t *source, uint64_t ns)
+{
+	os_atomic_set_long(&source->audio_render_time,
+			   ns > LONG_MAX ? LONG_MAX : (long)ns);
+}
+
+static inline void render_audio_source(obs_source_t *source, uint32_t mixers,
+				       size_t channels, size_t sample_rate)
+{
+	uint64_t start = os_gettime_ns();
+
+	obs_source_audio_render(source, mixers, channels, sample_rate,
+				obs->audio.frames_per_tick * sizeof(float));
+	set_audio_render_time(source, os_gettime_ns() - start);
+}
+
+static void render_next_leaves(struct obs_core_audio *audio)
+{
+	for (;;) {
+		long idx = os_atomic_inc_long(&audio->render_next) - 1;
+		if ((size_t)idx >= audio->render_leaves.num)
+			break;
+
+		render_audio_source(audio->render_leaves.array[idx],
+				    audio->render_mixers,
+				    audio->render_channels,
+				    audio->render_sample_rate);
+	}
+}
+
+static void *audio_render_thread(void *param)
+{
+	struct obs_core_audio *audio = param;
+
+	os_set_thread_name("libobs: audio render thread");
+
+	while (os_sem_wait(audio->render_start) == 0) {
+		if (os_atomic_load_bool(&audio->render_stop))
+			break;
+
+		render_next_leaves(audio);
+		os_sem_post(audio->render_done);
+	}
+
+	return NULL;
+}
+
+/* inputs don't depend on each other, so they're all rendered up front, spread
+ * across the render threads and the audio thread itself.  submixes call back
+ * into plugins (audio_mix, along with any filters and capture callbacks it
+ * triggers), which have always been called on the audio thread alone, so
+ * they're rendered in order on the audio thread along with scenes and
+ * transitions. */
+static inline bool render_in_parallel(const obs_source_t *source)
+{
+	return !source->info.audio_render && !source->info.audio_mix;
+}
+
+static void render_leaf_sources(struct obs_core_audio *audio, uint32_t mixers,
+				size_t channels, size_t sample_rate)
+{
+	size_t threads;
+
+	da_resize(audio->render_leaves, 0);
+
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+		if (render_in_parallel(source))
+			da_push_back(audio->render_leaves, &source);
+	}
+
+	if (!audio->render_leaves.num)
+		return;
+
+	threads = audio->render_leaves.num - 1;
+	if (threads > audio->num_render_threads)
+		threads = audio->num_render_threads;
+
+	audio->render_mixers = mixers;
+	audio->render_channels = channels;
+	audio->render_sample_rate = sample_rate;
+	os_atomic_set_long(&audio->render_next, 0);
+
+	for (size_t i = 0; i < threads; i++)
+		os_sem_post(audio->render_start);
+
+	render_next_leaves(audio);
+
+	for (size_t i = 0; i < threads; i++)
+		os_sem_wait(audio->render_done);
+}
+
+bool obs_init_audio_render_threads(struct obs_core_audio *audio)
+{
+	size_t threads = (size_t)os_get_logical_cores() / 2;
+
+	if (threads > MAX_AUDIO_RENDER_THREADS)
+		threads = MAX_AUDIO_RENDER_THREADS;
+	if (!threads)
+		return true;
+
+	if (os_sem_init(&audio->render_start, 0) != 0)
+		return false;
+	if (os_sem_init(&audio->render_done, 0) != 0)
+		return false;
+
+	audio->render_threads = bzalloc(sizeof(pthread_t) * threads);
+
+	for (size_t i = 0; i < threads; i++) {
+		if (pthread_create(&audio->render_threads[i], NULL,
+				   audio_render_thread, audio) != 0) {
+			blog(LOG_WARNING, "Failed to create audio render "
+					  "thread, rendering audio with "
+					  "fewer threads");
+			break;
+		}
+		audio->num_render_threads++;
+	}
+
+	blog(LOG_INFO, "audio: rendering sources with %d extra threads",
+	     (int)audio->num_render_threads);
+	return true;
+}
+
+void obs_free_audio_render_threads(struct obs_core_audio *audio)
+{
+	os_atomic_set_bool(&audio->render_stop, true);
+
+	for (size_t i = 0; i < audio->num_render_threads; i++)
+		os_sem_post(audio->render_start);
+	for (size_t i = 0; i < audio->num_render_threads; i++)
+		pthread_join(audio->render_threads[i], NULL);
+
+	bfree(audio->render_threads);
+	os_sem_destroy(audio->render_start);
+	os_sem_destroy(audio->render_done);
+
+	audio->render_threads = NULL;
+	audio->num_render_threads = 0;
+	audio->render_start = NULL;
+	audio->render_done = NULL;
+	audio->render_stop = false;
+}
+
 bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 		    uint64_t *out_ts, uint32_t mixers,
 		    struct audio_output_data *mixes)
@@ -452,18 +679,22 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	size_t sample_rate = audio_output_get_sample_rate(audio->audio);
 	size_t channels = audio_output_get_channels(audio->audio);
 	struct ts_info ts = {start_ts_in, end_ts_in};
-	size_t audio_size;
+	uint64_t min_lead = UINT64_MAX;
 	uint64_t min_ts;
 
 	da_resize(audio->render_order, 0);
 	da_resize(audio->root_nodes, 0);
 
-	circlebuf_push_back(&audio->buffered_timestamps, &ts, sizeof(ts));
+	/* extra ticks requested by shrink_audio_buffering don't add any new
+	 * time, they only output the oldest buffered tick */
+	if (start_ts_in != end_ts_in)
+		circlebuf_push_back(&audio->buffered_timestamps, &ts,
+				    sizeof(ts));
+	else if (!audio->buffered_timestamps.size)
+		return false;
 	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
-	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
-
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG, "ts %llu-%llu", ts.start, ts.end);
 #endif
@@ -494,14 +725,18 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	/* ------------------------------------------------ */
 	/* render audio data */
+	render_leaf_sources(audio, mixers, channels, sample_rate);
+
 	for (size_t i = 0; i < audio->render_order.num; i++) {
 		obs_source_t *source = audio->render_order.array[i];
-		obs_source_audio_render(source, mixers, channels, sample_rate,
-					audio_size);
+		if (!render_in_parallel(source))
+			render_audio_source(source, mixers, channels,
+					    sample_rate);
 
 		/* if a source has gone backward in time and we can no
 		 * longer buffer, drop some or all of its audio */
-		if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS &&
+		if (audio->total_buffering_ticks ==
+			    audio->max_buffering_ticks &&
 		    source->audio_ts < ts.start) {
 			if (source->info.audio_render) {
 				blog(LOG_DEBUG,
@@ -523,11 +758,17 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 				pthread_mutex_unlock(&source->audio_buf_mutex);
 
 				/* if we (potentially) recovered, re-render */
-				if (rerender)
-					obs_source_audio_render(source, mixers,
-								channels,
-								sample_rate,
-								audio_size);
+				if (rerender) {
+					uint64_t prev =
+						get_audio_render_time(source);
+					render_audio_source(source, mixers,
+							    channels,
+							    sample_rate);
+					set_audio_render_time(
+						source,
+						prev + get_audio_render_time(
+							       source));
+				}
 			}
 		}
 	}
@@ -553,13 +794,9 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 			if (source->audio_pending)
 				continue;
 
-			pthread_mutex_lock(&source->audio_buf_mutex);
-
 			if (source->audio_output_buf[0][0] && source->audio_ts)
-				mix_audio(mixes, source, channels, sample_rate,
-					  &ts);
-
-			pthread_mutex_unlock(&source->audio_buf_mutex);
+				mix_audio(mixes, source, mixers, channels,
+					  sample_rate, &ts);
 		}
 	}
 
@@ -569,15 +806,20 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	source = data->first_audio_source;
 	while (source) {
-		pthread_mutex_lock(&source->audio_buf_mutex);
+		uint64_t lead = audio_lead(source, sample_rate, &ts);
+		if (lead < min_lead)
+			min_lead = lead;
+
 		discard_audio(audio, source, channels, sample_rate, &ts);
-		pthread_mutex_unlock(&source->audio_buf_mutex);
 
 		source = (struct obs_source *)source->next_audio_source;
 	}
 
 	pthread_mutex_unlock(&data->audio_sources_mutex);
 
+	if (!audio->buffering_wait_ticks)
+		shrink_audio_buffering(audio, sample_rate, &ts, min_lead);
+
 	/* ------------------------------------------------ */
 	/* release audio sources */
 	release_audio_sources(audio);
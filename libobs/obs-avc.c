@@ -15,7 +15,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
-#include "obs.h"
+#include "obs-internal.h"
 #include "obs-avc.h"
 #include "util/array-serializer.h"
 
@@ -130,22 +130,36 @@ static void serialize_avc_data(struct serializer *s, const uint8_t *data,
 	}
 }
 
+struct packet_output {
+	uint8_t *data;
+	size_t size;
+};
+
+static size_t packet_output_write(void *param, const void *data, size_t size)
+{
+	struct packet_output *output = param;
+	memcpy(output->data + output->size, data, size);
+	output->size += size;
+	return size;
+}
+
 void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 			  const struct encoder_packet *src)
 {
-	struct array_output_data output;
-	struct serializer s;
-	long ref = 1;
+	struct packet_output output;
+	struct serializer s = {.data = &output, .write = packet_output_write};
 
-	array_output_serializer_init(&s, &output);
+	/* every NAL unit follows a start code of at least three bytes, and
+	 * grows by at most one byte when that becomes a 32-bit size */
+	output.data = packet_pool_alloc(src->size + src->size / 3 + 4);
+	output.size = 0;
 	*avc_packet = *src;
 
-	serialize(&s, &ref, sizeof(ref));
 	serialize_avc_data(&s, src->data, src->size, &avc_packet->keyframe,
 			   &avc_packet->priority);
 
-	avc_packet->data = output.bytes.array + sizeof(ref);
-	avc_packet->size = output.bytes.num - sizeof(ref);
+	avc_packet->data = output.data;
+	avc_packet->size = output.size;
 	avc_packet->drop_priority = get_drop_priority(avc_packet->priority);
 }
 
@@ -0,0 +1,330 @@
+/******************************************************************************
+    Copyright (C) 2023 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "media-io/video-frame.h"
+#include "obs-internal.h"
+
+struct queued_frame {
+	struct encoder_frame frame;
+	uint64_t queued_ts;
+};
+
+static inline size_t queued_frames(const struct encoder_queue *queue)
+{
+	return queue->queued.size / sizeof(struct queued_frame);
+}
+
+static void record_encode(struct encoder_queue *queue, uint64_t latency)
+{
+	struct obs_encoder_queue_stats *stats = &queue->stats;
+
+	stats->encoded++;
+	stats->last_latency_ns = latency;
+	if (latency > stats->max_latency_ns)
+		stats->max_latency_ns = latency;
+
+	queue->total_latency += latency;
+	stats->avg_latency_ns = queue->total_latency / stats->encoded;
+}
+
+static bool pop_queued_frame(struct encoder_queue *queue,
+			     struct queued_frame *qf)
+{
+	bool popped;
+
+	pthread_mutex_lock(&queue->mutex);
+	popped = queue->queued.size != 0;
+	if (popped)
+		circlebuf_pop_front(&queue->queued, qf, sizeof(*qf));
+	pthread_mutex_unlock(&queue->mutex);
+
+	if (popped && queue->policy == OBS_ENCODER_QUEUE_BLOCK)
+		os_sem_post(queue->slots_sem);
+	return popped;
+}
+
+static bool encode_queued_frame(struct obs_encoder *encoder,
+				struct queued_frame *qf)
+{
+	struct encoder_queue *queue = &encoder->queue;
+	bool success = do_encode(encoder, &qf->frame);
+
+	pthread_mutex_lock(&queue->mutex);
+	record_encode(queue, os_gettime_ns() - qf->queued_ts);
+	circlebuf_push_back(&queue->avail, qf, sizeof(*qf));
+	pthread_mutex_unlock(&queue->mutex);
+
+	return success;
+}
+
+static void *encoder_queue_thread(void *param)
+{
+	struct obs_encoder *encoder = param;
+	struct encoder_queue *queue = &encoder->queue;
+	struct queued_frame qf;
+
+	os_set_thread_name("obs encoder queue thread");
+
+	while (os_sem_wait(queue->frames_sem) == 0) {
+		if (os_atomic_load_bool(&queue->stop))
+			break;
+
+		/* frames replaced at the front of the queue leave their
+		 * posts behind */
+		if (!pop_queued_frame(queue, &qf))
+			continue;
+
+		/* do_encode has already stopped the encoder */
+		if (!encode_queued_frame(encoder, &qf))
+			return NULL;
+	}
+
+	/* frames queued before a normal stop are still encoded.  nothing
+	 * is queued after this, see encoder_queue_push */
+	while (pop_queued_frame(queue, &qf)) {
+		if (!encode_queued_frame(encoder, &qf))
+			break;
+	}
+
+	return NULL;
+}
+
+static void free_frames(struct circlebuf *frames)
+{
+	while (frames->size) {
+		struct queued_frame qf;
+		circlebuf_pop_front(frames, &qf, sizeof(qf));
+		bfree(qf.frame.data[0]);
+	}
+	circlebuf_free(frames);
+}
+
+static void free_queue_data(struct encoder_queue *queue)
+{
+	pthread_mutex_lock(&queue->mutex);
+	free_frames(&queue->queued);
+	free_frames(&queue->avail);
+	pthread_mutex_unlock(&queue->mutex);
+
+	os_sem_destroy(queue->frames_sem);
+	os_sem_destroy(queue->slots_sem);
+	queue->frames_sem = NULL;
+	queue->slots_sem = NULL;
+}
+
+/* each frame owns one allocation, pointed to by data[0] */
+static void alloc_frame(struct obs_encoder *encoder,
+			struct encoder_frame *frame)
+{
+	memset(frame, 0, sizeof(*frame));
+
+	if (encoder->info.type == OBS_ENCODER_VIDEO) {
+		struct video_scale_info *info = &encoder->queue.video_info;
+		struct video_frame vf;
+
+		video_frame_init(&vf, info->format, info->width, info->height);
+		memcpy(frame->data, vf.data, sizeof(frame->data));
+		memcpy(frame->linesize, vf.linesize,
+		       sizeof(frame->linesize));
+	} else {
+		uint8_t *data = bmalloc(encoder->framesize_bytes *
+					encoder->planes);
+
+		for (size_t i = 0; i < encoder->planes; i++) {
+			frame->data[i] = data + encoder->framesize_bytes * i;
+			frame->linesize[i] =
+				(uint32_t)encoder->framesize_bytes;
+		}
+	}
+}
+
+bool start_encoder_queue(struct obs_encoder *encoder)
+{
+	struct encoder_queue *queue = &encoder->queue;
+	size_t slots = queue->max_depth;
+
+	/* clean up after a thread that stopped itself on an encode error */
+	free_encoder_queue(encoder);
+
+	pthread_mutex_lock(&queue->mutex);
+	memset(&queue->stats, 0, sizeof(queue->stats));
+	queue->total_latency = 0;
+	pthread_mutex_unlock(&queue->mutex);
+	queue->stop = false;
+
+	if (queue->policy != OBS_ENCODER_QUEUE_BLOCK)
+		slots = 0;
+
+	if (os_sem_init(&queue->frames_sem, 0) != 0)
+		return false;
+	if (os_sem_init(&queue->slots_sem, (int)slots) != 0) {
+		os_sem_destroy(queue->frames_sem);
+		queue->frames_sem = NULL;
+		return false;
+	}
+
+	/* one frame being encoded and one being filled on top of a full
+	 * queue */
+	for (size_t i = 0; i < queue->max_depth + 2; i++) {
+		struct queued_frame qf = {0};
+		alloc_frame(encoder, &qf.frame);
+		circlebuf_push_back(&queue->avail, &qf, sizeof(qf));
+	}
+
+	if (pthread_create(&queue->thread, NULL, encoder_queue_thread,
+			   encoder) != 0) {
+		blog(LOG_ERROR, "encoder '%s': Failed to create queue thread",
+		     obs_encoder_get_name(encoder));
+		free_queue_data(queue);
+		return false;
+	}
+
+	queue->thread_initialized = true;
+	queue->thread_running = true;
+	return true;
+}
+
+/* called before disconnecting from the media, so that a submission blocked
+ * on a full queue returns.  frames already queued are encoded before the
+ * thread exits, frames submitted after this are ignored */
+void stop_encoder_queue(struct obs_encoder *encoder)
+{
+	struct encoder_queue *queue = &encoder->queue;
+
+	if (!queue->thread_running)
+		return;
+
+	os_atomic_set_bool(&queue->stop, true);
+	os_sem_post(queue->slots_sem);
+	os_sem_post(queue->frames_sem);
+
+	/* an encode error stops the encoder from the queue thread itself,
+	 * which then exits on its own and is joined later */
+	if (pthread_equal(pthread_self(), queue->thread))
+		return;
+
+	pthread_join(queue->thread, NULL);
+	queue->thread_running = false;
+}
+
+/* called once nothing can submit frames any more */
+void free_encoder_queue(struct obs_encoder *encoder)
+{
+	struct encoder_queue *queue = &encoder->queue;
+
+	if (!queue->thread_initialized)
+		return;
+
+	stop_encoder_queue(encoder);
+	if (queue->thread_running)
+		return;
+
+	free_queue_data(queue);
+	queue->thread_initialized = false;
+}
+
+static void copy_frame(struct obs_encoder *encoder, struct encoder_frame *dst,
+		       const struct encoder_frame *src)
+{
+	if (encoder->info.type == OBS_ENCODER_VIDEO) {
+		struct video_scale_info *info = &encoder->queue.video_info;
+		struct video_frame vf_dst, vf_src;
+
+		memcpy(vf_dst.data, dst->data, sizeof(dst->data));
+		memcpy(vf_dst.linesize, dst->linesize, sizeof(dst->linesize));
+		memcpy(vf_src.data, src->data, sizeof(src->data));
+		memcpy(vf_src.linesize, src->linesize, sizeof(src->linesize));
+
+		video_frame_copy(&vf_dst, &vf_src, info->format, info->height);
+	} else {
+		for (size_t i = 0; i < encoder->planes; i++)
+			memcpy(dst->data[i], src->data[i], src->linesize[i]);
+	}
+
+	dst->frames = src->frames;
+	dst->pts = src->pts;
+}
+
+void encoder_queue_push(struct obs_encoder *encoder,
+			const struct encoder_frame *frame)
+{
+	struct encoder_queue *queue = &encoder->queue;
+	struct queued_frame qf;
+
+	if (os_atomic_load_bool(&queue->stop))
+		return;
+	if (queue->policy == OBS_ENCODER_QUEUE_BLOCK) {
+		os_sem_wait(queue->slots_sem);
+		if (os_atomic_load_bool(&queue->stop))
+			return;
+	}
+
+	pthread_mutex_lock(&queue->mutex);
+	if (queue->policy == OBS_ENCODER_QUEUE_DROP_NEWEST &&
+	    queued_frames(queue) >= queue->max_depth) {
+		queue->stats.submitted++;
+		queue->stats.dropped++;
+		pthread_mutex_unlock(&queue->mutex);
+		return;
+	}
+
+	circlebuf_pop_front(&queue->avail, &qf, sizeof(qf));
+	pthread_mutex_unlock(&queue->mutex);
+
+	/* only this thread pushes, so the frame can be filled unlocked */
+	copy_frame(encoder, &qf.frame, frame);
+	qf.queued_ts = os_gettime_ns();
+
+	/* stop is checked under the mutex so that the queue thread, which
+	 * drains the queue under the same mutex after a stop, either sees
+	 * this frame or it is never queued */
+	pthread_mutex_lock(&queue->mutex);
+	if (os_atomic_load_bool(&queue->stop)) {
+		circlebuf_push_back(&queue->avail, &qf, sizeof(qf));
+		pthread_mutex_unlock(&queue->mutex);
+		return;
+	}
+
+	queue->stats.submitted++;
+
+	/* only OBS_ENCODER_QUEUE_DROP_OLDEST gets here with a full queue */
+	if (queued_frames(queue) >= queue->max_depth) {
+		struct queued_frame oldest;
+
+		circlebuf_pop_front(&queue->queued, &oldest, sizeof(oldest));
+		circlebuf_push_back(&queue->avail, &oldest, sizeof(oldest));
+		queue->stats.dropped++;
+	}
+
+	circlebuf_push_back(&queue->queued, &qf, sizeof(qf));
+	if (queued_frames(queue) > queue->stats.peak_depth)
+		queue->stats.peak_depth = queued_frames(queue);
+	pthread_mutex_unlock(&queue->mutex);
+
+	os_sem_post(queue->frames_sem);
+}
+
+void encoder_queue_get_stats(struct obs_encoder *encoder,
+			     struct obs_encoder_queue_stats *stats)
+{
+	struct encoder_queue *queue = &encoder->queue;
+
+	pthread_mutex_lock(&queue->mutex);
+	*stats = queue->stats;
+	stats->depth = queued_frames(queue);
+	pthread_mutex_unlock(&queue->mutex);
+}
@@ -48,6 +48,7 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 	pthread_mutex_init_value(&encoder->callbacks_mutex);
 	pthread_mutex_init_value(&encoder->outputs_mutex);
 	pthread_mutex_init_value(&encoder->pause.mutex);
+	pthread_mutex_init_value(&encoder->queue.mutex);
 
 	if (!obs_context_data_init(&encoder->context, OBS_OBJ_TYPE_ENCODER,
 				   settings, name, hotkey_data, false))
@@ -60,6 +61,8 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 		return false;
 	if (pthread_mutex_init(&encoder->pause.mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&encoder->queue.mutex, NULL) != 0)
+		return false;
 
 	if (encoder->orig_info.get_defaults) {
 		encoder->orig_info.get_defaults(encoder->context.settings);
@@ -192,6 +195,19 @@ static inline bool gpu_encode_available(const struct obs_encoder *encoder)
 
 static void add_connection(struct obs_encoder *encoder)
 {
+	bool gpu_encode = encoder->info.type == OBS_ENCODER_VIDEO &&
+			  gpu_encode_available(encoder);
+	struct video_scale_info info = {0};
+
+	if (encoder->info.type == OBS_ENCODER_VIDEO)
+		get_video_info(encoder, &info);
+
+	/* queued frames are copies of what the encoder would have received */
+	if (encoder->queue.max_depth && !gpu_encode) {
+		encoder->queue.video_info = info;
+		start_encoder_queue(encoder);
+	}
+
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
 		struct audio_convert_info audio_info = {0};
 		get_audio_info(encoder, &audio_info);
@@ -199,10 +215,7 @@ static void add_connection(struct obs_encoder *encoder)
 		audio_output_connect(encoder->media, encoder->mixer_idx,
 				     &audio_info, receive_audio, encoder);
 	} else {
-		struct video_scale_info info = {0};
-		get_video_info(encoder, &info);
-
-		if (gpu_encode_available(encoder)) {
+		if (gpu_encode) {
 			start_gpu_encode(encoder);
 		} else {
 			start_raw_video(encoder->media, &info, receive_video,
@@ -215,6 +228,10 @@ static void add_connection(struct obs_encoder *encoder)
 
 static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 {
+	/* release a frame blocked on a full queue before the media output
+	 * waits for its callback to return */
+	stop_encoder_queue(encoder);
+
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
 		audio_output_disconnect(encoder->media, encoder->mixer_idx,
 					receive_audio, encoder);
@@ -226,6 +243,8 @@ static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 		}
 	}
 
+	free_encoder_queue(encoder);
+
 	/* obs_encoder_shutdown locks init_mutex, so don't call it on encode
 	 * errors, otherwise you can get a deadlock with outputs when they end
 	 * data capture, which will lock init_mutex and the video callback
@@ -260,6 +279,7 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		     encoder->context.name);
 
 		free_audio_buffers(encoder);
+		free_encoder_queue(encoder);
 
 		if (encoder->context.data)
 			encoder->info.destroy(encoder->context.data);
@@ -268,6 +288,7 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		pthread_mutex_destroy(&encoder->callbacks_mutex);
 		pthread_mutex_destroy(&encoder->outputs_mutex);
 		pthread_mutex_destroy(&encoder->pause.mutex);
+		pthread_mutex_destroy(&encoder->queue.mutex);
 		obs_context_data_free(&encoder->context);
 		if (encoder->owns_info_id)
 			bfree((void *)encoder->info.id);
@@ -447,6 +468,11 @@ static void intitialize_audio_encoder(struct obs_encoder *encoder)
 
 static THREAD_LOCAL bool can_reroute = false;
 
+/* data of the packet currently being passed to encoder callbacks on this
+ * thread, and its pooled copy once a callback has taken a reference */
+static THREAD_LOCAL const uint8_t *lent_data = NULL;
+static THREAD_LOCAL uint8_t *lent_copy = NULL;
+
 static inline bool obs_encoder_initialize_internal(obs_encoder_t *encoder)
 {
 	if (encoder_active(encoder))
@@ -695,6 +721,45 @@ void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 	encoder->scaled_height = height;
 }
 
+bool obs_encoder_set_queue(obs_encoder_t *encoder, size_t max_depth,
+			   enum obs_encoder_queue_policy policy)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_set_queue"))
+		return false;
+	if (encoder_active(encoder)) {
+		blog(LOG_WARNING,
+		     "encoder '%s': Cannot change the queue "
+		     "while the encoder is active",
+		     obs_encoder_get_name(encoder));
+		return false;
+	}
+
+	encoder->queue.max_depth = max_depth;
+	encoder->queue.policy = policy;
+	return true;
+}
+
+size_t obs_encoder_get_queue_depth(const obs_encoder_t *encoder)
+{
+	return obs_encoder_valid(encoder, "obs_encoder_get_queue_depth")
+		       ? encoder->queue.max_depth
+		       : 0;
+}
+
+bool obs_encoder_get_queue_stats(const obs_encoder_t *encoder,
+				 struct obs_encoder_queue_stats *stats)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_queue_stats"))
+		return false;
+	if (!obs_ptr_valid(stats, "obs_encoder_get_queue_stats"))
+		return false;
+	if (!encoder->queue.max_depth)
+		return false;
+
+	encoder_queue_get_stats((obs_encoder_t *)encoder, stats);
+	return true;
+}
+
 bool obs_encoder_scaling_enabled(const obs_encoder_t *encoder)
 {
 	if (!obs_encoder_valid(encoder, "obs_encoder_scaling_enabled"))
@@ -853,7 +918,6 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 				    struct encoder_packet *packet)
 {
 	struct encoder_packet first_packet;
-	DARRAY(uint8_t) data;
 	uint8_t *sei;
 	size_t size;
 
@@ -861,25 +925,22 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 	if (!packet->keyframe)
 		return;
 
-	da_init(data);
-
 	if (!get_sei(encoder, &sei, &size) || !sei || !size) {
 		cb->new_packet(cb->param, packet);
 		cb->sent_first_packet = true;
 		return;
 	}
 
-	da_push_back_array(data, sei, size);
-	da_push_back_array(data, packet->data, packet->size);
-
 	first_packet = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
+	first_packet.size = size + packet->size;
+	first_packet.data = packet_pool_alloc(first_packet.size);
+	memcpy(first_packet.data, sei, size);
+	memcpy(first_packet.data + size, packet->data, packet->size);
 
 	cb->new_packet(cb->param, &first_packet);
 	cb->sent_first_packet = true;
 
-	da_free(data);
+	obs_encoder_packet_release(&first_packet);
 }
 
 static const char *send_packet_name = "send_packet";
@@ -947,12 +1008,22 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
+		/* callbacks see the encoder's own data, the first one that
+		 * keeps the packet copies it into the pool for all of them */
+		lent_data = pkt->data;
+
 		for (size_t i = encoder->callbacks.num; i > 0; i--) {
 			struct encoder_callback *cb;
 			cb = encoder->callbacks.array + (i - 1);
 			send_packet(encoder, cb, pkt);
 		}
 
+		lent_data = NULL;
+		if (lent_copy) {
+			packet_pool_release(lent_copy);
+			lent_copy = NULL;
+		}
+
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
 	}
 }
@@ -1053,8 +1124,13 @@ static void receive_video(void *param, struct video_data *frame)
 	enc_frame.frames = 1;
 	enc_frame.pts = encoder->cur_pts;
 
-	if (do_encode(encoder, &enc_frame))
+	/* queued frames keep their time even if they end up dropped */
+	if (encoder->queue.thread_initialized) {
+		encoder_queue_push(encoder, &enc_frame);
+		encoder->cur_pts += encoder->timebase_num;
+	} else if (do_encode(encoder, &enc_frame)) {
 		encoder->cur_pts += encoder->timebase_num;
+	}
 
 wait_for_audio:
 	profile_end(receive_video_name);
@@ -1180,7 +1256,9 @@ static bool send_audio_data(struct obs_encoder *encoder)
 	enc_frame.frames = (uint32_t)encoder->framesize;
 	enc_frame.pts = encoder->cur_pts;
 
-	if (!do_encode(encoder, &enc_frame))
+	if (encoder->queue.thread_initialized)
+		encoder_queue_push(encoder, &enc_frame);
+	else if (!do_encode(encoder, &enc_frame))
 		return false;
 
 	encoder->cur_pts += encoder->framesize;
@@ -1317,12 +1395,8 @@ void obs_encoder_remove_output(struct obs_encoder *encoder,
 void obs_encoder_packet_create_instance(struct encoder_packet *dst,
 					const struct encoder_packet *src)
 {
-	long *p_refs;
-
 	*dst = *src;
-	p_refs = bmalloc(src->size + sizeof(long));
-	dst->data = (void *)(p_refs + 1);
-	*p_refs = 1;
+	dst->data = packet_pool_alloc(src->size);
 	memcpy(dst->data, src->data, src->size);
 }
 
@@ -1342,15 +1416,25 @@ void obs_free_encoder_packet(struct encoder_packet *packet)
 void obs_encoder_packet_ref(struct encoder_packet *dst,
 			    struct encoder_packet *src)
 {
+	uint8_t *data;
+
 	if (!src)
 		return;
 
-	if (src->data) {
-		long *p_refs = ((long *)src->data) - 1;
-		os_atomic_inc_long(p_refs);
+	data = src->data;
+	if (data && data == lent_data) {
+		if (!lent_copy) {
+			lent_copy = packet_pool_alloc(src->size);
+			memcpy(lent_copy, data, src->size);
+		}
+		data = lent_copy;
 	}
 
+	if (data)
+		packet_pool_addref(data);
+
 	*dst = *src;
+	dst->data = data;
 }
 
 void obs_encoder_packet_release(struct encoder_packet *pkt)
@@ -1358,11 +1442,8 @@ void obs_encoder_packet_release(struct encoder_packet *pkt)
 	if (!pkt)
 		return;
 
-	if (pkt->data) {
-		long *p_refs = ((long *)pkt->data) - 1;
-		if (os_atomic_dec_long(p_refs) == 0)
-			bfree(p_refs);
-	}
+	if (pkt->data)
+		packet_pool_release(pkt->data);
 
 	memset(pkt, 0, sizeof(struct encoder_packet));
 }
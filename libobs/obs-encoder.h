@@ -42,7 +42,16 @@ enum obs_encoder_type {
 
 /** Encoder output packet */
 struct encoder_packet {
-	uint8_t *data; /**< Packet data */
+	/**
+	 * Packet data
+	 *
+	 * Packets passed to output callbacks only borrow this for the length
+	 * of the call.  It must be treated as read-only, and kept by taking a
+	 * reference with obs_encoder_packet_ref, which moves it into the
+	 * packet pool.  Referenced data is owned by the pool and must only be
+	 * freed with obs_encoder_packet_release.
+	 */
+	uint8_t *data;
 	size_t size;   /**< Packet size */
 
 	int64_t pts; /**< Presentation timestamp */
@@ -102,6 +111,43 @@ struct encoder_frame {
 	int64_t pts;
 };
 
+/** What a queued encoder does with a new frame when its queue is full */
+enum obs_encoder_queue_policy {
+	/** Wait for the encoder to take a frame from the queue */
+	OBS_ENCODER_QUEUE_BLOCK,
+	/** Replace the oldest queued frame with the new one */
+	OBS_ENCODER_QUEUE_DROP_OLDEST,
+	/** Drop the new frame */
+	OBS_ENCODER_QUEUE_DROP_NEWEST,
+};
+
+/** Submission queue statistics, since the encoder was last started */
+struct obs_encoder_queue_stats {
+	size_t depth;      /**< Frames waiting to be encoded */
+	size_t peak_depth; /**< Most frames that were waiting at once */
+
+	uint64_t submitted; /**< Frames handed to the queue */
+	uint64_t dropped;   /**< Frames dropped because the queue was full */
+	uint64_t encoded;   /**< Frames passed to the encoder */
+
+	/** Time from a frame being queued to the encoder returning */
+	uint64_t last_latency_ns;
+	uint64_t avg_latency_ns;
+	uint64_t max_latency_ns;
+};
+
+/** Allocation counts for the pool that encoder packet data is kept in */
+struct obs_packet_pool_stats {
+	uint64_t allocs;    /**< Packet buffers handed out */
+	uint64_t pool_hits; /**< Buffers reused rather than allocated */
+	uint64_t unpooled;  /**< Buffers too large to be pooled */
+	uint64_t frees;     /**< Buffers whose last reference was released */
+
+	size_t outstanding;   /**< Buffers still referenced */
+	size_t cached_blocks; /**< Freed buffers kept for reuse */
+	size_t cached_bytes;  /**< Size of the buffers kept for reuse */
+};
+
 /**
  * Encoder interface
  *
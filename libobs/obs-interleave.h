@@ -0,0 +1,387 @@
+/******************************************************************************
+    Copyright (C) 2023 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stdlib.h>
+
+#include "util/darray.h"
+#include "obs.h"
+
+/*
+ * Packet interleaver used by outputs
+ *
+ *   Packets are kept in one queue per stream (video, then each audio track),
+ * each sorted by the order packets are sent in, and a min-heap of the
+ * streams gives the next packet to send.  Since every encoder produces
+ * packets in order, inserting a packet is normally just a push onto the end
+ * of its stream.
+ *
+ *   Packets are sent by DTS.  Video goes before audio with the same DTS,
+ * audio packets with the same DTS go in the order they were received, and
+ * video packets with the same DTS go newest first.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INTERLEAVE_STREAMS (MAX_AUDIO_MIXES + 1)
+
+struct interleaved_packet {
+	struct encoder_packet packet;
+	int64_t seq;
+};
+
+struct interleave_stream {
+	DARRAY(struct interleaved_packet) packets;
+	size_t head;
+};
+
+struct packet_interleaver {
+	struct interleave_stream streams[INTERLEAVE_STREAMS];
+	size_t heap[INTERLEAVE_STREAMS];
+	size_t heap_size;
+	size_t num;
+	int64_t next_seq;
+};
+
+static inline bool interleaved_before(const struct interleaved_packet *a,
+				      const struct interleaved_packet *b)
+{
+	bool a_video = a->packet.type == OBS_ENCODER_VIDEO;
+	bool b_video = b->packet.type == OBS_ENCODER_VIDEO;
+
+	if (a->packet.dts_usec != b->packet.dts_usec)
+		return a->packet.dts_usec < b->packet.dts_usec;
+	if (a_video != b_video)
+		return a_video;
+
+	return a_video ? a->seq > b->seq : a->seq < b->seq;
+}
+
+static inline size_t interleave_stream_idx(const struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_VIDEO ? 0 : packet->track_idx + 1;
+}
+
+static inline size_t interleave_stream_size(const struct interleave_stream *s)
+{
+	return s->packets.num - s->head;
+}
+
+static inline struct interleaved_packet *
+interleave_stream_get(struct interleave_stream *s, size_t idx)
+{
+	return s->packets.array + s->head + idx;
+}
+
+static inline struct interleaved_packet *
+interleaver_first(struct packet_interleaver *il, size_t stream)
+{
+	struct interleave_stream *s = &il->streams[stream];
+	return interleave_stream_size(s) ? interleave_stream_get(s, 0) : NULL;
+}
+
+static inline struct interleaved_packet *
+interleaver_last(struct packet_interleaver *il, size_t stream)
+{
+	struct interleave_stream *s = &il->streams[stream];
+	return interleave_stream_size(s) ? &s->packets.array[s->packets.num - 1]
+					 : NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool interleaver_heap_less(struct packet_interleaver *il,
+					 size_t a, size_t b)
+{
+	return interleaved_before(interleaver_first(il, il->heap[a]),
+				  interleaver_first(il, il->heap[b]));
+}
+
+static inline void interleaver_heap_swap(struct packet_interleaver *il,
+					 size_t a, size_t b)
+{
+	size_t stream = il->heap[a];
+	il->heap[a] = il->heap[b];
+	il->heap[b] = stream;
+}
+
+static inline void interleaver_sift_up(struct packet_interleaver *il,
+				       size_t pos)
+{
+	while (pos > 0) {
+		size_t parent = (pos - 1) / 2;
+		if (!interleaver_heap_less(il, pos, parent))
+			break;
+
+		interleaver_heap_swap(il, pos, parent);
+		pos = parent;
+	}
+}
+
+static inline void interleaver_sift_down(struct packet_interleaver *il,
+					 size_t pos)
+{
+	while (true) {
+		size_t left = pos * 2 + 1;
+		size_t right = left + 1;
+		size_t min = pos;
+
+		if (left < il->heap_size &&
+		    interleaver_heap_less(il, left, min))
+			min = left;
+		if (right < il->heap_size &&
+		    interleaver_heap_less(il, right, min))
+			min = right;
+		if (min == pos)
+			break;
+
+		interleaver_heap_swap(il, pos, min);
+		pos = min;
+	}
+}
+
+static inline void interleaver_heapify(struct packet_interleaver *il)
+{
+	il->heap_size = 0;
+	for (size_t i = 0; i < INTERLEAVE_STREAMS; i++) {
+		if (interleave_stream_size(&il->streams[i]))
+			il->heap[il->heap_size++] = i;
+	}
+
+	for (size_t i = il->heap_size / 2; i > 0; i--)
+		interleaver_sift_down(il, i - 1);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* takes ownership of the packet */
+static inline void interleaver_push(struct packet_interleaver *il,
+				    const struct encoder_packet *packet)
+{
+	size_t stream = interleave_stream_idx(packet);
+	struct interleave_stream *s = &il->streams[stream];
+	struct interleaved_packet ip = {*packet, il->next_seq++};
+	size_t idx = s->packets.num;
+	bool was_empty = !interleave_stream_size(s);
+
+	while (idx > s->head &&
+	       interleaved_before(&ip, &s->packets.array[idx - 1]))
+		idx--;
+
+	da_insert(s->packets, idx, &ip);
+	il->num++;
+
+	if (was_empty) {
+		il->heap[il->heap_size] = stream;
+		interleaver_sift_up(il, il->heap_size++);
+
+	} else if (idx == s->head) {
+		for (size_t i = 0; i < il->heap_size; i++) {
+			if (il->heap[i] == stream) {
+				interleaver_sift_up(il, i);
+				break;
+			}
+		}
+	}
+}
+
+static inline struct interleaved_packet *
+interleaver_peek(struct packet_interleaver *il)
+{
+	return il->heap_size ? interleaver_first(il, il->heap[0]) : NULL;
+}
+
+/* removes the next packet to send, passing ownership to the caller */
+static inline void interleaver_pop(struct packet_interleaver *il,
+				   struct encoder_packet *packet)
+{
+	struct interleave_stream *s = &il->streams[il->heap[0]];
+
+	*packet = s->packets.array[s->head++].packet;
+	il->num--;
+
+	if (!interleave_stream_size(s)) {
+		da_resize(s->packets, 0);
+		s->head = 0;
+		il->heap[0] = il->heap[--il->heap_size];
+
+	} else if (s->head >= 64 && s->head * 2 >= s->packets.num) {
+		da_erase_range(s->packets, 0, s->head);
+		s->head = 0;
+	}
+
+	if (il->heap_size)
+		interleaver_sift_down(il, 0);
+}
+
+static inline void interleaver_discard_next(struct packet_interleaver *il)
+{
+	struct encoder_packet packet;
+	interleaver_pop(il, &packet);
+	obs_encoder_packet_release(&packet);
+}
+
+/* discards every packet that would be sent before the given one */
+static inline void
+interleaver_discard_before(struct packet_interleaver *il,
+			   const struct interleaved_packet *packet)
+{
+	struct interleaved_packet pos = *packet;
+	struct interleaved_packet *next;
+
+	while ((next = interleaver_peek(il)) && interleaved_before(next, &pos))
+		interleaver_discard_next(il);
+}
+
+/* discards the given packet and every packet sent before it */
+static inline void
+interleaver_discard_through(struct packet_interleaver *il,
+			    const struct interleaved_packet *packet)
+{
+	struct interleaved_packet pos = *packet;
+	struct interleaved_packet *next;
+
+	while ((next = interleaver_peek(il)) && !interleaved_before(&pos, next))
+		interleaver_discard_next(il);
+}
+
+static inline void interleaver_discard_dts(struct packet_interleaver *il,
+					   int64_t dts_usec)
+{
+	struct interleaved_packet *next;
+
+	while ((next = interleaver_peek(il)) &&
+	       next->packet.dts_usec < dts_usec)
+		interleaver_discard_next(il);
+}
+
+/* finds the audio packet with the DTS closest to the given one, or the first
+ * one sent of those that are equally close */
+static inline struct interleaved_packet *
+interleaver_closest_audio(struct packet_interleaver *il, int64_t dts_usec)
+{
+	struct interleaved_packet *closest = NULL;
+	int64_t closest_diff = 0x7FFFFFFFFFFFFFFFLL;
+
+	for (size_t i = 1; i < INTERLEAVE_STREAMS; i++) {
+		struct interleave_stream *s = &il->streams[i];
+
+		for (size_t j = 0; j < interleave_stream_size(s); j++) {
+			struct interleaved_packet *ip =
+				interleave_stream_get(s, j);
+			int64_t diff = llabs(ip->packet.dts_usec - dts_usec);
+
+			if (diff < closest_diff ||
+			    (diff == closest_diff &&
+			     interleaved_before(ip, closest))) {
+				closest = ip;
+				closest_diff = diff;
+
+			} else if (ip->packet.dts_usec > dts_usec) {
+				/* only gets further away from here */
+				break;
+			}
+		}
+	}
+
+	return closest;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* numbers packets by the order they're currently sent in.  done before the
+ * timestamps of all packets are offset, so that packets which then share a
+ * DTS keep their relative order. */
+static inline void interleaver_renumber(struct packet_interleaver *il)
+{
+	size_t pos[INTERLEAVE_STREAMS] = {0};
+
+	for (size_t seq = 0; seq < il->num; seq++) {
+		struct interleaved_packet *next = NULL;
+		size_t next_stream = 0;
+
+		for (size_t i = 0; i < INTERLEAVE_STREAMS; i++) {
+			struct interleave_stream *s = &il->streams[i];
+			struct interleaved_packet *ip;
+
+			if (pos[i] == interleave_stream_size(s))
+				continue;
+
+			ip = interleave_stream_get(s, pos[i]);
+			if (!next || interleaved_before(ip, next)) {
+				next = ip;
+				next_stream = i;
+			}
+		}
+
+		next->seq = (int64_t)seq;
+		pos[next_stream]++;
+	}
+
+	il->next_seq = (int64_t)il->num;
+}
+
+/* re-sorts after the timestamps of queued packets have changed */
+static inline void interleaver_resort(struct packet_interleaver *il)
+{
+	for (size_t i = 0; i < INTERLEAVE_STREAMS; i++) {
+		struct interleave_stream *s = &il->streams[i];
+
+		for (size_t j = 1; j < interleave_stream_size(s); j++) {
+			struct interleaved_packet ip =
+				*interleave_stream_get(s, j);
+			size_t k = j;
+
+			for (; k > 0; k--) {
+				struct interleaved_packet *prev =
+					interleave_stream_get(s, k - 1);
+				if (!interleaved_before(&ip, prev))
+					break;
+				*interleave_stream_get(s, k) = *prev;
+			}
+
+			*interleave_stream_get(s, k) = ip;
+		}
+	}
+
+	interleaver_heapify(il);
+}
+
+static inline void interleaver_free(struct packet_interleaver *il)
+{
+	for (size_t i = 0; i < INTERLEAVE_STREAMS; i++) {
+		struct interleave_stream *s = &il->streams[i];
+
+		for (size_t j = 0; j < interleave_stream_size(s); j++)
+			obs_encoder_packet_release(
+				&interleave_stream_get(s, j)->packet);
+
+		da_free(s->packets);
+		s->head = 0;
+	}
+
+	il->heap_size = 0;
+	il->num = 0;
+	il->next_seq = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
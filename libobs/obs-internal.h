@@ -35,10 +35,13 @@
 #include "media-io/audio-io.h"
 
 #include "obs.h"
+#include "obs-interleave.h"
 
 #include <caption/caption.h>
 
-#define NUM_TEXTURES 2
+/* maximum depth of the GPU readback pipeline */
+#define NUM_TEXTURES 4
+#define DEFAULT_READBACK_DEPTH 2
 #define NUM_CHANNELS 3
 #define MICROSECOND_DEN 1000000
 #define NUM_ENCODE_TEXTURES 3
@@ -250,6 +253,7 @@ struct obs_core_video {
 	gs_texture_t *output_texture;
 	gs_texture_t *convert_textures[NUM_CHANNELS];
 	bool texture_rendered;
+	volatile bool main_texture_dirty;
 	bool textures_copied[NUM_TEXTURES];
 	bool texture_converted;
 	bool using_nv12_tex;
@@ -269,6 +273,23 @@ struct obs_core_video {
 	gs_samplerstate_t *point_sampler;
 	gs_stagesurf_t *mapped_surfaces[NUM_CHANNELS];
 	int cur_texture;
+	int readback_depth;
+	volatile long readback_frames;
+	bool readback_fences;
+	bool readback_skipped;
+	bool offline;
+
+	/* copies of downloaded raw frames into the video-io frame cache are
+	 * done on their own thread so that they overlap with rendering the
+	 * next frame; the surfaces stay mapped until the copy is done */
+	pthread_t raw_copy_thread;
+	bool raw_copy_thread_initialized;
+	os_sem_t *raw_copy_start;
+	os_sem_t *raw_copy_done;
+	volatile bool raw_copy_stop;
+	bool raw_copy_pending;
+	struct video_data raw_copy_frame;
+	int raw_copy_count;
 	long raw_active;
 	long gpu_encoder_active;
 	pthread_mutex_t gpu_encoder_mutex;
@@ -291,6 +312,11 @@ struct obs_core_video {
 	uint32_t lagged_frames;
 	bool thread_initialized;
 
+	enum obs_video_pacing pacing;
+	uint64_t pacing_spin_ns;
+	pthread_mutex_t pacing_mutex;
+	struct obs_video_pacing_stats pacing_stats;
+
 	bool gpu_conversion;
 	const char *conversion_techs[NUM_CHANNELS];
 	bool conversion_needed;
@@ -315,6 +341,10 @@ struct obs_core_video {
 	gs_effect_t *deinterlace_yadif_2x_effect;
 
 	struct obs_video_info ovi;
+	size_t frame_cache_size;
+	uint32_t frame_cache_wait_ms;
+	uint32_t readback_depth_setting;
+	bool offline_setting;
 
 	pthread_mutex_t task_mutex;
 	struct circlebuf tasks;
@@ -322,17 +352,42 @@ struct obs_core_video {
 
 struct audio_monitor;
 
+/* audio buffering can grow to at most this many frames, whatever the size
+ * of each tick */
+#define MAX_AUDIO_BUFFERING_FRAMES (45 * AUDIO_OUTPUT_FRAMES)
+
 struct obs_core_audio {
 	audio_t *audio;
+	size_t frames_per_tick;
+	int max_buffering_ticks;
 
 	DARRAY(struct obs_source *) render_order;
 	DARRAY(struct obs_source *) root_nodes;
 
+	/* leaf sources are rendered on a small worker pool each tick
+	 * before any scene or transition mixes them */
+	DARRAY(struct obs_source *) render_leaves;
+	pthread_t *render_threads;
+	size_t num_render_threads;
+	os_sem_t *render_start;
+	os_sem_t *render_done;
+	volatile long render_next;
+	volatile bool render_stop;
+	uint32_t render_mixers;
+	size_t render_channels;
+	size_t render_sample_rate;
+
 	uint64_t buffered_ts;
 	struct circlebuf buffered_timestamps;
 	uint64_t buffering_wait_ticks;
 	int total_buffering_ticks;
 
+	/* lowering buffering once every source has been comfortably ahead of
+	 * the mix for buffering_shrink_ns */
+	uint64_t buffering_shrink_ns;
+	uint64_t shrink_window_start;
+	uint64_t shrink_min_lead;
+
 	float user_volume;
 
 	pthread_mutex_t monitoring_mutex;
@@ -438,6 +493,12 @@ struct obs_core {
 
 extern struct obs_core *obs;
 
+/* makes the next frame render the main texture again instead of reusing it */
+static inline void obs_mark_video_dirty(void)
+{
+	os_atomic_set_bool(&obs->video.main_texture_dirty, true);
+}
+
 struct obs_graphics_context {
 	uint64_t last_time;
 	uint64_t interval;
@@ -453,6 +514,9 @@ struct obs_graphics_context {
 };
 
 extern void *obs_graphics_thread(void *param);
+extern bool init_raw_copy_thread(struct obs_core_video *video);
+extern void stop_raw_copy_thread(struct obs_core_video *video);
+extern void free_raw_copy(struct obs_core_video *video);
 extern bool obs_graphics_thread_loop(struct obs_graphics_context *context);
 #ifdef __APPLE__
 extern void *obs_graphics_thread_autorelease(void *param);
@@ -465,6 +529,8 @@ extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
 extern bool audio_callback(void *param, uint64_t start_ts_in,
 			   uint64_t end_ts_in, uint64_t *out_ts,
 			   uint32_t mixers, struct audio_output_data *mixes);
+extern bool obs_init_audio_render_threads(struct obs_core_audio *audio);
+extern void obs_free_audio_render_threads(struct obs_core_audio *audio);
 
 extern void
 start_raw_video(video_t *video, const struct video_scale_info *conversion,
@@ -579,6 +645,28 @@ struct audio_action {
 	};
 };
 
+/* Audio output by a source is handed to the audio thread through a
+ * single-producer/single-consumer ring of packets.  The thread outputting
+ * audio (serialized by audio_mutex) fills the packet at audio_packet_write
+ * and publishes it by incrementing audio_packets_queued.  The audio thread
+ * moves queued packets into audio_input_buf at the start of each tick, so
+ * audio_input_buf and audio_ts are only ever touched by the audio thread.
+ * Packet buffers are owned by whichever side currently holds the packet. */
+#define AUDIO_PACKET_RING_SIZE 64
+
+struct audio_input_packet {
+	float *data;
+	size_t capacity;
+	size_t channels;
+	uint32_t frames;
+	uint64_t timestamp;
+	bool push_back;
+
+	/* clear all buffered audio before this packet */
+	bool reset;
+	uint64_t reset_ts;
+};
+
 struct obs_weak_source {
 	struct obs_weak_ref ref;
 	struct obs_source *source;
@@ -656,9 +744,21 @@ struct obs_source {
 	uint64_t audio_ts;
 	struct circlebuf audio_input_buf[MAX_AUDIO_CHANNELS];
 	size_t last_audio_input_buf_size;
+	struct audio_input_packet audio_packets[AUDIO_PACKET_RING_SIZE];
+	size_t audio_packet_write;
+	size_t audio_packet_read;
+	volatile long audio_packets_queued;
+	volatile bool audio_reset_requested;
+	uint64_t audio_reset_ts;
+	volatile long audio_overflows;
+	volatile long audio_underflows;
 	DARRAY(struct audio_action) audio_actions;
 	float *audio_output_buf[MAX_AUDIO_MIXES][MAX_AUDIO_CHANNELS];
 	float *audio_mix_buf[MAX_AUDIO_CHANNELS];
+	/* mixes of audio_output_buf known to be silent this tick */
+	uint32_t audio_silent_mixes;
+	/* nanoseconds, set on audio render threads and read from anywhere */
+	volatile long audio_render_time;
 	struct resample_info sample_info;
 	audio_resampler_t *resampler;
 	pthread_mutex_t audio_actions_mutex;
@@ -666,6 +766,9 @@ struct obs_source {
 	pthread_mutex_t audio_mutex;
 	pthread_mutex_t audio_cb_mutex;
 	DARRAY(struct audio_cb_info) audio_cb_list;
+	/* meter shared by all obs_volmeters attached to this source, see
+	 * obs-audio-controls.c */
+	struct audio_meter *audio_meter;
 	struct obs_audio_data audio_data;
 	size_t audio_storage_size;
 	uint32_t audio_mixers;
@@ -781,6 +884,10 @@ extern bool obs_source_init_context(struct obs_source *source,
 				    obs_data_t *settings, const char *name,
 				    obs_data_t *hotkey_data, bool private);
 
+extern bool obs_source_video_static(obs_source_t *source);
+extern bool obs_scene_video_static(obs_source_t *source);
+extern bool obs_transition_video_static(obs_source_t *transition);
+
 extern bool obs_transition_init(obs_source_t *transition);
 extern void obs_transition_free(obs_source_t *transition);
 extern void obs_transition_tick(obs_source_t *transition, float t);
@@ -946,7 +1053,7 @@ struct obs_output {
 	pthread_t end_data_capture_thread;
 	os_event_t *stopping_event;
 	pthread_mutex_t interleaved_mutex;
-	DARRAY(struct encoder_packet) interleaved_packets;
+	struct packet_interleaver interleaver;
 	int stop_code;
 
 	int reconnect_retry_sec;
@@ -1057,6 +1164,36 @@ struct encoder_callback {
 	void *param;
 };
 
+struct encoder_queue {
+	/* only changed while the encoder is inactive */
+	size_t max_depth;
+	enum obs_encoder_queue_policy policy;
+
+	/* the format, width and height video frames are delivered in,
+	 * resolved when the encoder starts */
+	struct video_scale_info video_info;
+
+	pthread_t thread;
+	bool thread_initialized;
+	bool thread_running;
+	volatile bool stop;
+
+	/* posted for every queued frame, and for every free slot with
+	 * OBS_ENCODER_QUEUE_BLOCK */
+	os_sem_t *frames_sem;
+	os_sem_t *slots_sem;
+
+	/* queued and free encoder_frames, each with its own copy of the
+	 * data.  the mutex lives as long as the encoder so that the stats
+	 * can always be read */
+	pthread_mutex_t mutex;
+	struct circlebuf queued;
+	struct circlebuf avail;
+
+	struct obs_encoder_queue_stats stats;
+	uint64_t total_latency;
+};
+
 struct obs_encoder {
 	struct obs_context_data context;
 	struct obs_encoder_info info;
@@ -1123,6 +1260,9 @@ struct obs_encoder {
 
 	/* reconfigure encoder at next possible opportunity */
 	bool reconfigure_requested;
+
+	/* optional submission queue and thread */
+	struct encoder_queue queue;
 };
 
 extern struct obs_encoder_info *find_encoder(const char *id);
@@ -1147,12 +1287,26 @@ extern void obs_encoder_remove_output(struct obs_encoder *encoder,
 extern bool start_gpu_encode(obs_encoder_t *encoder);
 extern void stop_gpu_encode(obs_encoder_t *encoder);
 
+extern bool start_encoder_queue(obs_encoder_t *encoder);
+extern void stop_encoder_queue(obs_encoder_t *encoder);
+extern void free_encoder_queue(obs_encoder_t *encoder);
+extern void encoder_queue_push(obs_encoder_t *encoder,
+			       const struct encoder_frame *frame);
+extern void encoder_queue_get_stats(obs_encoder_t *encoder,
+				    struct obs_encoder_queue_stats *stats);
+
 extern bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame);
 extern void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 				    bool received, struct encoder_packet *pkt);
 
 void obs_encoder_destroy(obs_encoder_t *encoder);
 
+/* encoder packet data, with the refcount kept just before it */
+extern uint8_t *packet_pool_alloc(size_t size);
+extern void packet_pool_addref(uint8_t *data);
+extern void packet_pool_release(uint8_t *data);
+extern void packet_pool_trim(void);
+
 /* ------------------------------------------------------------------------- */
 /* services */
 
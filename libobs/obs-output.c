@@ -167,10 +167,7 @@ fail:
 
 static inline void free_packets(struct obs_output *output)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_encoder_packet_release(output->interleaved_packets.array +
-					   i);
-	da_free(output->interleaved_packets);
+	interleaver_free(&output->interleaver);
 }
 
 static inline void clear_audio_buffers(obs_output_t *output)
@@ -1212,19 +1209,13 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 	sei_t sei;
 	uint8_t *data;
 	size_t size;
-	long ref = 1;
-
-	DARRAY(uint8_t) out_data;
+	uint8_t *out_data;
 
 	if (out->priority > 1)
 		return false;
 
 	sei_init(&sei, 0.0);
 
-	da_init(out_data);
-	da_push_back_array(out_data, (uint8_t *)&ref, sizeof(ref));
-	da_push_back_array(out_data, out->data, out->size);
-
 	if (output->caption_data.size > 0) {
 
 		cea708_t cea708;
@@ -1284,16 +1275,19 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 
 	data = malloc(sei_render_size(&sei));
 	size = sei_render(&sei, data);
+
+	out_data = packet_pool_alloc(out->size + sizeof(nal_start) + size);
+	memcpy(out_data, out->data, out->size);
 	/* TODO SEI should come after AUD/SPS/PPS, but before any VCL */
-	da_push_back_array(out_data, nal_start, 4);
-	da_push_back_array(out_data, data, size);
+	memcpy(out_data + out->size, nal_start, sizeof(nal_start));
+	memcpy(out_data + out->size + sizeof(nal_start), data, size);
 	free(data);
 
 	obs_encoder_packet_release(out);
 
 	*out = backup;
-	out->data = (uint8_t *)out_data.array + sizeof(ref);
-	out->size = out_data.num - sizeof(ref);
+	out->data = out_data;
+	out->size = backup.size + sizeof(nal_start) + size;
 
 	sei_free(&sei);
 
@@ -1304,7 +1298,8 @@ double last_caption_timestamp = 0;
 
 static inline void send_interleaved(struct obs_output *output)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	struct packet_interleaver *il = &output->interleaver;
+	struct encoder_packet out = interleaver_peek(il)->packet;
 
 	/* do not send an interleaved packet if there's no packet of the
 	 * opposing type of a higher timestamp in the interleave buffer.
@@ -1312,7 +1307,7 @@ static inline void send_interleaved(struct obs_output *output)
 	if (!has_higher_opposing_ts(output, &out))
 		return;
 
-	da_erase(output->interleaved_packets, 0);
+	interleaver_pop(il, &out);
 
 	if (out.type == OBS_ENCODER_VIDEO) {
 		output->total_frames++;
@@ -1364,186 +1359,116 @@ static inline void set_higher_ts(struct obs_output *output,
 
 static inline struct encoder_packet *
 find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx);
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type,
-				      size_t audio_idx);
-
-/* gets the point where audio and video are closest together */
-static size_t get_interleaved_start_idx(struct obs_output *output)
-{
-	int64_t closest_diff = 0x7FFFFFFFFFFFFFFFLL;
-	struct encoder_packet *first_video =
-		find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
-	size_t video_idx = DARRAY_INVALID;
-	size_t idx = 0;
-
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		int64_t diff;
-
-		if (packet->type != OBS_ENCODER_AUDIO) {
-			if (packet == first_video)
-				video_idx = i;
-			continue;
-		}
+		       size_t audio_idx)
+{
+	struct interleaved_packet *ip = interleaver_first(
+		&output->interleaver,
+		type == OBS_ENCODER_VIDEO ? 0 : audio_idx + 1);
+	return ip ? &ip->packet : NULL;
+}
 
-		diff = llabs(packet->dts_usec - first_video->dts_usec);
-		if (diff < closest_diff) {
-			closest_diff = diff;
-			idx = i;
-		}
-	}
+static inline struct encoder_packet *
+find_last_packet_type(struct obs_output *output, enum obs_encoder_type type,
+		      size_t audio_idx)
+{
+	struct interleaved_packet *ip = interleaver_last(
+		&output->interleaver,
+		type == OBS_ENCODER_VIDEO ? 0 : audio_idx + 1);
+	return ip ? &ip->packet : NULL;
+}
+
+/* discards up to the point where audio and video are closest together */
+static bool discard_to_interleaved_start(struct obs_output *output)
+{
+	struct packet_interleaver *il = &output->interleaver;
+	struct interleaved_packet *video = interleaver_first(il, 0);
+	struct interleaved_packet *start;
+	size_t num = il->num;
 
-	return video_idx < idx ? video_idx : idx;
+	start = interleaver_closest_audio(il, video->packet.dts_usec);
+	if (!start)
+		return false;
+
+	if (interleaved_before(video, start))
+		start = video;
+
+	interleaver_discard_before(il, start);
+	return il->num != num;
 }
 
+/* returns -1 if a track has no packets yet, 1 if the first packets were too
+ * far apart and have been pruned, or 0 otherwise */
 static int prune_premature_packets(struct obs_output *output)
 {
+	struct packet_interleaver *il = &output->interleaver;
 	size_t audio_mixes = num_audio_mixes(output);
-	struct encoder_packet *video;
-	int video_idx;
-	int max_idx;
+	struct interleaved_packet *video;
+	struct interleaved_packet *last;
 	int64_t duration_usec;
-	int64_t max_diff = 0;
 	int64_t diff = 0;
 
-	video_idx = find_first_packet_type_idx(output, OBS_ENCODER_VIDEO, 0);
-	if (video_idx == -1) {
+	video = interleaver_first(il, 0);
+	if (!video) {
 		output->received_video = false;
 		return -1;
 	}
 
-	max_idx = video_idx;
-	video = &output->interleaved_packets.array[video_idx];
-	duration_usec = video->timebase_num * 1000000LL / video->timebase_den;
+	last = video;
+	duration_usec = video->packet.timebase_num * 1000000LL /
+			video->packet.timebase_den;
 
 	for (size_t i = 0; i < audio_mixes; i++) {
-		struct encoder_packet *audio;
-		int audio_idx;
+		struct interleaved_packet *audio = interleaver_first(il, i + 1);
 
-		audio_idx = find_first_packet_type_idx(output,
-						       OBS_ENCODER_AUDIO, i);
-		if (audio_idx == -1) {
+		if (!audio) {
 			output->received_audio = false;
 			return -1;
 		}
 
-		audio = &output->interleaved_packets.array[audio_idx];
-		if (audio_idx > max_idx)
-			max_idx = audio_idx;
+		if (interleaved_before(last, audio))
+			last = audio;
 
-		diff = audio->dts_usec - video->dts_usec;
-		if (diff > max_diff)
-			max_diff = diff;
+		diff = audio->packet.dts_usec - video->packet.dts_usec;
 	}
 
-	return diff > duration_usec ? max_idx + 1 : 0;
-}
-
-static void discard_to_idx(struct obs_output *output, size_t idx)
-{
-	for (size_t i = 0; i < idx; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		obs_encoder_packet_release(packet);
-	}
+	if (diff <= duration_usec)
+		return 0;
 
-	da_erase_range(output->interleaved_packets, 0, idx);
+	interleaver_discard_through(il, last);
+	return 1;
 }
 
 #define DEBUG_STARTING_PACKETS 0
 
 static bool prune_interleaved_packets(struct obs_output *output)
 {
-	size_t start_idx = 0;
 	int prune_start = prune_premature_packets(output);
 
 #if DEBUG_STARTING_PACKETS == 1
 	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune_start);
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		blog(LOG_DEBUG, "packet: %s %d, ts: %lld, pruned = %s",
-		     packet->type == OBS_ENCODER_AUDIO ? "audio" : "video",
-		     (int)packet->track_idx, packet->dts_usec,
-		     (int)i < prune_start ? "true" : "false");
+	for (size_t i = 0; i < INTERLEAVE_STREAMS; i++) {
+		struct interleave_stream *s = &output->interleaver.streams[i];
+
+		for (size_t j = 0; j < interleave_stream_size(s); j++) {
+			struct encoder_packet *packet =
+				&interleave_stream_get(s, j)->packet;
+			blog(LOG_DEBUG, "packet: %s %d, ts: %lld",
+			     packet->type == OBS_ENCODER_AUDIO ? "audio"
+							       : "video",
+			     (int)packet->track_idx, packet->dts_usec);
+		}
 	}
 #endif
 
 	/* prunes the first video packet if it's too far away from audio */
 	if (prune_start == -1)
 		return false;
-	else if (prune_start != 0)
-		start_idx = (size_t)prune_start;
-	else
-		start_idx = get_interleaved_start_idx(output);
-
-	if (start_idx)
-		discard_to_idx(output, start_idx);
+	else if (prune_start == 0)
+		discard_to_interleaved_start(output);
 
 	return true;
 }
 
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type,
-				      size_t audio_idx)
-{
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
-
-			return (int)i;
-		}
-	}
-
-	return -1;
-}
-
-static int find_last_packet_type_idx(struct obs_output *output,
-				     enum obs_encoder_type type,
-				     size_t audio_idx)
-{
-	for (size_t i = output->interleaved_packets.num; i > 0; i--) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i - 1];
-
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
-
-			return (int)(i - 1);
-		}
-	}
-
-	return -1;
-}
-
-static inline struct encoder_packet *
-find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx)
-{
-	int idx = find_first_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
-
-static inline struct encoder_packet *
-find_last_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		      size_t audio_idx)
-{
-	int idx = find_last_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
-
 static bool get_audio_and_video_packets(struct obs_output *output,
 					struct encoder_packet **video,
 					struct encoder_packet **audio,
@@ -1574,7 +1499,6 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	struct encoder_packet *audio[MAX_AUDIO_MIXES];
 	struct encoder_packet *last_audio[MAX_AUDIO_MIXES];
 	size_t audio_mixes = num_audio_mixes(output);
-	size_t start_idx;
 
 	if (!get_audio_and_video_packets(output, &video, audio, audio_mixes))
 		return false;
@@ -1592,9 +1516,7 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	}
 
 	/* clear out excess starting audio if it hasn't been already */
-	start_idx = get_interleaved_start_idx(output);
-	if (start_idx) {
-		discard_to_idx(output, start_idx);
+	if (discard_to_interleaved_start(output)) {
 		if (!get_audio_and_video_packets(output, &video, audio,
 						 audio_mixes))
 			return false;
@@ -1621,63 +1543,17 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	output->highest_video_ts -= video->dts_usec;
 
 	/* apply new offsets to all existing packet DTS/PTS values */
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		apply_interleaved_packet_offset(output, packet);
-	}
-
-	return true;
-}
-
-static inline void insert_interleaved_packet(struct obs_output *output,
-					     struct encoder_packet *out)
-{
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
-
-		if (out->dts_usec == cur_packet->dts_usec &&
-		    out->type == OBS_ENCODER_VIDEO) {
-			break;
-		} else if (out->dts_usec < cur_packet->dts_usec) {
-			break;
-		}
-	}
-
-	da_insert(output->interleaved_packets, idx, out);
-}
-
-static void resort_interleaved_packets(struct obs_output *output)
-{
-	DARRAY(struct encoder_packet) old_array;
-
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0,
-	       sizeof(output->interleaved_packets));
-
-	for (size_t i = 0; i < old_array.num; i++)
-		insert_interleaved_packet(output, &old_array.array[i]);
+	interleaver_renumber(&output->interleaver);
 
-	da_free(old_array);
-}
-
-static void discard_unused_audio_packets(struct obs_output *output,
-					 int64_t dts_usec)
-{
-	size_t idx = 0;
+	for (size_t i = 0; i < INTERLEAVE_STREAMS; i++) {
+		struct interleave_stream *s = &output->interleaver.streams[i];
 
-	for (; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *p =
-			&output->interleaved_packets.array[idx];
-
-		if (p->dts_usec >= dts_usec)
-			break;
+		for (size_t j = 0; j < interleave_stream_size(s); j++)
+			apply_interleaved_packet_offset(
+				output, &interleave_stream_get(s, j)->packet);
 	}
 
-	if (idx)
-		discard_to_idx(output, idx);
+	return true;
 }
 
 static void interleave_packets(void *data, struct encoder_packet *packet)
@@ -1697,7 +1573,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	/* if first video frame is not a keyframe, discard until received */
 	if (!output->received_video && packet->type == OBS_ENCODER_VIDEO &&
 	    !packet->keyframe) {
-		discard_unused_audio_packets(output, packet->dts_usec);
+		interleaver_discard_dts(&output->interleaver, packet->dts_usec);
 		pthread_mutex_unlock(&output->interleaved_mutex);
 
 		if (output->active_delay_ns)
@@ -1710,14 +1586,14 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->active_delay_ns)
 		out = *packet;
 	else
-		obs_encoder_packet_create_instance(&out, packet);
+		obs_encoder_packet_ref(&out, packet);
 
 	if (was_started)
 		apply_interleaved_packet_offset(output, &out);
 	else
 		check_received(output, packet);
 
-	insert_interleaved_packet(output, &out);
+	interleaver_push(&output->interleaver, &out);
 	set_higher_ts(output, &out);
 
 	/* when both video and audio have been received, we're ready
@@ -1726,7 +1602,8 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 		if (!was_started) {
 			if (prune_interleaved_packets(output)) {
 				if (initialize_interleaved_packets(output)) {
-					resort_interleaved_packets(output);
+					interleaver_resort(
+						&output->interleaver);
 					send_interleaved(output);
 				}
 			}
@@ -0,0 +1,197 @@
+/******************************************************************************
+    Copyright (C) 2023 by agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/* Size-class pool for encoder packet payloads.  Payloads are refcounted
+ * (see obs_encoder_packet_ref/release), so an encoded packet is copied into
+ * the pool when it's first referenced and then shared read-only by every
+ * output, delay buffer and replay buffer that holds it.  Freed blocks are
+ * kept per size class for reuse rather than going back to the allocator. */
+
+#include "obs-internal.h"
+
+/* 1 KiB up to 16 MiB, larger payloads are allocated directly */
+#define MIN_CLASS_SHIFT 10
+#define MAX_CLASS_SHIFT 24
+#define NUM_CLASSES (MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1)
+#define UNPOOLED_CLASS NUM_CLASSES
+
+/* bounds how much each class keeps around once packets are freed */
+#define MAX_CACHED_BLOCKS 64
+#define MAX_CACHED_BYTES_PER_CLASS (32 * 1024 * 1024)
+
+/* sits right before the payload, with the refcount last so that it's at
+ * ((long *)data - 1) as it has always been */
+struct packet_header {
+	uint32_t size_class;
+	long refs;
+};
+
+struct free_block {
+	struct free_block *next;
+};
+
+struct packet_pool {
+	pthread_mutex_t mutex;
+	struct free_block *free_blocks[NUM_CLASSES];
+	size_t num_free[NUM_CLASSES];
+	struct obs_packet_pool_stats stats;
+};
+
+static struct packet_pool pool = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+
+static inline size_t class_size(uint32_t size_class)
+{
+	return (size_t)1 << (size_class + MIN_CLASS_SHIFT);
+}
+
+static inline uint32_t get_size_class(size_t size)
+{
+	uint32_t size_class = 0;
+
+	while (size_class < NUM_CLASSES && class_size(size_class) < size)
+		size_class++;
+	return size_class;
+}
+
+static inline size_t max_cached_blocks(uint32_t size_class)
+{
+	size_t max = MAX_CACHED_BYTES_PER_CLASS / class_size(size_class);
+	return max < MAX_CACHED_BLOCKS ? max : MAX_CACHED_BLOCKS;
+}
+
+static inline struct packet_header *get_header(uint8_t *data)
+{
+	return (struct packet_header *)data - 1;
+}
+
+uint8_t *packet_pool_alloc(size_t size)
+{
+	uint32_t size_class = get_size_class(size);
+	struct packet_header *header = NULL;
+	size_t alloc_size;
+
+	pthread_mutex_lock(&pool.mutex);
+	pool.stats.allocs++;
+	pool.stats.outstanding++;
+
+	if (size_class == UNPOOLED_CLASS) {
+		pool.stats.unpooled++;
+
+	} else if (pool.free_blocks[size_class]) {
+		struct free_block *block = pool.free_blocks[size_class];
+
+		pool.free_blocks[size_class] = block->next;
+		pool.num_free[size_class]--;
+		pool.stats.pool_hits++;
+		pool.stats.cached_blocks--;
+		pool.stats.cached_bytes -= class_size(size_class);
+
+		header = (struct packet_header *)block;
+	}
+	pthread_mutex_unlock(&pool.mutex);
+
+	if (!header) {
+		alloc_size = size_class == UNPOOLED_CLASS
+				     ? size
+				     : class_size(size_class);
+		header = bmalloc(sizeof(*header) + alloc_size);
+	}
+
+	/* cached blocks have had the header overwritten by the free list */
+	header->size_class = size_class;
+	header->refs = 1;
+	return (uint8_t *)(header + 1);
+}
+
+static void packet_pool_free(uint8_t *data)
+{
+	struct packet_header *header = get_header(data);
+	uint32_t size_class = header->size_class;
+	bool cached = false;
+
+	if (size_class > UNPOOLED_CLASS) {
+		blog(LOG_ERROR,
+		     "packet_pool_free: Packet data %p was not allocated "
+		     "from the packet pool (size class %u)",
+		     data, (unsigned)size_class);
+		return;
+	}
+
+	pthread_mutex_lock(&pool.mutex);
+	pool.stats.frees++;
+	pool.stats.outstanding--;
+
+	if (size_class != UNPOOLED_CLASS &&
+	    pool.num_free[size_class] < max_cached_blocks(size_class)) {
+		struct free_block *block = (struct free_block *)header;
+
+		block->next = pool.free_blocks[size_class];
+		pool.free_blocks[size_class] = block;
+		pool.num_free[size_class]++;
+		pool.stats.cached_blocks++;
+		pool.stats.cached_bytes += class_size(size_class);
+		cached = true;
+	}
+	pthread_mutex_unlock(&pool.mutex);
+
+	if (!cached)
+		bfree(header);
+}
+
+void packet_pool_release(uint8_t *data)
+{
+	if (os_atomic_dec_long(&get_header(data)->refs) == 0)
+		packet_pool_free(data);
+}
+
+void packet_pool_addref(uint8_t *data)
+{
+	os_atomic_inc_long(&get_header(data)->refs);
+}
+
+void packet_pool_trim(void)
+{
+	struct free_block *blocks[NUM_CLASSES];
+
+	pthread_mutex_lock(&pool.mutex);
+	for (size_t i = 0; i < NUM_CLASSES; i++) {
+		blocks[i] = pool.free_blocks[i];
+		pool.free_blocks[i] = NULL;
+		pool.num_free[i] = 0;
+	}
+	pool.stats.cached_blocks = 0;
+	pool.stats.cached_bytes = 0;
+	pthread_mutex_unlock(&pool.mutex);
+
+	for (size_t i = 0; i < NUM_CLASSES; i++) {
+		while (blocks[i]) {
+			struct free_block *next = blocks[i]->next;
+			bfree(blocks[i]);
+			blocks[i] = next;
+		}
+	}
+}
+
+void obs_get_packet_pool_stats(struct obs_packet_pool_stats *stats)
+{
+	if (!obs_ptr_valid(stats, "obs_get_packet_pool_stats"))
+		return;
+
+	pthread_mutex_lock(&pool.mutex);
+	*stats = pool.stats;
+	pthread_mutex_unlock(&pool.mutex);
+}
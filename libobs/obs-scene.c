@@ -19,6 +19,7 @@
 #include "util/threading.h"
 #include "util/util_uint64.h"
 #include "graphics/math-defs.h"
+#include "media-io/audio-math.h"
 #include "obs-scene.h"
 #include "obs-internal.h"
 
@@ -723,6 +724,40 @@ update_transforms_and_prune_sources(obs_scene_t *scene,
 		resize_group(group_sceneitem);
 }
 
+static inline bool item_video_static(struct obs_scene_item *item)
+{
+	if (obs_source_removed(item->source) ||
+	    os_atomic_load_bool(&item->update_transform) ||
+	    os_atomic_load_bool(&item->update_group_resize) ||
+	    source_size_changed(item))
+		return false;
+	if (transition_active(item->show_transition) ||
+	    transition_active(item->hide_transition))
+		return false;
+
+	return !item->user_visible || obs_source_video_static(item->source);
+}
+
+/* a scene renders the same thing as long as none of its items have pending
+ * changes and all of its visible sources are static */
+bool obs_scene_video_static(obs_source_t *source)
+{
+	struct obs_scene *scene = source->context.data;
+	struct obs_scene_item *item;
+	bool is_static = true;
+
+	video_lock(scene);
+
+	item = scene->first_item;
+	while (item && is_static) {
+		is_static = item_video_static(item);
+		item = item->next;
+	}
+
+	video_unlock(scene);
+	return is_static;
+}
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	DARRAY(struct obs_scene_item *) remove_items;
@@ -1069,7 +1104,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 		new_frame_num = util_mul_div64(timestamp - ts, sample_rate,
 					       1000000000ULL);
 
-		if (ts && new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (ts && new_frame_num >= obs->audio.frames_per_tick)
 			break;
 
 		da_erase(item->audio_actions, i--);
@@ -1087,7 +1122,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 	}
 
 	if (buf) {
-		for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+		for (; frame_num < obs->audio.frames_per_tick; frame_num++)
 			buf[frame_num] = cur_visible ? 1.0f : 0.0f;
 	}
 
@@ -1116,7 +1151,7 @@ static bool apply_scene_item_volume(struct obs_scene_item *item, float *buf,
 	pthread_mutex_unlock(&item->actions_mutex);
 
 	if (actions_pending) {
-		uint64_t duration = util_mul_div64(AUDIO_OUTPUT_FRAMES,
+		uint64_t duration = util_mul_div64(obs->audio.frames_per_tick,
 						   1000000000ULL, sample_rate);
 
 		if (!ts || action.timestamp < (ts + duration)) {
@@ -1136,27 +1171,16 @@ static void process_all_audio_actions(struct obs_scene_item *item,
 		;
 }
 
-static void mix_audio_with_buf(float *p_out, float *p_in, float *buf_in,
-			       size_t pos, size_t count)
+static inline void mix_audio_with_buf(float *p_out, float *p_in,
+				      float *buf_in, size_t pos, size_t count)
 {
-	register float *out = p_out;
-	register float *buf = buf_in + pos;
-	register float *in = p_in + pos;
-	register float *end = in + count;
-
-	while (in < end)
-		*(out++) += *(in++) * *(buf++);
+	audio_mix_floats_mul(p_out, p_in + pos, buf_in + pos, count);
 }
 
 static inline void mix_audio(float *p_out, float *p_in, size_t pos,
 			     size_t count)
 {
-	register float *out = p_out;
-	register float *in = p_in + pos;
-	register float *end = in + count;
-
-	while (in < end)
-		*(out++) += *(in++);
+	audio_mix_floats(p_out, p_in + pos, count);
 }
 
 static bool scene_audio_render(void *data, uint64_t *ts_out,
@@ -1238,7 +1262,7 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 
 		pos = (size_t)ns_to_audio_frames(sample_rate,
 						 source_ts - timestamp);
-		count = AUDIO_OUTPUT_FRAMES - pos;
+		count = obs->audio.frames_per_tick - pos;
 
 		if (!apply_buf && !item->visible &&
 		    !transition_active(item->hide_transition)) {
@@ -1251,6 +1275,8 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 		for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
 			if ((mixers & (1 << mix)) == 0)
 				continue;
+			if ((source->audio_silent_mixes & (1 << mix)) != 0)
+				continue;
 
 			for (size_t ch = 0; ch < channels; ch++) {
 				float *out = audio_output->output[mix].data[ch];
@@ -1921,6 +1947,8 @@ obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source)
 	if (!item)
 		return NULL;
 
+	obs_mark_video_dirty();
+
 	calldata_init_fixed(&params, stack, sizeof(stack));
 	calldata_set_ptr(&params, "scene", scene);
 	calldata_set_ptr(&params, "item", item);
@@ -2033,6 +2061,9 @@ obs_source_t *obs_sceneitem_get_source(const obs_sceneitem_t *item)
 static void signal_parent(obs_scene_t *parent, const char *command,
 			  calldata_t *params)
 {
+	/* every change to a scene's items is signaled through here */
+	obs_mark_video_dirty();
+
 	calldata_set_ptr(params, "scene", parent);
 	signal_handler_signal(parent->source->context.signals, command, params);
 }
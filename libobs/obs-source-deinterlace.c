@@ -466,6 +466,8 @@ void obs_source_set_deinterlace_mode(obs_source_t *source,
 	if (source->deinterlace_mode == mode)
 		return;
 
+	obs_mark_video_dirty();
+
 	if (source->deinterlace_mode == OBS_DEINTERLACE_MODE_DISABLE) {
 		enable_deinterlacing(source, mode);
 	} else if (mode == OBS_DEINTERLACE_MODE_DISABLE) {
@@ -92,6 +92,8 @@ void obs_transition_clear(obs_source_t *transition)
 	transition->transitioning_audio = false;
 	unlock_transition(transition);
 
+	obs_mark_video_dirty();
+
 	for (size_t i = 0; i < 2; i++) {
 		if (s[i] && active[i])
 			obs_source_remove_active_child(transition, s[i]);
@@ -178,6 +180,7 @@ static inline void recalculate_transition_matrices(obs_source_t *transition)
 {
 	recalculate_transition_matrix(transition, 0);
 	recalculate_transition_matrix(transition, 1);
+	obs_mark_video_dirty();
 }
 
 static void recalculate_transition_size(obs_source_t *transition)
@@ -459,6 +462,8 @@ void obs_transition_set(obs_source_t *transition, obs_source_t *source)
 	transition->transition_manual_target = 0.0f;
 	unlock_transition(transition);
 
+	obs_mark_video_dirty();
+
 	for (size_t i = 0; i < 2; i++) {
 		if (s[i] && active[i])
 			obs_source_remove_active_child(transition, s[i]);
@@ -716,6 +721,30 @@ void obs_transition_force_stop(obs_source_t *transition)
 	handle_stop(transition);
 }
 
+/* a transition renders the same thing as long as it isn't transitioning and
+ * the source it's showing is static */
+bool obs_transition_video_static(obs_source_t *transition)
+{
+	obs_source_t *child;
+	bool is_static;
+
+	lock_transition(transition);
+	if (transition->transitioning_video) {
+		unlock_transition(transition);
+		return false;
+	}
+
+	child = transition->transitioning_audio
+			? transition->transition_sources[1]
+			: transition->transition_sources[0];
+	obs_source_addref(child);
+	unlock_transition(transition);
+
+	is_static = !child || obs_source_video_static(child);
+	obs_source_release(child);
+	return is_static;
+}
+
 void obs_transition_video_render(obs_source_t *transition,
 				 obs_transition_video_render_callback_t callback)
 {
@@ -801,9 +830,11 @@ void obs_transition_video_render(obs_source_t *transition,
 	obs_source_release(state.s[0]);
 	obs_source_release(state.s[1]);
 
-	if (video_stopped)
+	if (video_stopped) {
+		obs_mark_video_dirty();
 		obs_source_dosignal(transition, "source_transition_video_stop",
 				    "transition_video_stop");
+	}
 	if (stopped)
 		handle_stop(transition);
 }
@@ -853,9 +884,11 @@ bool obs_transition_video_render_direct(obs_source_t *transition,
 	obs_source_release(state.s[0]);
 	obs_source_release(state.s[1]);
 
-	if (video_stopped)
+	if (video_stopped) {
+		obs_mark_video_dirty();
 		obs_source_dosignal(transition, "source_transition_video_stop",
 				    "transition_video_stop");
+	}
 	if (stopped)
 		handle_stop(transition);
 
@@ -891,6 +924,7 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 {
 	bool valid = child && !child->audio_pending && child->audio_ts;
 	struct obs_source_audio_mix child_audio;
+	size_t frames = obs->audio.frames_per_tick;
 	uint64_t ts;
 	size_t pos;
 
@@ -901,7 +935,7 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 	obs_source_get_audio_mix(child, &child_audio);
 	pos = (size_t)ns_to_audio_frames(sample_rate, ts - min_ts);
 
-	if (pos > AUDIO_OUTPUT_FRAMES)
+	if (pos > frames)
 		return;
 
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
@@ -915,9 +949,8 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 			float *out = output->data[ch];
 			float *in = input->data[ch];
 
-			mix_child(transition, out + pos, in,
-				  AUDIO_OUTPUT_FRAMES - pos, sample_rate, ts,
-				  mix);
+			mix_child(transition, out + pos, in, frames - pos,
+				  sample_rate, ts, mix);
 		}
 	}
 }
@@ -21,6 +21,7 @@
 #include "media-io/format-conversion.h"
 #include "media-io/video-frame.h"
 #include "media-io/audio-io.h"
+#include "media-io/audio-math.h"
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/util_uint64.h"
@@ -669,6 +670,8 @@ void obs_source_destroy(struct obs_source *source)
 		bfree(source->audio_data.data[i]);
 	for (i = 0; i < MAX_AUDIO_CHANNELS; i++)
 		circlebuf_free(&source->audio_input_buf[i]);
+	for (i = 0; i < AUDIO_PACKET_RING_SIZE; i++)
+		bfree(source->audio_packets[i].data);
 	audio_resampler_destroy(source->resampler);
 	bfree(source->audio_output_buf[0][0]);
 	bfree(source->audio_mix_buf[0]);
@@ -787,6 +790,7 @@ void obs_source_remove(obs_source_t *source)
 
 	if (!source->removed) {
 		source->removed = true;
+		obs_mark_video_dirty();
 		obs_source_dosignal(source, "source_remove", "remove");
 	}
 }
@@ -915,6 +919,7 @@ static void obs_source_deferred_update(obs_source_t *source)
 				    source->context.settings);
 		os_atomic_compare_swap_long(&source->defer_update_count, count,
 					    0);
+		obs_mark_video_dirty();
 	}
 }
 
@@ -1154,9 +1159,13 @@ static void async_tick(obs_source_t *source)
 	source->last_sys_timestamp = sys_time;
 	pthread_mutex_unlock(&source->async_mutex);
 
-	if (source->cur_async_frame)
+	if (source->cur_async_frame) {
 		source->async_update_texture =
 			set_async_texture_size(source, source->cur_async_frame);
+
+		if (os_atomic_load_long(&source->activate_refs) > 0)
+			obs_mark_video_dirty();
+	}
 }
 
 void obs_source_video_tick(obs_source_t *source, float seconds)
@@ -1264,7 +1273,8 @@ static inline void reset_audio_timing(obs_source_t *source, uint64_t timestamp,
 	source->timing_adjust = os_time - timestamp;
 }
 
-static void reset_audio_data(obs_source_t *source, uint64_t os_time)
+/* audio thread only */
+static void reset_audio_input(obs_source_t *source, uint64_t os_time)
 {
 	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
 		if (source->audio_input_buf[i].size)
@@ -1274,11 +1284,20 @@ static void reset_audio_data(obs_source_t *source, uint64_t os_time)
 
 	source->last_audio_input_buf_size = 0;
 	source->audio_ts = os_time;
+}
+
+/* can be called from any thread with audio_buf_mutex held; the buffered
+ * audio itself is cleared by the audio thread on its next tick */
+static void reset_audio_data(obs_source_t *source, uint64_t os_time)
+{
 	source->next_audio_sys_ts_min = os_time;
+	source->audio_reset_ts = os_time;
+	os_atomic_set_bool(&source->audio_reset_requested, true);
 }
 
 static void handle_ts_jump(obs_source_t *source, uint64_t expected, uint64_t ts,
-			   uint64_t diff, uint64_t os_time)
+			   uint64_t diff, uint64_t os_time,
+			   struct audio_input_packet *packet)
 {
 	blog(LOG_DEBUG,
 	     "Timestamp for source '%s' jumped by '%" PRIu64 "', "
@@ -1287,8 +1306,12 @@ static void handle_ts_jump(obs_source_t *source, uint64_t expected, uint64_t ts,
 
 	pthread_mutex_lock(&source->audio_buf_mutex);
 	reset_audio_timing(source, ts, os_time);
-	reset_audio_data(source, os_time);
+	source->next_audio_sys_ts_min = os_time;
 	pthread_mutex_unlock(&source->audio_buf_mutex);
+
+	/* cleared in order with the audio output before and after the jump */
+	packet->reset = true;
+	packet->reset_ts = os_time;
 }
 
 static void source_signal_audio_data(obs_source_t *source,
@@ -1316,15 +1339,15 @@ static inline size_t get_buf_placement(audio_t *audio, uint64_t offset)
 }
 
 static void source_output_audio_place(obs_source_t *source,
-				      const struct audio_data *in)
+				      const struct audio_data *in,
+				      size_t channels)
 {
 	audio_t *audio = obs->audio.audio;
 	size_t buf_placement;
-	size_t channels = audio_output_get_channels(audio);
 	size_t size = in->frames * sizeof(float);
 
 	if (!source->audio_ts || in->timestamp < source->audio_ts)
-		reset_audio_data(source, in->timestamp);
+		reset_audio_input(source, in->timestamp);
 
 	buf_placement =
 		get_buf_placement(audio, in->timestamp - source->audio_ts) *
@@ -1339,8 +1362,10 @@ static void source_output_audio_place(obs_source_t *source,
 #endif
 
 	/* do not allow the circular buffers to become too big */
-	if ((buf_placement + size) > MAX_BUF_SIZE)
+	if ((buf_placement + size) > MAX_BUF_SIZE) {
+		os_atomic_inc_long(&source->audio_overflows);
 		return;
+	}
 
 	for (size_t i = 0; i < channels; i++) {
 		circlebuf_place(&source->audio_input_buf[i], buf_placement,
@@ -1354,15 +1379,16 @@ static void source_output_audio_place(obs_source_t *source,
 }
 
 static inline void source_output_audio_push_back(obs_source_t *source,
-						 const struct audio_data *in)
+						 const struct audio_data *in,
+						 size_t channels)
 {
-	audio_t *audio = obs->audio.audio;
-	size_t channels = audio_output_get_channels(audio);
 	size_t size = in->frames * sizeof(float);
 
 	/* do not allow the circular buffers to become too big */
-	if ((source->audio_input_buf[0].size + size) > MAX_BUF_SIZE)
+	if ((source->audio_input_buf[0].size + size) > MAX_BUF_SIZE) {
+		os_atomic_inc_long(&source->audio_overflows);
 		return;
+	}
 
 	for (size_t i = 0; i < channels; i++)
 		circlebuf_push_back(&source->audio_input_buf[i], in->data[i],
@@ -1373,6 +1399,90 @@ static inline void source_output_audio_push_back(obs_source_t *source,
 	source->last_audio_input_buf_size = 0;
 }
 
+/* called with audio_mutex held */
+static void push_audio_packet(obs_source_t *source,
+			      struct audio_input_packet *info,
+			      const struct audio_data *in)
+{
+	struct audio_input_packet *packet;
+	size_t floats;
+
+	if (os_atomic_load_long(&source->audio_packets_queued) ==
+	    AUDIO_PACKET_RING_SIZE) {
+		os_atomic_inc_long(&source->audio_overflows);
+
+		/* the audio thread is stalled; don't lose the reset */
+		if (info->reset) {
+			pthread_mutex_lock(&source->audio_buf_mutex);
+			reset_audio_data(source, info->reset_ts);
+			pthread_mutex_unlock(&source->audio_buf_mutex);
+		}
+		return;
+	}
+
+	packet = &source->audio_packets[source->audio_packet_write];
+	floats = info->frames * info->channels;
+
+	if (packet->capacity < floats) {
+		packet->data = brealloc(packet->data, floats * sizeof(float));
+		packet->capacity = floats;
+	}
+
+	for (size_t ch = 0; ch < info->channels; ch++)
+		memcpy(packet->data + info->frames * ch, in->data[ch],
+		       info->frames * sizeof(float));
+
+	packet->channels = info->channels;
+	packet->frames = info->frames;
+	packet->timestamp = info->timestamp;
+	packet->push_back = info->push_back;
+	packet->reset = info->reset;
+	packet->reset_ts = info->reset_ts;
+
+	source->audio_packet_write =
+		(source->audio_packet_write + 1) % AUDIO_PACKET_RING_SIZE;
+	os_atomic_inc_long(&source->audio_packets_queued);
+}
+
+/* audio thread only: moves all audio output since the last tick into the
+ * audio input buffers */
+static void read_audio_packets(obs_source_t *source, size_t channels)
+{
+	long queued = os_atomic_load_long(&source->audio_packets_queued);
+
+	if (os_atomic_exchange_bool(&source->audio_reset_requested, false))
+		reset_audio_input(source, source->audio_reset_ts);
+
+	while (queued--) {
+		struct audio_input_packet *packet =
+			&source->audio_packets[source->audio_packet_read];
+		struct audio_data in = {0};
+
+		if (packet->reset)
+			reset_audio_input(source, packet->reset_ts);
+
+		if (packet->frames && packet->channels >= channels) {
+			for (size_t ch = 0; ch < channels; ch++)
+				in.data[ch] = (uint8_t *)(packet->data +
+							  packet->frames * ch);
+			in.frames = packet->frames;
+			in.timestamp = packet->timestamp;
+
+			if (packet->push_back && source->audio_ts)
+				source_output_audio_push_back(source, &in,
+							      channels);
+			else
+				source_output_audio_place(source, &in,
+							  channels);
+		}
+
+		source->audio_packet_read =
+			(source->audio_packet_read + 1) %
+			AUDIO_PACKET_RING_SIZE;
+		os_atomic_dec_long(&source->audio_packets_queued);
+	}
+}
+
 static inline bool source_muted(obs_source_t *source, uint64_t os_time)
 {
 	if (source->push_to_mute_enabled && source->user_push_to_mute_pressed)
@@ -1397,6 +1507,7 @@ static void source_output_audio_data(obs_source_t *source,
 				     const struct audio_data *data)
 {
 	size_t sample_rate = audio_output_get_sample_rate(obs->audio.audio);
+	struct audio_input_packet packet = {0};
 	struct audio_data in = *data;
 	uint64_t diff;
 	uint64_t os_time = os_gettime_ns();
@@ -1421,7 +1532,7 @@ static void source_output_audio_data(obs_source_t *source,
 		/* smooth audio if within threshold */
 		if (diff > MAX_TS_VAR && !using_direct_ts)
 			handle_ts_jump(source, source->next_audio_ts_min,
-				       in.timestamp, diff, os_time);
+				       in.timestamp, diff, os_time, &packet);
 		else if (diff < TS_SMOOTHING_THRESHOLD) {
 			if (source->async_unbuffered && source->async_decoupled)
 				source->timing_adjust = os_time - in.timestamp;
@@ -1471,14 +1582,17 @@ static void source_output_audio_data(obs_source_t *source,
 		source->last_sync_offset = sync_offset;
 	}
 
+	pthread_mutex_unlock(&source->audio_buf_mutex);
+
 	if (source->monitoring_type != OBS_MONITORING_TYPE_MONITOR_ONLY) {
-		if (push_back && source->audio_ts)
-			source_output_audio_push_back(source, &in);
-		else
-			source_output_audio_place(source, &in);
+		packet.channels = audio_output_get_channels(obs->audio.audio);
+		packet.frames = in.frames;
+		packet.timestamp = in.timestamp;
+		packet.push_back = push_back;
 	}
 
-	pthread_mutex_unlock(&source->audio_buf_mutex);
+	if (packet.frames || packet.reset)
+		push_audio_packet(source, &packet, &in);
 
 	source_signal_audio_data(source, data, source_muted(source, os_time));
 }
@@ -2335,6 +2449,56 @@ static inline void render_video(obs_source_t *source)
 	GS_DEBUG_MARKER_END();
 }
 
+void obs_source_mark_video_dirty(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_mark_video_dirty"))
+		return;
+
+	obs_mark_video_dirty();
+}
+
+static inline bool filter_video_static(const obs_source_t *filter)
+{
+	uint32_t flags = filter->info.output_flags;
+
+	if (!filter->enabled || (flags & OBS_SOURCE_VIDEO) == 0)
+		return true;
+
+	/* async filters only ever process new frames */
+	return (flags & (OBS_SOURCE_ASYNC | OBS_SOURCE_STATIC_VIDEO)) != 0;
+}
+
+/* whether the source would render exactly what it rendered the last time,
+ * provided nothing has marked video dirty since */
+bool obs_source_video_static(obs_source_t *source)
+{
+	uint32_t flags = source->info.output_flags;
+	bool is_static;
+
+	if (!source->context.data || !source->enabled ||
+	    (flags & OBS_SOURCE_VIDEO) == 0)
+		return true;
+
+	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
+		is_static = obs_transition_video_static(source);
+	else if (obs_scene_from_source(source) || obs_group_from_source(source))
+		is_static = obs_scene_video_static(source);
+	else if ((flags & OBS_SOURCE_ASYNC) != 0)
+		is_static = !deinterlacing_enabled(source);
+	else
+		is_static = (flags & OBS_SOURCE_STATIC_VIDEO) != 0;
+
+	if (is_static && source->filters.num) {
+		pthread_mutex_lock(&source->filter_mutex);
+		for (size_t i = 0; is_static && i < source->filters.num; i++)
+			is_static =
+				filter_video_static(source->filters.array[i]);
+		pthread_mutex_unlock(&source->filter_mutex);
+	}
+
+	return is_static;
+}
+
 void obs_source_video_render(obs_source_t *source)
 {
 	if (!obs_source_valid(source, "obs_source_video_render"))
@@ -2520,6 +2684,8 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_mark_video_dirty();
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -2554,6 +2720,8 @@ static bool obs_source_filter_remove_refless(obs_source_t *source,
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_mark_video_dirty();
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -2681,8 +2849,10 @@ void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
 	success = move_filter_dir(source, filter, movement);
 	pthread_mutex_unlock(&source->filter_mutex);
 
-	if (success)
+	if (success) {
+		obs_mark_video_dirty();
 		obs_source_dosignal(source, NULL, "reorder_filters");
+	}
 }
 
 obs_data_t *obs_source_get_settings(const obs_source_t *source)
@@ -2925,6 +3095,7 @@ obs_source_output_video_internal(obs_source_t *source,
 
 	if (!frame) {
 		source->async_active = false;
+		obs_mark_video_dirty();
 		return;
 	}
 
@@ -3231,6 +3402,40 @@ void obs_source_set_video_frame2(obs_source_t *source,
 	obs_source_set_video_frame_internal(source, &new_frame);
 }
 
+/* frames per slice of fused audio filters, small enough that all channels
+ * of a slice stay in L1 from one filter to the next */
+#define AUDIO_FILTER_SLICE_FRAMES 256
+#define MAX_FUSED_AUDIO_FILTERS 16
+
+static inline bool can_fuse_audio_filter(const struct obs_source *filter)
+{
+	return filter->enabled && filter->context.data &&
+	       filter->info.filter_audio_block;
+}
+
+/* runs a chain of filters that implement filter_audio_block slice by slice
+ * rather than each over the whole block */
+static void filter_audio_slices(struct obs_source *const *filters,
+				size_t count, struct obs_audio_data *in)
+{
+	for (uint32_t pos = 0; pos < in->frames;
+	     pos += AUDIO_FILTER_SLICE_FRAMES) {
+		uint32_t frames = in->frames - pos;
+		float *planes[MAX_AV_PLANES];
+
+		if (frames > AUDIO_FILTER_SLICE_FRAMES)
+			frames = AUDIO_FILTER_SLICE_FRAMES;
+
+		for (size_t c = 0; c < MAX_AV_PLANES; c++)
+			planes[c] = in->data[c] ? (float *)in->data[c] + pos
+						: NULL;
+
+		for (size_t i = 0; i < count; i++)
+			filters[i]->info.filter_audio_block(
+				filters[i]->context.data, planes, frames);
+	}
+}
+
 static inline struct obs_audio_data *
 filter_async_audio(obs_source_t *source, struct obs_audio_data *in)
 {
@@ -3241,6 +3446,30 @@ filter_async_audio(obs_source_t *source, struct obs_audio_data *in)
 		if (!filter->enabled)
 			continue;
 
+		if (can_fuse_audio_filter(filter)) {
+			struct obs_source *fused[MAX_FUSED_AUDIO_FILTERS];
+			size_t count = 0;
+
+			/* gather this and the following fusable filters,
+			 * skipping over disabled ones */
+			for (; i > 0 && count < MAX_FUSED_AUDIO_FILTERS; i--) {
+				filter = source->filters.array[i - 1];
+
+				if (!filter->enabled)
+					continue;
+				if (!can_fuse_audio_filter(filter))
+					break;
+
+				fused[count++] = filter;
+			}
+
+			filter_audio_slices(fused, count, in);
+
+			/* step back onto the filter that ended the chain */
+			i++;
+			continue;
+		}
+
 		if (filter->context.data && filter->info.filter_audio) {
 			in = filter->info.filter_audio(filter->context.data,
 						       in);
@@ -4433,6 +4662,7 @@ void obs_source_set_enabled(obs_source_t *source, bool enabled)
 		return;
 
 	source->enabled = enabled;
+	obs_mark_video_dirty();
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
 	calldata_set_ptr(&data, "source", source);
@@ -4650,11 +4880,15 @@ static float get_source_volume(obs_source_t *source, uint64_t os_time)
 static inline void multiply_output_audio(obs_source_t *source, size_t mix,
 					 size_t channels, float vol)
 {
-	register float *out = source->audio_output_buf[mix][0];
-	register float *end = out + AUDIO_OUTPUT_FRAMES * channels;
+	size_t frames = obs->audio.frames_per_tick;
+
+	for (size_t ch = 0; ch < channels; ch++) {
+		register float *out = source->audio_output_buf[mix][ch];
+		register float *end = out + frames;
 
-	while (out < end)
-		*(out++) *= vol;
+		while (out < end)
+			*(out++) *= vol;
+	}
 }
 
 static inline void multiply_vol_data(obs_source_t *source, size_t mix,
@@ -4662,7 +4896,7 @@ static inline void multiply_vol_data(obs_source_t *source, size_t mix,
 {
 	for (size_t ch = 0; ch < channels; ch++) {
 		register float *out = source->audio_output_buf[mix][ch];
-		register float *end = out + AUDIO_OUTPUT_FRAMES;
+		register float *end = out + obs->audio.frames_per_tick;
 		register float *vol = vol_data;
 
 		while (out < end)
@@ -4694,6 +4928,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 {
 	float vol_data[AUDIO_OUTPUT_FRAMES];
 	float cur_vol = get_source_volume(source, source->audio_ts);
+	size_t frames = obs->audio.frames_per_tick;
 	size_t frame_num = 0;
 
 	pthread_mutex_lock(&source->audio_actions_mutex);
@@ -4709,7 +4944,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		new_frame_num = conv_time_to_frames(
 			sample_rate, timestamp - source->audio_ts);
 
-		if (new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (new_frame_num >= frames)
 			break;
 
 		da_erase(source->audio_actions, i--);
@@ -4724,7 +4959,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		cur_vol = get_source_volume(source, timestamp);
 	}
 
-	for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+	for (; frame_num < frames; frame_num++)
 		vol_data[frame_num] = cur_vol;
 
 	pthread_mutex_unlock(&source->audio_actions_mutex);
@@ -4751,8 +4986,8 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 	pthread_mutex_unlock(&source->audio_actions_mutex);
 
 	if (actions_pending) {
-		uint64_t duration =
-			conv_frames_to_time(sample_rate, AUDIO_OUTPUT_FRAMES);
+		uint64_t duration = conv_frames_to_time(
+			sample_rate, obs->audio.frames_per_tick);
 
 		if (action.timestamp < (source->audio_ts + duration)) {
 			apply_audio_actions(source, channels, sample_rate);
@@ -4768,6 +5003,7 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 		memset(source->audio_output_buf[0][0], 0,
 		       AUDIO_OUTPUT_FRAMES * sizeof(float) *
 			       MAX_AUDIO_CHANNELS * MAX_AUDIO_MIXES);
+		source->audio_silent_mixes = (1 << MAX_AUDIO_MIXES) - 1;
 		return;
 	}
 
@@ -4816,6 +5052,7 @@ static void custom_audio_render(obs_source_t *source, uint32_t mixers,
 		if ((source->audio_mixers & mix_bit) == 0) {
 			memset(source->audio_output_buf[mix][0], 0,
 			       sizeof(float) * AUDIO_OUTPUT_FRAMES * channels);
+			source->audio_silent_mixes |= mix_bit;
 		}
 	}
 
@@ -4847,7 +5084,7 @@ static void audio_submix(obs_source_t *source, size_t channels,
 		audio.data[i] = (const uint8_t *)audio_data.data[i];
 
 	audio.samples_per_sec = (uint32_t)sample_rate;
-	audio.frames = AUDIO_OUTPUT_FRAMES;
+	audio.frames = (uint32_t)obs->audio.frames_per_tick;
 	audio.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	audio.speakers = (enum speaker_layout)channels;
 	audio.timestamp = ts;
@@ -4861,11 +5098,12 @@ static inline void process_audio_source_tick(obs_source_t *source,
 {
 	bool audio_submix = !!(source->info.output_flags & OBS_SOURCE_SUBMIX);
 
-	pthread_mutex_lock(&source->audio_buf_mutex);
-
 	if (source->audio_input_buf[0].size < size) {
+		/* some audio but not enough for a whole tick */
+		if (source->audio_input_buf[0].size)
+			os_atomic_inc_long(&source->audio_underflows);
+
 		source->audio_pending = true;
-		pthread_mutex_unlock(&source->audio_buf_mutex);
 		return;
 	}
 
@@ -4873,7 +5111,12 @@ static inline void process_audio_source_tick(obs_source_t *source,
 		circlebuf_peek_front(&source->audio_input_buf[ch],
 				     source->audio_output_buf[0][ch], size);
 
-	pthread_mutex_unlock(&source->audio_buf_mutex);
+	/* sources that output digital silence (muted devices, paused media)
+	 * never need to be added to any mix */
+	bool silent = !audio_submix;
+	for (size_t ch = 0; silent && ch < channels; ch++)
+		silent = audio_floats_silent(source->audio_output_buf[0][ch],
+					     size / sizeof(float));
 
 	for (size_t mix = 1; mix < MAX_AUDIO_MIXES; mix++) {
 		uint32_t mix_and_val = (1 << mix);
@@ -4889,13 +5132,17 @@ static inline void process_audio_source_tick(obs_source_t *source,
 		if ((source->audio_mixers & mix_and_val) == 0 ||
 		    (mixers & mix_and_val) == 0) {
 			memset(source->audio_output_buf[mix][0], 0,
-			       size * channels);
+			       sizeof(float) * AUDIO_OUTPUT_FRAMES * channels);
+			if (!audio_submix)
+				source->audio_silent_mixes |= mix_and_val;
 			continue;
 		}
 
 		for (size_t ch = 0; ch < channels; ch++)
 			memcpy(source->audio_output_buf[mix][ch],
 			       source->audio_output_buf[0][ch], size);
+		if (silent)
+			source->audio_silent_mixes |= mix_and_val;
 	}
 
 	if (audio_submix) {
@@ -4903,8 +5150,13 @@ static inline void process_audio_source_tick(obs_source_t *source,
 		return;
 	}
 
-	if ((source->audio_mixers & 1) == 0 || (mixers & 1) == 0)
-		memset(source->audio_output_buf[0][0], 0, size * channels);
+	if ((source->audio_mixers & 1) == 0 || (mixers & 1) == 0) {
+		memset(source->audio_output_buf[0][0], 0,
+		       sizeof(float) * AUDIO_OUTPUT_FRAMES * channels);
+		source->audio_silent_mixes |= 1;
+	} else if (silent) {
+		source->audio_silent_mixes |= 1;
+	}
 
 	apply_audio_volume(source, mixers, channels, sample_rate);
 	source->audio_pending = false;
@@ -4913,6 +5165,8 @@ static inline void process_audio_source_tick(obs_source_t *source,
 void obs_source_audio_render(obs_source_t *source, uint32_t mixers,
 			     size_t channels, size_t sample_rate, size_t size)
 {
+	source->audio_silent_mixes = 0;
+
 	if (!source->audio_output_buf[0][0]) {
 		source->audio_pending = true;
 		return;
@@ -4931,6 +5185,8 @@ void obs_source_audio_render(obs_source_t *source, uint32_t mixers,
 		audio_submix(source, channels, sample_rate);
 	}
 
+	read_audio_packets(source, channels);
+
 	if (!source->audio_ts) {
 		source->audio_pending = true;
 		return;
@@ -4949,6 +5205,29 @@ bool obs_source_audio_pending(const obs_source_t *source)
 		       : true;
 }
 
+uint32_t obs_source_get_audio_overflows(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_audio_overflows")
+		       ? (uint32_t)os_atomic_load_long(&source->audio_overflows)
+		       : 0;
+}
+
+uint32_t obs_source_get_audio_underflows(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_audio_underflows")
+		       ? (uint32_t)os_atomic_load_long(
+				 &source->audio_underflows)
+		       : 0;
+}
+
+uint64_t obs_source_get_audio_render_time(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_audio_render_time")
+		       ? (uint64_t)os_atomic_load_long(
+				 &source->audio_render_time)
+		       : 0;
+}
+
 uint64_t obs_source_get_audio_timestamp(const obs_source_t *source)
 {
 	return obs_source_valid(source, "obs_source_get_audio_timestamp")
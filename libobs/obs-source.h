@@ -196,6 +196,13 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_SRGB (1 << 15)
 
+/**
+ * Source only renders something different when its settings are updated or
+ * when it calls obs_source_mark_video_dirty, which allows the previous frame
+ * to be reused when nothing on screen has changed.
+ */
+#define OBS_SOURCE_STATIC_VIDEO (1 << 16)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -540,6 +547,25 @@ struct obs_source_info {
 
 	/** Missing files **/
 	obs_missing_files_t *(*missing_files)(void *data);
+
+	/**
+	 * Called to filter a slice of raw audio data in place.  Optional
+	 * alternative to filter_audio for audio filters that never defer or
+	 * replace the data they're given.  Neighbouring filters that
+	 * implement it are run one slice at a time, so the audio stays in
+	 * cache from one filter to the next.  filter_audio is not called
+	 * for filters that implement this.  Slices can be any length, so
+	 * the output must not depend on where they're split.
+	 *
+	 * @note          This function is only used with filter sources.
+	 *
+	 * @param  data    Filter data
+	 * @param  planes  Audio planes, starting at the slice.  Unused
+	 *                 planes are NULL.
+	 * @param  frames  Number of frames in the slice
+	 */
+	void (*filter_audio_block)(void *data, float *planes[],
+				   uint32_t frames);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
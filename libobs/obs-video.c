@@ -112,8 +112,18 @@ static inline void set_render_size(uint32_t width, uint32_t height)
 	gs_set_viewport(0, 0, width, height);
 }
 
+static inline void wait_for_raw_copy(struct obs_core_video *video)
+{
+	if (video->raw_copy_pending) {
+		os_sem_wait(video->raw_copy_done);
+		video->raw_copy_pending = false;
+	}
+}
+
 static inline void unmap_last_surface(struct obs_core_video *video)
 {
+	wait_for_raw_copy(video);
+
 	for (int c = 0; c < NUM_CHANNELS; ++c) {
 		if (video->mapped_surfaces[c]) {
 			gs_stagesurface_unmap(video->mapped_surfaces[c]);
@@ -123,12 +133,44 @@ static inline void unmap_last_surface(struct obs_core_video *video)
 }
 
 static const char *render_main_texture_name = "render_main_texture";
+/* the main texture can be reused as long as nothing has been marked dirty
+ * since it was last rendered, and everything in the main view would render
+ * the same thing again */
+static bool main_texture_static(void)
+{
+	struct obs_view *view = &obs->data.main_view;
+	bool is_static;
+
+	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
+	is_static = !obs->data.draw_callbacks.num;
+	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+
+	pthread_mutex_lock(&view->channels_mutex);
+
+	for (size_t i = 0; is_static && i < MAX_CHANNELS; i++) {
+		struct obs_source *source = view->channels[i];
+
+		if (source)
+			is_static = !source->removed &&
+				    obs_source_video_static(source);
+	}
+
+	pthread_mutex_unlock(&view->channels_mutex);
+	return is_static;
+}
+
 static inline void render_main_texture(struct obs_core_video *video)
 {
 	profile_start(render_main_texture_name);
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_MAIN_TEXTURE,
 			      render_main_texture_name);
 
+	bool dirty = os_atomic_exchange_bool(&video->main_texture_dirty, false);
+	if (!dirty && main_texture_static()) {
+		video->texture_rendered = true;
+		goto end;
+	}
+
 	struct vec4 clear_color;
 	vec4_set(&clear_color, 0.0f, 0.0f, 0.0f, 0.0f);
 
@@ -153,6 +195,7 @@ static inline void render_main_texture(struct obs_core_video *video)
 
 	video->texture_rendered = true;
 
+end:
 	GS_DEBUG_MARKER_END();
 	profile_end(render_main_texture_name);
 }
@@ -369,6 +412,7 @@ static inline void stage_output_texture(struct obs_core_video *video,
 			gs_stage_texture(copy, video->output_texture);
 
 		video->textures_copied[cur_texture] = true;
+		os_atomic_inc_long(&video->readback_frames);
 	} else if (video->texture_converted) {
 		for (int i = 0; i < NUM_CHANNELS; i++) {
 			gs_stagesurf_t *copy =
@@ -379,6 +423,7 @@ static inline void stage_output_texture(struct obs_core_video *video,
 		}
 
 		video->textures_copied[cur_texture] = true;
+		os_atomic_inc_long(&video->readback_frames);
 	}
 
 	profile_end(stage_output_texture_name);
@@ -515,15 +560,35 @@ static inline void render_video(struct obs_core_video *video, bool raw_active,
 	gs_end_scene();
 }
 
-static inline bool download_frame(struct obs_core_video *video,
-				  int prev_texture, struct video_data *frame)
+static inline int oldest_readback_texture(struct obs_core_video *video)
 {
-	if (!video->textures_copied[prev_texture])
-		return false;
+	int frames = (int)video->readback_frames;
+	int texture = video->cur_texture - frames;
+	return texture < 0 ? texture + video->readback_depth : texture;
+}
+
+static inline bool readback_ready(struct obs_core_video *video, int texture)
+{
+	for (int channel = 0; channel < NUM_CHANNELS; ++channel) {
+		gs_stagesurf_t *surface =
+			video->copy_surfaces[texture][channel];
+		if (surface && !gs_stagesurface_ready(surface))
+			return false;
+	}
+	return true;
+}
+
+static inline bool download_frame(struct obs_core_video *video, int texture,
+				  struct video_data *frame)
+{
+	unmap_last_surface(video);
+
+	video->textures_copied[texture] = false;
+	os_atomic_dec_long(&video->readback_frames);
 
 	for (int channel = 0; channel < NUM_CHANNELS; ++channel) {
 		gs_stagesurf_t *surface =
-			video->copy_surfaces[prev_texture][channel];
+			video->copy_surfaces[texture][channel];
 		if (surface) {
 			if (!gs_stagesurface_map(surface, &frame->data[channel],
 						 &frame->linesize[channel]))
@@ -709,6 +774,141 @@ static inline void output_video_data(struct obs_core_video *video,
 	}
 }
 
+static void *raw_copy_thread(void *param)
+{
+	struct obs_core_video *video = param;
+
+	os_set_thread_name("libobs: raw video copy thread");
+
+	while (os_sem_wait(video->raw_copy_start) == 0) {
+		if (video->raw_copy_stop)
+			break;
+
+		output_video_data(video, &video->raw_copy_frame,
+				  video->raw_copy_count);
+		os_sem_post(video->raw_copy_done);
+	}
+
+	return NULL;
+}
+
+bool init_raw_copy_thread(struct obs_core_video *video)
+{
+	video->raw_copy_stop = false;
+	video->raw_copy_pending = false;
+
+	if (os_sem_init(&video->raw_copy_start, 0) != 0)
+		return false;
+	if (os_sem_init(&video->raw_copy_done, 0) != 0)
+		return false;
+	if (pthread_create(&video->raw_copy_thread, NULL, raw_copy_thread,
+			   video) != 0)
+		return false;
+
+	video->raw_copy_thread_initialized = true;
+	return true;
+}
+
+void stop_raw_copy_thread(struct obs_core_video *video)
+{
+	if (video->raw_copy_thread_initialized) {
+		wait_for_raw_copy(video);
+
+		video->raw_copy_stop = true;
+		os_sem_post(video->raw_copy_start);
+		pthread_join(video->raw_copy_thread, NULL);
+		video->raw_copy_thread_initialized = false;
+	}
+}
+
+void free_raw_copy(struct obs_core_video *video)
+{
+	os_sem_destroy(video->raw_copy_start);
+	os_sem_destroy(video->raw_copy_done);
+	video->raw_copy_start = NULL;
+	video->raw_copy_done = NULL;
+}
+
+/* hands the mapped frame to the copy thread if there is one; the mapping is
+ * released by unmap_last_surface once the copy is done */
+static inline void queue_video_data(struct obs_core_video *video,
+				    struct video_data *input_frame, int count)
+{
+	if (!video->raw_copy_thread_initialized) {
+		output_video_data(video, input_frame, count);
+		return;
+	}
+
+	video->raw_copy_frame = *input_frame;
+	video->raw_copy_count = count;
+	video->raw_copy_pending = true;
+	os_sem_post(video->raw_copy_start);
+}
+
+static void frame_histogram_add(struct obs_frame_histogram *histogram,
+				uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	size_t bucket = 0;
+
+	while (us > 1 && bucket < OBS_FRAME_HISTOGRAM_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+
+	histogram->buckets[bucket]++;
+	histogram->count++;
+	histogram->total_ns += ns;
+	if (ns > histogram->max_ns)
+		histogram->max_ns = ns;
+}
+
+static inline void add_render_time(struct obs_core_video *video,
+				   uint64_t frame_time_ns)
+{
+	pthread_mutex_lock(&video->pacing_mutex);
+	frame_histogram_add(&video->pacing_stats.render_time, frame_time_ns);
+	pthread_mutex_unlock(&video->pacing_mutex);
+}
+
+static inline void add_wakeup(struct obs_core_video *video, bool slept,
+			      uint64_t wakeup_error_ns)
+{
+	pthread_mutex_lock(&video->pacing_mutex);
+	if (slept)
+		frame_histogram_add(&video->pacing_stats.wakeup_error,
+				    wakeup_error_ns);
+	else
+		video->pacing_stats.render_overruns++;
+	pthread_mutex_unlock(&video->pacing_mutex);
+}
+
+/* sleeps until shortly before the deadline, then spins the rest of the way
+ * so that scheduler latency can't make the frame late */
+static bool sleepto_spin_ns(uint64_t time_target, uint64_t spin_ns)
+{
+	uint64_t t = os_gettime_ns();
+
+	if (t >= time_target)
+		return false;
+
+	if (time_target - t > spin_ns)
+		os_sleepto_ns(time_target - spin_ns);
+
+	while (os_gettime_ns() < time_target)
+		;
+	return true;
+}
+
+static inline bool video_sleepto(struct obs_core_video *video,
+				 uint64_t time_target)
+{
+	if (video->pacing == OBS_VIDEO_PACING_SLEEP_SPIN)
+		return sleepto_spin_ns(time_target, video->pacing_spin_ns);
+
+	return os_sleepto_ns(time_target);
+}
+
 static inline void video_sleep(struct obs_core_video *video, bool raw_active,
 			       const bool gpu_active, uint64_t *p_time,
 			       uint64_t interval_ns)
@@ -716,12 +916,21 @@ static inline void video_sleep(struct obs_core_video *video, bool raw_active,
 	struct obs_vframe_info vframe_info;
 	uint64_t cur_time = *p_time;
 	uint64_t t = cur_time + interval_ns;
+	uint64_t wake_time;
 	int count;
 
-	if (os_sleepto_ns(t)) {
+	if (video->offline) {
+		*p_time = t;
+		count = 1;
+	} else if (video_sleepto(video, t)) {
+		wake_time = os_gettime_ns();
+		add_wakeup(video, true, wake_time > t ? wake_time - t : 0);
+
 		*p_time = t;
 		count = 1;
 	} else {
+		add_wakeup(video, false, 0);
+
 		count = (int)((os_gettime_ns() - cur_time) / interval_ns);
 		*p_time = cur_time + interval_ns * count;
 	}
@@ -732,9 +941,21 @@ static inline void video_sleep(struct obs_core_video *video, bool raw_active,
 	vframe_info.timestamp = cur_time;
 	vframe_info.count = count;
 
-	if (raw_active)
+	/* a frame that couldn't be staged for readback is output as another
+	 * copy of the newest staged frame, or dropped if that has already
+	 * been downloaded */
+	if (raw_active && video->readback_skipped) {
+		if (video->vframe_info_buffer.size) {
+			struct obs_vframe_info *last = circlebuf_data(
+				&video->vframe_info_buffer,
+				video->vframe_info_buffer.size - sizeof(*last));
+			last->count += count;
+		}
+		video->lagged_frames += count;
+	} else if (raw_active) {
 		circlebuf_push_back(&video->vframe_info_buffer, &vframe_info,
 				    sizeof(vframe_info));
+	}
 	if (gpu_active)
 		circlebuf_push_back(&video->vframe_info_buffer_gpu,
 				    &vframe_info, sizeof(vframe_info));
@@ -745,16 +966,90 @@ static const char *output_frame_render_video_name = "render_video";
 static const char *output_frame_download_frame_name = "download_frame";
 static const char *output_frame_gs_flush_name = "gs_flush";
 static const char *output_frame_output_video_data_name = "output_video_data";
+
+static void output_readback_frame(struct obs_core_video *video, int texture)
+{
+	struct obs_vframe_info vframe_info;
+	struct video_data frame;
+	bool frame_ready;
+
+	memset(&frame, 0, sizeof(struct video_data));
+
+	gs_enter_context(video->graphics);
+	profile_start(output_frame_download_frame_name);
+	frame_ready = download_frame(video, texture, &frame);
+	profile_end(output_frame_download_frame_name);
+	gs_leave_context();
+
+	circlebuf_pop_front(&video->vframe_info_buffer, &vframe_info,
+			    sizeof(vframe_info));
+
+	if (frame_ready) {
+		frame.timestamp = vframe_info.timestamp;
+		profile_start(output_frame_output_video_data_name);
+		queue_video_data(video, &frame, vframe_info.count);
+		profile_end(output_frame_output_video_data_name);
+	}
+}
+
+/* Raw frames are staged into one of readback_depth sets of staging surfaces
+ * and downloaded in order once the GPU has finished copying them.  If the
+ * graphics subsystem can't tell when a copy is done, a frame is downloaded
+ * once the pipeline is full, which at the default depth of 2 is the frame
+ * after it was staged. */
+static inline void download_ready_frames(struct obs_core_video *video,
+					 bool staged)
+{
+	const long keep = staged ? 1 : 0;
+
+	if (!video->readback_fences) {
+		if (video->readback_frames == video->readback_depth)
+			output_readback_frame(video,
+					      oldest_readback_texture(video));
+		return;
+	}
+
+	while (video->readback_frames > keep) {
+		int texture = oldest_readback_texture(video);
+		bool ready;
+
+		gs_enter_context(video->graphics);
+		ready = readback_ready(video, texture);
+		gs_leave_context();
+
+		if (!ready)
+			break;
+
+		output_readback_frame(video, texture);
+	}
+}
+
 static inline void output_frame(bool raw_active, const bool gpu_active)
 {
 	struct obs_core_video *video = &obs->video;
 	int cur_texture = video->cur_texture;
-	int prev_texture = cur_texture == 0 ? NUM_TEXTURES - 1
-					    : cur_texture - 1;
-	struct video_data frame;
-	bool frame_ready = 0;
+	bool stage = raw_active;
+	bool staged = false;
+
+	/* every surface still being in flight means the oldest frame has to
+	 * be downloaded before its surfaces can be reused.  rather than block
+	 * on a copy that hasn't finished, skip staging this frame and let the
+	 * newest staged frame be duplicated in its place. */
+	if (raw_active && video->textures_copied[cur_texture]) {
+		bool ready = true;
+
+		/* offline rendering waits for the copy instead */
+		if (video->readback_fences && !video->offline) {
+			gs_enter_context(video->graphics);
+			ready = readback_ready(video, cur_texture);
+			gs_leave_context();
+		}
 
-	memset(&frame, 0, sizeof(struct video_data));
+		if (ready)
+			output_readback_frame(video, cur_texture);
+		else
+			stage = false;
+	}
 
 	profile_start(output_frame_gs_context_name);
 	gs_enter_context(video->graphics);
@@ -762,16 +1057,10 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 	profile_start(output_frame_render_video_name);
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_RENDER_VIDEO,
 			      output_frame_render_video_name);
-	render_video(video, raw_active, gpu_active, cur_texture);
+	render_video(video, stage, gpu_active, cur_texture);
 	GS_DEBUG_MARKER_END();
 	profile_end(output_frame_render_video_name);
 
-	if (raw_active) {
-		profile_start(output_frame_download_frame_name);
-		frame_ready = download_frame(video, prev_texture, &frame);
-		profile_end(output_frame_download_frame_name);
-	}
-
 	profile_start(output_frame_gs_flush_name);
 	gs_flush();
 	profile_end(output_frame_gs_flush_name);
@@ -779,19 +1068,16 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 	gs_leave_context();
 	profile_end(output_frame_gs_context_name);
 
-	if (raw_active && frame_ready) {
-		struct obs_vframe_info vframe_info;
-		circlebuf_pop_front(&video->vframe_info_buffer, &vframe_info,
-				    sizeof(vframe_info));
-
-		frame.timestamp = vframe_info.timestamp;
-		profile_start(output_frame_output_video_data_name);
-		output_video_data(video, &frame, vframe_info.count);
-		profile_end(output_frame_output_video_data_name);
+	if (stage && video->textures_copied[cur_texture]) {
+		if (++video->cur_texture == video->readback_depth)
+			video->cur_texture = 0;
+		staged = true;
 	}
 
-	if (++video->cur_texture == NUM_TEXTURES)
-		video->cur_texture = 0;
+	if (raw_active)
+		download_ready_frames(video, staged);
+
+	video->readback_skipped = raw_active && !staged;
 }
 
 #define NBSP "\xC2\xA0"
@@ -809,6 +1095,8 @@ static void clear_raw_frame_data(void)
 {
 	struct obs_core_video *video = &obs->video;
 	memset(video->textures_copied, 0, sizeof(video->textures_copied));
+	os_atomic_set_long(&video->readback_frames, 0);
+	video->readback_skipped = false;
 	circlebuf_free(&video->vframe_info_buffer);
 }
 
@@ -982,6 +1270,7 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	profile_end(render_displays_name);
 
 	frame_time_ns = os_gettime_ns() - frame_start;
+	add_render_time(&obs->video, frame_time_ns);
 
 	profile_end(context->video_thread_name);
 
@@ -990,6 +1279,10 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	video_sleep(&obs->video, raw_active, gpu_active, &obs->video.video_time,
 		    context->interval);
 
+	/* when offline, audio only advances along with the video clock */
+	if (obs->video.offline && obs->audio.audio)
+		audio_output_advance(obs->audio.audio, obs->video.video_time);
+
 	context->frame_time_total_ns += frame_time_ns;
 	context->fps_total_ns += (obs->video.video_time - context->last_time);
 	context->fps_total_frames++;
@@ -19,6 +19,7 @@
 
 #include "graphics/matrix4.h"
 #include "callback/calldata.h"
+#include "media-io/format-conversion.h"
 
 #include "obs.h"
 #include "obs-internal.h"
@@ -39,7 +40,18 @@ static inline void make_video_info(struct video_output_info *vi,
 	vi->height = ovi->output_height;
 	vi->range = ovi->range;
 	vi->colorspace = ovi->colorspace;
-	vi->cache_size = 6;
+	vi->cache_size = obs->video.frame_cache_size;
+	if (!vi->cache_size)
+		vi->cache_size = 6;
+	vi->max_wait_ms = obs->video.frame_cache_wait_ms;
+	vi->offline = obs->video.offline_setting;
+
+	/* split CPU scaling of large outputs across a few threads */
+	vi->scaler_threads = 0;
+	if ((uint64_t)vi->width * vi->height >= 2ULL * 1920 * 1080) {
+		int threads = os_get_logical_cores() / 2;
+		vi->scaler_threads = (uint32_t)(threads > 4 ? 4 : threads);
+	}
 }
 
 static inline void calc_gpu_conversion_sizes(const struct obs_video_info *ovi)
@@ -203,7 +215,17 @@ static bool obs_init_textures(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
 
-	for (size_t i = 0; i < NUM_TEXTURES; i++) {
+	video->readback_depth = (int)video->readback_depth_setting;
+	if (!video->readback_depth)
+		video->readback_depth = DEFAULT_READBACK_DEPTH;
+	else if (video->readback_depth < 2)
+		video->readback_depth = 2;
+	else if (video->readback_depth > NUM_TEXTURES)
+		video->readback_depth = NUM_TEXTURES;
+
+	video->readback_fences = gs_stagesurface_ready_supported();
+
+	for (int i = 0; i < video->readback_depth; i++) {
 #ifdef _WIN32
 		if (video->using_nv12_tex) {
 			video->copy_surfaces[i][0] =
@@ -237,6 +259,8 @@ static bool obs_init_textures(struct obs_video_info *ovi)
 	if (!video->render_texture)
 		return false;
 
+	obs_mark_video_dirty();
+
 	video->output_texture = gs_texture_create(ovi->output_width,
 						  ovi->output_height, GS_RGBA,
 						  1, NULL, GS_RENDER_TARGET);
@@ -395,6 +419,7 @@ static int obs_init_video(struct obs_video_info *ovi)
 	video->output_height = ovi->output_height;
 	video->gpu_conversion = ovi->gpu_conversion;
 	video->scale_type = ovi->scale_type;
+	video->offline = vi.offline;
 
 	set_video_matrix(video, ovi);
 
@@ -423,6 +448,11 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 	if (pthread_mutex_init(&video->task_mutex, NULL) < 0)
 		return OBS_VIDEO_FAIL;
+	if (pthread_mutex_init(&video->pacing_mutex, NULL) < 0)
+		return OBS_VIDEO_FAIL;
+	memset(&video->pacing_stats, 0, sizeof(video->pacing_stats));
+	if (!init_raw_copy_thread(video))
+		return OBS_VIDEO_FAIL;
 
 #ifdef __APPLE__
 	errorcode = pthread_create(&video->video_thread, NULL,
@@ -450,6 +480,8 @@ static void stop_video(void)
 			pthread_join(video->video_thread, &thread_retval);
 			video->thread_initialized = false;
 		}
+
+		stop_raw_copy_thread(video);
 	}
 }
 
@@ -458,6 +490,9 @@ static void obs_free_video(void)
 	struct obs_core_video *video = &obs->video;
 
 	if (video->video) {
+		stop_raw_copy_thread(video);
+		free_raw_copy(video);
+
 		video_output_close(video->video);
 		video->video = NULL;
 
@@ -515,6 +550,7 @@ static void obs_free_video(void)
 		video->texture_rendered = false;
 		memset(video->textures_copied, 0,
 		       sizeof(video->textures_copied));
+		os_atomic_set_long(&video->readback_frames, 0);
 		video->texture_converted = false;
 
 		pthread_mutex_destroy(&video->gpu_encoder_mutex);
@@ -525,6 +561,9 @@ static void obs_free_video(void)
 		pthread_mutex_init_value(&video->task_mutex);
 		circlebuf_free(&video->tasks);
 
+		pthread_mutex_destroy(&video->pacing_mutex);
+		pthread_mutex_init_value(&video->pacing_mutex);
+
 		video->gpu_encoder_active = 0;
 		video->cur_texture = 0;
 	}
@@ -560,7 +599,9 @@ static void obs_free_graphics(void)
 	}
 }
 
-static bool obs_init_audio(struct audio_output_info *ai)
+static bool obs_init_audio(struct audio_output_info *ai,
+			   uint64_t max_buffering_frames,
+			   uint32_t buffering_shrink_ms)
 {
 	struct obs_core_audio *audio = &obs->audio;
 	int errorcode;
@@ -575,6 +616,15 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
 
+	if (!obs_init_audio_render_threads(audio))
+		return false;
+
+	/* the audio thread can start ticking as soon as the output opens */
+	audio->frames_per_tick = ai->frames_per_tick;
+	audio->max_buffering_ticks =
+		(int)(max_buffering_frames / ai->frames_per_tick);
+	audio->buffering_shrink_ns = buffering_shrink_ms * 1000000ULL;
+
 	errorcode = audio_output_open(&audio->audio, ai);
 	if (errorcode == AUDIO_OUTPUT_SUCCESS)
 		return true;
@@ -602,9 +652,12 @@ static void obs_free_audio(void)
 	if (audio->audio)
 		audio_output_close(audio->audio);
 
+	obs_free_audio_render_threads(audio);
+
 	circlebuf_free(&audio->buffered_timestamps);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
+	da_free(audio->render_leaves);
 
 	da_free(audio->monitors);
 	bfree(audio->monitoring_device_name);
@@ -721,6 +774,7 @@ static const char *obs_signals[] = {
 
 	"void channel_change(int channel, in out ptr source, ptr prev_source)",
 	"void master_volume(in out float volume)",
+	"void audio_buffering(int ms)",
 
 	"void hotkey_layout_change()",
 	"void hotkey_register(ptr hotkey)",
@@ -840,6 +894,7 @@ static bool obs_init(const char *locale, const char *module_config_path,
 	pthread_mutex_init_value(&obs->audio.monitoring_mutex);
 	pthread_mutex_init_value(&obs->video.gpu_encoder_mutex);
 	pthread_mutex_init_value(&obs->video.task_mutex);
+	pthread_mutex_init_value(&obs->video.pacing_mutex);
 
 	obs->name_store_owned = !store;
 	obs->name_store = store ? store : profiler_name_store_create();
@@ -1029,6 +1084,7 @@ void obs_shutdown(void)
 	obs_free_video();
 	obs_free_hotkeys();
 	obs_free_graphics();
+	packet_pool_trim();
 	proc_handler_destroy(obs->procs);
 	signal_handler_destroy(obs->signals);
 	obs->procs = NULL;
@@ -1164,18 +1220,71 @@ int obs_reset_video(struct obs_video_info *ovi)
 	     "\tdownscale filter:  %s\n"
 	     "\tfps:               %d/%d\n"
 	     "\tformat:            %s\n"
-	     "\tYUV mode:          %s%s%s",
+	     "\tYUV mode:          %s%s%s\n"
+	     "\tCPU conversion:    %s",
 	     ovi->base_width, ovi->base_height, ovi->output_width,
 	     ovi->output_height, scale_type_name, ovi->fps_num, ovi->fps_den,
 	     get_video_format_name(ovi->output_format),
-	     yuv ? yuv_format : "None", yuv ? "/" : "", yuv ? yuv_range : "");
+	     yuv ? yuv_format : "None", yuv ? "/" : "", yuv ? yuv_range : "",
+	     format_conversion_get_impl());
 
 	return obs_init_video(ovi);
 }
 
+void obs_set_video_frame_cache(size_t frames, uint32_t max_wait_ms)
+{
+	if (!obs)
+		return;
+
+	obs->video.frame_cache_size = frames;
+	obs->video.frame_cache_wait_ms = max_wait_ms;
+}
+
+void obs_set_video_readback_depth(uint32_t depth)
+{
+	if (!obs)
+		return;
+
+	obs->video.readback_depth_setting = depth;
+}
+
+void obs_set_offline_rendering(bool enable)
+{
+	if (!obs)
+		return;
+
+	obs->video.offline_setting = enable;
+}
+
+bool obs_get_offline_rendering(void)
+{
+	return obs ? obs->video.offline : false;
+}
+
+uint32_t obs_get_video_frames_in_flight(void)
+{
+	if (!obs)
+		return 0;
+
+	return (uint32_t)os_atomic_load_long(&obs->video.readback_frames);
+}
+
 bool obs_reset_audio(const struct obs_audio_info *oai)
+{
+	struct obs_audio_info2 oai2 = {0};
+
+	if (!oai)
+		return obs_reset_audio2(NULL);
+
+	oai2.samples_per_sec = oai->samples_per_sec;
+	oai2.speakers = oai->speakers;
+	return obs_reset_audio2(&oai2);
+}
+
+bool obs_reset_audio2(const struct obs_audio_info2 *oai)
 {
 	struct audio_output_info ai;
+	uint64_t max_buffering_frames;
 
 	/* don't allow changing of audio settings if active. */
 	if (obs->audio.audio && audio_output_active(obs->audio.audio))
@@ -1190,15 +1299,33 @@ bool obs_reset_audio(const struct obs_audio_info *oai)
 	ai.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	ai.speakers = oai->speakers;
 	ai.input_callback = audio_callback;
+	ai.offline = obs->video.offline_setting;
+	ai.frames_per_tick = oai->frames_per_tick ? oai->frames_per_tick
+						  : AUDIO_OUTPUT_FRAMES;
+
+	max_buffering_frames =
+		oai->max_buffering_ms
+			? (uint64_t)oai->max_buffering_ms *
+				  ai.samples_per_sec / 1000
+			: MAX_AUDIO_BUFFERING_FRAMES;
+	if (max_buffering_frames < ai.frames_per_tick)
+		max_buffering_frames = ai.frames_per_tick;
 
 	blog(LOG_INFO, "---------------------------------");
 	blog(LOG_INFO,
 	     "audio settings reset:\n"
 	     "\tsamples per sec: %d\n"
-	     "\tspeakers:        %d",
-	     (int)ai.samples_per_sec, (int)ai.speakers);
+	     "\tspeakers:        %d\n"
+	     "\tframes per tick: %d\n"
+	     "\tmax buffering:   %d ms\n"
+	     "\tshrink after:    %d ms",
+	     (int)ai.samples_per_sec, (int)ai.speakers,
+	     (int)ai.frames_per_tick,
+	     (int)(max_buffering_frames * 1000 / ai.samples_per_sec),
+	     (int)oai->buffering_shrink_ms);
 
-	return obs_init_audio(&ai);
+	return obs_init_audio(&ai, max_buffering_frames,
+			      oai->buffering_shrink_ms);
 }
 
 bool obs_get_video_info(struct obs_video_info *ovi)
@@ -1434,6 +1561,8 @@ void obs_set_output_source(uint32_t channel, obs_source_t *source)
 
 	pthread_mutex_unlock(&view->channels_mutex);
 
+	obs_mark_video_dirty();
+
 	if (source)
 		obs_source_activate(source, MAIN_VIEW);
 
@@ -2334,6 +2463,43 @@ uint32_t obs_get_lagged_frames(void)
 	return obs->video.lagged_frames;
 }
 
+void obs_set_video_pacing(enum obs_video_pacing pacing, uint32_t spin_us)
+{
+	if (!obs)
+		return;
+
+	obs->video.pacing_spin_ns = (uint64_t)(spin_us ? spin_us : 1000) *
+				    1000ULL;
+	obs->video.pacing = pacing;
+}
+
+bool obs_get_video_pacing_stats(struct obs_video_pacing_stats *stats)
+{
+	struct obs_core_video *video;
+
+	if (!obs || !obs->video.video || !stats)
+		return false;
+
+	video = &obs->video;
+	pthread_mutex_lock(&video->pacing_mutex);
+	*stats = video->pacing_stats;
+	pthread_mutex_unlock(&video->pacing_mutex);
+	return true;
+}
+
+void obs_reset_video_pacing_stats(void)
+{
+	struct obs_core_video *video;
+
+	if (!obs || !obs->video.video)
+		return;
+
+	video = &obs->video;
+	pthread_mutex_lock(&video->pacing_mutex);
+	memset(&video->pacing_stats, 0, sizeof(video->pacing_stats));
+	pthread_mutex_unlock(&video->pacing_mutex);
+}
+
 void start_raw_video(video_t *v, const struct video_scale_info *conversion,
 		     void (*callback)(void *param, struct video_data *frame),
 		     void *param)
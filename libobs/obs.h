@@ -188,6 +188,26 @@ struct obs_audio_info {
 	enum speaker_layout speakers;
 };
 
+struct obs_audio_info2 {
+	uint32_t samples_per_sec;
+	enum speaker_layout speakers;
+
+	/** Frames mixed per audio tick, from AUDIO_OUTPUT_MIN_FRAMES to
+	 * AUDIO_OUTPUT_FRAMES.  Smaller ticks lower audio latency at the cost
+	 * of more CPU overhead.  0 for AUDIO_OUTPUT_FRAMES. */
+	uint32_t frames_per_tick;
+
+	/** Hard cap on how much audio buffering late sources can add, in
+	 * milliseconds.  0 for the default of 45 ticks of AUDIO_OUTPUT_FRAMES
+	 * frames. */
+	uint32_t max_buffering_ms;
+
+	/** Once every source has stayed at least two ticks ahead of the mix
+	 * for this many milliseconds, audio buffering is lowered by one tick.
+	 * 0 to never lower audio buffering. */
+	uint32_t buffering_shrink_ms;
+};
+
 /**
  * Sent to source filters via the filter_audio callback to allow filtering of
  * audio data
@@ -387,6 +407,51 @@ EXPORT profiler_name_store_t *obs_get_profiler_name_store(void);
  */
 EXPORT int obs_reset_video(struct obs_video_info *ovi);
 
+/**
+ * Sets the number of raw video frames that can be queued for outputs and
+ * encoders, and how long the graphics thread may wait for a free frame before
+ * duplicating the last one instead.
+ *
+ * @note Takes effect on the next call to obs_reset_video.
+ *
+ * @param  frames       Frame cache depth (0 for the default)
+ * @param  max_wait_ms  Maximum wait time, or 0 to never wait
+ */
+EXPORT void obs_set_video_frame_cache(size_t frames, uint32_t max_wait_ms);
+
+/**
+ * Sets the number of frames the GPU readback of raw video may have in flight.
+ * A deeper pipeline adds latency to raw outputs, but gives slow drivers more
+ * time to finish each copy so the graphics thread doesn't stall mapping it.
+ *
+ * @note Takes effect on the next call to obs_reset_video.
+ *
+ * @param  depth  Readback depth, from 2 to 4 (0 for the default of 2)
+ */
+EXPORT void obs_set_video_readback_depth(uint32_t depth);
+
+/**
+ * Enables or disables offline rendering.  When offline, frames are rendered
+ * as fast as outputs can consume them instead of at the video frame rate:
+ * the graphics thread doesn't sleep, video frames are never skipped or
+ * duplicated, and audio is processed in lockstep with the video clock.
+ *
+ * @note Takes effect on the next calls to obs_reset_audio and
+ *       obs_reset_video.  Asynchronous sources still timestamp their frames
+ *       and audio with the system clock, so offline rendering is meant for
+ *       scenes made of synchronous sources and media files.
+ *
+ * @param  enable  Whether to render offline
+ */
+EXPORT void obs_set_offline_rendering(bool enable);
+
+/** Returns whether the current video is being rendered offline */
+EXPORT bool obs_get_offline_rendering(void);
+
+/** Gets the number of raw video frames currently being read back from the
+ * GPU */
+EXPORT uint32_t obs_get_video_frames_in_flight(void);
+
 /**
  * Sets base audio output format/channels/samples/etc
  *
@@ -394,6 +459,14 @@ EXPORT int obs_reset_video(struct obs_video_info *ovi);
  */
 EXPORT bool obs_reset_audio(const struct obs_audio_info *oai);
 
+/**
+ * Sets base audio output format/channels/samples/etc, as well as the number
+ * of frames processed per audio tick
+ *
+ * @note Cannot reset base audio if an output is currently active.
+ */
+EXPORT bool obs_reset_audio2(const struct obs_audio_info2 *oai);
+
 /** Gets the current video settings, returns false if no video */
 EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
 
@@ -772,6 +845,53 @@ EXPORT uint64_t obs_get_frame_interval_ns(void);
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+enum obs_video_pacing {
+	/** Sleep until each frame's deadline */
+	OBS_VIDEO_PACING_SLEEP,
+	/** Sleep until shortly before each frame's deadline, then spin until
+	 * the deadline to avoid late wakeups */
+	OBS_VIDEO_PACING_SLEEP_SPIN,
+};
+
+/**
+ * Sets how the graphics thread waits for the next frame.
+ *
+ * @param  pacing   Pacing mode
+ * @param  spin_us  Time to spin before each deadline with
+ *                  OBS_VIDEO_PACING_SLEEP_SPIN, in microseconds (0 for the
+ *                  default of 1000)
+ */
+EXPORT void obs_set_video_pacing(enum obs_video_pacing pacing,
+				 uint32_t spin_us);
+
+/* Bucket 0 holds values under 2 microseconds, bucket i holds values from
+ * 2^i up to 2^(i+1) microseconds, and the last bucket holds everything
+ * above that */
+#define OBS_FRAME_HISTOGRAM_BUCKETS 20
+
+struct obs_frame_histogram {
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t buckets[OBS_FRAME_HISTOGRAM_BUCKETS];
+};
+
+struct obs_video_pacing_stats {
+	/** How late the graphics thread woke up after sleeping until a
+	 * frame's deadline */
+	struct obs_frame_histogram wakeup_error;
+	/** How long each frame took to render */
+	struct obs_frame_histogram render_time;
+	/** Frames that finished rendering after their deadline, so the
+	 * graphics thread didn't sleep at all */
+	uint64_t render_overruns;
+};
+
+/** Gets the frame pacing statistics gathered since the last video reset or
+ * call to obs_reset_video_pacing_stats */
+EXPORT bool obs_get_video_pacing_stats(struct obs_video_pacing_stats *stats);
+EXPORT void obs_reset_video_pacing_stats(void);
+
 EXPORT bool obs_nv12_tex_active(void);
 
 EXPORT void obs_apply_private_data(obs_data_t *settings);
@@ -956,6 +1076,13 @@ EXPORT void obs_source_reset_settings(obs_source_t *source,
 /** Renders a video source. */
 EXPORT void obs_source_video_render(obs_source_t *source);
 
+/**
+ * Signals that a source will render something different on the next frame.
+ * Sources with OBS_SOURCE_STATIC_VIDEO must call this whenever what they
+ * render changes for any reason other than their settings being updated.
+ */
+EXPORT void obs_source_mark_video_dirty(obs_source_t *source);
+
 /** Gets the width of a source (if it has video) */
 EXPORT uint32_t obs_source_get_width(obs_source_t *source);
 
@@ -1410,6 +1537,18 @@ EXPORT uint32_t obs_source_get_base_height(obs_source_t *source);
 
 EXPORT bool obs_source_audio_pending(const obs_source_t *source);
 EXPORT uint64_t obs_source_get_audio_timestamp(const obs_source_t *source);
+
+/** Gets how long the source took to render its audio on the last audio tick,
+ * in nanoseconds (not including its children) */
+EXPORT uint64_t obs_source_get_audio_render_time(const obs_source_t *source);
+
+/** Gets how many times audio output by the source had to be dropped because
+ * the audio thread had fallen too far behind */
+EXPORT uint32_t obs_source_get_audio_overflows(const obs_source_t *source);
+
+/** Gets how many audio ticks the source had some, but not enough, audio
+ * buffered to be mixed */
+EXPORT uint32_t obs_source_get_audio_underflows(const obs_source_t *source);
 EXPORT void obs_source_get_audio_mix(const obs_source_t *source,
 				     struct obs_source_audio_mix *audio);
 
@@ -2252,12 +2391,35 @@ EXPORT void obs_encoder_packet_ref(struct encoder_packet *dst,
 				   struct encoder_packet *src);
 EXPORT void obs_encoder_packet_release(struct encoder_packet *packet);
 
+/** Gets the allocation counts of the encoder packet pool */
+EXPORT void obs_get_packet_pool_stats(struct obs_packet_pool_stats *stats);
+
 EXPORT void *obs_encoder_create_rerouted(obs_encoder_t *encoder,
 					 const char *reroute_id);
 
 /** Returns whether encoder is paused */
 EXPORT bool obs_encoder_paused(const obs_encoder_t *output);
 
+/**
+ * Moves encoding off the thread that delivers raw frames onto a thread of
+ * the encoder's own, fed through a queue of at most max_depth frames.
+ * Frames are copied into the queue.  A max_depth of 0 encodes on the
+ * delivering thread again, which is the default.  Cannot be changed while
+ * the encoder is active, and has no effect on texture-based encoding.
+ */
+EXPORT bool obs_encoder_set_queue(obs_encoder_t *encoder, size_t max_depth,
+				  enum obs_encoder_queue_policy policy);
+
+/** Returns the queue depth set with obs_encoder_set_queue */
+EXPORT size_t obs_encoder_get_queue_depth(const obs_encoder_t *encoder);
+
+/**
+ * Gets submission queue statistics, returns false if the encoder doesn't
+ * use a queue
+ */
+EXPORT bool obs_encoder_get_queue_stats(const obs_encoder_t *encoder,
+					struct obs_encoder_queue_stats *stats);
+
 EXPORT const char *obs_encoder_get_last_error(obs_encoder_t *encoder);
 EXPORT void obs_encoder_set_last_error(obs_encoder_t *encoder,
 				       const char *message);
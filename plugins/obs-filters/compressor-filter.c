@@ -67,13 +67,14 @@ struct compressor_data {
 
 	float ratio;
 	float threshold;
+	float threshold_mul;
 	float attack_gain;
 	float release_gain;
 	float output_gain;
 
 	size_t num_channels;
 	size_t sample_rate;
-	float envelope;
+	float envelope[MAX_AUDIO_CHANNELS];
 	float slope;
 
 	pthread_mutex_t sidechain_update_mutex;
@@ -99,7 +100,8 @@ static inline obs_source_t *get_sidechain(struct compressor_data *cd)
 static inline void get_sidechain_data(struct compressor_data *cd,
 				      const uint32_t num_samples)
 {
-	size_t data_size = cd->envelope_buf_len * sizeof(float);
+	/* only take what this slice consumes, the rest is for the next one */
+	size_t data_size = num_samples * sizeof(float);
 	if (!data_size)
 		return;
 
@@ -139,6 +141,17 @@ static inline float gain_coefficient(uint32_t sample_rate, float time)
 	return (float)exp(-1.0f / (sample_rate * time));
 }
 
+/* envelope level up to which mul_to_db() never goes above threshold_db, so
+ * skipping the gain calculation there gives the same output as doing it */
+static float threshold_to_mul(float threshold_db)
+{
+	float mul = db_to_mul(threshold_db);
+
+	while (mul > 0.0f && mul_to_db(mul) > threshold_db)
+		mul = nextafterf(mul, 0.0f);
+	return mul;
+}
+
 static const char *compressor_name(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -203,6 +216,7 @@ static void compressor_update(void *data, obs_data_t *s)
 
 	cd->ratio = (float)obs_data_get_double(s, S_RATIO);
 	cd->threshold = (float)obs_data_get_double(s, S_THRESHOLD);
+	cd->threshold_mul = threshold_to_mul(cd->threshold);
 	cd->attack_gain =
 		gain_coefficient(sample_rate, attack_time_ms / MS_IN_S_F);
 	cd->release_gain =
@@ -326,7 +340,7 @@ static void analyze_envelope(struct compressor_data *cd, float **samples,
 			continue;
 
 		float *envelope_buf = cd->envelope_buf;
-		float env = cd->envelope;
+		float env = cd->envelope[chan];
 		for (uint32_t i = 0; i < num_samples; ++i) {
 			const float env_in = fabsf(samples[chan][i]);
 			if (env < env_in) {
@@ -336,8 +350,11 @@ static void analyze_envelope(struct compressor_data *cd, float **samples,
 			}
 			envelope_buf[i] = fmaxf(envelope_buf[i], env);
 		}
+
+		/* each channel picks up from its own envelope, so the output
+		 * doesn't depend on how the audio is split into slices */
+		cd->envelope[chan] = env;
 	}
-	cd->envelope = cd->envelope_buf[num_samples - 1];
 }
 
 static void analyze_sidechain(struct compressor_data *cd,
@@ -359,7 +376,7 @@ static void analyze_sidechain(struct compressor_data *cd,
 			continue;
 
 		float *envelope_buf = cd->envelope_buf;
-		float env = cd->envelope;
+		float env = cd->envelope[chan];
 		for (uint32_t i = 0; i < num_samples; ++i) {
 			const float env_in = fabsf(sidechain_buf[chan][i]);
 
@@ -370,23 +387,36 @@ static void analyze_sidechain(struct compressor_data *cd,
 			}
 			envelope_buf[i] = fmaxf(envelope_buf[i], env);
 		}
+
+		cd->envelope[chan] = env;
 	}
-	cd->envelope = cd->envelope_buf[num_samples - 1];
 }
 
 static inline void process_compression(const struct compressor_data *cd,
 				       float **samples, uint32_t num_samples)
 {
-	for (size_t i = 0; i < num_samples; ++i) {
-		const float env_db = mul_to_db(cd->envelope_buf[i]);
-		float gain = cd->slope * (cd->threshold - env_db);
-		gain = db_to_mul(fminf(0, gain));
+	const float threshold_mul = cd->threshold_mul;
+	float *gain_buf = cd->envelope_buf;
 
-		for (size_t c = 0; c < cd->num_channels; ++c) {
-			if (samples[c]) {
-				samples[c][i] *= gain * cd->output_gain;
-			}
+	/* turn the envelope into the gain of each sample, then apply it to
+	 * every channel in one vectorized pass */
+	for (size_t i = 0; i < num_samples; ++i) {
+		const float env = cd->envelope_buf[i];
+		float gain = cd->output_gain;
+
+		/* no reduction at or below the threshold */
+		if (env > threshold_mul) {
+			const float env_db = mul_to_db(env);
+			gain *= db_to_mul(
+				fminf(0, cd->slope * (cd->threshold - env_db)));
 		}
+
+		gain_buf[i] = gain;
+	}
+
+	for (size_t c = 0; c < cd->num_channels; ++c) {
+		if (samples[c])
+			audio_mul_floats(samples[c], gain_buf, num_samples);
 	}
 }
 
@@ -439,28 +469,24 @@ static void compressor_tick(void *data, float seconds)
 	UNUSED_PARAMETER(seconds);
 }
 
-static struct obs_audio_data *
-compressor_filter_audio(void *data, struct obs_audio_data *audio)
+static void compressor_filter_audio_block(void *data, float *planes[],
+					  uint32_t frames)
 {
 	struct compressor_data *cd = data;
 
-	const uint32_t num_samples = audio->frames;
-	if (num_samples == 0)
-		return audio;
-
-	float **samples = (float **)audio->data;
+	if (frames == 0)
+		return;
 
 	pthread_mutex_lock(&cd->sidechain_update_mutex);
 	obs_weak_source_t *weak_sidechain = cd->weak_sidechain;
 	pthread_mutex_unlock(&cd->sidechain_update_mutex);
 
 	if (weak_sidechain)
-		analyze_sidechain(cd, num_samples);
+		analyze_sidechain(cd, frames);
 	else
-		analyze_envelope(cd, samples, num_samples);
+		analyze_envelope(cd, planes, frames);
 
-	process_compression(cd, samples, num_samples);
-	return audio;
+	process_compression(cd, planes, frames);
 }
 
 static void compressor_defaults(obs_data_t *s)
@@ -545,7 +571,7 @@ struct obs_source_info compressor_filter = {
 	.create = compressor_create,
 	.destroy = compressor_destroy,
 	.update = compressor_update,
-	.filter_audio = compressor_filter_audio,
+	.filter_audio_block = compressor_filter_audio_block,
 	.video_tick = compressor_tick,
 	.get_defaults = compressor_defaults,
 	.get_properties = compressor_properties,
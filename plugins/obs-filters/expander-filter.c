@@ -74,6 +74,7 @@ struct expander_data {
 
 	float ratio;
 	float threshold;
+	float threshold_mul;
 	float attack_gain;
 	float release_gain;
 	float output_gain;
@@ -137,6 +138,17 @@ static inline float gain_coefficient(uint32_t sample_rate, float time)
 	return expf(-1.0f / (sample_rate * time));
 }
 
+/* envelope level from which mul_to_db() never goes below threshold_db, so
+ * skipping the gain calculation there gives the same output as doing it */
+static float threshold_to_mul(float threshold_db)
+{
+	float mul = db_to_mul(threshold_db);
+
+	while (mul_to_db(mul) < threshold_db)
+		mul = nextafterf(mul, INFINITY);
+	return mul;
+}
+
 static const char *expander_name(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -190,6 +202,7 @@ static void expander_update(void *data, obs_data_t *s)
 	cd->ratio = (float)obs_data_get_double(s, S_RATIO);
 
 	cd->threshold = (float)obs_data_get_double(s, S_THRESHOLD);
+	cd->threshold_mul = threshold_to_mul(cd->threshold);
 	cd->attack_gain =
 		gain_coefficient(sample_rate, attack_time_ms / MS_IN_S_F);
 	cd->release_gain =
@@ -309,6 +322,7 @@ static inline void process_expansion(struct expander_data *cd, float **samples,
 {
 	const float attack_gain = cd->attack_gain;
 	const float release_gain = cd->release_gain;
+	const float threshold_mul = cd->threshold_mul;
 
 	if (cd->gaindB_len < num_samples)
 		resize_gaindB_buffer(cd, num_samples);
@@ -316,63 +330,57 @@ static inline void process_expansion(struct expander_data *cd, float **samples,
 		memset(cd->gaindB[i], 0,
 		       num_samples * sizeof(cd->gaindB[i][0]));
 
+	/* env_in is free again once the envelope has been analyzed, so it
+	 * holds the linear gain of each sample for the final multiply */
+	float *gain_mul = cd->env_in;
+
 	for (size_t chan = 0; chan < cd->num_channels; chan++) {
+		float prev = cd->gaindB_buf[chan];
+
 		for (size_t i = 0; i < num_samples; ++i) {
-			// gain stage of expansion
-			float env_db = mul_to_db(cd->envelope_buf[chan][i]);
-			float gain =
-				cd->threshold - env_db > 0.0f
-					? fmaxf(cd->slope * (cd->threshold -
-							     env_db),
-						-60.0f)
-					: 0.0f;
-			// ballistics (attack/release)
-			if (i > 0) {
-				if (gain > cd->gaindB[chan][i - 1])
-					cd->gaindB[chan][i] =
-						attack_gain *
-							cd->gaindB[chan][i - 1] +
-						(1.0f - attack_gain) * gain;
-				else
-					cd->gaindB[chan][i] =
-						release_gain *
-							cd->gaindB[chan][i - 1] +
-						(1.0f - release_gain) * gain;
-			} else {
-				if (gain > cd->gaindB_buf[chan])
-					cd->gaindB[chan][i] =
-						attack_gain *
-							cd->gaindB_buf[chan] +
-						(1.0f - attack_gain) * gain;
-				else
-					cd->gaindB[chan][i] =
-						release_gain *
-							cd->gaindB_buf[chan] +
-						(1.0f - release_gain) * gain;
+			// gain stage of expansion, no change at or above
+			// the threshold
+			const float env = cd->envelope_buf[chan][i];
+			float gain = 0.0f;
+
+			if (env < threshold_mul) {
+				const float env_db = mul_to_db(env);
+				const float diff = cd->threshold - env_db;
+				if (diff > 0.0f)
+					gain = fmaxf(cd->slope * diff, -60.0f);
 			}
 
-			gain = db_to_mul(fminf(0, cd->gaindB[chan][i]));
-			if (samples[chan])
-				samples[chan][i] *= gain * cd->output_gain;
+			// ballistics (attack/release)
+			if (gain > prev)
+				prev = attack_gain * prev +
+				       (1.0f - attack_gain) * gain;
+			else
+				prev = release_gain * prev +
+				       (1.0f - release_gain) * gain;
+
+			cd->gaindB[chan][i] = prev;
+			gain_mul[i] = prev < 0.0f ? db_to_mul(prev) *
+							    cd->output_gain
+						  : cd->output_gain;
 		}
-		cd->gaindB_buf[chan] = cd->gaindB[chan][num_samples - 1];
+
+		if (samples[chan])
+			audio_mul_floats(samples[chan], gain_mul,
+					 num_samples);
+		cd->gaindB_buf[chan] = prev;
 	}
 }
 
-static struct obs_audio_data *
-expander_filter_audio(void *data, struct obs_audio_data *audio)
+static void expander_filter_audio_block(void *data, float *planes[],
+					uint32_t frames)
 {
 	struct expander_data *cd = data;
 
-	const uint32_t num_samples = audio->frames;
-	if (num_samples == 0)
-		return audio;
-
-	float **samples = (float **)audio->data;
+	if (frames == 0)
+		return;
 
-	analyze_envelope(cd, samples, num_samples);
-	process_expansion(cd, samples, num_samples);
-	return audio;
+	analyze_envelope(cd, planes, frames);
+	process_expansion(cd, planes, frames);
 }
 
 static bool presets_changed(obs_properties_t *props, obs_property_t *prop,
@@ -433,7 +441,7 @@ struct obs_source_info expander_filter = {
 	.create = expander_create,
 	.destroy = expander_destroy,
 	.update = expander_update,
-	.filter_audio = expander_filter_audio,
+	.filter_audio_block = expander_filter_audio_block,
 	.get_defaults = expander_defaults,
 	.get_properties = expander_properties,
 };
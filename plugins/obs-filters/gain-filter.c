@@ -48,23 +48,17 @@ static void *gain_create(obs_data_t *settings, obs_source_t *filter)
 	return gf;
 }
 
-static struct obs_audio_data *gain_filter_audio(void *data,
-						struct obs_audio_data *audio)
+static void gain_filter_audio_block(void *data, float *planes[],
+				    uint32_t frames)
 {
 	struct gain_data *gf = data;
 	const size_t channels = gf->channels;
-	float **adata = (float **)audio->data;
 	const float multiple = gf->multiple;
 
 	for (size_t c = 0; c < channels; c++) {
-		if (audio->data[c]) {
-			for (size_t i = 0; i < audio->frames; i++) {
-				adata[c][i] *= multiple;
-			}
-		}
+		if (planes[c])
+			audio_scale_floats(planes[c], multiple, frames);
 	}
-
-	return audio;
 }
 
 static void gain_defaults(obs_data_t *s)
@@ -92,7 +86,7 @@ struct obs_source_info gain_filter = {
 	.create = gain_create,
 	.destroy = gain_destroy,
 	.update = gain_update,
-	.filter_audio = gain_filter_audio,
+	.filter_audio_block = gain_filter_audio_block,
 	.get_defaults = gain_defaults,
 	.get_properties = gain_properties,
 };
@@ -1,4 +1,5 @@
 #include <obs-module.h>
+#include <media-io/audio-math.h>
 
 static const char *invert_polarity_name(void *unused)
 {
@@ -17,25 +18,18 @@ static void *invert_polarity_create(obs_data_t *settings, obs_source_t *filter)
 	return filter;
 }
 
-static struct obs_audio_data *
-invert_polarity_filter_audio(void *unused, struct obs_audio_data *audio)
+static void invert_polarity_filter_audio_block(void *unused,
+					       float *planes[],
+					       uint32_t frames)
 {
-	float **adata = (float **)audio->data;
-
 	for (size_t c = 0; c < MAX_AV_PLANES; c++) {
-		register float *channel_data = adata[c];
-		register float *channel_end = channel_data + audio->frames;
-
-		if (!channel_data)
+		if (!planes[c])
 			break;
 
-		while (channel_data < channel_end) {
-			*(channel_data++) *= -1.0f;
-		}
+		audio_scale_floats(planes[c], -1.0f, frames);
 	}
 
 	UNUSED_PARAMETER(unused);
-	return audio;
 }
 
 struct obs_source_info invert_polarity_filter = {
@@ -45,5 +39,5 @@ struct obs_source_info invert_polarity_filter = {
 	.get_name = invert_polarity_name,
 	.create = invert_polarity_create,
 	.destroy = invert_polarity_destroy,
-	.filter_audio = invert_polarity_filter_audio,
+	.filter_audio_block = invert_polarity_filter_audio_block,
 };
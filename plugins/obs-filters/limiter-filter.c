@@ -51,13 +51,14 @@ struct limiter_data {
 	size_t envelope_buf_len;
 
 	float threshold;
+	float threshold_mul;
 	float attack_gain;
 	float release_gain;
 	float output_gain;
 
 	size_t num_channels;
 	size_t sample_rate;
-	float envelope;
+	float envelope[MAX_AUDIO_CHANNELS];
 	float slope;
 };
 
@@ -74,6 +75,17 @@ static inline float gain_coefficient(uint32_t sample_rate, float time)
 	return (float)exp(-1.0f / (sample_rate * time));
 }
 
+/* envelope level up to which mul_to_db() never goes above threshold_db, so
+ * skipping the gain calculation there gives the same output as doing it */
+static float threshold_to_mul(float threshold_db)
+{
+	float mul = db_to_mul(threshold_db);
+
+	while (mul > 0.0f && mul_to_db(mul) > threshold_db)
+		mul = nextafterf(mul, 0.0f);
+	return mul;
+}
+
 static const char *limiter_name(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -94,6 +106,7 @@ static void limiter_update(void *data, obs_data_t *s)
 	const float output_gain_db = 0;
 
 	cd->threshold = (float)obs_data_get_double(s, S_THRESHOLD);
+	cd->threshold_mul = threshold_to_mul(cd->threshold);
 
 	cd->attack_gain =
 		gain_coefficient(sample_rate, attack_time_ms / MS_IN_S_F);
@@ -142,7 +155,7 @@ static void analyze_envelope(struct limiter_data *cd, float **samples,
 			continue;
 
 		float *envelope_buf = cd->envelope_buf;
-		float env = cd->envelope;
+		float env = cd->envelope[chan];
 		for (uint32_t i = 0; i < num_samples; ++i) {
 			const float env_in = fabsf(samples[chan][i]);
 			if (env < env_in) {
@@ -152,39 +165,51 @@ static void analyze_envelope(struct limiter_data *cd, float **samples,
 			}
 			envelope_buf[i] = fmaxf(envelope_buf[i], env);
 		}
+
+		/* each channel picks up from its own envelope, so the output
+		 * doesn't depend on how the audio is split into slices */
+		cd->envelope[chan] = env;
 	}
-	cd->envelope = cd->envelope_buf[num_samples - 1];
 }
 
 static inline void process_compression(const struct limiter_data *cd,
 				       float **samples, uint32_t num_samples)
 {
-	for (size_t i = 0; i < num_samples; ++i) {
-		const float env_db = mul_to_db(cd->envelope_buf[i]);
-		float gain = cd->slope * (cd->threshold - env_db);
-		gain = db_to_mul(fminf(0, gain));
+	const float threshold_mul = cd->threshold_mul;
+	float *gain_buf = cd->envelope_buf;
 
-		for (size_t c = 0; c < cd->num_channels; ++c) {
-			if (samples[c]) {
-				samples[c][i] *= gain * cd->output_gain;
-			}
+	/* turn the envelope into the gain of each sample, then apply it to
+	 * every channel in one vectorized pass */
+	for (size_t i = 0; i < num_samples; ++i) {
+		const float env = cd->envelope_buf[i];
+		float gain = cd->output_gain;
+
+		/* no reduction at or below the threshold */
+		if (env > threshold_mul) {
+			const float env_db = mul_to_db(env);
+			gain *= db_to_mul(
+				fminf(0, cd->slope * (cd->threshold - env_db)));
 		}
+
+		gain_buf[i] = gain;
+	}
+
+	for (size_t c = 0; c < cd->num_channels; ++c) {
+		if (samples[c])
+			audio_mul_floats(samples[c], gain_buf, num_samples);
 	}
 }
 
-static struct obs_audio_data *limiter_filter_audio(void *data,
-						   struct obs_audio_data *audio)
+static void limiter_filter_audio_block(void *data, float *planes[],
+				       uint32_t frames)
 {
 	struct limiter_data *cd = data;
 
-	const uint32_t num_samples = audio->frames;
-	if (num_samples == 0)
-		return audio;
+	if (frames == 0)
+		return;
 
-	float **samples = (float **)audio->data;
-	analyze_envelope(cd, samples, num_samples);
-	process_compression(cd, samples, num_samples);
-	return audio;
+	analyze_envelope(cd, planes, frames);
+	process_compression(cd, planes, frames);
 }
 
 static void limiter_defaults(obs_data_t *s)
@@ -219,7 +244,7 @@ struct obs_source_info limiter_filter = {
 	.create = limiter_create,
 	.destroy = limiter_destroy,
 	.update = limiter_update,
-	.filter_audio = limiter_filter_audio,
+	.filter_audio_block = limiter_filter_audio_block,
 	.get_defaults = limiter_defaults,
 	.get_properties = limiter_properties,
 };
@@ -243,6 +243,7 @@ static void mask_filter_tick(void *data, float seconds)
 
 		if (filter->image_file_timestamp != t) {
 			mask_filter_image_load(filter);
+			obs_source_mark_video_dirty(filter->context);
 		}
 	}
 
@@ -258,6 +259,7 @@ static void mask_filter_tick(void *data, float seconds)
 		gs_image_file_update_texture(&filter->image);
 		obs_leave_graphics();
 
+		obs_source_mark_video_dirty(filter->context);
 		filter->last_time = cur_time;
 	}
 }
@@ -334,7 +336,8 @@ static void mask_filter_render(void *data, gs_effect_t *effect)
 struct obs_source_info mask_filter = {
 	.id = "mask_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE |
+			OBS_SOURCE_STATIC_VIDEO,
 	.get_name = mask_filter_get_name,
 	.create = mask_filter_create,
 	.destroy = mask_filter_destroy,
@@ -349,7 +352,8 @@ struct obs_source_info mask_filter_v2 = {
 	.id = "mask_filter",
 	.version = 2,
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			OBS_SOURCE_STATIC_VIDEO,
 	.get_name = mask_filter_get_name,
 	.create = mask_filter_create,
 	.destroy = mask_filter_destroy,
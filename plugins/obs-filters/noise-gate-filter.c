@@ -108,12 +108,13 @@ static void *noise_gate_create(obs_data_t *settings, obs_source_t *filter)
 	return ng;
 }
 
-static struct obs_audio_data *
-noise_gate_filter_audio(void *data, struct obs_audio_data *audio)
-{
-	struct noise_gate_data *ng = data;
+/* the gate runs over a block this size at a time, with the level and the
+ * attenuation of each sample kept on the stack */
+#define GATE_CHUNK_FRAMES 256
 
-	float **adata = (float **)audio->data;
+static void noise_gate_process(struct noise_gate_data *ng, float *planes[],
+			       uint32_t frames)
+{
 	const float close_threshold = ng->close_threshold;
 	const float open_threshold = ng->open_threshold;
 	const float sample_rate_i = ng->sample_rate_i;
@@ -122,12 +123,17 @@ noise_gate_filter_audio(void *data, struct obs_audio_data *audio)
 	const float decay_rate = ng->decay_rate;
 	const float hold_time = ng->hold_time;
 	const size_t channels = ng->channels;
+	float level[GATE_CHUNK_FRAMES];
+	float attenuation[GATE_CHUNK_FRAMES];
 
-	for (size_t i = 0; i < audio->frames; i++) {
-		float cur_level = fabsf(adata[0][i]);
-		for (size_t j = 0; j < channels; j++) {
-			cur_level = fmaxf(cur_level, fabsf(adata[j][i]));
-		}
+	memset(level, 0, frames * sizeof(float));
+	for (size_t c = 0; c < channels; c++) {
+		if (planes[c])
+			audio_max_abs_floats(level, planes[c], frames);
+	}
+
+	for (size_t i = 0; i < frames; i++) {
+		float cur_level = level[i];
 
 		if (cur_level > open_threshold && !ng->is_open) {
 			ng->is_open = true;
@@ -150,11 +156,31 @@ noise_gate_filter_audio(void *data, struct obs_audio_data *audio)
 			}
 		}
 
-		for (size_t c = 0; c < channels; c++)
-			adata[c][i] *= ng->attenuation;
+		attenuation[i] = ng->attenuation;
 	}
 
-	return audio;
+	for (size_t c = 0; c < channels; c++) {
+		if (planes[c])
+			audio_mul_floats(planes[c], attenuation, frames);
+	}
+}
+
+static void noise_gate_filter_audio_block(void *data, float *planes[],
+					  uint32_t frames)
+{
+	struct noise_gate_data *ng = data;
+	float *chunk[MAX_AV_PLANES];
+
+	for (uint32_t pos = 0; pos < frames; pos += GATE_CHUNK_FRAMES) {
+		uint32_t count = frames - pos;
+		if (count > GATE_CHUNK_FRAMES)
+			count = GATE_CHUNK_FRAMES;
+
+		for (size_t c = 0; c < MAX_AV_PLANES; c++)
+			chunk[c] = planes[c] ? planes[c] + pos : NULL;
+
+		noise_gate_process(ng, chunk, count);
+	}
 }
 
 static void noise_gate_defaults(obs_data_t *s)
@@ -201,7 +227,7 @@ struct obs_source_info noise_gate_filter = {
 	.create = noise_gate_create,
 	.destroy = noise_gate_destroy,
 	.update = noise_gate_update,
-	.filter_audio = noise_gate_filter_audio,
+	.filter_audio_block = noise_gate_filter_audio_block,
 	.get_defaults = noise_gate_defaults,
 	.get_properties = noise_gate_properties,
 };
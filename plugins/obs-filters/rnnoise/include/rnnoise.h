@@ -61,6 +61,12 @@ RNNOISE_EXPORT void rnnoise_destroy(DenoiseState *st);
 
 RNNOISE_EXPORT float rnnoise_process_frame(DenoiseState *st, float *out, const float *in);
 
+/* Processes one frame for each of count states, running the network for
+ * all of them together.  Each in may be the same buffer as its out.  vad
+ * receives count voice probabilities and may be NULL. */
+#define RNNOISE_HAS_PROCESS_FRAMES 1
+RNNOISE_EXPORT void rnnoise_process_frames(DenoiseState *const *st, float *const *out, const float *const *in, float *vad, int count);
+
 RNNOISE_EXPORT RNNModel *rnnoise_model_from_file(FILE *f);
 
 RNNOISE_EXPORT void rnnoise_model_free(RNNModel *model);
@@ -85,6 +85,18 @@ typedef struct {
   float dct_table[NB_BANDS*NB_BANDS];
 } CommonState;
 
+/* One analysed frame, kept between computing its features and applying the
+   gains so that the frames of several states can go through the network
+   together */
+typedef struct {
+  kiss_fft_cpx X[FREQ_SIZE];
+  kiss_fft_cpx P[WINDOW_SIZE];
+  float Ex[NB_BANDS], Ep[NB_BANDS];
+  float Exp[NB_BANDS];
+  float features[NB_FEATURES];
+  int silence;
+} FrameAnalysis;
+
 struct DenoiseState {
   float analysis_mem[FRAME_SIZE];
   float cepstral_mem[CEPS_MEM][NB_BANDS];
@@ -97,6 +109,7 @@ struct DenoiseState {
   float mem_hp_x[2];
   float lastg[NB_BANDS];
   RNNState rnn;
+  FrameAnalysis frame;
 };
 
 void compute_band_energy(float *bandE, const kiss_fft_cpx *X) {
@@ -453,26 +466,22 @@ void pitch_filter(kiss_fft_cpx *X, const kiss_fft_cpx *P, const float *Ex, const
   }
 }
 
-float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
-  int i;
-  kiss_fft_cpx X[FREQ_SIZE];
-  kiss_fft_cpx P[WINDOW_SIZE];
+static void process_frame_begin(DenoiseState *st, const float *in) {
+  FrameAnalysis *f = &st->frame;
   float x[FRAME_SIZE];
-  float Ex[NB_BANDS], Ep[NB_BANDS];
-  float Exp[NB_BANDS];
-  float features[NB_FEATURES];
-  float g[NB_BANDS];
-  float gf[FREQ_SIZE]={1};
-  float vad_prob = 0;
-  int silence;
   static const float a_hp[2] = {-1.99599f, 0.99600f};
   static const float b_hp[2] = {-2, 1};
   biquad(x, st->mem_hp_x, in, b_hp, a_hp, FRAME_SIZE);
-  silence = compute_frame_features(st, X, P, Ex, Ep, Exp, features, x);
+  f->silence = compute_frame_features(st, f->X, f->P, f->Ex, f->Ep, f->Exp, f->features, x);
+}
 
-  if (!silence) {
-    compute_rnn(&st->rnn, g, &vad_prob, features);
-    pitch_filter(X, P, Ex, Ep, Exp, g);
+static void process_frame_end(DenoiseState *st, float *out, float *g) {
+  FrameAnalysis *f = &st->frame;
+  int i;
+  float gf[FREQ_SIZE]={1};
+
+  if (!f->silence) {
+    pitch_filter(f->X, f->P, f->Ex, f->Ep, f->Exp, g);
     for (i=0;i<NB_BANDS;i++) {
       float alpha = .6f;
       g[i] = MAX16(g[i], alpha*st->lastg[i]);
@@ -481,16 +490,72 @@ float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
     interp_band_gain(gf, g);
 #if 1
     for (i=0;i<FREQ_SIZE;i++) {
-      X[i].r *= gf[i];
-      X[i].i *= gf[i];
+      f->X[i].r *= gf[i];
+      f->X[i].i *= gf[i];
     }
 #endif
   }
 
-  frame_synthesis(st, out, X);
+  frame_synthesis(st, out, f->X);
+}
+
+float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
+  float g[NB_BANDS];
+  float vad_prob = 0;
+
+  process_frame_begin(st, in);
+  if (!st->frame.silence)
+    compute_rnn(&st->rnn, g, &vad_prob, st->frame.features);
+  process_frame_end(st, out, g);
   return vad_prob;
 }
 
+void rnnoise_process_frames(DenoiseState *const *st, float *const *out, const float *const *in, float *vad, int count) {
+  int i, j;
+
+  while (count > 0) {
+    int batch = count < RNN_MAX_BATCH ? count : RNN_MAX_BATCH;
+    int active = 0;
+    RNNState *rnn[RNN_MAX_BATCH];
+    const float *features[RNN_MAX_BATCH];
+    float g[RNN_MAX_BATCH][NB_BANDS];
+    float *gains[RNN_MAX_BATCH];
+    float vad_prob[RNN_MAX_BATCH] = {0};
+
+    /* all frames have to be read before any is written, as out may be in */
+    for (i=0;i<batch;i++)
+      process_frame_begin(st[i], in[i]);
+
+    /* silent frames skip the network, as in rnnoise_process_frame() */
+    for (i=0;i<batch;i++) {
+      if (st[i]->frame.silence)
+        continue;
+      rnn[active] = &st[i]->rnn;
+      features[active] = st[i]->frame.features;
+      gains[active] = g[i];
+      active++;
+    }
+    if (active)
+      compute_rnn_batch(rnn, active, gains, vad_prob, features);
+
+    for (i=0,j=0;i<batch;i++) {
+      float v = 0;
+      if (!st[i]->frame.silence)
+        v = vad_prob[j++];
+      process_frame_end(st[i], out[i], g[i]);
+      if (vad)
+        vad[i] = v;
+    }
+
+    st += batch;
+    out += batch;
+    in += batch;
+    if (vad)
+      vad += batch;
+    count -= batch;
+  }
+}
+
 #if TRAINING
 
 static float uni_rand() {
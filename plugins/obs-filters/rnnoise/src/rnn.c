@@ -37,6 +37,25 @@
 #include "rnn.h"
 #include "rnn_data.h"
 #include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RNN_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+     defined(_M_IX86)) && !defined(__e2k__) && \
+    !(defined(_M_ARM64) || defined(_M_ARM64EC))
+#define RNN_HAVE_AVX2
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+void rnn_accumulate_avx2(float *const *sums, int count,
+      const rnn_weight *weights, int stride, int start, int N,
+      const float *const *x, const float *const *x2, int M);
+#endif
 
 static OPUS_INLINE float tansig_approx(float x)
 {
@@ -157,7 +176,7 @@ static void compute_gru(const GRULayer *gru, float *state, const float *input)
 
 #define INPUT_SIZE 42
 
-void compute_rnn(RNNState *rnn, float *gains, float *vad, const float *input) {
+void compute_rnn_reference(RNNState *rnn, float *gains, float *vad, const float *input) {
   int i;
   float dense_out[MAX_NEURONS];
   float noise_input[MAX_NEURONS*3];
@@ -176,3 +195,266 @@ void compute_rnn(RNNState *rnn, float *gains, float *vad, const float *input) {
   compute_gru(rnn->model->denoise_gru, rnn->denoise_gru_state, denoise_input);
   compute_dense(rnn->model->denoise_output, gains, rnn->denoise_gru_state);
 }
+
+void rnn_accumulate_c(float *const *sums, int count,
+      const rnn_weight *weights, int stride, int start, int N,
+      const float *const *x, const float *const *x2, int M)
+{
+   int c, i, j;
+   for (c=0;c<count;c++)
+   {
+      for (i=start;i<N;i++)
+      {
+         float sum = sums[c][i];
+         if (x2) {
+            for (j=0;j<M;j++)
+               sum += weights[j*stride + i]*x[c][j]*x2[c][j];
+         } else {
+            for (j=0;j<M;j++)
+               sum += weights[j*stride + i]*x[c][j];
+         }
+         sums[c][i] = sum;
+      }
+   }
+}
+
+#ifdef RNN_HAVE_SSE2
+/* Sign-extends four weights to floats with plain SSE2 */
+static OPUS_INLINE __m128 load_weights_sse2(const rnn_weight *w)
+{
+   int packed;
+   __m128i v;
+   memcpy(&packed, w, sizeof(packed));
+   v = _mm_cvtsi32_si128(packed);
+   v = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+   v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+   return _mm_cvtepi32_ps(v);
+}
+
+/* Four neurons at a time, with every state of the batch sharing each load
+   of the weights */
+static void rnn_accumulate_sse2(float *const *sums, int count,
+      const rnn_weight *weights, int stride, int start, int N,
+      const float *const *x, const float *const *x2, int M)
+{
+   int c, i, j;
+   for (i=start;i+4<=N;i+=4)
+   {
+      __m128 acc[RNN_MAX_BATCH];
+      for (c=0;c<count;c++)
+         acc[c] = _mm_loadu_ps(sums[c] + i);
+      if (x2) {
+         for (j=0;j<M;j++)
+         {
+            __m128 w = load_weights_sse2(weights + j*stride + i);
+            for (c=0;c<count;c++)
+               acc[c] = _mm_add_ps(acc[c], _mm_mul_ps(_mm_mul_ps(w,
+                     _mm_set1_ps(x[c][j])), _mm_set1_ps(x2[c][j])));
+         }
+      } else {
+         for (j=0;j<M;j++)
+         {
+            __m128 w = load_weights_sse2(weights + j*stride + i);
+            for (c=0;c<count;c++)
+               acc[c] = _mm_add_ps(acc[c],
+                     _mm_mul_ps(w, _mm_set1_ps(x[c][j])));
+         }
+      }
+      for (c=0;c<count;c++)
+         _mm_storeu_ps(sums[c] + i, acc[c]);
+   }
+   if (i < N)
+      rnn_accumulate_c(sums, count, weights, stride, i, N, x, x2, M);
+}
+#endif
+
+#ifdef RNN_HAVE_AVX2
+static int cpu_has_avx2_fma(void)
+{
+#ifdef _MSC_VER
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < 7)
+      return 0;
+   /* FMA, OSXSAVE and AVX, and the OS must save the AVX registers */
+   __cpuid(info, 1);
+   if ((info[2] & (1 << 12)) == 0 || (info[2] & (1 << 27)) == 0 ||
+       (info[2] & (1 << 28)) == 0)
+      return 0;
+   if ((_xgetbv(0) & 0x6) != 0x6)
+      return 0;
+   __cpuidex(info, 7, 0);
+   return (info[1] & (1 << 5)) != 0;
+#else
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+static rnn_accumulate_func rnn_accumulate = NULL;
+
+int rnn_set_isa(int isa)
+{
+   switch (isa) {
+   case RNN_ISA_C:
+      rnn_accumulate = rnn_accumulate_c;
+      return 1;
+#ifdef RNN_HAVE_SSE2
+   case RNN_ISA_SSE2:
+      rnn_accumulate = rnn_accumulate_sse2;
+      return 1;
+#endif
+#ifdef RNN_HAVE_AVX2
+   case RNN_ISA_AVX2:
+      if (!cpu_has_avx2_fma())
+         return 0;
+      rnn_accumulate = rnn_accumulate_avx2;
+      return 1;
+#endif
+   default:
+      return 0;
+   }
+}
+
+static rnn_accumulate_func get_accumulate(void)
+{
+   /* racing threads all pick the same kernel, so this is harmless */
+   if (!rnn_accumulate) {
+      if (!rnn_set_isa(RNN_ISA_AVX2) && !rnn_set_isa(RNN_ISA_SSE2))
+         rnn_set_isa(RNN_ISA_C);
+   }
+   return rnn_accumulate;
+}
+
+static OPUS_INLINE float activate(int activation, float x)
+{
+   if (activation == ACTIVATION_SIGMOID) return sigmoid_approx(x);
+   else if (activation == ACTIVATION_TANH) return tansig_approx(x);
+   else if (activation == ACTIVATION_RELU) return relu(x);
+   *(int*)0=0;
+   return 0;
+}
+
+static void compute_dense_batch(const DenseLayer *layer, int count,
+      float *const *output, const float *const *input)
+{
+   rnn_accumulate_func accumulate = get_accumulate();
+   int c, i;
+   int N = layer->nb_neurons;
+   for (c=0;c<count;c++)
+      for (i=0;i<N;i++)
+         output[c][i] = layer->bias[i];
+   accumulate(output, count, layer->input_weights, N, 0, N, input, NULL,
+         layer->nb_inputs);
+   for (c=0;c<count;c++)
+      for (i=0;i<N;i++)
+         output[c][i] = activate(layer->activation, WEIGHTS_SCALE*output[c][i]);
+}
+
+static void compute_gru_batch(const GRULayer *gru, int count,
+      float *const *state, const float *const *input)
+{
+   rnn_accumulate_func accumulate = get_accumulate();
+   int c, i;
+   int N = gru->nb_neurons;
+   int stride = 3*N;
+   /* update gate, reset gate and output sums, in the order of the weights */
+   float zrh[RNN_MAX_BATCH][3*MAX_NEURONS];
+   float *sums[RNN_MAX_BATCH];
+   float *r[RNN_MAX_BATCH];
+   float *h[RNN_MAX_BATCH];
+
+   for (c=0;c<count;c++)
+   {
+      sums[c] = zrh[c];
+      r[c] = zrh[c] + N;
+      h[c] = zrh[c] + 2*N;
+      for (i=0;i<stride;i++)
+         zrh[c][i] = gru->bias[i];
+   }
+
+   /* all three gates see the same input, and the update and reset gates
+      the same state */
+   accumulate(sums, count, gru->input_weights, stride, 0, stride, input,
+         NULL, gru->nb_inputs);
+   accumulate(sums, count, gru->recurrent_weights, stride, 0, 2*N,
+         (const float *const *)state, NULL, N);
+   for (c=0;c<count;c++)
+      for (i=0;i<2*N;i++)
+         zrh[c][i] = sigmoid_approx(WEIGHTS_SCALE*zrh[c][i]);
+
+   accumulate(h, count, gru->recurrent_weights + 2*N, stride, 0, N,
+         (const float *const *)state, (const float *const *)r, N);
+   for (c=0;c<count;c++)
+   {
+      for (i=0;i<N;i++)
+      {
+         float z = zrh[c][i];
+         float sum = activate(gru->activation, WEIGHTS_SCALE*h[c][i]);
+         state[c][i] = z*state[c][i] + (1-z)*sum;
+      }
+   }
+}
+
+void compute_rnn_batch(RNNState *const *rnn, int count, float *const *gains,
+      float *vad, const float *const *input) {
+  int c, i;
+  const RNNModel *model;
+  float dense_out[RNN_MAX_BATCH][MAX_NEURONS];
+  float noise_input[RNN_MAX_BATCH][MAX_NEURONS*3];
+  float denoise_input[RNN_MAX_BATCH][MAX_NEURONS*3];
+  float *dense[RNN_MAX_BATCH];
+  float *noise[RNN_MAX_BATCH];
+  float *denoise[RNN_MAX_BATCH];
+  float *vad_state[RNN_MAX_BATCH];
+  float *noise_state[RNN_MAX_BATCH];
+  float *denoise_state[RNN_MAX_BATCH];
+  float *vad_out[RNN_MAX_BATCH];
+
+  while (count > RNN_MAX_BATCH) {
+    compute_rnn_batch(rnn, RNN_MAX_BATCH, gains, vad, input);
+    rnn += RNN_MAX_BATCH;
+    gains += RNN_MAX_BATCH;
+    vad += RNN_MAX_BATCH;
+    input += RNN_MAX_BATCH;
+    count -= RNN_MAX_BATCH;
+  }
+  if (count <= 0)
+    return;
+
+  /* every state of a batch must share the same model */
+  model = rnn[0]->model;
+  for (c=0;c<count;c++) {
+    celt_assert(rnn[c]->model == model);
+    dense[c] = dense_out[c];
+    noise[c] = noise_input[c];
+    denoise[c] = denoise_input[c];
+    vad_state[c] = rnn[c]->vad_gru_state;
+    noise_state[c] = rnn[c]->noise_gru_state;
+    denoise_state[c] = rnn[c]->denoise_gru_state;
+    vad_out[c] = vad + c;
+  }
+
+  compute_dense_batch(model->input_dense, count, dense, input);
+  compute_gru_batch(model->vad_gru, count, vad_state, (const float *const *)dense);
+  compute_dense_batch(model->vad_output, count, vad_out, (const float *const *)vad_state);
+  for (c=0;c<count;c++) {
+    for (i=0;i<model->input_dense_size;i++) noise_input[c][i] = dense_out[c][i];
+    for (i=0;i<model->vad_gru_size;i++) noise_input[c][i+model->input_dense_size] = vad_state[c][i];
+    for (i=0;i<INPUT_SIZE;i++) noise_input[c][i+model->input_dense_size+model->vad_gru_size] = input[c][i];
+  }
+  compute_gru_batch(model->noise_gru, count, noise_state, (const float *const *)noise);
+
+  for (c=0;c<count;c++) {
+    for (i=0;i<model->vad_gru_size;i++) denoise_input[c][i] = vad_state[c][i];
+    for (i=0;i<model->noise_gru_size;i++) denoise_input[c][i+model->vad_gru_size] = noise_state[c][i];
+    for (i=0;i<INPUT_SIZE;i++) denoise_input[c][i+model->vad_gru_size+model->noise_gru_size] = input[c][i];
+  }
+  compute_gru_batch(model->denoise_gru, count, denoise_state, (const float *const *)denoise);
+  compute_dense_batch(model->denoise_output, count, gains, (const float *const *)denoise_state);
+}
+
+void compute_rnn(RNNState *rnn, float *gains, float *vad, const float *input) {
+  compute_rnn_batch(&rnn, 1, &gains, vad, &input);
+}
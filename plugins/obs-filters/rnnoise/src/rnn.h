@@ -60,6 +60,40 @@ typedef struct {
 
 typedef struct RNNState RNNState;
 
+/* Largest number of states compute_rnn_batch() runs through the network
+   together.  Larger batches are split up. */
+#define RNN_MAX_BATCH 8
+
+#define RNN_ISA_C    0
+#define RNN_ISA_SSE2 1
+#define RNN_ISA_AVX2 2
+
+/* Adds weights[j*stride + i]*x[c][j] (times x2[c][j] when x2 is not NULL)
+   to sums[c][i] for i in [start, N), j in [0, M) and c in [0, count).  The
+   terms of each sum are added in order of j, so the SIMD kernels give the
+   same results as the scalar reference, except for FMA contraction. */
+typedef void (*rnn_accumulate_func)(float *const *sums, int count,
+      const rnn_weight *weights, int stride, int start, int N,
+      const float *const *x, const float *const *x2, int M);
+
+void rnn_accumulate_c(float *const *sums, int count,
+      const rnn_weight *weights, int stride, int start, int N,
+      const float *const *x, const float *const *x2, int M);
+
+/* Selects the kernel used by compute_rnn() and compute_rnn_batch(), returns
+   0 if the CPU doesn't support it.  The best supported one is used by
+   default. */
+int rnn_set_isa(int isa);
+
 void compute_rnn(RNNState *rnn, float *gains, float *vad, const float *input);
 
+/* Runs count states through the network at once, so each weight is only
+   loaded once per batch rather than once per state. */
+void compute_rnn_batch(RNNState *const *rnn, int count, float *const *gains,
+      float *vad, const float *const *input);
+
+/* The original scalar implementation, used as a reference in tests */
+void compute_rnn_reference(RNNState *rnn, float *gains, float *vad,
+      const float *input);
+
 #endif /* _MLP_H_ */
@@ -0,0 +1,91 @@
+/* Copyright (c) 2023 agent <agent@local> */
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* AVX2/FMA version of the rnn_accumulate_sse2() kernel in rnn.c.  Kept in
+   its own file so the rest of RNNoise doesn't get built for AVX2, and only
+   called once rnn.c has checked that the CPU supports it. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "opus_types.h"
+#include "common.h"
+#include "rnn.h"
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+     defined(_M_IX86)) && !defined(__e2k__) && \
+    !(defined(_M_ARM64) || defined(_M_ARM64EC))
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define AVX2_FUNC
+#else
+#define AVX2_FUNC __attribute__((target("avx2,fma")))
+#endif
+
+/* Eight neurons at a time; the sums of each are still built up in order of
+   the inputs, but with fused multiply-adds they are rounded once per term
+   rather than twice. */
+AVX2_FUNC void rnn_accumulate_avx2(float *const *sums, int count,
+      const rnn_weight *weights, int stride, int start, int N,
+      const float *const *x, const float *const *x2, int M)
+{
+   int c, i, j;
+   for (i=start;i+8<=N;i+=8)
+   {
+      __m256 acc[RNN_MAX_BATCH];
+      for (c=0;c<count;c++)
+         acc[c] = _mm256_loadu_ps(sums[c] + i);
+      if (x2) {
+         for (j=0;j<M;j++)
+         {
+            __m256 w = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+                  _mm_loadl_epi64((const __m128i *)(weights + j*stride + i))));
+            for (c=0;c<count;c++)
+               acc[c] = _mm256_fmadd_ps(
+                     _mm256_mul_ps(w, _mm256_set1_ps(x[c][j])),
+                     _mm256_set1_ps(x2[c][j]), acc[c]);
+         }
+      } else {
+         for (j=0;j<M;j++)
+         {
+            __m256 w = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+                  _mm_loadl_epi64((const __m128i *)(weights + j*stride + i))));
+            for (c=0;c<count;c++)
+               acc[c] = _mm256_fmadd_ps(w, _mm256_set1_ps(x[c][j]),
+                     acc[c]);
+         }
+      }
+      for (c=0;c<count;c++)
+         _mm256_storeu_ps(sums[c] + i, acc[c]);
+   }
+   if (i < N)
+      rnn_accumulate_c(sums, count, weights, stride, i, N, x, x2, M);
+}
+
+#endif
@@ -173,10 +173,26 @@ void flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 static int32_t last_time = 0;
 #endif
 
+/* the extra bytes in front of the packet data in video and audio tags */
+static void flv_video_body_header(struct serializer *s,
+				  struct encoder_packet *packet, bool is_header)
+{
+	int64_t offset = packet->pts - packet->dts;
+
+	s_w8(s, packet->keyframe ? 0x17 : 0x27);
+	s_w8(s, is_header ? 0 : 1);
+	s_wb24(s, get_ms_time(packet, offset));
+}
+
+static void flv_audio_body_header(struct serializer *s, bool is_header)
+{
+	s_w8(s, 0xaf);
+	s_w8(s, is_header ? 0 : 1);
+}
+
 static void flv_video(struct serializer *s, int32_t dts_offset,
 		      struct encoder_packet *packet, bool is_header)
 {
-	int64_t offset = packet->pts - packet->dts;
 	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
 
 	if (!packet->data || !packet->size)
@@ -198,10 +214,7 @@ static void flv_video(struct serializer *s, int32_t dts_offset,
 	s_w8(s, (time_ms >> 24) & 0x7F);
 	s_wb24(s, 0);
 
-	/* these are the 5 extra bytes mentioned above */
-	s_w8(s, packet->keyframe ? 0x17 : 0x27);
-	s_w8(s, is_header ? 0 : 1);
-	s_wb24(s, get_ms_time(packet, offset));
+	flv_video_body_header(s, packet, is_header);
 	s_write(s, packet->data, packet->size);
 
 	/* write tag size (starting byte doesn't count) */
@@ -232,9 +245,7 @@ static void flv_audio(struct serializer *s, int32_t dts_offset,
 	s_w8(s, (time_ms >> 24) & 0x7F);
 	s_wb24(s, 0);
 
-	/* these are the two extra bytes mentioned above */
-	s_w8(s, 0xaf);
-	s_w8(s, is_header ? 0 : 1);
+	flv_audio_body_header(s, is_header);
 	s_write(s, packet->data, packet->size);
 
 	/* write tag size (starting byte doesn't count) */
@@ -414,6 +425,33 @@ static inline void s_u29b_value(struct serializer *s, uint32_t val)
 	s_u29(s, 1 | ((val & 0xFFFFFFF) << 1));
 }
 
+/* everything in front of the packet data, which is followed by the end of the
+ * object */
+static void flv_additional_audio_body_header(struct serializer *s,
+					     struct encoder_packet *packet,
+					     bool is_header)
+{
+	s_w8(s, AMF_STRING);
+	s_amf_conststring(s, "additionalMedia");
+
+	s_w8(s, AMF_OBJECT);
+	{
+		s_amf_conststring(s, "id");
+
+		s_w8(s, AMF_STRING);
+		s_amf_conststring(s, "stream0");
+
+		/* ----- */
+
+		s_amf_conststring(s, "media");
+
+		s_w8(s, AMF_AVMPLUS);
+		s_w8(s, AMF3_BYTE_ARRAY);
+		s_u29b_value(s, (uint32_t)packet->size + 2);
+		flv_audio_body_header(s, is_header);
+	}
+}
+
 static void flv_build_additional_audio(uint8_t **data, size_t *size,
 				       struct encoder_packet *packet,
 				       bool is_header, size_t index)
@@ -424,27 +462,8 @@ static void flv_build_additional_audio(uint8_t **data, size_t *size,
 
 	array_output_serializer_init(&s, &out);
 
-	s_w8(&s, AMF_STRING);
-	s_amf_conststring(&s, "additionalMedia");
-
-	s_w8(&s, AMF_OBJECT);
-	{
-		s_amf_conststring(&s, "id");
-
-		s_w8(&s, AMF_STRING);
-		s_amf_conststring(&s, "stream0");
-
-		/* ----- */
-
-		s_amf_conststring(&s, "media");
-
-		s_w8(&s, AMF_AVMPLUS);
-		s_w8(&s, AMF3_BYTE_ARRAY);
-		s_u29b_value(&s, (uint32_t)packet->size + 2);
-		s_w8(&s, 0xaf);
-		s_w8(&s, is_header ? 0 : 1);
-		s_write(&s, packet->data, packet->size);
-	}
+	flv_additional_audio_body_header(&s, packet, is_header);
+	s_write(&s, packet->data, packet->size);
 	s_wb24(&s, AMF_OBJECT_END);
 
 	*data = out.bytes.array;
@@ -505,3 +524,84 @@ void flv_additional_packet_mux(struct encoder_packet *packet,
 	*data = out.bytes.array;
 	*size = out.bytes.num;
 }
+
+/* ------------------------------------------------------------------------- */
+/* tag bodies for sending packet data in place                               */
+
+struct tag_part_output {
+	uint8_t *data;
+	size_t capacity;
+	size_t size;
+};
+
+static size_t tag_part_write(void *param, const void *data, size_t size)
+{
+	struct tag_part_output *out = param;
+
+	if (size > out->capacity - out->size)
+		size = out->capacity - out->size;
+
+	memcpy(out->data + out->size, data, size);
+	out->size += size;
+	return size;
+}
+
+static int64_t tag_part_get_pos(void *param)
+{
+	struct tag_part_output *out = param;
+	return (int64_t)out->size;
+}
+
+static void tag_part_serializer_init(struct serializer *s,
+				     struct tag_part_output *out, uint8_t *data,
+				     size_t capacity)
+{
+	out->data = data;
+	out->capacity = capacity;
+	out->size = 0;
+
+	memset(s, 0, sizeof(*s));
+	s->data = out;
+	s->write = tag_part_write;
+	s->get_pos = tag_part_get_pos;
+}
+
+bool flv_packet_tag(struct encoder_packet *packet, int32_t dts_offset,
+		    bool is_header, size_t index, struct flv_tag *tag)
+{
+	struct tag_part_output out;
+	struct serializer s;
+
+	if (!packet->data || !packet->size)
+		return false;
+
+	tag->time_ms = get_ms_time(packet, packet->dts) - dts_offset;
+	tag->footer_size = 0;
+
+	tag_part_serializer_init(&s, &out, tag->header, sizeof(tag->header));
+
+	if (index > 0) {
+		if (packet->type == OBS_ENCODER_VIDEO)
+			bcrash("who said you could output an additional "
+			       "video packet?");
+
+		tag->type = RTMP_PACKET_TYPE_INFO;
+		flv_additional_audio_body_header(&s, packet, is_header);
+
+		tag->footer[0] = 0;
+		tag->footer[1] = 0;
+		tag->footer[2] = AMF_OBJECT_END;
+		tag->footer_size = 3;
+
+	} else if (packet->type == OBS_ENCODER_VIDEO) {
+		tag->type = RTMP_PACKET_TYPE_VIDEO;
+		flv_video_body_header(&s, packet, is_header);
+
+	} else {
+		tag->type = RTMP_PACKET_TYPE_AUDIO;
+		flv_audio_body_header(&s, is_header);
+	}
+
+	tag->header_size = out.size;
+	return true;
+}
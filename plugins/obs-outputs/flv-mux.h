@@ -20,12 +20,25 @@
 #include <obs.h>
 
 #define MILLISECOND_DEN 1000
+#define FLV_TAG_HEADER_SIZE 11
 
 static int32_t get_ms_time(struct encoder_packet *packet, int64_t val)
 {
 	return (int32_t)(val * MILLISECOND_DEN / packet->timebase_den);
 }
 
+/* An FLV tag with the packet data left out of its body, so that the data can
+ * be sent straight from the packet.  The body is the header, the packet data
+ * and then the footer. */
+struct flv_tag {
+	uint8_t type;
+	int32_t time_ms;
+	uint8_t header[64];
+	size_t header_size;
+	uint8_t footer[3];
+	size_t footer_size;
+};
+
 extern void write_file_info(FILE *file, int64_t duration_ms, int64_t size);
 
 extern void flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
@@ -38,3 +51,5 @@ extern void flv_additional_packet_mux(struct encoder_packet *packet,
 				      int32_t dts_offset, uint8_t **output,
 				      size_t *size, bool is_header,
 				      size_t index);
+extern bool flv_packet_tag(struct encoder_packet *packet, int32_t dts_offset,
+			   bool is_header, size_t index, struct flv_tag *tag);
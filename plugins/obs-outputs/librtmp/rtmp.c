@@ -4063,18 +4063,15 @@ RTMP_SendChunk(RTMP *r, RTMPChunk *chunk)
     return wrote;
 }
 
-int
-RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+/* grows the table of the last packet sent on each channel to hold the
+ * packet's channel, and compresses the packet's header against the last one
+ * sent on it.  returns FALSE if the table can't be allocated. */
+static int
+PrepareSendHeader(RTMP *r, RTMPPacket *packet, uint32_t *last)
 {
     const RTMPPacket *prevPacket;
-    uint32_t last = 0;
-    int nSize;
-    int hSize, cSize;
-    char *header, *hptr, *hend, hbuf[RTMP_MAX_HEADER_SIZE], c;
-    uint32_t t;
-    char *buffer, *tbuf = NULL, *toff = NULL;
-    int nChunkSize;
-    int tlen;
+
+    *last = 0;
 
     if (packet->m_nChannel >= r->m_channelsAllocatedOut)
     {
@@ -4104,9 +4101,27 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
         if (prevPacket->m_nTimeStamp == packet->m_nTimeStamp
                 && packet->m_headerType == RTMP_PACKET_SIZE_SMALL)
             packet->m_headerType = RTMP_PACKET_SIZE_MINIMUM;
-        last = prevPacket->m_nTimeStamp;
+        *last = prevPacket->m_nTimeStamp;
     }
 
+    return TRUE;
+}
+
+int
+RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+{
+    uint32_t last = 0;
+    int nSize;
+    int hSize, cSize;
+    char *header, *hptr, *hend, hbuf[RTMP_MAX_HEADER_SIZE], c;
+    uint32_t t;
+    char *buffer, *tbuf = NULL, *toff = NULL;
+    int nChunkSize;
+    int tlen;
+
+    if (!PrepareSendHeader(r, packet, &last))
+        return FALSE;
+
     if (packet->m_headerType > 3)	/* sanity */
     {
         RTMP_Log(RTMP_LOGERROR, "sanity failed!! trying to send header of type: 0x%02x.",
@@ -4280,6 +4295,328 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     return TRUE;
 }
 
+#ifdef _WIN32
+typedef WSABUF RTMPIOVec;
+
+static void
+IOVecSet(RTMPIOVec *v, const char *base, int len)
+{
+    v->buf = (CHAR *)base;
+    v->len = (ULONG)len;
+}
+
+static char *
+IOVecBase(const RTMPIOVec *v)
+{
+    return v->buf;
+}
+
+static int
+IOVecLen(const RTMPIOVec *v)
+{
+    return (int)v->len;
+}
+
+static int
+SockBufSendV(RTMPSockBuf *sb, RTMPIOVec *iov, int count)
+{
+    DWORD sent = 0;
+
+    if (WSASend(sb->sb_socket, iov, count, &sent, 0, NULL, NULL) != 0)
+        return -1;
+    return (int)sent;
+}
+#else
+typedef struct iovec RTMPIOVec;
+
+static void
+IOVecSet(RTMPIOVec *v, const char *base, int len)
+{
+    v->iov_base = (void *)base;
+    v->iov_len = (size_t)len;
+}
+
+static char *
+IOVecBase(const RTMPIOVec *v)
+{
+    return (char *)v->iov_base;
+}
+
+static int
+IOVecLen(const RTMPIOVec *v)
+{
+    return (int)v->iov_len;
+}
+
+static int
+SockBufSendV(RTMPSockBuf *sb, RTMPIOVec *iov, int count)
+{
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    return (int)sendmsg(sb->sb_socket, &msg, MSG_NOSIGNAL);
+}
+#endif
+
+/* max buffers handed to the socket per call, well under any IOV_MAX */
+#define RTMP_MAX_IOV 128
+
+/* whether writes can go straight to the socket rather than needing WriteN
+ * for HTTP, custom sends, encryption or TLS */
+static int
+CanWriteV(RTMP *r)
+{
+    if (r->Link.protocol & RTMP_FEATURE_HTTP)
+        return FALSE;
+    if (r->m_bCustomSend && r->m_customSendFunc)
+        return FALSE;
+#if defined(RTMP_NETSTACK_DUMP)
+    return FALSE;
+#endif
+#ifdef CRYPTO
+    if (r->Link.rc4keyOut)
+        return FALSE;
+#ifndef NO_SSL
+    if (r->m_sb.sb_ssl)
+        return FALSE;
+#endif
+#endif
+    return TRUE;
+}
+
+static int
+WriteV(RTMP *r, RTMPIOVec *iov, int count)
+{
+    if (r->m_bCustomSend && r->m_customSendVFunc)
+    {
+        AVal bufs[RTMP_MAX_IOV];
+        int i, n = 0, nBytes;
+
+        for (i = 0; i < count; i++)
+        {
+            bufs[i].av_val = IOVecBase(&iov[i]);
+            bufs[i].av_len = IOVecLen(&iov[i]);
+            n += bufs[i].av_len;
+        }
+
+        nBytes = r->m_customSendVFunc(&r->m_sb, bufs, count, r->m_customSendParam);
+        if (nBytes < 0)
+        {
+            int sockerr = GetSockError();
+            RTMP_Log(RTMP_LOGERROR, "%s, RTMP send error %d (%d bytes)", __FUNCTION__,
+                     sockerr, n);
+
+            r->last_error_code = sockerr;
+
+            RTMP_Close(r);
+            return FALSE;
+        }
+
+        return nBytes == n;
+    }
+
+    if (!CanWriteV(r))
+    {
+        /* the other paths need a single buffer, so send it all in one
+         * write rather than one per piece */
+        int i, n = 0, ret;
+        char *buf, *ptr;
+
+        for (i = 0; i < count; i++)
+            n += IOVecLen(&iov[i]);
+
+        buf = ptr = malloc(n);
+        if (!buf)
+            return FALSE;
+
+        for (i = 0; i < count; i++)
+        {
+            memcpy(ptr, IOVecBase(&iov[i]), IOVecLen(&iov[i]));
+            ptr += IOVecLen(&iov[i]);
+        }
+
+        ret = WriteN(r, buf, n);
+        free(buf);
+        return ret;
+    }
+
+    while (count)
+    {
+        int nBytes = SockBufSendV(&r->m_sb, iov, count);
+
+        if (nBytes < 0)
+        {
+            int sockerr = GetSockError();
+            RTMP_Log(RTMP_LOGERROR, "%s, RTMP send error %d", __FUNCTION__,
+                     sockerr);
+
+            if (sockerr == EINTR && !RTMP_ctrlC)
+                continue;
+
+            r->last_error_code = sockerr;
+
+            RTMP_Close(r);
+            return FALSE;
+        }
+
+        if (nBytes == 0)
+            return FALSE;
+
+        /* skip what was sent and resume partway through a buffer */
+        while (count && nBytes >= IOVecLen(iov))
+        {
+            nBytes -= IOVecLen(iov);
+            iov++;
+            count--;
+        }
+        if (count)
+            IOVecSet(iov, IOVecBase(iov) + nBytes, IOVecLen(iov) - nBytes);
+    }
+
+    return TRUE;
+}
+
+/* Sends a packet the same way as RTMP_SendPacket, but with its body in
+ * pieces rather than in packet->m_body.  The chunk headers are interleaved
+ * with the pieces in one list of buffers, so the body is never copied. */
+static int
+SendPacketV(RTMP *r, RTMPPacket *packet, const AVal *body, int count)
+{
+    uint32_t last = 0;
+    int nSize, hSize, cSize = 0, cHSize;
+    char hbuf[RTMP_MAX_HEADER_SIZE], cbuf[3], *hptr, *hend, c;
+    RTMPIOVec iov[RTMP_MAX_IOV];
+    int niov = 0;
+    int left, chunkLeft, piece = 0, off = 0;
+    uint32_t t;
+
+    if (!PrepareSendHeader(r, packet, &last))
+        return FALSE;
+
+    if (packet->m_headerType > 3)	/* sanity */
+    {
+        RTMP_Log(RTMP_LOGERROR, "sanity failed!! trying to send header of type: 0x%02x.",
+                 (unsigned char)packet->m_headerType);
+        return FALSE;
+    }
+
+    nSize = packetSize[packet->m_headerType];
+    t = packet->m_nTimeStamp - last;
+
+    if (packet->m_nChannel > 319)
+        cSize = 2;
+    else if (packet->m_nChannel > 63)
+        cSize = 1;
+
+    hptr = hbuf;
+    hend = hbuf + sizeof(hbuf);
+    c = packet->m_headerType << 6;
+    switch (cSize)
+    {
+    case 0:
+        c |= packet->m_nChannel;
+        break;
+    case 1:
+        break;
+    case 2:
+        c |= 1;
+        break;
+    }
+    *hptr++ = c;
+    if (cSize)
+    {
+        int tmp = packet->m_nChannel - 64;
+        *hptr++ = tmp & 0xff;
+        if (cSize == 2)
+            *hptr++ = tmp >> 8;
+    }
+
+    if (nSize > 1)
+    {
+        hptr = AMF_EncodeInt24(hptr, hend, t > 0xffffff ? 0xffffff : t);
+    }
+
+    if (nSize > 4)
+    {
+        hptr = AMF_EncodeInt24(hptr, hend, packet->m_nBodySize);
+        *hptr++ = packet->m_packetType;
+    }
+
+    if (nSize > 8)
+        hptr += EncodeInt32LE(hptr, packet->m_nInfoField2);
+
+    if (nSize > 1 && t >= 0xffffff)
+        hptr = AMF_EncodeInt32(hptr, hend, t);
+
+    hSize = (int)(hptr - hbuf);
+
+    /* every chunk after the first starts with the same header */
+    cbuf[0] = (0xc0 | c);
+    if (cSize)
+    {
+        int tmp = packet->m_nChannel - 64;
+        cbuf[1] = tmp & 0xff;
+        if (cSize == 2)
+            cbuf[2] = tmp >> 8;
+    }
+    cHSize = 1 + cSize;
+
+    RTMP_Log(RTMP_LOGDEBUG2, "%s: fd=%d, size=%d", __FUNCTION__, (int)r->m_sb.sb_socket,
+             packet->m_nBodySize);
+
+    IOVecSet(&iov[niov++], hbuf, hSize);
+    left = packet->m_nBodySize;
+    chunkLeft = r->m_outChunkSize;
+
+    while (left > 0)
+    {
+        int n;
+
+        while (!body[piece].av_len)
+            piece++;
+
+        n = body[piece].av_len - off;
+        if (n > chunkLeft)
+            n = chunkLeft;
+
+        IOVecSet(&iov[niov++], body[piece].av_val + off, n);
+        off += n;
+        left -= n;
+        chunkLeft -= n;
+
+        if (off == body[piece].av_len)
+        {
+            piece++;
+            off = 0;
+        }
+
+        if (!chunkLeft && left > 0)
+        {
+            IOVecSet(&iov[niov++], cbuf, cHSize);
+            chunkLeft = r->m_outChunkSize;
+        }
+
+        /* each pass adds at most two */
+        if (niov > RTMP_MAX_IOV - 2)
+        {
+            if (!WriteV(r, iov, niov))
+                return FALSE;
+            niov = 0;
+        }
+    }
+
+    if (niov && !WriteV(r, iov, niov))
+        return FALSE;
+
+    packet->m_body = NULL;
+    if (!r->m_vecChannelsOut[packet->m_nChannel])
+        r->m_vecChannelsOut[packet->m_nChannel] = malloc(sizeof(RTMPPacket));
+    memcpy(r->m_vecChannelsOut[packet->m_nChannel], packet, sizeof(RTMPPacket));
+    return TRUE;
+}
+
 void
 RTMP_Close(RTMP *r)
 {
@@ -4380,6 +4717,7 @@ RTMP_Close(RTMP *r)
     memset (&r->m_bindIP, 0, sizeof(r->m_bindIP));
     r->m_bCustomSend = 0;
     r->m_customSendFunc = NULL;
+    r->m_customSendVFunc = NULL;
     r->m_customSendParam = NULL;
 
 #if defined(CRYPTO) || defined(USE_ONLY_MD5)
@@ -5369,3 +5707,38 @@ RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
     }
     return size+s2;
 }
+
+int
+RTMP_WriteTag(RTMP *r, int type, uint32_t timestamp, const AVal *body,
+              int count, int streamIdx)
+{
+    RTMPPacket pkt;
+    int i, size = 0;
+
+    memset(&pkt, 0, sizeof(pkt));
+
+    for (i = 0; i < count; i++)
+        size += body[i].av_len;
+    if (!size)
+        return 0;
+
+    pkt.m_nChannel = 0x04;	/* source channel */
+    pkt.m_nInfoField2 = r->Link.streams[streamIdx].id;
+    pkt.m_packetType = type;
+    pkt.m_nTimeStamp = timestamp;
+    pkt.m_nBodySize = size;
+
+    if (((type == RTMP_PACKET_TYPE_AUDIO || type == RTMP_PACKET_TYPE_VIDEO) &&
+            !timestamp) || type == RTMP_PACKET_TYPE_INFO)
+    {
+        pkt.m_headerType = RTMP_PACKET_SIZE_LARGE;
+    }
+    else
+    {
+        pkt.m_headerType = RTMP_PACKET_SIZE_MEDIUM;
+    }
+
+    if (!SendPacketV(r, &pkt, body, count))
+        return -1;
+    return size;
+}
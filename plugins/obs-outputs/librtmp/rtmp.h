@@ -393,6 +393,7 @@ extern "C"
     } RTMP_BINDINFO;
 
     typedef int (*CUSTOMSEND)(RTMPSockBuf*, const char *, int, void*);
+    typedef int (*CUSTOMSENDV)(RTMPSockBuf*, const AVal *, int, void*);
 
     typedef struct RTMP
     {
@@ -418,6 +419,7 @@ extern "C"
         uint8_t m_bCustomSend;
         void*   m_customSendParam;
         CUSTOMSEND m_customSendFunc;
+        CUSTOMSENDV m_customSendVFunc;	/* optional, for scattered data */
 
         RTMP_BINDINFO m_bindIP;
 
@@ -540,6 +542,11 @@ extern "C"
     int RTMP_Read(RTMP *r, char *buf, int size);
     int RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx);
 
+    /* sends the body of an FLV tag of the given type and timestamp, in one
+     * or more pieces that are sent without being copied into one buffer */
+    int RTMP_WriteTag(RTMP *r, int type, uint32_t timestamp, const AVal *body,
+                      int count, int streamIdx);
+
 #ifdef USE_HASHSWF
     /* hashswf.c */
     int RTMP_HashSWF(const char *url, unsigned int *size, unsigned char *hash,
@@ -406,8 +406,9 @@ static int send_packet(struct rtmp_stream *stream,
 		       struct encoder_packet *packet, bool is_header,
 		       size_t idx)
 {
-	uint8_t *data;
-	size_t size;
+	struct flv_tag tag;
+	AVal body[3];
+	size_t size = 0;
 	int recv_size = 0;
 	int ret = 0;
 
@@ -427,21 +428,41 @@ static int send_packet(struct rtmp_stream *stream,
 		}
 	}
 
-	if (idx > 0) {
-		flv_additional_packet_mux(
-			packet, is_header ? 0 : stream->start_dts_offset, &data,
-			&size, is_header, idx);
-	} else {
-		flv_packet_mux(packet, is_header ? 0 : stream->start_dts_offset,
-			       &data, &size, is_header);
-	}
+	/* the packet data is sent in place, between the few bytes that the
+	 * FLV tag body puts around it */
+	if (flv_packet_tag(packet, is_header ? 0 : stream->start_dts_offset,
+			   is_header, idx, &tag)) {
+		body[0].av_val = (char *)tag.header;
+		body[0].av_len = (int)tag.header_size;
+		body[1].av_val = (char *)packet->data;
+		body[1].av_len = (int)packet->size;
+		body[2].av_val = (char *)tag.footer;
+		body[2].av_len = (int)tag.footer_size;
+
+		/* counted as the FLV tag it would have been muxed into, which
+		 * ends with its own size */
+		size = FLV_TAG_HEADER_SIZE + tag.header_size + packet->size +
+		       tag.footer_size + 4;
 
 #ifdef TEST_FRAMEDROPS
-	droptest_cap_data_rate(stream, size);
+		droptest_cap_data_rate(stream, size);
 #endif
 
-	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
-	bfree(data);
+#if COMPILE_IO_URING
+		if (stream->uring)
+			rtmp_uring_begin_packet(stream->uring, packet,
+						is_header);
+#endif
+
+		ret = RTMP_WriteTag(&stream->rtmp, tag.type,
+				    (uint32_t)tag.time_ms & 0x7FFFFFFF, body, 3,
+				    0);
+
+#if COMPILE_IO_URING
+		if (stream->uring)
+			rtmp_uring_end_packet(stream->uring);
+#endif
+	}
 
 	if (is_header)
 		bfree(packet->data);
@@ -540,7 +561,7 @@ static void set_output_error(struct rtmp_stream *stream)
 		obs_output_set_last_error(stream->output, msg);
 }
 
-static void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *back)
+void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *back)
 {
 	struct dbr_frame front;
 	uint64_t dur;
@@ -604,7 +625,10 @@ static void *send_thread(void *data)
 			}
 		}
 
-		if (stream->dbr_enabled) {
+		/* sends through io_uring are timed when they complete */
+		bool time_send = stream->dbr_enabled && !stream->uring;
+
+		if (time_send) {
 			dbr_frame.send_beg = os_gettime_ns();
 			dbr_frame.size = packet.size;
 		}
@@ -614,7 +638,7 @@ static void *send_thread(void *data)
 			break;
 		}
 
-		if (stream->dbr_enabled) {
+		if (time_send) {
 			dbr_frame.send_end = os_gettime_ns();
 
 			pthread_mutex_lock(&stream->dbr_mutex);
@@ -641,6 +665,11 @@ static void *send_thread(void *data)
 		stream->rtmp.m_bCustomSend = false;
 	}
 
+#if COMPILE_IO_URING
+	if (stream->uring)
+		rtmp_uring_stop(stream);
+#endif
+
 	set_output_error(stream);
 	RTMP_Close(&stream->rtmp);
 
@@ -882,6 +911,11 @@ static int init_send(struct rtmp_stream *stream)
 		stream->rtmp.m_customSendParam = stream;
 	}
 
+#if COMPILE_IO_URING
+	if (stream->io_uring_enabled && !stream->new_socket_loop)
+		rtmp_uring_start(stream);
+#endif
+
 	os_atomic_set_bool(&stream->active, true);
 
 	if (!send_meta_data(stream)) {
@@ -1115,6 +1149,8 @@ static bool init_connect(struct rtmp_stream *stream)
 		obs_data_get_bool(settings, OPT_NEWSOCKETLOOP_ENABLED);
 	stream->low_latency_mode =
 		obs_data_get_bool(settings, OPT_LOWLATENCY_ENABLED);
+	stream->io_uring_enabled =
+		obs_data_get_bool(settings, OPT_IO_URING_ENABLED);
 
 	// ugly hack for now, can be removed once new loop is reworked
 	if (stream->new_socket_loop &&
@@ -1476,6 +1512,7 @@ static void rtmp_stream_defaults(obs_data_t *defaults)
 	obs_data_set_default_string(defaults, OPT_BIND_IP, "default");
 	obs_data_set_default_bool(defaults, OPT_NEWSOCKETLOOP_ENABLED, false);
 	obs_data_set_default_bool(defaults, OPT_LOWLATENCY_ENABLED, false);
+	obs_data_set_default_bool(defaults, OPT_IO_URING_ENABLED, false);
 }
 
 static obs_properties_t *rtmp_stream_properties(void *unused)
@@ -1508,6 +1545,10 @@ static obs_properties_t *rtmp_stream_properties(void *unused)
 				obs_module_text("RTMPStream.NewSocketLoop"));
 	obs_properties_add_bool(props, OPT_LOWLATENCY_ENABLED,
 				obs_module_text("RTMPStream.LowLatencyMode"));
+#if COMPILE_IO_URING
+	obs_properties_add_bool(props, OPT_IO_URING_ENABLED,
+				obs_module_text("RTMPStream.IOUring"));
+#endif
 
 	return props;
 }
@@ -9,6 +9,7 @@
 #include "librtmp/log.h"
 #include "flv-mux.h"
 #include "net-if.h"
+#include "obs-outputs-config.h"
 
 #ifdef _WIN32
 #include <Iphlpapi.h>
@@ -32,6 +33,7 @@
 #define OPT_NEWSOCKETLOOP_ENABLED "new_socket_loop_enabled"
 #define OPT_LOWLATENCY_ENABLED "low_latency_mode_enabled"
 #define OPT_METADATA_MULTITRACK "metadata_multitrack"
+#define OPT_IO_URING_ENABLED "io_uring_enabled"
 
 //#define TEST_FRAMEDROPS
 //#define TEST_FRAMEDROPS_WITH_BITRATE_SHORTCUTS
@@ -128,8 +130,21 @@ struct rtmp_stream {
 	os_event_t *buffer_has_data_event;
 	os_event_t *socket_available_event;
 	os_event_t *send_thread_signaled_exit;
+
+	bool io_uring_enabled;
+	struct rtmp_uring *uring;
 };
 
+void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *back);
+
 #ifdef _WIN32
 void *socket_thread_windows(void *data);
 #endif
+
+#if COMPILE_IO_URING
+bool rtmp_uring_start(struct rtmp_stream *stream);
+void rtmp_uring_stop(struct rtmp_stream *stream);
+void rtmp_uring_begin_packet(struct rtmp_uring *uring,
+			     struct encoder_packet *packet, bool is_header);
+void rtmp_uring_end_packet(struct rtmp_uring *uring);
+#endif
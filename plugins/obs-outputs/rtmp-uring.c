@@ -0,0 +1,731 @@
+#include "rtmp-stream.h"
+
+#if COMPILE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+/*
+ * io_uring send loop (Linux)
+ *
+ *   librtmp hands each write over as a list of buffers.  Buffers that point
+ * into the encoder packet being sent are sent from it in place, with a
+ * reference to the packet held until the send completes, and everything else
+ * (chunk headers, tag headers, control messages) is copied into a staging
+ * ring.  Each write becomes one SENDMSG.
+ *
+ *   Sends on a TCP socket have to complete in order, which io_uring only
+ * guarantees within a linked chain, so everything queued while a chain is in
+ * flight goes out as the next chain once it completes.  With MSG_WAITALL a
+ * short send cancels the rest of its chain, which is then resubmitted from
+ * where it stopped.
+ */
+
+#define URING_ENTRIES 128
+#define URING_MAX_IOV 128
+#define URING_STAGING_SIZE (1024 * 1024)
+
+struct uring_entry {
+	struct msghdr msg;
+	struct iovec iov[URING_MAX_IOV];
+	size_t len;
+	int32_t res;
+
+	/* bytes of the staging ring used, including any skipped at its end */
+	size_t staged;
+
+	struct encoder_packet packet;
+	bool holds_packet;
+
+	/* last write of a packet whose completion latency is reported */
+	bool packet_end;
+	uint64_t packet_ts;
+	size_t packet_size;
+};
+
+struct rtmp_uring {
+	struct rtmp_stream *stream;
+	int fd;
+	int sock;
+
+	void *ring_ptr;
+	size_t ring_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	os_event_t *data_event;
+	os_event_t *space_event;
+
+	/* entries are used in order: [retired, submitted) are with the kernel,
+	 * [submitted, published) are waiting for the chain in flight, and
+	 * [published, queued) belong to the packet still being written */
+	struct uring_entry entries[URING_ENTRIES];
+	uint64_t retired;
+	uint64_t submitted;
+	uint64_t published;
+	uint64_t queued;
+	uint64_t chain_start;
+	unsigned in_flight;
+
+	uint8_t *staging;
+	size_t staging_start;
+	size_t staging_used;
+
+	/* packet being written */
+	const struct encoder_packet *packet;
+	bool in_packet;
+	bool report_packet;
+	uint64_t packet_first;
+	uint64_t packet_ts;
+	size_t packet_size;
+
+	bool stop;
+	bool failed;
+	int error;
+
+	uint64_t packets_sent;
+	uint64_t total_latency_ns;
+	uint64_t max_latency_ns;
+};
+
+static inline int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int uring_enter(int fd, unsigned to_submit,
+			      unsigned min_complete, unsigned flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+			    flags, NULL, 0);
+}
+
+static inline struct uring_entry *get_entry(struct rtmp_uring *u, uint64_t seq)
+{
+	return &u->entries[seq % URING_ENTRIES];
+}
+
+/* ------------------------------------------------------------------------- */
+
+static uint8_t *staging_alloc(struct rtmp_uring *u, size_t size, size_t *taken)
+{
+	size_t end, pad = 0;
+
+	if (!u->staging_used)
+		u->staging_start = 0;
+	if (u->staging_used + size > URING_STAGING_SIZE)
+		return NULL;
+
+	end = (u->staging_start + u->staging_used) % URING_STAGING_SIZE;
+
+	if (end >= u->staging_start) {
+		/* free space wraps around, allocations don't */
+		if (URING_STAGING_SIZE - end < size) {
+			if (size > u->staging_start)
+				return NULL;
+			pad = URING_STAGING_SIZE - end;
+			end = 0;
+		}
+	} else if (u->staging_start - end < size) {
+		return NULL;
+	}
+
+	u->staging_used += pad + size;
+	*taken = pad + size;
+	return u->staging + end;
+}
+
+static void staging_free(struct rtmp_uring *u, size_t size)
+{
+	u->staging_start = (u->staging_start + size) % URING_STAGING_SIZE;
+	u->staging_used -= size;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void report_packet(struct rtmp_uring *u, uint64_t packet_ts,
+			  size_t packet_size)
+{
+	struct rtmp_stream *stream = u->stream;
+	uint64_t now = os_gettime_ns();
+	uint64_t latency = now - packet_ts;
+
+	u->packets_sent++;
+	u->total_latency_ns += latency;
+	if (latency > u->max_latency_ns)
+		u->max_latency_ns = latency;
+
+	/* with sends no longer blocking, the bitrate estimate goes by when
+	 * they complete instead */
+	if (stream->dbr_enabled) {
+		struct dbr_frame dbr_frame = {
+			.send_beg = packet_ts,
+			.send_end = now,
+			.size = packet_size,
+		};
+
+		pthread_mutex_lock(&stream->dbr_mutex);
+		dbr_add_frame(stream, &dbr_frame);
+		pthread_mutex_unlock(&stream->dbr_mutex);
+	}
+}
+
+static void retire_entry(struct rtmp_uring *u, struct uring_entry *e)
+{
+	if (e->holds_packet) {
+		obs_encoder_packet_release(&e->packet);
+		e->holds_packet = false;
+	}
+
+	staging_free(u, e->staged);
+
+	if (e->packet_end && !u->failed)
+		report_packet(u, e->packet_ts, e->packet_size);
+
+	u->retired++;
+}
+
+/* gives back the newest entry, which the kernel has never seen, so its
+ * staging space is at the end of what's used */
+static void unqueue_entry(struct rtmp_uring *u, struct uring_entry *e)
+{
+	if (e->holds_packet) {
+		obs_encoder_packet_release(&e->packet);
+		e->holds_packet = false;
+	}
+
+	u->staging_used -= e->staged;
+	u->queued--;
+}
+
+static void fail(struct rtmp_uring *u, int error, const char *reason)
+{
+	struct rtmp_stream *stream = u->stream;
+
+	warn("io_uring send failed: %s (%d)", reason, error);
+
+	u->failed = true;
+	u->error = error;
+	stream->rtmp.last_error_code = error;
+
+	while (u->queued > u->submitted)
+		unqueue_entry(u, get_entry(u, u->queued - 1));
+	u->published = u->submitted;
+
+	/* entries still in flight point the kernel at their packets and
+	 * staging, so they're only retired once their completions are
+	 * reaped, or once the ring is closed */
+	if (!u->in_flight) {
+		while (u->retired < u->submitted)
+			retire_entry(u, get_entry(u, u->retired));
+	}
+
+	os_event_signal(u->space_event);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void prepare_chain(struct rtmp_uring *u)
+{
+	unsigned tail = *u->sq_tail;
+	unsigned count = (unsigned)(u->published - u->submitted);
+
+	for (unsigned i = 0; i < count; i++) {
+		uint64_t seq = u->submitted + i;
+		unsigned idx = (tail + i) & *u->sq_mask;
+		struct io_uring_sqe *sqe = &u->sqes[idx];
+
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->fd = u->sock;
+		sqe->addr = (uint64_t)(uintptr_t)&get_entry(u, seq)->msg;
+		sqe->len = 1;
+		sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+		sqe->user_data = seq;
+		if (i + 1 < count)
+			sqe->flags = IOSQE_IO_LINK;
+
+		u->sq_array[idx] = idx;
+	}
+
+	__atomic_store_n(u->sq_tail, tail + count, __ATOMIC_RELEASE);
+
+	u->chain_start = u->submitted;
+	u->submitted += count;
+	u->in_flight = count;
+}
+
+static void advance_entry(struct uring_entry *e, size_t sent)
+{
+	struct iovec *iov = e->msg.msg_iov;
+	size_t count = e->msg.msg_iovlen;
+
+	e->len -= sent;
+
+	while (count && sent >= iov->iov_len) {
+		sent -= iov->iov_len;
+		iov++;
+		count--;
+	}
+	if (count) {
+		iov->iov_base = (uint8_t *)iov->iov_base + sent;
+		iov->iov_len -= sent;
+	}
+
+	e->msg.msg_iov = iov;
+	e->msg.msg_iovlen = count;
+}
+
+/* once the whole chain has completed, retires what was sent and sets up the
+ * rest to be resubmitted */
+static void finish_chain(struct rtmp_uring *u)
+{
+	uint64_t end = u->submitted;
+
+	for (uint64_t seq = u->chain_start; seq < end; seq++) {
+		struct uring_entry *e = get_entry(u, seq);
+
+		if (e->res >= 0 && (size_t)e->res == e->len) {
+			retire_entry(u, e);
+			continue;
+		}
+
+		if (e->res < 0) {
+			fail(u, -e->res, "send error");
+			return;
+		}
+		if (e->res == 0) {
+			fail(u, EPIPE, "connection closed");
+			return;
+		}
+
+		/* whatever followed a short send must not have gone out */
+		for (uint64_t next = seq + 1; next < end; next++) {
+			if (get_entry(u, next)->res != -ECANCELED) {
+				fail(u, EPROTO, "sends completed out of order");
+				return;
+			}
+		}
+
+		advance_entry(e, (size_t)e->res);
+		u->submitted = seq;
+		break;
+	}
+
+	os_event_signal(u->space_event);
+}
+
+static void reap_completions(struct rtmp_uring *u)
+{
+	unsigned head = *u->cq_head;
+	unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+		get_entry(u, cqe->user_data)->res = cqe->res;
+		u->in_flight--;
+	}
+
+	__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void *uring_thread(void *data)
+{
+	struct rtmp_uring *u = data;
+
+	os_set_thread_name("rtmp-stream: uring_thread");
+
+	for (;;) {
+		unsigned to_submit;
+		int ret;
+
+		pthread_mutex_lock(&u->mutex);
+		if (!u->in_flight) {
+			if (u->published == u->submitted) {
+				bool stop = u->stop || u->failed;
+				pthread_mutex_unlock(&u->mutex);
+
+				if (stop)
+					break;
+
+				os_event_wait(u->data_event);
+				continue;
+			}
+
+			prepare_chain(u);
+		}
+
+		/* anything not taken when interrupted is submitted again */
+		to_submit = *u->sq_tail -
+			    __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+		pthread_mutex_unlock(&u->mutex);
+
+		ret = uring_enter(u->fd, to_submit, 1,
+				  IORING_ENTER_GETEVENTS);
+		if (ret < 0 && errno != EINTR && errno != EAGAIN &&
+		    errno != EBUSY) {
+			pthread_mutex_lock(&u->mutex);
+			fail(u, errno, "io_uring_enter failed");
+			pthread_mutex_unlock(&u->mutex);
+			break;
+		}
+
+		pthread_mutex_lock(&u->mutex);
+		reap_completions(u);
+		if (!u->in_flight)
+			finish_chain(u);
+		pthread_mutex_unlock(&u->mutex);
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool points_into(const struct encoder_packet *packet,
+			     const AVal *buf)
+{
+	const uint8_t *ptr = (const uint8_t *)buf->av_val;
+
+	return packet && ptr >= packet->data &&
+	       ptr + buf->av_len <= packet->data + packet->size;
+}
+
+static void publish(struct rtmp_uring *u)
+{
+	if (u->published != u->queued) {
+		u->published = u->queued;
+		os_event_signal(u->data_event);
+	}
+}
+
+static int queue_write(struct rtmp_uring *u, const AVal *bufs, int count)
+{
+	const struct encoder_packet *packet = u->packet;
+	struct uring_entry *e;
+	uint8_t *staged = NULL;
+	size_t taken = 0;
+	size_t len = 0;
+	size_t copy = 0;
+	size_t iovcnt = 0;
+
+	for (int i = 0; i < count; i++) {
+		len += bufs[i].av_len;
+		if (!points_into(packet, &bufs[i]))
+			copy += bufs[i].av_len;
+	}
+
+	if (copy > URING_STAGING_SIZE) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	pthread_mutex_lock(&u->mutex);
+	for (;;) {
+		if (u->failed) {
+			errno = u->error;
+			pthread_mutex_unlock(&u->mutex);
+			return -1;
+		}
+
+		if (u->queued - u->retired < URING_ENTRIES &&
+		    (!copy || (staged = staging_alloc(u, copy, &taken))))
+			break;
+
+		/* let earlier writes of this packet go out to make room */
+		publish(u);
+		pthread_mutex_unlock(&u->mutex);
+		os_event_wait(u->space_event);
+		pthread_mutex_lock(&u->mutex);
+	}
+
+	e = get_entry(u, u->queued);
+	e->len = len;
+	e->res = 0;
+	e->staged = taken;
+	e->packet_end = false;
+
+	for (int i = 0; i < count; i++) {
+		const AVal *buf = &bufs[i];
+
+		if (!buf->av_len)
+			continue;
+
+		if (points_into(packet, buf)) {
+			e->iov[iovcnt].iov_base = buf->av_val;
+			e->iov[iovcnt++].iov_len = buf->av_len;
+
+			if (!e->holds_packet) {
+				obs_encoder_packet_ref(
+					&e->packet,
+					(struct encoder_packet *)packet);
+				e->holds_packet = true;
+			}
+			continue;
+		}
+
+		memcpy(staged, buf->av_val, buf->av_len);
+
+		/* copies made one after another can be sent as one */
+		if (iovcnt && (uint8_t *)e->iov[iovcnt - 1].iov_base +
+					      e->iov[iovcnt - 1].iov_len ==
+				      staged) {
+			e->iov[iovcnt - 1].iov_len += buf->av_len;
+		} else {
+			e->iov[iovcnt].iov_base = staged;
+			e->iov[iovcnt++].iov_len = buf->av_len;
+		}
+		staged += buf->av_len;
+	}
+
+	memset(&e->msg, 0, sizeof(e->msg));
+	e->msg.msg_iov = e->iov;
+	e->msg.msg_iovlen = iovcnt;
+
+	u->queued++;
+	if (!u->in_packet)
+		publish(u);
+	pthread_mutex_unlock(&u->mutex);
+
+	return (int)len;
+}
+
+static int uring_send_v(RTMPSockBuf *sb, const AVal *bufs, int count,
+			void *param)
+{
+	struct rtmp_stream *stream = param;
+	int total = 0;
+
+	UNUSED_PARAMETER(sb);
+
+	while (count > 0) {
+		int n = count < URING_MAX_IOV ? count : URING_MAX_IOV;
+		int ret = queue_write(stream->uring, bufs, n);
+
+		if (ret < 0)
+			return ret;
+
+		total += ret;
+		bufs += n;
+		count -= n;
+	}
+
+	return total;
+}
+
+static int uring_send(RTMPSockBuf *sb, const char *data, int len, void *param)
+{
+	AVal buf = {(char *)data, len};
+	return uring_send_v(sb, &buf, 1, param);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void rtmp_uring_begin_packet(struct rtmp_uring *u,
+			     struct encoder_packet *packet, bool is_header)
+{
+	pthread_mutex_lock(&u->mutex);
+	/* headers aren't pool allocated, so they're copied */
+	u->packet = is_header ? NULL : packet;
+	u->in_packet = true;
+	u->report_packet = !is_header;
+	u->packet_first = u->queued;
+	u->packet_ts = os_gettime_ns();
+	u->packet_size = packet->size;
+	pthread_mutex_unlock(&u->mutex);
+}
+
+void rtmp_uring_end_packet(struct rtmp_uring *u)
+{
+	pthread_mutex_lock(&u->mutex);
+	if (u->report_packet && u->queued > u->packet_first) {
+		if (u->queued - 1 >= u->retired) {
+			struct uring_entry *e = get_entry(u, u->queued - 1);
+			e->packet_end = true;
+			e->packet_ts = u->packet_ts;
+			e->packet_size = u->packet_size;
+
+		} else if (!u->failed) {
+			/* sent already, which can happen when it had to be
+			 * published early */
+			report_packet(u, u->packet_ts, u->packet_size);
+		}
+	}
+
+	u->packet = NULL;
+	u->in_packet = false;
+	u->report_packet = false;
+	publish(u);
+	pthread_mutex_unlock(&u->mutex);
+}
+
+static bool map_rings(struct rtmp_uring *u, struct io_uring_params *p)
+{
+	size_t sq_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	size_t cq_size =
+		p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+	uint8_t *ring;
+
+	u->ring_size = sq_size > cq_size ? sq_size : cq_size;
+	u->ring_ptr = mmap(NULL, u->ring_size, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, u->fd,
+			   IORING_OFF_SQ_RING);
+	if (u->ring_ptr == MAP_FAILED) {
+		u->ring_ptr = NULL;
+		return false;
+	}
+
+	u->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+	u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+	if (u->sqes == MAP_FAILED) {
+		u->sqes = NULL;
+		return false;
+	}
+
+	ring = u->ring_ptr;
+	u->sq_head = (unsigned *)(ring + p->sq_off.head);
+	u->sq_tail = (unsigned *)(ring + p->sq_off.tail);
+	u->sq_mask = (unsigned *)(ring + p->sq_off.ring_mask);
+	u->sq_array = (unsigned *)(ring + p->sq_off.array);
+	u->cq_head = (unsigned *)(ring + p->cq_off.head);
+	u->cq_tail = (unsigned *)(ring + p->cq_off.tail);
+	u->cq_mask = (unsigned *)(ring + p->cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe *)(ring + p->cq_off.cqes);
+	return true;
+}
+
+static void free_uring(struct rtmp_uring *u)
+{
+	if (u->sqes)
+		munmap(u->sqes, u->sqes_size);
+	if (u->ring_ptr)
+		munmap(u->ring_ptr, u->ring_size);
+	if (u->fd >= 0)
+		close(u->fd);
+
+	/* sends left in flight by a failed io_uring_enter end with the ring */
+	while (u->retired < u->queued)
+		retire_entry(u, get_entry(u, u->retired));
+
+	os_event_destroy(u->data_event);
+	os_event_destroy(u->space_event);
+	pthread_mutex_destroy(&u->mutex);
+	bfree(u->staging);
+	bfree(u);
+}
+
+/* needs linked sends to stop at a short send, which MSG_WAITALL does as of
+ * the same kernel (5.12) that added native workers */
+#define REQUIRED_FEATURES                                   \
+	(IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |     \
+	 IORING_FEAT_SUBMIT_STABLE | IORING_FEAT_NATIVE_WORKERS)
+
+bool rtmp_uring_start(struct rtmp_stream *stream)
+{
+	struct io_uring_params params = {0};
+	struct rtmp_uring *u;
+	RTMP *r = &stream->rtmp;
+
+	if ((r->Link.protocol & RTMP_FEATURE_HTTP) || r->m_sb.sb_ssl) {
+		info("io_uring send loop not available for this protocol, "
+		     "using regular sends");
+		return false;
+	}
+#ifdef CRYPTO
+	if (r->Link.rc4keyOut) {
+		info("io_uring send loop not available for this protocol, "
+		     "using regular sends");
+		return false;
+	}
+#endif
+
+	u = bzalloc(sizeof(*u));
+	u->stream = stream;
+	u->sock = r->m_sb.sb_socket;
+	u->fd = uring_setup(URING_ENTRIES, &params);
+	pthread_mutex_init_value(&u->mutex);
+
+	if (u->fd < 0) {
+		info("io_uring not available (%d), using regular sends",
+		     errno);
+		goto fail;
+	}
+	if ((params.features & REQUIRED_FEATURES) != REQUIRED_FEATURES) {
+		info("io_uring too old, using regular sends");
+		goto fail;
+	}
+	if (!map_rings(u, &params)) {
+		warn("Failed to map io_uring rings, using regular sends");
+		goto fail;
+	}
+
+	if (pthread_mutex_init(&u->mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&u->data_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+	if (os_event_init(&u->space_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	u->staging = bmalloc(URING_STAGING_SIZE);
+
+	if (pthread_create(&u->thread, NULL, uring_thread, u) != 0) {
+		warn("Failed to create io_uring thread, using regular sends");
+		goto fail;
+	}
+
+	stream->uring = u;
+	r->m_bCustomSend = true;
+	r->m_customSendFunc = uring_send;
+	r->m_customSendVFunc = uring_send_v;
+	r->m_customSendParam = stream;
+
+	info("io_uring send loop enabled");
+	return true;
+
+fail:
+	free_uring(u);
+	return false;
+}
+
+/* sends everything still queued before returning */
+void rtmp_uring_stop(struct rtmp_stream *stream)
+{
+	struct rtmp_uring *u = stream->uring;
+
+	pthread_mutex_lock(&u->mutex);
+	u->stop = true;
+	publish(u);
+	pthread_mutex_unlock(&u->mutex);
+
+	os_event_signal(u->data_event);
+	pthread_join(u->thread, NULL);
+
+	if (u->packets_sent)
+		info("io_uring: %" PRIu64 " packets sent, completion latency "
+		     "avg %.2f ms, max %.2f ms",
+		     u->packets_sent,
+		     (double)u->total_latency_ns /
+			     (double)u->packets_sent / 1000000.0,
+		     (double)u->max_latency_ns / 1000000.0);
+
+	stream->rtmp.m_bCustomSend = false;
+	stream->rtmp.m_customSendFunc = NULL;
+	stream->rtmp.m_customSendVFunc = NULL;
+	stream->rtmp.m_customSendParam = NULL;
+	stream->uring = NULL;
+
+	free_uring(u);
+}
+#endif
@@ -0,0 +1,156 @@
+/* Times chains of the built-in audio filters per 1024-frame block, fused and
+ * with a pass-through filter between each one so that every filter makes its
+ * own pass over the block.
+ *
+ * Usage: bench_audio_filter_chain [obs-filters module] [module data path] */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <obs.h>
+#include <util/platform.h>
+
+#define SAMPLE_RATE 48000
+#define BLOCK_FRAMES 1024
+#define BENCH_BLOCKS 2000
+
+static const char *chain_ids[] = {
+	"gain_filter",       "noise_gate_filter", "expander_filter",
+	"compressor_filter", "limiter_filter",
+};
+
+#define MAX_CHAIN (sizeof(chain_ids) / sizeof(chain_ids[0]))
+
+static const char *bench_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "bench";
+}
+
+static void *bench_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void bench_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_audio_data *passthrough_filter_audio(
+	void *data, struct obs_audio_data *audio)
+{
+	UNUSED_PARAMETER(data);
+	return audio;
+}
+
+static struct obs_source_info bench_input = {
+	.id = "bench_input",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name = bench_name,
+	.create = bench_create,
+	.destroy = bench_destroy,
+};
+
+static struct obs_source_info bench_passthrough = {
+	.id = "bench_passthrough",
+	.type = OBS_SOURCE_TYPE_FILTER,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name = bench_name,
+	.create = bench_create,
+	.destroy = bench_destroy,
+	.filter_audio = passthrough_filter_audio,
+};
+
+static void add_filter(obs_source_t *source, const char *id)
+{
+	obs_source_t *filter = obs_source_create_private(id, id, NULL);
+	obs_source_filter_add(source, filter);
+	obs_source_release(filter);
+}
+
+/* noise under a level that sweeps up and down, so the dynamics filters cross
+ * their thresholds */
+static void fill_samples(float *samples, size_t start)
+{
+	for (size_t i = 0; i < BLOCK_FRAMES; i++) {
+		size_t n = start + i;
+		float level = (float)(n % 48000) / 48000.0f;
+		float noise = (float)((n * 7919) % 2001) / 1000.0f - 1.0f;
+
+		samples[i] = noise * level * level;
+	}
+}
+
+static double bench_chain(size_t length, bool separate)
+{
+	static float samples[2][BLOCK_FRAMES];
+	obs_source_t *source =
+		obs_source_create("bench_input", "input", NULL, NULL);
+
+	for (size_t i = 0; i < length; i++) {
+		if (separate && i)
+			add_filter(source, "bench_passthrough");
+		add_filter(source, chain_ids[i]);
+	}
+
+	uint64_t total = 0;
+
+	for (size_t block = 0; block < BENCH_BLOCKS; block++) {
+		struct obs_source_audio audio = {
+			.data = {(uint8_t *)samples[0], (uint8_t *)samples[1]},
+			.frames = BLOCK_FRAMES,
+			.speakers = SPEAKERS_STEREO,
+			.format = AUDIO_FORMAT_FLOAT_PLANAR,
+			.samples_per_sec = SAMPLE_RATE,
+			.timestamp = block * BLOCK_FRAMES * 1000000000ULL /
+				     SAMPLE_RATE,
+		};
+
+		fill_samples(samples[0], block * BLOCK_FRAMES);
+		memcpy(samples[1], samples[0], sizeof(samples[0]));
+
+		uint64_t start = os_gettime_ns();
+		obs_source_output_audio(source, &audio);
+		total += os_gettime_ns() - start;
+	}
+
+	obs_source_release(source);
+	return (double)total / 1000.0 / BENCH_BLOCKS;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = argc > 1 ? argv[1] : OBS_FILTERS_MODULE;
+	const char *data_path = argc > 2 ? argv[2] : OBS_FILTERS_DATA;
+	struct obs_audio_info ai = {SAMPLE_RATE, SPEAKERS_STEREO};
+	obs_module_t *module;
+	int ret = 1;
+
+	if (!obs_startup("en-US", NULL, NULL))
+		return 1;
+	if (!obs_reset_audio(&ai))
+		goto fail;
+	if (obs_open_module(&module, path, data_path) != MODULE_SUCCESS ||
+	    !obs_init_module(module)) {
+		fprintf(stderr, "Failed to load '%s'\n", path);
+		goto fail;
+	}
+
+	obs_register_source(&bench_input);
+	obs_register_source(&bench_passthrough);
+
+	for (size_t length = 1; length <= MAX_CHAIN; length++)
+		printf("%zu filters: separate %.2f us/block, "
+		       "fused %.2f us/block\n",
+		       length, bench_chain(length, true),
+		       bench_chain(length, false));
+
+	ret = 0;
+
+fail:
+	obs_shutdown();
+	return ret;
+}
@@ -0,0 +1,72 @@
+/* Times 44.1 to 48 kHz stereo resampling with the ffmpeg backend and with
+ * the polyphase backend at each quality. */
+
+#include <math.h>
+#include <stdio.h>
+
+#include <util/platform.h>
+#include <media-io/audio-resampler.h>
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+#define IN_RATE 44100
+#define OUT_RATE 48000
+#define BLOCK_FRAMES 441
+#define BENCH_SECONDS 20
+
+static double bench_resampler(enum audio_resampler_type type,
+			      enum audio_resampler_quality quality)
+{
+	struct resample_info src = {IN_RATE, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	struct resample_info dst = {OUT_RATE, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	float left[BLOCK_FRAMES], right[BLOCK_FRAMES];
+	const uint8_t *input[2] = {(uint8_t *)left, (uint8_t *)right};
+	uint64_t total = 0;
+
+	audio_resampler_t *rs =
+		audio_resampler_create2(&dst, &src, type, quality);
+	if (!rs)
+		return 0.0;
+
+	for (size_t pos = 0; pos < IN_RATE * BENCH_SECONDS;
+	     pos += BLOCK_FRAMES) {
+		uint8_t *output[MAX_AV_PLANES];
+		uint32_t out_frames;
+		uint64_t ts_offset;
+
+		for (size_t i = 0; i < BLOCK_FRAMES; i++) {
+			double t = (double)(pos + i) / IN_RATE;
+			left[i] = (float)(0.5 * sin(2.0 * M_PI * 1000.0 * t));
+			right[i] = -left[i];
+		}
+
+		uint64_t start = os_gettime_ns();
+		audio_resampler_resample(rs, output, &out_frames, &ts_offset,
+					 input, BLOCK_FRAMES);
+		total += os_gettime_ns() - start;
+	}
+
+	audio_resampler_destroy(rs);
+	return (double)total / 1000000.0;
+}
+
+int main(void)
+{
+	static const char *quality_names[] = {"fast", "medium", "high"};
+
+	printf("%d s of 44.1 -> 48 kHz stereo:\n", BENCH_SECONDS);
+	printf("ffmpeg: %.2f ms\n",
+	       bench_resampler(AUDIO_RESAMPLER_FFMPEG,
+			       AUDIO_RESAMPLER_QUALITY_MEDIUM));
+
+	for (int q = AUDIO_RESAMPLER_QUALITY_FAST;
+	     q <= AUDIO_RESAMPLER_QUALITY_HIGH; q++)
+		printf("polyphase %s: %.2f ms\n", quality_names[q],
+		       bench_resampler(AUDIO_RESAMPLER_POLYPHASE,
+				       (enum audio_resampler_quality)q));
+	return 0;
+}
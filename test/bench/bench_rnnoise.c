@@ -0,0 +1,110 @@
+/* Times the RNNoise network on ten channels per 10 ms frame, one channel at a
+ * time with the reference code and batched with each instruction set the CPU
+ * supports. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <util/platform.h>
+
+#include <rnnoise.h>
+#include "rnn.h"
+#include "rnn_data.h"
+
+#define CHANNELS 10
+#define BENCH_FRAMES 2000
+#define NB_FEATURES 42
+#define NB_BANDS 22
+
+extern const struct RNNModel rnnoise_model_orig;
+
+static const char *isa_names[] = {"scalar", "sse2", "avx2+fma"};
+
+static RNNState rnn[CHANNELS];
+static float gains[CHANNELS][NB_BANDS];
+static float vad[CHANNELS];
+static float features[CHANNELS][NB_FEATURES];
+
+static void make_features(size_t frame)
+{
+	for (size_t c = 0; c < CHANNELS; c++) {
+		uint32_t seed = (uint32_t)(c * 7919 + frame * 104729 + 1);
+
+		for (size_t i = 0; i < NB_FEATURES; i++) {
+			seed = seed * 1664525 + 1013904223;
+			features[c][i] =
+				(float)(seed >> 8) / (float)(1 << 24) * 8.0f -
+				4.0f;
+		}
+	}
+}
+
+static double bench_reference(void)
+{
+	uint64_t total = 0;
+
+	for (size_t frame = 0; frame < BENCH_FRAMES; frame++) {
+		make_features(frame);
+
+		uint64_t start = os_gettime_ns();
+		for (size_t c = 0; c < CHANNELS; c++)
+			compute_rnn_reference(&rnn[c], gains[c], &vad[c],
+					      features[c]);
+		total += os_gettime_ns() - start;
+	}
+
+	return (double)total / 1000.0 / BENCH_FRAMES;
+}
+
+static double bench_batched(void)
+{
+	RNNState *states[CHANNELS];
+	const float *input[CHANNELS];
+	float *output[CHANNELS];
+	uint64_t total = 0;
+
+	for (size_t c = 0; c < CHANNELS; c++) {
+		states[c] = &rnn[c];
+		input[c] = features[c];
+		output[c] = gains[c];
+	}
+
+	for (size_t frame = 0; frame < BENCH_FRAMES; frame++) {
+		make_features(frame);
+
+		uint64_t start = os_gettime_ns();
+		compute_rnn_batch(states, CHANNELS, output, vad, input);
+		total += os_gettime_ns() - start;
+	}
+
+	return (double)total / 1000.0 / BENCH_FRAMES;
+}
+
+int main(void)
+{
+	for (size_t c = 0; c < CHANNELS; c++) {
+		rnn[c].model = &rnnoise_model_orig;
+		rnn[c].vad_gru_state =
+			calloc(rnnoise_model_orig.vad_gru_size, sizeof(float));
+		rnn[c].noise_gru_state = calloc(
+			rnnoise_model_orig.noise_gru_size, sizeof(float));
+		rnn[c].denoise_gru_state = calloc(
+			rnnoise_model_orig.denoise_gru_size, sizeof(float));
+	}
+
+	printf("%d channels, reference: %.2f us/frame\n", CHANNELS,
+	       bench_reference());
+
+	for (int isa = RNN_ISA_C; isa <= RNN_ISA_AVX2; isa++) {
+		if (rnn_set_isa(isa))
+			printf("%d channels, batched %s: %.2f us/frame\n",
+			       CHANNELS, isa_names[isa], bench_batched());
+	}
+
+	for (size_t c = 0; c < CHANNELS; c++) {
+		free(rnn[c].vad_gru_state);
+		free(rnn[c].noise_gru_state);
+		free(rnn[c].denoise_gru_state);
+	}
+	return 0;
+}
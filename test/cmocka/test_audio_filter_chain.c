@@ -0,0 +1,215 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <obs.h>
+#include <util/bmem.h>
+
+#define SAMPLE_RATE 48000
+#define BLOCK_FRAMES 1024
+#define TEST_FRAMES (BLOCK_FRAMES * 2)
+
+struct test_filter {
+	float state[MAX_AV_PLANES];
+	float out[2][TEST_FRAMES];
+	size_t frames;
+};
+
+/* a one-pole lowpass, stateful so that its output only matches if each slice
+ * picks up where the last one stopped */
+static void lowpass_filter_audio_block(void *data, float *planes[],
+				       uint32_t frames)
+{
+	struct test_filter *lp = data;
+
+	for (size_t c = 0; c < MAX_AV_PLANES; c++) {
+		if (!planes[c])
+			continue;
+
+		for (uint32_t i = 0; i < frames; i++) {
+			lp->state[c] += 0.25f * (planes[c][i] - lp->state[c]);
+			planes[c][i] = lp->state[c];
+		}
+	}
+}
+
+/* squares the audio with filter_audio, which has to break up the fused chain
+ * without changing the order the filters run in */
+static struct obs_audio_data *square_filter_audio(void *data,
+						  struct obs_audio_data *audio)
+{
+	for (size_t c = 0; c < 2; c++) {
+		float *samples = (float *)audio->data[c];
+		for (uint32_t i = 0; i < audio->frames; i++)
+			samples[i] *= samples[i];
+	}
+
+	UNUSED_PARAMETER(data);
+	return audio;
+}
+
+/* keeps what comes out of the chain */
+static struct obs_audio_data *capture_filter_audio(void *data,
+						   struct obs_audio_data *audio)
+{
+	struct test_filter *cap = data;
+
+	for (size_t c = 0; c < 2; c++)
+		memcpy(cap->out[c] + cap->frames, audio->data[c],
+		       audio->frames * sizeof(float));
+	cap->frames += audio->frames;
+	return audio;
+}
+
+static const char *test_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "test";
+}
+
+static void *test_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(source);
+	return bzalloc(sizeof(struct test_filter));
+}
+
+static void test_destroy(void *data)
+{
+	bfree(data);
+}
+
+static struct obs_source_info test_input = {
+	.id = "test_input",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name = test_name,
+	.create = test_create,
+	.destroy = test_destroy,
+};
+
+static struct obs_source_info test_lowpass = {
+	.id = "test_lowpass",
+	.type = OBS_SOURCE_TYPE_FILTER,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name = test_name,
+	.create = test_create,
+	.destroy = test_destroy,
+	.filter_audio_block = lowpass_filter_audio_block,
+};
+
+static struct obs_source_info test_square = {
+	.id = "test_square",
+	.type = OBS_SOURCE_TYPE_FILTER,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name = test_name,
+	.create = test_create,
+	.destroy = test_destroy,
+	.filter_audio = square_filter_audio,
+};
+
+static struct obs_source_info test_capture = {
+	.id = "test_capture",
+	.type = OBS_SOURCE_TYPE_FILTER,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name = test_name,
+	.create = test_create,
+	.destroy = test_destroy,
+	.filter_audio = capture_filter_audio,
+};
+
+static obs_source_t *add_filter(obs_source_t *source, const char *id)
+{
+	obs_source_t *filter = obs_source_create_private(id, id, NULL);
+	obs_source_filter_add(source, filter);
+	obs_source_release(filter);
+	return filter;
+}
+
+/* two lowpasses fused into one chain, then a square, then a lowpass on its
+ * own, over a sawtooth that doesn't line up with the slices */
+static void fused_chain_test(void **state)
+{
+	static const struct {
+		size_t frame;
+		float value;
+	} expected[] = {
+		{2, 1.26953125e-06f}, {255, 0.212807208f},
+		{256, 0.222105682f},  {257, 0.231604487f},
+		{1024, 0.0305753574f}, {2047, 0.14564611f},
+	};
+	static float samples[2][BLOCK_FRAMES];
+
+	UNUSED_PARAMETER(state);
+
+	obs_source_t *source =
+		obs_source_create("test_input", "input", NULL, NULL);
+	add_filter(source, "test_lowpass");
+	add_filter(source, "test_lowpass");
+	add_filter(source, "test_square");
+	add_filter(source, "test_lowpass");
+	obs_source_t *capture = add_filter(source, "test_capture");
+
+	for (size_t n = 0; n < TEST_FRAMES; n += BLOCK_FRAMES) {
+		struct obs_source_audio audio = {
+			.data = {(uint8_t *)samples[0], (uint8_t *)samples[1]},
+			.frames = BLOCK_FRAMES,
+			.speakers = SPEAKERS_STEREO,
+			.format = AUDIO_FORMAT_FLOAT_PLANAR,
+			.samples_per_sec = SAMPLE_RATE,
+			.timestamp = n * 1000000000ULL / SAMPLE_RATE,
+		};
+
+		for (size_t i = 0; i < BLOCK_FRAMES; i++)
+			samples[0][i] = samples[1][i] =
+				(float)((n + i) % 100) / 100.0f;
+		obs_source_output_audio(source, &audio);
+	}
+
+	struct test_filter *cap = obs_obj_get_data(capture);
+
+	assert_int_equal(cap->frames, TEST_FRAMES);
+	for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+		size_t n = expected[i].frame;
+		assert_true(fabsf(cap->out[0][n] - expected[i].value) < 1e-6f);
+		assert_true(fabsf(cap->out[1][n] - expected[i].value) < 1e-6f);
+	}
+
+	obs_source_release(source);
+}
+
+static int setup(void **state)
+{
+	struct obs_audio_info ai = {SAMPLE_RATE, SPEAKERS_STEREO};
+
+	UNUSED_PARAMETER(state);
+
+	if (!obs_startup("en-US", NULL, NULL) || !obs_reset_audio(&ai))
+		return -1;
+
+	obs_register_source(&test_input);
+	obs_register_source(&test_lowpass);
+	obs_register_source(&test_square);
+	obs_register_source(&test_capture);
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	UNUSED_PARAMETER(state);
+	obs_shutdown();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(fused_chain_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,163 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <media-io/audio-resampler.h>
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+#define IN_RATE 44100
+#define OUT_RATE 48000
+#define BLOCK_FRAMES 441
+#define TEST_SECONDS 2
+#define TONE_HZ 1000.0
+
+struct resample_result {
+	float *data;
+	size_t frames;
+};
+
+/* least-squares fit of a sine at the known frequency, so the SNR doesn't
+ * depend on the latency of either backend */
+static double tone_snr(const float *data, size_t frames, double freq)
+{
+	double ss = 0.0, sc = 0.0, cc = 0.0, ys = 0.0, yc = 0.0;
+
+	for (size_t i = 0; i < frames; i++) {
+		double s = sin(2.0 * M_PI * freq * (double)i);
+		double c = cos(2.0 * M_PI * freq * (double)i);
+		ss += s * s;
+		sc += s * c;
+		cc += c * c;
+		ys += data[i] * s;
+		yc += data[i] * c;
+	}
+
+	double det = ss * cc - sc * sc;
+	double a = (ys * cc - yc * sc) / det;
+	double b = (yc * ss - ys * sc) / det;
+	double signal = 0.0, noise = 0.0;
+
+	for (size_t i = 0; i < frames; i++) {
+		double fit = a * sin(2.0 * M_PI * freq * (double)i) +
+			     b * cos(2.0 * M_PI * freq * (double)i);
+		signal += fit * fit;
+		noise += (data[i] - fit) * (data[i] - fit);
+	}
+
+	return 10.0 * log10(signal / noise);
+}
+
+static void resample_tone(struct resample_result *result,
+			  enum audio_resampler_type type,
+			  enum audio_resampler_quality quality)
+{
+	struct resample_info src = {IN_RATE, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	struct resample_info dst = {OUT_RATE, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	size_t total = (size_t)IN_RATE * TEST_SECONDS;
+	size_t capacity = (size_t)OUT_RATE * TEST_SECONDS + OUT_RATE / 10;
+	float left[BLOCK_FRAMES], right[BLOCK_FRAMES];
+	const uint8_t *input[2] = {(uint8_t *)left, (uint8_t *)right};
+
+	audio_resampler_t *rs = audio_resampler_create2(&dst, &src, type,
+							quality);
+	assert_non_null(rs);
+
+	result->data = bzalloc(capacity * sizeof(float));
+	result->frames = 0;
+
+	for (size_t pos = 0; pos < total; pos += BLOCK_FRAMES) {
+		uint8_t *output[MAX_AV_PLANES] = {0};
+		uint32_t out_frames = 0;
+		uint64_t ts_offset = 0;
+
+		for (size_t i = 0; i < BLOCK_FRAMES; i++) {
+			double t = (double)(pos + i) / IN_RATE;
+			left[i] = (float)(0.5 * sin(2.0 * M_PI * TONE_HZ * t));
+			right[i] = -left[i];
+		}
+
+		assert_true(audio_resampler_resample(rs, output, &out_frames,
+						     &ts_offset, input,
+						     BLOCK_FRAMES));
+
+		/* well under a millisecond of latency at 44.1 kHz */
+		assert_true(ts_offset < 2000000);
+		assert_true(result->frames + out_frames <= capacity);
+
+		memcpy(result->data + result->frames, output[0],
+		       out_frames * sizeof(float));
+		result->frames += out_frames;
+	}
+
+	audio_resampler_destroy(rs);
+}
+
+static void check_tone(enum audio_resampler_quality quality,
+		       double min_snr)
+{
+	struct resample_result ffmpeg, native;
+	size_t expected = (size_t)OUT_RATE * TEST_SECONDS;
+
+	resample_tone(&ffmpeg, AUDIO_RESAMPLER_FFMPEG,
+		      AUDIO_RESAMPLER_QUALITY_MEDIUM);
+	resample_tone(&native, AUDIO_RESAMPLER_POLYPHASE, quality);
+
+	/* both only hold back a filter's worth of samples */
+	assert_in_range(ffmpeg.frames, expected - 128, expected);
+	assert_in_range(native.frames, expected - 128, expected);
+
+	/* skip the filter warm-up at the start */
+	assert_true(tone_snr(native.data + 256, native.frames - 256,
+			     TONE_HZ / OUT_RATE) >= min_snr);
+
+	bfree(ffmpeg.data);
+	bfree(native.data);
+}
+
+static void accuracy_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	check_tone(AUDIO_RESAMPLER_QUALITY_FAST, 60.0);
+	check_tone(AUDIO_RESAMPLER_QUALITY_MEDIUM, 85.0);
+	check_tone(AUDIO_RESAMPLER_QUALITY_HIGH, 100.0);
+}
+
+static void fallback_test(void **state)
+{
+	struct resample_info src = {IN_RATE, AUDIO_FORMAT_16BIT,
+				    SPEAKERS_STEREO};
+	struct resample_info dst = {OUT_RATE, AUDIO_FORMAT_FLOAT,
+				    SPEAKERS_STEREO};
+
+	UNUSED_PARAMETER(state);
+
+	/* packed output isn't handled natively */
+	assert_null(audio_resampler_create2(&dst, &src,
+					    AUDIO_RESAMPLER_POLYPHASE,
+					    AUDIO_RESAMPLER_QUALITY_MEDIUM));
+
+	audio_resampler_t *rs = audio_resampler_create(&dst, &src);
+	assert_non_null(rs);
+	audio_resampler_destroy(rs);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(accuracy_test),
+		cmocka_unit_test(fallback_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,465 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include <obs.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <media-io/video-io.h>
+#include <media-io/video-frame.h>
+
+#define SAMPLE_RATE 48000
+#define FRAME_SIZE 1024
+#define MAX_FRAMES 4096
+
+/* ------------------------------------------------------------------------- */
+/* An audio encoder that waits on a gate before every frame, so the tests can
+ * hold it up while the audio thread keeps submitting */
+
+struct slow_encoder {
+	os_event_t *gate;
+	unsigned long encode_ms;
+
+	int64_t pts[MAX_FRAMES];
+	volatile long frames;
+};
+
+static struct slow_encoder slow;
+static uint8_t packet_data[1];
+
+static bool test_packet(struct encoder_frame *frame,
+			struct encoder_packet *packet,
+			enum obs_encoder_type type, bool *received_packet)
+{
+	packet->data = packet_data;
+	packet->size = sizeof(packet_data);
+	packet->pts = frame->pts;
+	packet->dts = frame->pts;
+	packet->type = type;
+	packet->keyframe = true;
+	*received_packet = true;
+	return true;
+}
+
+static const char *slow_encoder_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "Slow audio encoder";
+}
+
+static void *slow_encoder_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(encoder);
+	return &slow;
+}
+
+static void slow_encoder_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static bool slow_encoder_encode(void *data, struct encoder_frame *frame,
+				struct encoder_packet *packet,
+				bool *received_packet)
+{
+	struct slow_encoder *enc = data;
+	long idx;
+
+	os_event_wait(enc->gate);
+	if (enc->encode_ms)
+		os_sleep_ms(enc->encode_ms);
+
+	idx = os_atomic_load_long(&enc->frames);
+	if (idx < MAX_FRAMES)
+		enc->pts[idx] = frame->pts;
+	os_atomic_inc_long(&enc->frames);
+
+	return test_packet(frame, packet, OBS_ENCODER_AUDIO, received_packet);
+}
+
+static size_t slow_encoder_frame_size(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return FRAME_SIZE;
+}
+
+static struct obs_encoder_info slow_encoder_info = {
+	.id = "slow_audio_encoder",
+	.type = OBS_ENCODER_AUDIO,
+	.codec = "pcm",
+	.get_name = slow_encoder_name,
+	.create = slow_encoder_create,
+	.destroy = slow_encoder_destroy,
+	.encode = slow_encoder_encode,
+	.get_frame_size = slow_encoder_frame_size,
+};
+
+/* ------------------------------------------------------------------------- */
+/* A video encoder that asks for NV12 while the video output is RGBA, the way
+ * x264 and nvenc do */
+
+#define VIDEO_WIDTH 64
+#define VIDEO_HEIGHT 64
+
+static volatile long nv12_frames;
+static volatile long nv12_bad_frames;
+
+static bool nv12_encoder_encode(void *data, struct encoder_frame *frame,
+				struct encoder_packet *packet,
+				bool *received_packet)
+{
+	UNUSED_PARAMETER(data);
+
+	if (!frame->data[0] || !frame->data[1] || frame->data[2] ||
+	    frame->linesize[0] < VIDEO_WIDTH ||
+	    frame->linesize[1] < VIDEO_WIDTH)
+		os_atomic_inc_long(&nv12_bad_frames);
+	os_atomic_inc_long(&nv12_frames);
+
+	return test_packet(frame, packet, OBS_ENCODER_VIDEO, received_packet);
+}
+
+static void nv12_encoder_video_info(void *data, struct video_scale_info *info)
+{
+	UNUSED_PARAMETER(data);
+	info->format = VIDEO_FORMAT_NV12;
+}
+
+static struct obs_encoder_info nv12_encoder_info = {
+	.id = "nv12_video_encoder",
+	.type = OBS_ENCODER_VIDEO,
+	.codec = "h264",
+	.get_name = slow_encoder_name,
+	.create = slow_encoder_create,
+	.destroy = slow_encoder_destroy,
+	.encode = nv12_encoder_encode,
+	.get_video_info = nv12_encoder_video_info,
+};
+
+/* ------------------------------------------------------------------------- */
+/* Encoded outputs, so the encoder is started the way outputs start it */
+
+static const char *test_output_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "Test output";
+}
+
+static void *test_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	UNUSED_PARAMETER(settings);
+	return output;
+}
+
+static void test_output_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static bool test_output_start(void *data)
+{
+	obs_output_t *output = data;
+
+	if (!obs_output_can_begin_data_capture(output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(output, 0))
+		return false;
+	return obs_output_begin_data_capture(output, 0);
+}
+
+static void test_output_stop(void *data, uint64_t ts)
+{
+	UNUSED_PARAMETER(ts);
+	obs_output_end_data_capture(data);
+}
+
+static void test_output_packet(void *data, struct encoder_packet *packet)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(packet);
+}
+
+static struct obs_output_info test_output_info = {
+	.id = "test_encoded_audio_output",
+	.flags = OBS_OUTPUT_AUDIO | OBS_OUTPUT_ENCODED,
+	.get_name = test_output_name,
+	.create = test_output_create,
+	.destroy = test_output_destroy,
+	.start = test_output_start,
+	.stop = test_output_stop,
+	.encoded_packet = test_output_packet,
+};
+
+static struct obs_output_info test_video_output_info = {
+	.id = "test_encoded_video_output",
+	.flags = OBS_OUTPUT_VIDEO | OBS_OUTPUT_ENCODED,
+	.get_name = test_output_name,
+	.create = test_output_create,
+	.destroy = test_output_destroy,
+	.start = test_output_start,
+	.stop = test_output_stop,
+	.encoded_packet = test_output_packet,
+};
+
+/* ------------------------------------------------------------------------- */
+
+struct queue_test {
+	obs_encoder_t *encoder;
+	obs_output_t *output;
+	struct obs_encoder_queue_stats stats;
+};
+
+static void start_queue_test(struct queue_test *test, size_t depth,
+			     enum obs_encoder_queue_policy policy)
+{
+	memset(slow.pts, 0, sizeof(slow.pts));
+	slow.frames = 0;
+	slow.encode_ms = 0;
+	os_event_reset(slow.gate);
+
+	test->encoder = obs_audio_encoder_create("slow_audio_encoder",
+						 "slow encoder", NULL, 0, NULL);
+	assert_non_null(test->encoder);
+
+	obs_encoder_set_audio(test->encoder, obs_get_audio());
+	assert_true(obs_encoder_set_queue(test->encoder, depth, policy));
+
+	test->output = obs_output_create("test_encoded_audio_output",
+					 "test output", NULL, NULL);
+	assert_non_null(test->output);
+	obs_output_set_audio_encoder(test->output, test->encoder, 0);
+
+	assert_true(obs_output_start(test->output));
+}
+
+static void update_stats(struct queue_test *test)
+{
+	assert_true(obs_encoder_get_queue_stats(test->encoder, &test->stats));
+}
+
+/* the audio thread submits a frame every FRAME_SIZE samples */
+static void wait_for_submitted(struct queue_test *test, uint64_t submitted)
+{
+	uint64_t timeout = os_gettime_ns() + 5000000000ULL;
+
+	update_stats(test);
+	while (test->stats.submitted < submitted && os_gettime_ns() < timeout) {
+		os_sleep_ms(1);
+		update_stats(test);
+	}
+
+	assert_true(test->stats.submitted >= submitted);
+}
+
+static void wait_for_encoded(long frames)
+{
+	uint64_t timeout = os_gettime_ns() + 5000000000ULL;
+
+	while (os_atomic_load_long(&slow.frames) < frames &&
+	       os_gettime_ns() < timeout)
+		os_sleep_ms(1);
+
+	assert_true(os_atomic_load_long(&slow.frames) >= frames);
+}
+
+/* outputs only deactivate once their encoders have stopped */
+static void stop_output(obs_output_t *output)
+{
+	uint64_t timeout = os_gettime_ns() + 5000000000ULL;
+
+	obs_output_stop(output);
+	while (obs_output_active(output) && os_gettime_ns() < timeout)
+		os_sleep_ms(1);
+	assert_false(obs_output_active(output));
+}
+
+static void stop_queue_test(struct queue_test *test)
+{
+	stop_output(test->output);
+
+	/* stats are kept until the encoder is started again */
+	update_stats(test);
+	assert_int_equal(test->stats.depth, 0);
+	assert_int_equal(test->stats.encoded,
+			 test->stats.submitted - test->stats.dropped);
+	assert_int_equal(test->stats.encoded,
+			 (uint64_t)os_atomic_load_long(&slow.frames));
+	assert_true(test->stats.max_latency_ns >= test->stats.avg_latency_ns);
+
+	obs_output_release(test->output);
+	obs_encoder_release(test->encoder);
+}
+
+static void assert_contiguous(long first, long last)
+{
+	for (long i = first; i < last; i++)
+		assert_int_equal(slow.pts[i + 1], slow.pts[i] + FRAME_SIZE);
+}
+
+/* a full queue holds up the audio thread instead of dropping frames, and
+ * everything still queued when the encoder stops is encoded */
+static void block_test(void **state)
+{
+	const size_t depth = 4;
+	struct queue_test test;
+
+	UNUSED_PARAMETER(state);
+
+	start_queue_test(&test, depth, OBS_ENCODER_QUEUE_BLOCK);
+
+	/* one frame taken by the encoder, then a full queue */
+	wait_for_submitted(&test, depth + 1);
+	os_sleep_ms(100);
+
+	update_stats(&test);
+	assert_int_equal(test.stats.submitted, depth + 1);
+	assert_int_equal(test.stats.depth, depth);
+
+	/* slower than the audio thread, so the queue is full when stopped */
+	slow.encode_ms = 30;
+	os_event_signal(slow.gate);
+	wait_for_encoded(2);
+
+	stop_queue_test(&test);
+	assert_int_equal(test.stats.dropped, 0);
+	assert_true(slow.frames > (long)depth);
+	assert_int_equal(slow.pts[0], 0);
+	assert_contiguous(0, slow.frames - 1);
+}
+
+/* holds the encoder up until the queue has overflowed, then lets it encode
+ * what was kept */
+static void run_drop_test(size_t depth, enum obs_encoder_queue_policy policy)
+{
+	struct queue_test test;
+
+	start_queue_test(&test, depth, policy);
+
+	wait_for_submitted(&test, depth + 4);
+	update_stats(&test);
+	assert_int_equal(test.stats.depth, depth);
+	assert_int_equal(test.stats.dropped, test.stats.submitted - depth - 1);
+
+	os_event_signal(slow.gate);
+	wait_for_encoded((long)depth + 4);
+
+	stop_queue_test(&test);
+	assert_int_equal(test.stats.peak_depth, depth);
+	assert_int_equal(slow.pts[0], 0);
+}
+
+/* the frame being encoded and the queue, then a gap */
+static void drop_newest_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	run_drop_test(2, OBS_ENCODER_QUEUE_DROP_NEWEST);
+	assert_contiguous(0, 2);
+	assert_true(slow.pts[3] > slow.pts[2] + FRAME_SIZE);
+}
+
+/* the frame being encoded, a gap, then the queue */
+static void drop_oldest_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	run_drop_test(2, OBS_ENCODER_QUEUE_DROP_OLDEST);
+	assert_true(slow.pts[1] > slow.pts[0] + FRAME_SIZE);
+	assert_contiguous(1, 2);
+}
+
+/* queued frames are kept in the format the encoder asked for, not in the
+ * video output's format */
+static void video_format_test(void **state)
+{
+	struct video_output_info info = {
+		.name = "queue test video",
+		.format = VIDEO_FORMAT_RGBA,
+		.fps_num = 100,
+		.fps_den = 1,
+		.width = VIDEO_WIDTH,
+		.height = VIDEO_HEIGHT,
+	};
+	obs_encoder_t *encoder;
+	obs_output_t *output;
+	video_t *video;
+	uint64_t timestamp = os_gettime_ns();
+
+	UNUSED_PARAMETER(state);
+
+	assert_int_equal(video_output_open(&video, &info),
+			 VIDEO_OUTPUT_SUCCESS);
+
+	encoder = obs_video_encoder_create("nv12_video_encoder", "nv12", NULL,
+					   NULL);
+	assert_non_null(encoder);
+	obs_encoder_set_video(encoder, video);
+	assert_true(obs_encoder_set_queue(encoder, 2, OBS_ENCODER_QUEUE_BLOCK));
+
+	output = obs_output_create("test_encoded_video_output", "video output",
+				   NULL, NULL);
+	assert_non_null(output);
+	obs_output_set_video_encoder(output, encoder);
+	assert_true(obs_output_start(output));
+
+	for (int i = 0; i < 10; i++) {
+		struct video_frame frame;
+
+		os_sleepto_ns(timestamp);
+		if (video_output_lock_frame(video, &frame, 1, timestamp))
+			video_output_unlock_frame(video);
+		timestamp += video_output_get_frame_time(video);
+	}
+
+	stop_output(output);
+	assert_true(os_atomic_load_long(&nv12_frames) > 0);
+	assert_int_equal(os_atomic_load_long(&nv12_bad_frames), 0);
+
+	obs_output_release(output);
+	obs_encoder_release(encoder);
+	video_output_close(video);
+}
+
+static int setup(void **state)
+{
+	struct obs_audio_info ai = {SAMPLE_RATE, SPEAKERS_STEREO};
+
+	UNUSED_PARAMETER(state);
+
+	if (os_event_init(&slow.gate, OS_EVENT_TYPE_MANUAL) != 0)
+		return -1;
+	if (!obs_startup("en-US", NULL, NULL))
+		return -1;
+	if (!obs_reset_audio(&ai))
+		return -1;
+
+	obs_register_encoder(&slow_encoder_info);
+	obs_register_encoder(&nv12_encoder_info);
+	obs_register_output(&test_output_info);
+	obs_register_output(&test_video_output_info);
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	UNUSED_PARAMETER(state);
+	obs_shutdown();
+	os_event_destroy(slow.gate);
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(block_test),
+		cmocka_unit_test(drop_newest_test),
+		cmocka_unit_test(drop_oldest_test),
+		cmocka_unit_test(video_format_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,108 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs-interleave.h>
+
+/* packets are told apart by their pts, which is the order they're pushed */
+static void push(struct packet_interleaver *il, enum obs_encoder_type type,
+		 size_t track, int64_t dts_usec)
+{
+	struct encoder_packet packet = {0};
+
+	packet.type = type;
+	packet.track_idx = track;
+	packet.dts_usec = dts_usec;
+	packet.pts = (int64_t)il->next_seq;
+	interleaver_push(il, &packet);
+}
+
+static void push_mixed_streams(struct packet_interleaver *il)
+{
+	push(il, OBS_ENCODER_VIDEO, 0, 0);
+	push(il, OBS_ENCODER_AUDIO, 0, 0);
+	push(il, OBS_ENCODER_AUDIO, 1, 0);
+	push(il, OBS_ENCODER_AUDIO, 0, 20);
+	push(il, OBS_ENCODER_VIDEO, 0, 33);
+	push(il, OBS_ENCODER_AUDIO, 1, 20);
+	push(il, OBS_ENCODER_AUDIO, 0, 10);
+	push(il, OBS_ENCODER_VIDEO, 0, 33);
+	push(il, OBS_ENCODER_AUDIO, 1, 40);
+}
+
+static void assert_order(struct packet_interleaver *il, const int64_t *order,
+			 size_t count)
+{
+	assert_int_equal(il->num, count);
+
+	for (size_t i = 0; i < count; i++) {
+		struct encoder_packet packet;
+
+		interleaver_pop(il, &packet);
+		assert_int_equal(packet.pts, order[i]);
+	}
+
+	assert_null(interleaver_peek(il));
+}
+
+/* by DTS, video before audio, audio in the order it was received and video
+ * newest first */
+static void order_test(void **state)
+{
+	static const int64_t order[] = {0, 1, 2, 6, 3, 5, 7, 4, 8};
+	struct packet_interleaver il = {0};
+
+	UNUSED_PARAMETER(state);
+
+	push_mixed_streams(&il);
+	assert_order(&il, order, sizeof(order) / sizeof(order[0]));
+	interleaver_free(&il);
+}
+
+static void discard_test(void **state)
+{
+	static const int64_t order[] = {3, 5, 7, 4, 8};
+	struct packet_interleaver il = {0};
+
+	UNUSED_PARAMETER(state);
+
+	push_mixed_streams(&il);
+	assert_int_equal(interleaver_closest_audio(&il, 33)->packet.pts, 8);
+
+	interleaver_discard_dts(&il, 20);
+	assert_order(&il, order, sizeof(order) / sizeof(order[0]));
+	interleaver_free(&il);
+}
+
+/* audio tracks that started at different times keep the order they were in
+ * when they're offset to start at the same time */
+static void renumber_test(void **state)
+{
+	static const int64_t order[] = {1, 0};
+	struct packet_interleaver il = {0};
+
+	UNUSED_PARAMETER(state);
+
+	push(&il, OBS_ENCODER_AUDIO, 0, 95);
+	push(&il, OBS_ENCODER_AUDIO, 1, 90);
+	interleaver_renumber(&il);
+
+	interleaver_first(&il, 1)->packet.dts_usec -= 95;
+	interleaver_first(&il, 2)->packet.dts_usec -= 90;
+	interleaver_resort(&il);
+
+	assert_order(&il, order, sizeof(order) / sizeof(order[0]));
+	interleaver_free(&il);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(order_test),
+		cmocka_unit_test(discard_test),
+		cmocka_unit_test(renumber_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,187 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include <obs.h>
+#include <obs-avc.h>
+#include <util/bmem.h>
+
+/* an SPS, a 3-byte start code and an IDR slice */
+static const uint8_t annexb[] = {
+	0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1f, /* SPS */
+	0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x21, /* IDR slice */
+};
+
+static const uint8_t avcc[] = {
+	0x00, 0x00, 0x00, 0x04, 0x67, 0x42, 0x00, 0x1f, /* SPS */
+	0x00, 0x00, 0x00, 0x05, 0x65, 0x88, 0x84, 0x00, 0x21,
+};
+
+static void parse(struct encoder_packet *out, const uint8_t *data,
+		  size_t size)
+{
+	struct encoder_packet src = {
+		.data = (uint8_t *)data,
+		.size = size,
+		.type = OBS_ENCODER_VIDEO,
+	};
+
+	obs_parse_avc_packet(out, &src);
+}
+
+static void parse_avc_test(void **state)
+{
+	struct encoder_packet pkt;
+
+	UNUSED_PARAMETER(state);
+
+	parse(&pkt, annexb, sizeof(annexb));
+
+	assert_int_equal(pkt.size, sizeof(avcc));
+	assert_memory_equal(pkt.data, avcc, sizeof(avcc));
+	assert_true(pkt.keyframe);
+
+	obs_encoder_packet_release(&pkt);
+	assert_null(pkt.data);
+}
+
+/* empty NAL units grow the most when their start codes become sizes */
+static void parse_avc_growth_test(void **state)
+{
+	static uint8_t data[3 * 1000];
+	struct encoder_packet pkt;
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t i = 0; i < sizeof(data); i += 3) {
+		data[i] = 0;
+		data[i + 1] = 0;
+		data[i + 2] = 1;
+	}
+
+	parse(&pkt, data, sizeof(data));
+	assert_true(pkt.size <= sizeof(data) + sizeof(data) / 3 + 4);
+	obs_encoder_packet_release(&pkt);
+}
+
+static void reuse_test(void **state)
+{
+	struct obs_packet_pool_stats before, after;
+	struct encoder_packet pkt;
+	uint8_t *first;
+
+	UNUSED_PARAMETER(state);
+
+	parse(&pkt, annexb, sizeof(annexb));
+	first = pkt.data;
+	obs_encoder_packet_release(&pkt);
+
+	obs_get_packet_pool_stats(&before);
+	assert_true(before.cached_blocks > 0);
+
+	parse(&pkt, annexb, sizeof(annexb));
+	assert_true(pkt.data == first);
+
+	obs_get_packet_pool_stats(&after);
+	assert_int_equal(after.allocs, before.allocs + 1);
+	assert_int_equal(after.pool_hits, before.pool_hits + 1);
+	assert_int_equal(after.outstanding, before.outstanding + 1);
+	assert_int_equal(after.cached_blocks, before.cached_blocks - 1);
+
+	obs_encoder_packet_release(&pkt);
+}
+
+/* blocks have to go back to their own class after being reused */
+static void reuse_many_test(void **state)
+{
+	struct obs_packet_pool_stats before, after;
+	struct encoder_packet pkts[4];
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t i = 0; i < 4; i++)
+		parse(&pkts[i], annexb, sizeof(annexb));
+	for (size_t i = 0; i < 4; i++)
+		obs_encoder_packet_release(&pkts[i]);
+
+	for (size_t i = 0; i < 4; i++)
+		parse(&pkts[i], annexb, sizeof(annexb));
+
+	obs_get_packet_pool_stats(&before);
+	for (size_t i = 0; i < 4; i++)
+		obs_encoder_packet_release(&pkts[i]);
+	obs_get_packet_pool_stats(&after);
+
+	assert_int_equal(after.cached_blocks, before.cached_blocks + 4);
+	assert_int_equal(after.cached_bytes, before.cached_bytes + 4 * 1024);
+}
+
+static void shared_refs_test(void **state)
+{
+	struct obs_packet_pool_stats before, after;
+	struct encoder_packet pkt, refs[4];
+
+	UNUSED_PARAMETER(state);
+
+	obs_get_packet_pool_stats(&before);
+	parse(&pkt, annexb, sizeof(annexb));
+
+	for (size_t i = 0; i < 4; i++) {
+		obs_encoder_packet_ref(&refs[i], &pkt);
+		assert_true(refs[i].data == pkt.data);
+	}
+
+	obs_encoder_packet_release(&pkt);
+	for (size_t i = 0; i < 3; i++)
+		obs_encoder_packet_release(&refs[i]);
+
+	/* still held by the last reference */
+	obs_get_packet_pool_stats(&after);
+	assert_int_equal(after.frees, before.frees);
+	assert_int_equal(after.outstanding, before.outstanding + 1);
+	assert_memory_equal(refs[3].data, avcc, sizeof(avcc));
+
+	obs_encoder_packet_release(&refs[3]);
+
+	obs_get_packet_pool_stats(&after);
+	assert_int_equal(after.allocs, before.allocs + 1);
+	assert_int_equal(after.frees, before.frees + 1);
+	assert_int_equal(after.outstanding, before.outstanding);
+}
+
+static void unpooled_test(void **state)
+{
+	struct obs_packet_pool_stats before, after;
+	struct encoder_packet pkt;
+	size_t size = 20 * 1024 * 1024;
+	uint8_t *data = bzalloc(size);
+
+	UNUSED_PARAMETER(state);
+
+	obs_get_packet_pool_stats(&before);
+	parse(&pkt, data, size);
+	obs_encoder_packet_release(&pkt);
+	obs_get_packet_pool_stats(&after);
+
+	assert_int_equal(after.unpooled, before.unpooled + 1);
+	assert_int_equal(after.cached_bytes, before.cached_bytes);
+
+	bfree(data);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(parse_avc_test),
+		cmocka_unit_test(parse_avc_growth_test),
+		cmocka_unit_test(reuse_test),
+		cmocka_unit_test(reuse_many_test),
+		cmocka_unit_test(shared_refs_test),
+		cmocka_unit_test(unpooled_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
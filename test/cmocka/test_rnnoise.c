@@ -0,0 +1,202 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/c99defs.h>
+
+#include <rnnoise.h>
+#include "rnn.h"
+#include "rnn_data.h"
+
+#define CHANNELS 4
+#define TEST_FRAMES 50
+#define NB_FEATURES 42
+#define NB_BANDS 22
+#define FRAME_SIZE 480
+
+extern const struct RNNModel rnnoise_model_orig;
+
+struct channel {
+	RNNState rnn;
+	float gains[NB_BANDS];
+	float vad;
+};
+
+static void channel_init(struct channel *ch)
+{
+	memset(ch, 0, sizeof(*ch));
+	ch->rnn.model = &rnnoise_model_orig;
+	ch->rnn.vad_gru_state =
+		calloc(rnnoise_model_orig.vad_gru_size, sizeof(float));
+	ch->rnn.noise_gru_state =
+		calloc(rnnoise_model_orig.noise_gru_size, sizeof(float));
+	ch->rnn.denoise_gru_state =
+		calloc(rnnoise_model_orig.denoise_gru_size, sizeof(float));
+}
+
+static void channel_free(struct channel *ch)
+{
+	free(ch->rnn.vad_gru_state);
+	free(ch->rnn.noise_gru_state);
+	free(ch->rnn.denoise_gru_state);
+}
+
+/* features in roughly the range RNNoise produces them, different for every
+ * channel and frame */
+static void make_features(float *features, size_t channel, size_t frame)
+{
+	uint32_t seed = (uint32_t)(channel * 7919 + frame * 104729 + 1);
+
+	for (size_t i = 0; i < NB_FEATURES; i++) {
+		seed = seed * 1664525 + 1013904223;
+		features[i] = (float)(seed >> 8) / (float)(1 << 24) * 8.0f -
+			      4.0f;
+	}
+}
+
+static void run_batched(struct channel *ch, size_t frame)
+{
+	float features[CHANNELS][NB_FEATURES];
+	RNNState *rnn[CHANNELS];
+	const float *input[CHANNELS];
+	float *gains[CHANNELS];
+	float vad[CHANNELS];
+
+	for (size_t c = 0; c < CHANNELS; c++) {
+		make_features(features[c], c, frame);
+		rnn[c] = &ch[c].rnn;
+		input[c] = features[c];
+		gains[c] = ch[c].gains;
+	}
+
+	compute_rnn_batch(rnn, CHANNELS, gains, vad, input);
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		ch[c].vad = vad[c];
+}
+
+static void run_reference(struct channel *ch, size_t frame)
+{
+	float features[NB_FEATURES];
+
+	for (size_t c = 0; c < CHANNELS; c++) {
+		make_features(features, c, frame);
+		compute_rnn_reference(&ch[c].rnn, ch[c].gains, &ch[c].vad,
+				      features);
+	}
+}
+
+static void check_isa(int isa, float tolerance)
+{
+	struct channel ref[CHANNELS], test[CHANNELS];
+	float max_diff = 0.0f;
+
+	if (!rnn_set_isa(isa))
+		return;
+
+	for (size_t c = 0; c < CHANNELS; c++) {
+		channel_init(&ref[c]);
+		channel_init(&test[c]);
+	}
+
+	for (size_t frame = 0; frame < TEST_FRAMES; frame++) {
+		run_reference(ref, frame);
+		run_batched(test, frame);
+
+		for (size_t c = 0; c < CHANNELS; c++) {
+			if (tolerance == 0.0f) {
+				assert_memory_equal(ref[c].gains,
+						    test[c].gains,
+						    sizeof(ref[c].gains));
+				assert_true(ref[c].vad == test[c].vad);
+				continue;
+			}
+
+			for (size_t i = 0; i < NB_BANDS; i++) {
+				float d = fabsf(ref[c].gains[i] -
+						test[c].gains[i]);
+				if (d > max_diff)
+					max_diff = d;
+			}
+			float d = fabsf(ref[c].vad - test[c].vad);
+			if (d > max_diff)
+				max_diff = d;
+		}
+	}
+
+	assert_true(max_diff <= tolerance);
+
+	for (size_t c = 0; c < CHANNELS; c++) {
+		channel_free(&ref[c]);
+		channel_free(&test[c]);
+	}
+}
+
+/* without FMA every sum is built up in the same order as the reference.  FMA
+ * rounds each term once rather than twice, and the recurrent state carries
+ * the difference forward, but it stays far below anything audible. */
+static void batched_matches_reference_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	check_isa(RNN_ISA_C, 0.0f);
+	check_isa(RNN_ISA_SSE2, 0.0f);
+	check_isa(RNN_ISA_AVX2, 0.02f);
+}
+
+/* batching whole frames gives the same output as one frame at a time */
+static void process_frames_test(void **state)
+{
+	DenoiseState *single[CHANNELS], *batched[CHANNELS];
+	static float a[CHANNELS][FRAME_SIZE], b[CHANNELS][FRAME_SIZE];
+	float *out[CHANNELS];
+	float vad[CHANNELS];
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t c = 0; c < CHANNELS; c++) {
+		single[c] = rnnoise_create(NULL);
+		batched[c] = rnnoise_create(NULL);
+		out[c] = b[c];
+	}
+
+	for (size_t frame = 0; frame < TEST_FRAMES; frame++) {
+		for (size_t c = 0; c < CHANNELS; c++) {
+			for (size_t i = 0; i < FRAME_SIZE; i++) {
+				size_t n = frame * FRAME_SIZE + i;
+				size_t v = (n * (c + 3) * 7919) % 20001;
+				a[c][i] = (float)v - 10000.0f;
+				b[c][i] = a[c][i];
+			}
+		}
+
+		rnnoise_process_frames(batched, out, (const float **)out, vad,
+				       CHANNELS);
+
+		for (size_t c = 0; c < CHANNELS; c++) {
+			float v = rnnoise_process_frame(single[c], a[c], a[c]);
+			assert_memory_equal(a[c], b[c], sizeof(a[c]));
+			assert_true(v == vad[c]);
+		}
+	}
+
+	for (size_t c = 0; c < CHANNELS; c++) {
+		rnnoise_destroy(single[c]);
+		rnnoise_destroy(batched[c]);
+	}
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(batched_matches_reference_test),
+		cmocka_unit_test(process_frames_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,116 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/platform.h>
+#include <util/threading.h>
+#include <media-io/video-io.h>
+#include <media-io/video-frame.h>
+
+#define FPS 100
+#define FRAMES 150
+
+struct test_input {
+	uint64_t frame_time;
+	uint64_t delay_ns;
+
+	uint64_t last_timestamp;
+	volatile long frames;
+	volatile long bad_timestamps;
+};
+
+static void input_callback(void *param, struct video_data *frame)
+{
+	struct test_input *input = param;
+
+	if (input->last_timestamp &&
+	    frame->timestamp != input->last_timestamp + input->frame_time)
+		os_atomic_inc_long(&input->bad_timestamps);
+	input->last_timestamp = frame->timestamp;
+
+	if (input->delay_ns)
+		os_sleepto_ns(os_gettime_ns() + input->delay_ns);
+
+	os_atomic_inc_long(&input->frames);
+}
+
+static void wait_for_frames(struct test_input *input, long frames)
+{
+	uint64_t timeout = os_gettime_ns() + 5000000000ULL;
+
+	while (os_atomic_load_long(&input->frames) < frames &&
+	       os_gettime_ns() < timeout)
+		os_sleep_ms(1);
+}
+
+/* an input running at half rate must not take up so much of the frame cache
+ * that frames have to be skipped for everyone else */
+static void slow_input_test(void **state)
+{
+	struct video_output_info info = {
+		.name = "test",
+		.format = VIDEO_FORMAT_I420,
+		.fps_num = FPS,
+		.fps_den = 1,
+		.width = 64,
+		.height = 64,
+		.max_wait_ms = 1,
+	};
+	struct video_input_stats fast_stats, slow_stats;
+	struct test_input fast = {0}, slow = {0};
+	video_t *video;
+
+	UNUSED_PARAMETER(state);
+
+	assert_int_equal(video_output_open(&video, &info),
+			 VIDEO_OUTPUT_SUCCESS);
+
+	fast.frame_time = video_output_get_frame_time(video);
+	slow.frame_time = fast.frame_time;
+	slow.delay_ns = fast.frame_time * 2;
+
+	assert_true(video_output_connect(video, NULL, input_callback, &fast));
+	assert_true(video_output_connect(video, NULL, input_callback, &slow));
+
+	uint64_t timestamp = os_gettime_ns();
+	for (long i = 0; i < FRAMES; i++) {
+		struct video_frame frame;
+
+		os_sleepto_ns(timestamp);
+		if (video_output_lock_frame(video, &frame, 1, timestamp))
+			video_output_unlock_frame(video);
+		timestamp += fast.frame_time;
+	}
+
+	wait_for_frames(&fast, FRAMES);
+	wait_for_frames(&slow, FRAMES);
+
+	assert_true(video_output_get_input_stats(video, input_callback, &fast,
+						 &fast_stats));
+	assert_true(video_output_get_input_stats(video, input_callback, &slow,
+						 &slow_stats));
+
+	/* the slow input gets duplicates, which keep its frame count and
+	 * timestamps intact, and nobody else is affected */
+	assert_int_equal(video_output_get_lock_waits(video), 0);
+	assert_int_equal(fast_stats.skipped_frames, 0);
+	assert_int_equal(fast_stats.total_frames, FRAMES);
+	assert_true(slow_stats.skipped_frames > 0);
+	assert_int_equal(slow_stats.total_frames, FRAMES);
+	assert_int_equal(fast.bad_timestamps, 0);
+	assert_int_equal(slow.bad_timestamps, 0);
+
+	video_output_disconnect(video, input_callback, &slow);
+	video_output_disconnect(video, input_callback, &fast);
+	video_output_close(video);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(slow_input_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,164 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/video-scaler.h>
+
+#define SRC_WIDTH 1920
+#define SRC_HEIGHT 1080
+#define BENCH_FRAMES 60
+
+struct test_frame {
+	uint8_t *data[4];
+	uint32_t linesize[4];
+};
+
+static void frame_init(struct test_frame *frame, uint32_t width,
+		       uint32_t height)
+{
+	/* I420 */
+	frame->linesize[0] = width;
+	frame->linesize[1] = width / 2;
+	frame->linesize[2] = width / 2;
+	frame->linesize[3] = 0;
+	frame->data[0] = bzalloc(width * height);
+	frame->data[1] = bzalloc(width * height / 4);
+	frame->data[2] = bzalloc(width * height / 4);
+	frame->data[3] = NULL;
+}
+
+static void frame_free(struct test_frame *frame)
+{
+	for (size_t i = 0; i < 4; i++)
+		bfree(frame->data[i]);
+}
+
+static void frame_fill(struct test_frame *frame, uint32_t width,
+		       uint32_t height)
+{
+	for (uint32_t y = 0; y < height; y++)
+		for (uint32_t x = 0; x < width; x++)
+			frame->data[0][y * width + x] = (uint8_t)(x * 3 + y);
+
+	for (uint32_t y = 0; y < height / 2; y++) {
+		for (uint32_t x = 0; x < width / 2; x++) {
+			size_t i = y * (width / 2) + x;
+			frame->data[1][i] = (uint8_t)(x + y * 5);
+			frame->data[2][i] = (uint8_t)(x * 7 - y);
+		}
+	}
+}
+
+/* the bands round their filter coefficients on their own, so samples may be
+ * off by 1 from a full-frame scale */
+static void compare_frames(const struct test_frame *a,
+			   const struct test_frame *b, uint32_t width,
+			   uint32_t height)
+{
+	const size_t sizes[3] = {width * height, width * height / 4,
+				 width * height / 4};
+
+	for (size_t plane = 0; plane < 3; plane++) {
+		for (size_t i = 0; i < sizes[plane]; i++) {
+			int diff = (int)a->data[plane][i] -
+				   (int)b->data[plane][i];
+			assert_in_range(diff, -1, 1);
+		}
+	}
+}
+
+static double bench(video_scaler_t *scaler, struct test_frame *dst,
+		    const struct test_frame *src)
+{
+	uint64_t start = os_gettime_ns();
+
+	for (size_t i = 0; i < BENCH_FRAMES; i++)
+		assert_true(video_scaler_scale(
+			scaler, dst->data, dst->linesize,
+			(const uint8_t *const *)src->data, src->linesize));
+
+	double seconds = (double)(os_gettime_ns() - start) / 1000000000.0;
+	return (double)BENCH_FRAMES / seconds;
+}
+
+static void sliced_matches_single(uint32_t width, uint32_t height,
+				  enum video_scale_type type, int threads)
+{
+	struct video_scale_info src_info = {
+		.format = VIDEO_FORMAT_I420,
+		.width = SRC_WIDTH,
+		.height = SRC_HEIGHT,
+		.range = VIDEO_RANGE_PARTIAL,
+		.colorspace = VIDEO_CS_709,
+	};
+	struct video_scale_info dst_info = src_info;
+	struct test_frame src, single_frame, sliced_frame;
+	video_scaler_t *single = NULL;
+	video_scaler_t *sliced = NULL;
+
+	dst_info.width = width;
+	dst_info.height = height;
+
+	frame_init(&src, SRC_WIDTH, SRC_HEIGHT);
+	frame_init(&single_frame, width, height);
+	frame_init(&sliced_frame, width, height);
+	frame_fill(&src, SRC_WIDTH, SRC_HEIGHT);
+
+	assert_int_equal(video_scaler_create(&single, &dst_info, &src_info,
+					     type),
+			 VIDEO_SCALER_SUCCESS);
+	assert_int_equal(video_scaler_create_sliced(&sliced, &dst_info,
+						    &src_info, type, threads),
+			 VIDEO_SCALER_SUCCESS);
+	assert_int_equal(video_scaler_get_threads(sliced), threads);
+
+	double single_fps = bench(single, &single_frame, &src);
+	double sliced_fps = bench(sliced, &sliced_frame, &src);
+
+	compare_frames(&single_frame, &sliced_frame, width, height);
+
+	printf("%ux%u -> %ux%u: 1 thread %.1f fps, %d threads %.1f fps\n",
+	       SRC_WIDTH, SRC_HEIGHT, width, height, single_fps, threads,
+	       sliced_fps);
+
+	video_scaler_destroy(single);
+	video_scaler_destroy(sliced);
+	frame_free(&src);
+	frame_free(&single_frame);
+	frame_free(&sliced_frame);
+}
+
+static void sliced_downscale_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	sliced_matches_single(1280, 720, VIDEO_SCALE_FAST_BILINEAR, 4);
+}
+
+static void sliced_upscale_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	sliced_matches_single(2560, 1440, VIDEO_SCALE_BICUBIC, 3);
+}
+
+static void sliced_same_size_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	sliced_matches_single(SRC_WIDTH, SRC_HEIGHT, VIDEO_SCALE_BILINEAR, 2);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(sliced_downscale_test),
+		cmocka_unit_test(sliced_upscale_test),
+		cmocka_unit_test(sliced_same_size_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}